@@ -115,10 +115,70 @@ local function CreateChunkMeshGroup(faces, material)
     return meshGroups
 end
 
+-- Welded, indexed parts from the native mesher, filled by the module since
+-- the mesh library has no way to write indices
+local function CreateIndexedMeshes(group, groupIndex, material)
+    local meshGroups = {}
+
+    for part = 1, group.parts do
+        local newMesh = Mesh(material)
+        if RTXFillWorldMesh(newMesh, groupIndex, part) then
+            table.insert(meshGroups, newMesh)
+        else
+            newMesh:Destroy()
+        end
+    end
+
+    return meshGroups
+end
+
+-- Faces, texinfo and vertices read by the module straight from the map file,
+-- bucketed the same way as below but with integer chunk keys
+local function BuildNativeMapMeshes()
+    if not RTXBuildWorldMeshes then return false end
+
+    local data = file.Read("maps/" .. game.GetMap() .. ".bsp", "GAME")
+    if not data then return false end
+
+    local groups = RTXBuildWorldMeshes(data, CONVARS.CHUNK_SIZE:GetInt())
+    if not groups then return false end
+
+    local totalVertCount = 0
+    for groupIndex, group in ipairs(groups) do
+        local material = materialCache[group.material]
+        if not material then
+            material = Material(group.material)
+            materialCache[group.material] = material
+        end
+
+        local renderType = group.translucent and "translucent" or "opaque"
+        mapMeshes[renderType][group.chunk] = mapMeshes[renderType][group.chunk] or {}
+        mapMeshes[renderType][group.chunk][group.material] = {
+            meshes = CreateIndexedMeshes(group, groupIndex, material),
+            material = material
+        }
+        totalVertCount = totalVertCount + group.vertices
+    end
+    RTXClearWorldMeshes()
+
+    return true, totalVertCount
+end
+
 -- Main Mesh Building Function
 local function BuildMapMeshes()
-    mapMeshes = {}
+    mapMeshes = {
+        opaque = {},
+        translucent = {}
+    }
     materialCache = {}
+
+    local nativeStart = SysTime()
+    local native, nativeVertCount = BuildNativeMapMeshes()
+    if native then
+        print(string.format("[RTX Fixes] Built chunked meshes natively in %.2f seconds", SysTime() - nativeStart))
+        print(string.format("[RTX Fixes] Total vertex count: %d", nativeVertCount))
+        return
+    end
     
     if not NikNaks or not NikNaks.CurrentMap then return end
 
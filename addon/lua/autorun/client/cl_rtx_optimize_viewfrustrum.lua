@@ -29,6 +29,11 @@ local cv_freq_close = CreateClientConVar("frustum_freq_close", "0.25", true, fal
 local cv_freq_medium = CreateClientConVar("frustum_freq_medium", "0.5", true, false, "Update frequency for medium distance entities")
 local cv_freq_far = CreateClientConVar("frustum_freq_far", "1.0", true, false, "Update frequency for far entities")
 local cv_freq_very_far = CreateClientConVar("frustum_freq_very_far", "2.0", true, false, "Update frequency for very far entities")
+-- The flow costs about 1.3 ms per frame on flatgrass, 5 ms at the 99th percentile,
+-- and is skipped while the camera stands still
+local cv_portal_flow = CreateClientConVar("pvs_portal_flow", "0", true, false, "Also cull entities outside the clusters the camera can see through portals (about 1.3 ms per moving frame)")
+local cv_move_threshold = CreateClientConVar("pvs_move_threshold", "32", true, false, "How far an entity moves before its cluster is looked up again")
+local cv_occlusion = CreateClientConVar("pvs_occlusion_culling", "0", true, false, "Also hide entities that are behind world brushes")
 
 
 local LIGHT_UPDATER_MODELS = {
@@ -70,26 +75,35 @@ local currentRadius = cv_min_radius:GetFloat()
 local lastAreaCheck = 0
 local AREA_CHECK_INTERVAL = 0.5
 
--- Entity Timers
-local EntityUpdateTimes = {}
+-- Entity Timers, weak keyed so removed entities don't pile up
+local EntityUpdateTimes = setmetatable({}, { __mode = "k" })
+-- Closest tier first, GetUpdateFrequency relies on the order
 local EntityUpdateFrequencies = {
-    -- Distance squared = update frequency in seconds
-    [256 * 256] = 0.1,    -- Very close entities (256 units): update frequently
-    [512 * 512] = 0.25,   -- Close entities (512 units): update moderately
-    [1024 * 1024] = 0.5,  -- Medium distance (1024 units): update occasionally
-    [2048 * 2048] = 1.0,  -- Far entities (2048 units): update rarely
-    [4096 * 4096] = 2.0   -- Very far entities (4096+ units): update very rarely
+    -- Distance squared, update frequency in seconds
+    { 256 * 256, 0.1 },    -- Very close entities (256 units): update frequently
+    { 512 * 512, 0.25 },   -- Close entities (512 units): update moderately
+    { 1024 * 1024, 0.5 },  -- Medium distance (1024 units): update occasionally
+    { 2048 * 2048, 1.0 },  -- Far entities (2048 units): update rarely
+    { 4096 * 4096, 2.0 }   -- Very far entities (4096+ units): update very rarely
 }
 
 -- PVS Cache
 
 local PVSCache = {
     data = nil,
+    native = false, -- visible set lives in the binary module
     timestamp = 0,
     leaf = nil,
     nearbyLeafs = nil
 }
 local LastPVSPosition = Vector(0, 0, 0)
+
+-- Native PVS from the binary module, loaded once per map
+local nativeVisibility = false
+-- Portal graph from the map's .prt, narrows the PVS to what the camera can see
+local nativePortals = false
+-- Broken vis regions from maps/<map>_novis.txt, for r_forcenovis 2
+local nativeNoVis = false
 local PVSCacheTimeout = cv_update_rate:GetFloat()  -- Use the existing convar
 local PVSCacheDistance = 32  -- Only recalculate if moved more than this
 
@@ -142,25 +156,23 @@ end
 
 -- Function to update frequencies from ConVars
 local function UpdateFrequencies()
-    EntityUpdateFrequencies[256 * 256] = cv_freq_very_close:GetFloat()
-    EntityUpdateFrequencies[512 * 512] = cv_freq_close:GetFloat()
-    EntityUpdateFrequencies[1024 * 1024] = cv_freq_medium:GetFloat()
-    EntityUpdateFrequencies[2048 * 2048] = cv_freq_far:GetFloat()
-    EntityUpdateFrequencies[4096 * 4096] = cv_freq_very_far:GetFloat()
+    EntityUpdateFrequencies[1][2] = cv_freq_very_close:GetFloat()
+    EntityUpdateFrequencies[2][2] = cv_freq_close:GetFloat()
+    EntityUpdateFrequencies[3][2] = cv_freq_medium:GetFloat()
+    EntityUpdateFrequencies[4][2] = cv_freq_far:GetFloat()
+    EntityUpdateFrequencies[5][2] = cv_freq_very_far:GetFloat()
 end
 
 -- Helper function to determine update frequency based on distance
 local function GetUpdateFrequency(distSqr)
-    local frequency = EntityUpdateFrequencies[4096 * 4096] -- Default to very far frequency
-    
-    for dist, freq in pairs(EntityUpdateFrequencies) do
-        if distSqr <= dist then
-            frequency = freq
-            break
+    for _, tier in ipairs(EntityUpdateFrequencies) do
+        if distSqr <= tier[1] then
+            return tier[2]
         end
     end
-    
-    return frequency
+
+    -- Default to very far frequency
+    return EntityUpdateFrequencies[#EntityUpdateFrequencies][2]
 end
 
 -- Helper function to check for RTX light updater entities
@@ -355,6 +367,20 @@ if debug_draw_enabled then
     hook.Add("PostDrawTranslucentRenderables", "DebugVisibilityRadius", DrawDebugRadius)
 end
 
+-- One native probe answers both the open area and corridor checks, it is
+-- only cast again once per AREA_CHECK_INTERVAL
+local cachedEnvironment = nil
+local lastEnvironmentProbe = 0
+
+local function GetEnvironment(ply, pos)
+    local curTime = CurTime()
+    if not cachedEnvironment or curTime > lastEnvironmentProbe + AREA_CHECK_INTERVAL or curTime < lastEnvironmentProbe then
+        cachedEnvironment = RTXAnalyzeEnvironment(pos, ply:GetAimVector())
+        lastEnvironmentProbe = curTime
+    end
+    return cachedEnvironment
+end
+
 -- Function to check if we're in an open area
 local function IsInOpenArea()
     local bsp = NikNaks.CurrentMap
@@ -365,6 +391,12 @@ local function IsInOpenArea()
     
     local pos = ply:GetPos()
     if not pos then return false end  -- Add position check
+
+    -- All nine traces as one native fan against the map's brushes
+    if nativeVisibility then
+        local env = GetEnvironment(ply, pos)
+        if env then return env.openArea end
+    end
     
     local upTrace = util.TraceLine({
         start = pos,
@@ -444,6 +476,11 @@ local function IsInCorridor()
     
     local pos = ply:GetPos()
     if not pos then return false end
+
+    if nativeVisibility then
+        local env = GetEnvironment(ply, pos)
+        if env then return env.corridor end
+    end
     
     local traces = {}
     local traceCount = 4
@@ -520,13 +557,42 @@ local function UpdateVisibilityData()
     currentLeaf = leaf
     PVSCache.leaf = leaf
     
-    if cv_enable_pvs:GetBool() then
+    if cv_enable_pvs:GetBool() and nativeVisibility then
+        -- Native path, the binary module merges the vis rows as bitsets
+        local points, clusters
+        if cv_indoor_mode:GetBool() and IsInCorridor() then
+            local viewDir = ply:GetAimVector()
+            local extendDist = cv_corridor_extend:GetFloat()
+
+            points = {}
+            for i = 1, cv_visibility_buffer:GetInt() do
+                points[i] = pos + viewDir * (extendDist * i)
+            end
+
+            if cv_flicker_prevention:GetBool() and leaf.neighbors then
+                clusters = {}
+                for _, neighborLeaf in ipairs(leaf.neighbors) do
+                    if neighborLeaf.cluster then
+                        table.insert(clusters, neighborLeaf.cluster)
+                    end
+                end
+            end
+        end
+
+        RTXUpdateVisibleClusters(pos, points, clusters, true)
+        PVSCache.data = nil
+        PVSCache.native = true
+        cachedPVS = nil
+    end
+
+    if cv_enable_pvs:GetBool() and not nativeVisibility then
         -- Get PVS data with safety check
         local pvs = bsp:PVSForOrigin(pos)
         if not pvs then return end
         
         -- Cache the new PVS data
         PVSCache.data = pvs
+        PVSCache.native = false
         cachedPVS = pvs
 
         -- If in indoor mode, handle corridors specially
@@ -575,7 +641,25 @@ local function UpdateVisibilityData()
                 end
             end
         end
-        
+    end
+
+    if cv_enable_pvs:GetBool() and nativeVisibility and RTXQueryLeafs then
+        -- Native octree over the leaf bounds, kept as a set of leaf indices
+        local leafSet = {}
+        for _, index in ipairs(RTXQueryLeafs("sphere", pos, GetSmartRadius())) do
+            leafSet[index] = true
+        end
+        local viewDir = ply:GetAimVector()
+        for _, index in ipairs(RTXQueryLeafs("ray", pos, pos + viewDir * cv_view_distance:GetFloat())) do
+            leafSet[index] = true
+        end
+
+        PVSCache.nearbyLeafSet = leafSet
+        PVSCache.nearbyLeafs = nil
+        cachedNearbyLeafs = nil
+    elseif cv_enable_pvs:GetBool() then
+        PVSCache.nearbyLeafSet = nil
+
         -- Get nearby leafs with smart radius
         local radius = GetSmartRadius()
         local nearbyLeafs = bsp:SphereInLeafs(0, pos, radius)
@@ -599,7 +683,9 @@ local function UpdateVisibilityData()
         end
     else
         PVSCache.data = nil
+        PVSCache.native = false
         PVSCache.nearbyLeafs = nil
+        PVSCache.nearbyLeafSet = nil
         cachedPVS = nil
         cachedNearbyLeafs = nil
     end
@@ -626,7 +712,7 @@ local function ShouldRenderEntity(ent)
     end
     
     local bsp = NikNaks.CurrentMap
-    if not bsp or not PVSCache.data then return true end
+    if not bsp or not (PVSCache.data or PVSCache.native) then return true end
     
     -- Always render if culling is disabled
     if not cv_disable_culling:GetBool() then return true end
@@ -660,31 +746,44 @@ local function ShouldRenderEntity(ent)
     end
     
     -- Check cached PVS first
-    if PVSCache.data[entLeaf.cluster] then return true end
+    if PVSCache.native then
+        if RTXIsClusterVisible(entLeaf.cluster) then return true end
+    elseif PVSCache.data[entLeaf.cluster] then
+        return true
+    end
     
     -- Check cached nearby leafs
-    if PVSCache.nearbyLeafs then
+    local nearby = false
+    if PVSCache.nearbyLeafSet then
+        nearby = PVSCache.nearbyLeafSet[RTXFindLeaf(entPos)] == true
+    elseif PVSCache.nearbyLeafs then
+        local entIndex = entLeaf:GetIndex()
         for _, leaf in ipairs(PVSCache.nearbyLeafs) do
-            if leaf and entLeaf and leaf:GetIndex() == entLeaf:GetIndex() then
-                if isOpenArea then
-                    local ply = LocalPlayer()
-                    if not IsValid(ply) then return true end
-                    
-                    local plyPos = ply:GetPos()
-                    if not plyPos then return true end
-                    
-                    local toEnt = (entPos - plyPos):GetNormalized()
-                    local viewDir = ply:GetAimVector()
-                    if not viewDir then return true end
-                    
-                    local dotProduct = viewDir:Dot(toEnt)
-                    
-                    return dotProduct > -0.5 or plyPos:DistToSqr(entPos) < (cv_min_radius:GetFloat() ^ 2)
-                end
-                return true
+            if leaf and leaf:GetIndex() == entIndex then
+                nearby = true
+                break
             end
         end
     end
+
+    if nearby then
+        if isOpenArea then
+            local ply = LocalPlayer()
+            if not IsValid(ply) then return true end
+            
+            local plyPos = ply:GetPos()
+            if not plyPos then return true end
+            
+            local toEnt = (entPos - plyPos):GetNormalized()
+            local viewDir = ply:GetAimVector()
+            if not viewDir then return true end
+            
+            local dotProduct = viewDir:Dot(toEnt)
+            
+            return dotProduct > -0.5 or plyPos:DistToSqr(entPos) < (cv_min_radius:GetFloat() ^ 2)
+        end
+        return true
+    end
     
     return false
 end
@@ -961,12 +1060,75 @@ for _, cvar in ipairs({
     cvars.AddChangeCallback(cvar:GetName(), function() UpdateFrequencies() end)
 end
 
+-- Settings for the native render bounds pass, the Vectors are reused every frame
+local NativeBoundsSettings = {
+    frequencies = {},
+    hugeMins = Vector(), hugeMaxs = Vector(),
+    lightMins = Vector(), lightMaxs = Vector(),
+    updaterMins = Vector(), updaterMaxs = Vector(),
+    fullMins = Vector(-16384, -16384, -16384), fullMaxs = Vector(16384, 16384, 16384),
+    hiddenMins = Vector(-1, -1, -1), hiddenMaxs = Vector(1, 1, 1)
+}
+
+local function SetCubeBounds(mins, maxs, size)
+    mins:SetUnpacked(-size, -size, -size)
+    maxs:SetUnpacked(size, size, size)
+end
+
+local nativeCorridor = false
+local lastCorridorCheck = 0
+
+local function UpdateRenderBoundsNative(ply)
+    if cv_enable_pvs:GetBool() then
+        UpdateVisibilityData()
+    end
+
+    local settings = NativeBoundsSettings
+    settings.time = CurTime()
+    settings.boundsSize = cached_bounds_size
+    settings.staticProps = cv_static_prop_enabled:GetBool()
+    settings.pvs = cv_enable_pvs:GetBool() and PVSCache.native
+    settings.radius = GetSmartRadius()
+    settings.minRadius = cv_min_radius:GetFloat()
+    settings.openArea = isOpenArea
+    settings.portalFlow = nativePortals and cv_portal_flow:GetBool()
+
+    -- The corridor traces are far too slow for every frame
+    if settings.time > lastCorridorCheck + AREA_CHECK_INTERVAL then
+        nativeCorridor = cv_indoor_mode:GetBool() and IsInCorridor()
+        lastCorridorCheck = settings.time
+    end
+    settings.corridor = nativeCorridor
+    settings.moveThreshold = cv_move_threshold:GetFloat()
+    settings.occlusion = cv_occlusion:GetBool()
+    settings.origin = ply:GetPos()
+    settings.aim = ply:GetAimVector()
+
+    settings.frequencies[1] = cv_freq_very_close:GetFloat()
+    settings.frequencies[2] = cv_freq_close:GetFloat()
+    settings.frequencies[3] = cv_freq_medium:GetFloat()
+    settings.frequencies[4] = cv_freq_far:GetFloat()
+    settings.frequencies[5] = cv_freq_very_far:GetFloat()
+
+    SetCubeBounds(settings.hugeMins, settings.hugeMaxs, cached_bounds_size)
+    SetCubeBounds(settings.lightMins, settings.lightMaxs, cv_light_render_distance:GetFloat())
+    SetCubeBounds(settings.updaterMins, settings.updaterMaxs, cv_light_updater_bounds:GetFloat())
+
+    RTXUpdateEntityRenderBounds(ents.GetAll(), settings)
+end
+
 -- Optimized think hook with timer-based updates
 local next_update = 0
 hook.Add("Think", "UpdateRenderBounds", function()
     if not LocalPlayer then return end
     if not IsGameReady() then return end
     if not cv_disable_culling:GetBool() then return end
+
+    -- One native pass per frame, entities are refreshed on their own distance tier
+    if nativeVisibility and RTXUpdateEntityRenderBounds then
+        UpdateRenderBoundsNative(LocalPlayer())
+        return
+    end
     
     local curTime = CurTime()
     if curTime < next_update then return end
@@ -1099,6 +1261,58 @@ hook.Add("InitPostEntity", "SetupLightUpdaterOverrides", function()
     end
 end)
 
+hook.Add("InitPostEntity", "LoadNativeVisibility", function()
+    nativeVisibility = false
+    if not RTXLoadMapVisibility then return end
+
+    local data = file.Read("maps/" .. game.GetMap() .. ".bsp", "GAME")
+    if not data then return end
+
+    nativeVisibility = RTXLoadMapVisibility(data)
+
+    -- Leaky spots that r_forcenovis 2 turns engine vis off in, only these
+    -- maps' own list, everything else keeps normal vis
+    nativeNoVis = false
+    if nativeVisibility and RTXLoadNoVisRegions then
+        local regions = file.Read("maps/" .. game.GetMap() .. "_novis.txt", "GAME")
+        nativeNoVis = RTXLoadNoVisRegions(regions or "") > 0
+    end
+
+    nativePortals = false
+    if not nativeVisibility or not RTXLoadMapPortals then return end
+
+    -- vbsp leaves the .prt next to the map, only maps that ship it get portal flow
+    local portals = file.Read("maps/" .. game.GetMap() .. ".prt", "GAME")
+    if portals then
+        nativePortals = RTXLoadMapPortals(portals)
+    end
+end)
+
+-- The engine asks whether to force novis every view, the answer follows the camera
+hook.Add("RenderScene", "RTXUpdateNoVisRegion", function(origin)
+    if not nativeNoVis then return end
+
+    RTXUpdateNoVisRegion(origin)
+end)
+
+-- Portal flow follows the camera every frame while entity or light culling uses it
+hook.Add("RenderScene", "RTXUpdatePortalVisibility", function(origin, angles, fov)
+    if not nativePortals then return end
+    local lightClusters = GetConVar("rtx_light_cluster_culling")
+    if not cv_portal_flow:GetBool() and not (lightClusters and lightClusters:GetBool()) then return end
+
+    RTXUpdatePortalVisibility(origin, angles:Forward(), angles:Right(), angles:Up(), fov, ScrW() / ScrH())
+end)
+
+-- The occlusion buffer is redrawn for every view while anything tests against it
+hook.Add("RenderScene", "RTXUpdateOcclusion", function(origin, angles, fov)
+    if not nativeVisibility then return end
+    local lightOcclusion = GetConVar("rtx_light_occlusion_culling")
+    if not cv_occlusion:GetBool() and not (lightOcclusion and lightOcclusion:GetBool()) then return end
+
+    RTXUpdateOcclusion(origin, angles:Forward(), angles:Right(), angles:Up(), fov, ScrW() / ScrH())
+end)
+
 hook.Add("InitPostEntity", "InitializeStaticProps", function()
     -- Delay the initialization to ensure everything is loaded
     timer.Create("InitializeStaticPropsDelay", 2, 1, function()
@@ -1304,6 +1518,87 @@ concommand.Add("debug_update_frequencies", function()
     print("Very Far Entities:", stats.very_far)
 end)
 
+concommand.Add("debug_native_render_bounds", function()
+    if not RTXGetRenderBoundsStats then return end
+
+    local stats = RTXGetRenderBoundsStats()
+    print(string.format("Native render bounds: %d entities, %d due, %d updated (%d visible, %d hidden) in %.3f ms",
+        stats.entities, stats.due, stats.updated, stats.visible, stats.hidden, stats.milliseconds))
+    print(string.format("  %d reclassified after moving, %d redone for cluster visibility changes, %d occluded",
+        stats.reclassified, stats.flipped, stats.occluded))
+end)
+
+hook.Add("EntityRemoved", "ForgetRemovedEntity", function(ent)
+    EntityUpdateTimes[ent] = nil
+    if not nativeVisibility then return end
+
+    local index = ent:EntIndex()
+    if index <= 0 then
+        -- Clientside static props keep their cached bounds in a native slot
+        if ent.RTXBoundsSlot and RTXForgetRenderBoundsProp then RTXForgetRenderBoundsProp(ent.RTXBoundsSlot) end
+        return
+    end
+
+    if RTXRemoveSpatialEntity then RTXRemoveSpatialEntity(index) end
+    if RTXForgetRenderBoundsEntity then RTXForgetRenderBoundsEntity(index) end
+end)
+
+concommand.Add("debug_spatial_index", function()
+    if not nativeVisibility or not RTXQueryLeafs then
+        print("Spatial index is not loaded for this map")
+        return
+    end
+
+    -- Nothing culls through the entity tree, it is only filled for this
+    RTXUpdateSpatialEntities(ents.GetAll())
+
+    local ply = LocalPlayer()
+    local pos = ply:GetPos()
+    local radius = GetSmartRadius()
+    print(string.format("Within %d units: %d leafs, %d entities", math.floor(radius),
+        #RTXQueryLeafs("sphere", pos, radius), #RTXQueryEntities("sphere", pos, radius)))
+    print(string.format("Along the view: %d leafs, %d entities",
+        #RTXQueryLeafs("ray", pos, pos + ply:GetAimVector() * cv_view_distance:GetFloat()),
+        #RTXQueryEntities("ray", pos, pos + ply:GetAimVector() * cv_view_distance:GetFloat())))
+end)
+
+concommand.Add("debug_environment", function()
+    if not nativeVisibility or not RTXAnalyzeEnvironment then
+        print("Native traces are not loaded for this map")
+        return
+    end
+
+    local ply = LocalPlayer()
+    local env = RTXAnalyzeEnvironment(ply:GetPos(), ply:GetAimVector())
+    if not env then return end
+
+    print(string.format("Ceiling %.2f, open space %.2f, corridor space %.2f, forward %.2f in %.3f ms",
+        env.ceiling, env.openSpace, env.corridorSpace, env.forward, env.milliseconds))
+    print(string.format("Open area: %s, corridor: %s, axis %s (elongation %.2f)",
+        tostring(env.openArea), tostring(env.corridor), tostring(env.axis), env.elongation))
+end)
+
+concommand.Add("debug_portal_visibility", function()
+    if not nativePortals then
+        print("Portal visibility is not loaded for this map")
+        return
+    end
+
+    local stats = RTXGetPortalVisibilityStats()
+    print(string.format("Portal flow: %d clusters visible, %d/%d portals passed in %.3f ms%s",
+        stats.clustersVisible, stats.portalsPassed, stats.portalsTested, stats.milliseconds,
+        stats.truncated and " (truncated, using PVS)" or stats.reused and " (camera still, last flow kept)" or ""))
+end)
+
+concommand.Add("debug_occlusion", function()
+    if not RTXGetOcclusionStats then return end
+
+    local stats = RTXGetOcclusionStats()
+    print(string.format("Occlusion: %d/%d occluder brushes drawn (%d triangles) in %.3f ms",
+        stats.occluders, stats.brushes, stats.triangles, stats.milliseconds))
+    print(string.format("  %d of %d tests occluded", stats.occluded, stats.tested))
+end)
+
 concommand.Add("debug_batch_performance", function()
     print("\nBatch Processing Performance:")
     print("Processed Entities:", PerformanceMonitor.stats.processedEntities)
@@ -0,0 +1,130 @@
+-- Console commands for the binary module's D3D9 shader fixes.
+if not CLIENT then return end
+
+-- Validation policies
+concommand.Add("rtx_validation_policy", function(ply, cmd, args)
+    if not RTXSetShaderValidationPolicy then return end
+
+    if not args[1] or not args[2] or not args[3] then
+        print("Usage: rtx_validation_policy <material|shader> <pattern> <off|sampled|first|always> [interval]")
+        return
+    end
+
+    RTXSetShaderValidationPolicy(args[1], args[2], args[3], tonumber(args[4]) or 1)
+    print(string.format("Set %s policy for '%s' to %s", args[1], args[2], args[3]))
+end)
+
+concommand.Add("rtx_validation_policy_remove", function(ply, cmd, args)
+    if not RTXRemoveShaderValidationPolicy then return end
+
+    if not args[1] or not args[2] then
+        print("Usage: rtx_validation_policy_remove <material|shader> <pattern>")
+        return
+    end
+
+    if RTXRemoveShaderValidationPolicy(args[1], args[2]) then
+        print(string.format("Removed %s policy for '%s'", args[1], args[2]))
+    else
+        print(string.format("No %s policy for '%s'", args[1], args[2]))
+    end
+end)
+
+concommand.Add("rtx_validation_policy_reload", function()
+    if not RTXReloadShaderValidationPolicies then return end
+    RTXReloadShaderValidationPolicies()
+end)
+
+concommand.Add("rtx_validation_policy_stats", function()
+    if not RTXPrintShaderValidationPolicies then return end
+    RTXPrintShaderValidationPolicies()
+end)
+
+-- The policy cache is keyed by material address, run this after
+-- mat_reloadallmaterials. Map changes clear it on their own.
+concommand.Add("rtx_validation_policy_flush", function()
+    if not RTXClearShaderValidationCache then return end
+    RTXClearShaderValidationCache()
+end)
+
+hook.Add("InitPostEntity", "RTXValidationPolicyFlush", function()
+    if RTXClearShaderValidationCache then RTXClearShaderValidationCache() end
+end)
+
+-- Crash site summary
+concommand.Add("rtx_crash_sites", function(ply, cmd, args)
+    if not RTXPrintShaderCrashSites then return end
+    RTXPrintShaderCrashSites(tonumber(args[1]) or 10)
+end)
+
+-- Adaptive guard state
+concommand.Add("rtx_shader_hooks", function()
+    if not RTXGetShaderHookStates then return end
+
+    print("\nShader fix guards (rtx_shaderfix_adaptive " .. GetConVarNumber("rtx_shaderfix_adaptive") .. "):")
+    for name, state in SortedPairs(RTXGetShaderHookStates()) do
+        print(string.format("  %-26s %-9s %d frames since last rejection",
+            name, state.armed and "armed" or "disarmed", state.framesSinceReject))
+    end
+end)
+
+-- Particle primitive budget, figures are for the last completed frame
+concommand.Add("rtx_particle_budget_stats", function()
+    if not RTXGetParticleBudgetStats then return end
+
+    local stats = RTXGetParticleBudgetStats()
+    if stats.budget == 0 then
+        print("Particle budget disabled (rtx_particle_budget 0)")
+        return
+    end
+
+    print(string.format("Particle budget: %d / %d primitives, skipped %d draws (%d primitives), min screen fraction %.4f",
+        stats.admittedPrimitives, stats.budget, stats.skippedDraws, stats.skippedPrimitives, stats.threshold))
+end)
+
+-- Async vertex buffer validation
+concommand.Add("rtx_async_vb_stats", function()
+    if not RTXPrintAsyncVertexBufferStats then return end
+    RTXPrintAsyncVertexBufferStats()
+end)
+
+-- Signatures resolved by the binary module
+concommand.Add("rtx_signatures", function()
+    if not RTXPrintSignatures then return end
+    RTXPrintSignatures()
+end)
+
+-- Detours installed by the binary module, toggled at runtime to compare frame times
+concommand.Add("rtx_hooks", function()
+    if not RTXPrintHooks then return end
+    RTXPrintHooks()
+end)
+
+local function HookNameComplete(cmd, args)
+    if not RTXGetHooks then return {} end
+
+    local partial = string.lower(string.Trim(args))
+    local results = {}
+    for name in SortedPairs(RTXGetHooks()) do
+        if string.find(string.lower(name), partial, 1, true) then
+            table.insert(results, cmd .. " " .. name)
+        end
+    end
+    return results
+end
+
+local function SetHookFromConsole(enabled)
+    return function(ply, cmd, args)
+        if not RTXSetHookEnabled then return end
+        if not args[1] then
+            print("Usage: " .. cmd .. " <hook name>, see rtx_hooks")
+            return
+        end
+
+        if RTXSetHookEnabled(args[1], enabled) then
+            print(string.format("%s hook %s", enabled and "Enabled" or "Disabled", args[1]))
+        end
+    end
+end
+
+concommand.Add("rtx_hook_enable", SetHookFromConsole(true), HookNameComplete)
+concommand.Add("rtx_hook_disable", SetHookFromConsole(false), HookNameComplete)
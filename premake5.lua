@@ -36,6 +36,9 @@ CreateWorkspace({name = "RTXFixesBinary", abi_compatible = false, path = ""})
 		files {
 			"source/rtx_lights/*",
 			"source/shader_fixes/*",
+			"source/signatures/*",
+			"source/visibility/*",
+			"source/world_mesh/*",
 		} 
 
 
@@ -10,6 +10,8 @@
 #include "cbase.h"
 #include "viewrender.h"
 #include "globalconvars.h"
+#include "signatures/signature_registry.h"
+#include "visibility/novis_regions.h"
 
 using namespace GarrysMod::Lua; 
 
@@ -25,14 +27,20 @@ Define_method_Hook(void, CViewRenderRender, CViewRender*, vrect_t* rect)
 Define_method_Hook(bool, CViewRenderShouldForceNoVis, void*)
 {   
 	bool original = CViewRenderShouldForceNoVis_trampoline()(_this);
-	if (GlobalConvars::r_forcenovis && GlobalConvars::r_forcenovis->GetBool()) {
+	if (GlobalConvars::r_forcenovis) {
+		int mode = GlobalConvars::r_forcenovis->GetInt();
 		//Msg("[Culling Fixes] Hi\n");
-		return true;
+		if (mode == 1) return true;
+
+		// Only while the view is inside one of the map's broken vis regions
+		if (mode == 2 && NoVisRegions::Instance().IsActive()) return true;
 	}
 	return original;
 }
 
 static StudioRenderConfig_t s_StudioRenderConfig;
+
+static const RegisteredSignature s_ShouldForceNoVisSignature("client.dll", "CViewRender::ShouldForceNoVis", SIGNATURE("0F B6 81 54 03 00 00 C3"));
  
 void CullingHooks::Initialize() {
 	try {
@@ -54,8 +62,7 @@ void CullingHooks::Initialize() {
 		// 0F B6 81 54 03 00 00 C3
 		// EDIT: its the 2nd/4th one, 2nd doesn't work, 4th works but will change with updates :(
 
-		static const char sign2[] = "0F B6 81 54 03 00 00 C3";
-		auto CViewRenderShouldForceNoVis = ScanSign(client, sign2, sizeof(sign2) - 1);
+		auto CViewRenderShouldForceNoVis = s_ShouldForceNoVisSignature.Get();
 		if (!CViewRenderShouldForceNoVis) { Msg("[Culling Fixes] CViewRender::ShouldForceNoVis == NULL\n"); return; }
 		else {
 			Msg("[Culling Fixes] Hooked CViewRender::ShouldForceNoVis\n");
@@ -70,7 +77,7 @@ void CullingHooks::Initialize() {
 void CullingHooks::Shutdown() {
 	// Existing shutdown code  
 	//CViewRenderRender_hook.Disable();
-	CViewRenderShouldForceNoVis_hook.Disable();
+	HookRegistry::Instance().DisableSubsystem("culling_fixes");
 
 	// Log shutdown completion
 	Msg("[Culling Fixes] Shutdown complete\n");
@@ -3,6 +3,8 @@
 // hopefully we either get permission to use this or we can replace it with our own code.
 
 #include "e_utils.h"
+#include "signatures/signature.h"
+#include "signatures/pe_image.h"
 #include <Windows.h>
 #include <scanning/symbolfinder.hpp>
 #include <detouring/hook.hpp>
@@ -44,42 +46,36 @@ bool GetLibraryInfo(const void* handle, DynLibInfo& lib)
 
 	lib.memorySize = opt->SizeOfImage;
 	lib.baseAddress = reinterpret_cast<void*>(baseAddr);
+	lib.timeDateStamp = file->TimeDateStamp;
+
+	// Identifies the build together with the timestamp and image size. Left
+	// at 0 when the section headers don't parse, the base and size above are
+	// still good for a plain scan, there is just nothing to cache against.
+	PEImage image;
+	lib.headerHash = image.Parse(reinterpret_cast<const uint8_t*>(baseAddr), lib.memorySize, PEImage::Layout::Mapped) ?
+		image.GetHeaderHash() : 0;
 	return true;
 }
 
 void* ScanSign(const void* handle, const char* sig, size_t len, const void* start)
+{
+	CompiledSignature compiled;
+	if (!compiled.Compile(sig, len))
+		return nullptr;
+
+	return ScanSign(handle, compiled.GetPattern(), len, start);
+}
+
+void* ScanSign(const void* handle, const SignaturePattern& pattern, size_t len, const void* start)
 {
 	DynLibInfo lib;
 	memset(&lib, 0, sizeof(DynLibInfo));
 	if (!GetLibraryInfo(handle, lib))
 		return nullptr;
 
-	uint8_t* ptr = reinterpret_cast<uint8_t*>(start > lib.baseAddress ? const_cast<void*>(start) : lib.baseAddress);
-	uint8_t* end = reinterpret_cast<uint8_t*>(lib.baseAddress) + lib.memorySize - len;
-	bool found = true;
-	while (ptr < end)
-	{
-		uint8_t* tmp = ptr;
-		for (size_t i = 0; i < len; ++i)
-		{
-			if (sig[i] == ' ') { continue; }
-			if (sig[i] == '?') { tmp++; continue; }
-
-			if (tmp[0] != strtoul(&sig[i], NULL, 16))
-			{
-				found = false;
-				break;
-			}
-			i++;
-			tmp++;
-		}
-
-		if (found)
-			return ptr;
-
-		++ptr;
-		found = true;
-	}
-
-	return nullptr;
-}
\ No newline at end of file
+	// Same bounds as the old byte-by-byte parser, len is the string length
+	const uint8_t* ptr = reinterpret_cast<const uint8_t*>(start > lib.baseAddress ? start : lib.baseAddress);
+	const uint8_t* end = reinterpret_cast<const uint8_t*>(lib.baseAddress) + lib.memorySize - len;
+
+	return const_cast<uint8_t*>(FindSignature(ptr, end, pattern));
+}
@@ -6,15 +6,104 @@
 #include <Windows.h>
 #include <scanning/symbolfinder.hpp>
 #include <detouring/hook.hpp>
+#include <stdexcept>
+#include "signatures/signature.h"
+#include "hook_registry.h"
 
 struct DynLibInfo
 {
 	void* baseAddress;
 	size_t memorySize;
+	uint32_t timeDateStamp;
+	uint64_t headerHash; // FNV-1a of the PE checksum and section headers, 0 if they don't parse
 };
 
+// Signature parsed at compile time, e.g. SIGNATURE("0F B6 81 ?? ?? ?? ?? C3").
+// Tokens are two hex digits or '?' (one wildcard byte each, like the runtime
+// parser), separated by single spaces. Anything else fails the build when
+// the literal is constant evaluated.
+template <size_t N>
+struct Signature
+{
+	static constexpr size_t kCapacity = N > 1 ? N - 1 : 1;
+
+	uint8_t bytes[kCapacity] = {};
+	uint8_t mask[kCapacity] = {};
+	size_t size = 0;
+	size_t anchor = 0;
+	bool hasAnchor = false;
+	const char* text = nullptr;
+
+	constexpr Signature(const char (&sig)[N]) : text(sig)
+	{
+		const size_t len = N - 1;
+		if (len == 0)
+			throw std::invalid_argument("empty signature");
+
+		size_t i = 0;
+		while (i < len)
+		{
+			if (sig[i] == '?')
+			{
+				bytes[size] = 0;
+				mask[size] = 0;
+				i++;
+			}
+			else
+			{
+				int high = SignatureHexValue(sig[i]);
+				int low = i + 1 < len ? SignatureHexValue(sig[i + 1]) : -1;
+				if (high < 0 || low < 0)
+					throw std::invalid_argument("signature bytes must be two hex digits or ?");
+
+				bytes[size] = static_cast<uint8_t>(high * 16 + low);
+				mask[size] = 0xFF;
+				i += 2;
+			}
+			size++;
+
+			if (i == len)
+				break;
+
+			// "??" is two wildcards with nothing between them
+			if (sig[i] == '?' && sig[i - 1] == '?')
+				continue;
+
+			if (sig[i] != ' ' || i + 1 == len || sig[i + 1] == ' ')
+				throw std::invalid_argument("signature tokens must be separated by single spaces");
+			i++;
+		}
+
+		hasAnchor = SelectSignatureAnchor(mask, bytes, size, anchor);
+	}
+
+	// ScanSign's end bound is based on the string length, not the byte count
+	constexpr size_t GetSourceLength() const { return N - 1; }
+
+	SignaturePattern GetPattern() const
+	{
+		SignaturePattern pattern;
+		pattern.bytes = bytes;
+		pattern.mask = mask;
+		pattern.size = size;
+		pattern.anchor = anchor;
+		pattern.hasAnchor = hasAnchor;
+		return pattern;
+	}
+};
+
+// Forces compile-time evaluation so a malformed signature is a build error
+#define SIGNATURE(x) ([]() { constexpr Signature sig(x); return sig; }())
+
 bool GetLibraryInfo(const void* handle, DynLibInfo& lib);
 void* ScanSign(const void* handle, const char* sig, size_t len, const void* start = NULL);
+void* ScanSign(const void* handle, const SignaturePattern& pattern, size_t len, const void* start = NULL);
+
+template <size_t N>
+void* ScanSign(const void* handle, const Signature<N>& sig, const void* start = NULL)
+{
+	return ScanSign(handle, sig.GetPattern(), sig.GetSourceLength(), start);
+}
 
 #define GetVTable(ptr) ((void***)ptr)[0]
 
@@ -22,6 +111,7 @@ void* ScanSign(const void* handle, const char* sig, size_t len, const void* star
 
 #define Define_method_Hook(rettype, name, thistype, ...) \
 	Detouring::Hook name##_hook; \
+	static HookRegistration name##_registration(#name, __FILE__, &name##_hook); \
 	typedef rettype (__fastcall* name##_decl)(thistype _this, __VA_ARGS__); \
 	inline name##_decl name##_trampoline() { return name##_hook.GetTrampoline<name##_decl>();}\
 	rettype __fastcall name##_detour(thistype _this, __VA_ARGS__) 
@@ -29,6 +119,7 @@ void* ScanSign(const void* handle, const char* sig, size_t len, const void* star
 
 #define Define_method_Hook(rettype, name, thistype, ...) \
 	Detouring::Hook name##_hook; \
+	static HookRegistration name##_registration(#name, __FILE__, &name##_hook); \
 	typedef rettype (__thiscall* name##_decl)(thistype _this, __VA_ARGS__); \
 	inline name##_decl name##_trampoline() { return name##_hook.GetTrampoline<name##_decl>();}\
 	rettype __fastcall name##_detour(thistype _this, void* edx, __VA_ARGS__) 
@@ -36,6 +127,7 @@ void* ScanSign(const void* handle, const char* sig, size_t len, const void* star
 
 #define Define_Hook(rettype, name, ...) \
 	Detouring::Hook name##_hook; \
+	static HookRegistration name##_registration(#name, __FILE__, &name##_hook); \
 	typedef rettype (* name##_decl)(__VA_ARGS__); \
 	inline name##_decl name##_trampoline() { return name##_hook.GetTrampoline<name##_decl>();}\
 	rettype name##_detour(__VA_ARGS__) 
@@ -46,6 +138,7 @@ void* ScanSign(const void* handle, const char* sig, size_t len, const void* star
 	Detouring::Hook::Target target(reinterpret_cast<void*>(targ)); \
 	name##_hook.Create(target, name##_detour); \
 	name##_hook.Enable(); \
+	HookRegistry::Instance().OnHookCreated(&name##_hook, reinterpret_cast<void*>(targ)); \
 }
 
 #define HOOK_SIGN(x) x;
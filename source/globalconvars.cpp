@@ -10,6 +10,16 @@ static GarrysMod::Lua::ILuaShared* lua_shared = nullptr;
 static GarrysMod::Lua::ILuaConVars* m_pLuaConVars;
  
 ConVar* GlobalConvars::r_forcenovis;
+ConVar* GlobalConvars::rtx_shaderfix_debug_sample;
+ConVar* GlobalConvars::rtx_shaderfix_adaptive;
+ConVar* GlobalConvars::rtx_shaderfix_adaptive_frames;
+ConVar* GlobalConvars::rtx_particle_budget;
+ConVar* GlobalConvars::rtx_shaderfix_async_vb;
+ConVar* GlobalConvars::rtx_shaderfix_async_vb_default;
+ConVar* GlobalConvars::rtx_signature_scan_all_sections;
+ConVar* GlobalConvars::rtx_shaderfix_vtable_hooks;
+ConVar* GlobalConvars::rtx_light_cluster_culling;
+ConVar* GlobalConvars::rtx_light_occlusion_culling;
 void GlobalConvars::InitialiseConVars() {
 	m_pLuaConVars = loader_lua_shared.GetInterface<GarrysMod::Lua::ILuaConVars>(GMOD_LUACONVARS_INTERFACE);
 	if (!m_pLuaConVars) {
@@ -17,8 +27,38 @@ void GlobalConvars::InitialiseConVars() {
 		return;
 	}
 
-	r_forcenovis = m_pLuaConVars->CreateConVar("r_forcenovis", "0", "Force disable vis", FCVAR_ARCHIVE);
+	r_forcenovis = m_pLuaConVars->CreateConVar("r_forcenovis", "0", "Force disable vis (1 = everywhere, 2 = only inside the map's novis regions)", FCVAR_ARCHIVE);
 	if (!r_forcenovis) { r_forcenovis = cvar->FindVar("r_forcenovis"); }
 	if (!r_forcenovis) { Error("[RTX Fixes 2] Failed to create r_forcenovis convar\n"); }
 	else { Msg("[RTX Fixes 2] r_forcenovis convar created\n"); }
+
+	rtx_shaderfix_debug_sample = m_pLuaConVars->CreateConVar("rtx_shaderfix_debug_sample", "0", "Log 1 in N hooked division calls (0 = off)", 0);
+	if (!rtx_shaderfix_debug_sample) { Error("[RTX Fixes 2] Failed to create rtx_shaderfix_debug_sample convar\n"); }
+
+	rtx_shaderfix_adaptive = m_pLuaConVars->CreateConVar("rtx_shaderfix_adaptive", "0", "Unhook D3D9 guards that have not rejected anything for a while", FCVAR_ARCHIVE);
+	if (!rtx_shaderfix_adaptive) { Error("[RTX Fixes 2] Failed to create rtx_shaderfix_adaptive convar\n"); }
+
+	rtx_shaderfix_adaptive_frames = m_pLuaConVars->CreateConVar("rtx_shaderfix_adaptive_frames", "1800", "Clean frames before an adaptive guard unhooks itself", FCVAR_ARCHIVE);
+	if (!rtx_shaderfix_adaptive_frames) { Error("[RTX Fixes 2] Failed to create rtx_shaderfix_adaptive_frames convar\n"); }
+
+	rtx_particle_budget = m_pLuaConVars->CreateConVar("rtx_particle_budget", "0", "Particle primitives drawn per frame, smallest on screen are dropped first (0 = off)", FCVAR_ARCHIVE);
+	if (!rtx_particle_budget) { Error("[RTX Fixes 2] Failed to create rtx_particle_budget convar\n"); }
+
+	rtx_shaderfix_async_vb = m_pLuaConVars->CreateConVar("rtx_shaderfix_async_vb", "0", "Validate particle vertex buffers on a worker thread, verdicts apply from the next frame", FCVAR_ARCHIVE);
+	if (!rtx_shaderfix_async_vb) { Error("[RTX Fixes 2] Failed to create rtx_shaderfix_async_vb convar\n"); }
+
+	rtx_shaderfix_async_vb_default = m_pLuaConVars->CreateConVar("rtx_shaderfix_async_vb_default", "1", "Draw vertex buffers that have no async verdict yet (1 = optimistic, 0 = pessimistic)", FCVAR_ARCHIVE);
+	if (!rtx_shaderfix_async_vb_default) { Error("[RTX Fixes 2] Failed to create rtx_shaderfix_async_vb_default convar\n"); }
+
+	rtx_signature_scan_all_sections = m_pLuaConVars->CreateConVar("rtx_signature_scan_all_sections", "0", "Scan whole module images for signatures instead of only their code sections", FCVAR_ARCHIVE);
+	if (!rtx_signature_scan_all_sections) { Error("[RTX Fixes 2] Failed to create rtx_signature_scan_all_sections convar\n"); }
+
+	rtx_shaderfix_vtable_hooks = m_pLuaConVars->CreateConVar("rtx_shaderfix_vtable_hooks", "1", "Hook D3D9 device methods by swapping vtable slots instead of inline detours (takes effect on next load)", FCVAR_ARCHIVE);
+	if (!rtx_shaderfix_vtable_hooks) { Error("[RTX Fixes 2] Failed to create rtx_shaderfix_vtable_hooks convar\n"); }
+
+	rtx_light_cluster_culling = m_pLuaConVars->CreateConVar("rtx_light_cluster_culling", "0", "Skip API lights whose surroundings are in no cluster the portal flow can see (runs the flow, about 1.3 ms per moving frame)", FCVAR_ARCHIVE);
+	if (!rtx_light_cluster_culling) { Error("[RTX Fixes 2] Failed to create rtx_light_cluster_culling convar\n"); }
+
+	rtx_light_occlusion_culling = m_pLuaConVars->CreateConVar("rtx_light_occlusion_culling", "0", "Skip API lights whose reach is hidden behind world brushes in the occlusion buffer", FCVAR_ARCHIVE);
+	if (!rtx_light_occlusion_culling) { Error("[RTX Fixes 2] Failed to create rtx_light_occlusion_culling convar\n"); }
 }
\ No newline at end of file
@@ -5,5 +5,15 @@ static class GlobalConvars
 {
 public:
 	static ConVar* r_forcenovis;
+	static ConVar* rtx_shaderfix_debug_sample;
+	static ConVar* rtx_shaderfix_adaptive;
+	static ConVar* rtx_shaderfix_adaptive_frames;
+	static ConVar* rtx_particle_budget;
+	static ConVar* rtx_shaderfix_async_vb;
+	static ConVar* rtx_shaderfix_async_vb_default;
+	static ConVar* rtx_signature_scan_all_sections;
+	static ConVar* rtx_shaderfix_vtable_hooks;
+	static ConVar* rtx_light_cluster_culling;
+	static ConVar* rtx_light_occlusion_culling;
 	static void InitialiseConVars();
 }; 
\ No newline at end of file
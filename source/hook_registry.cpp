@@ -0,0 +1,147 @@
+#include "hook_registry.h"
+#include <tier0/dbg.h>
+#include <cstring>
+
+HookRegistry& HookRegistry::Instance() {
+	static HookRegistry instance;
+	return instance;
+}
+
+std::string HookRegistry::SubsystemFromFile(const char* file) {
+	if (!file) return "unknown";
+
+	const char* base = file;
+	for (const char* c = file; *c; c++) {
+		if (*c == '/' || *c == '\\') base = c + 1;
+	}
+
+	std::string subsystem = base;
+	size_t dot = subsystem.rfind('.');
+	if (dot != std::string::npos) subsystem.erase(dot);
+	return subsystem;
+}
+
+void HookRegistry::Register(const char* name, const char* file, Detouring::Hook* hook) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (Find(hook)) return;
+
+	Entry entry;
+	entry.name = name ? name : "";
+	entry.subsystem = SubsystemFromFile(file);
+	entry.hook = hook;
+	m_entries.push_back(entry);
+}
+
+void HookRegistry::OnHookCreated(Detouring::Hook* hook, void* target) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Entry* entry = Find(hook);
+	if (!entry) return;
+
+	entry->target = target;
+	entry->created = true;
+	entry->enabled = true;
+}
+
+HookRegistry::Entry& HookRegistry::AddEntry(const char* name, const char* subsystem, const void* hook, void* target) {
+	Entry* entry = Find(hook);
+	if (!entry) {
+		m_entries.emplace_back();
+		entry = &m_entries.back();
+	}
+
+	entry->name = name ? name : "";
+	entry->subsystem = subsystem ? subsystem : "unknown";
+	entry->target = target;
+	entry->created = true;
+	entry->enabled = true;
+	return *entry;
+}
+
+void HookRegistry::Add(const char* name, const char* subsystem, Detouring::Hook* hook, void* target) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	AddEntry(name, subsystem, hook, target).hook = hook;
+}
+
+void HookRegistry::Add(const char* name, const char* subsystem, VTableHook* hook, void* target) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	AddEntry(name, subsystem, hook, target).vtableHook = hook;
+}
+
+HookRegistry::Entry* HookRegistry::Find(const void* hook) {
+	for (Entry& entry : m_entries) {
+		if (entry.hook == hook || entry.vtableHook == hook) return &entry;
+	}
+	return nullptr;
+}
+
+void HookRegistry::Apply(Entry& entry, bool enabled) {
+	if (!entry.created || entry.enabled == enabled) return;
+
+	if (entry.vtableHook) {
+		// Can refuse when another module stacked on the slot after us
+		bool applied = enabled ? entry.vtableHook->Enable() : entry.vtableHook->Disable();
+		if (!applied) return;
+	} else if (enabled) {
+		entry.hook->Enable();
+	} else {
+		entry.hook->Disable();
+	}
+	entry.enabled = enabled;
+}
+
+bool HookRegistry::SetEnabled(const void* hook, bool enabled) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Entry* entry = Find(hook);
+	if (!entry) return false;
+
+	if (enabled && entry->userDisabled) return entry->enabled;
+
+	Apply(*entry, enabled);
+	return entry->enabled;
+}
+
+bool HookRegistry::SetEnabledByUser(const char* name, bool enabled) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	bool found = false;
+	for (Entry& entry : m_entries) {
+		if (!name || entry.name != name) continue;
+
+		entry.userDisabled = !enabled;
+		Apply(entry, enabled);
+		found = true;
+	}
+	return found;
+}
+
+void HookRegistry::DisableSubsystem(const char* subsystem) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (Entry& entry : m_entries) {
+		if (subsystem && entry.subsystem == subsystem) {
+			Apply(entry, false);
+		}
+	}
+}
+
+void HookRegistry::DisableAll() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (Entry& entry : m_entries) {
+		Apply(entry, false);
+	}
+}
+
+std::vector<HookRegistry::Entry> HookRegistry::GetEntries() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries;
+}
+
+void HookRegistry::Print() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Msg("[Hooks] %u hooks registered\n", static_cast<unsigned>(m_entries.size()));
+	for (const Entry& entry : m_entries) {
+		const char* state = !entry.created ? "not created" :
+			entry.enabled ? "enabled" : (entry.userDisabled ? "disabled (user)" : "disabled");
+		Msg("  %-16s %-32s %-16s %p\n", entry.subsystem.c_str(), entry.name.c_str(), state, entry.target);
+	}
+}
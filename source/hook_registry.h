@@ -0,0 +1,76 @@
+#pragma once
+#include <detouring/hook.hpp>
+#include "vtable_hook.h"
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Central list of every detour the module installs.
+//
+// Hooks declared with the Define_*_Hook macros register themselves at static
+// init, Setup_Hook records the target once the hook is created, and hooks
+// owned by classes call Add(), either inline detours or vtable slot hooks.
+// Hooks are identified by the address of their hook object. Disabled hooks are fully unpatched, so a hook
+// turned off from the console costs nothing.
+//
+// A hook disabled from the console stays off until it is enabled from the
+// console again, even if code (e.g. adaptive mode) asks for it.
+class HookRegistry {
+public:
+	struct Entry {
+		std::string name;
+		std::string subsystem;
+		Detouring::Hook* hook = nullptr;
+		VTableHook* vtableHook = nullptr;
+		void* target = nullptr;
+		bool created = false;
+		bool enabled = false;
+		bool userDisabled = false;
+	};
+
+	static HookRegistry& Instance();
+
+	// Static registration from the Define_*_Hook macros, file is __FILE__
+	void Register(const char* name, const char* file, Detouring::Hook* hook);
+
+	// Setup_Hook, after Create() and Enable()
+	void OnHookCreated(Detouring::Hook* hook, void* target);
+
+	// Class owned hooks, already created and enabled
+	void Add(const char* name, const char* subsystem, Detouring::Hook* hook, void* target);
+	void Add(const char* name, const char* subsystem, VTableHook* hook, void* target);
+
+	// Code driven toggle. Returns whether the hook ends up enabled, false for
+	// hooks that are not registered.
+	bool SetEnabled(const void* hook, bool enabled);
+
+	// Console/Lua toggle by name, false if there is no such hook
+	bool SetEnabledByUser(const char* name, bool enabled);
+
+	void DisableSubsystem(const char* subsystem);
+	void DisableAll();
+
+	std::vector<Entry> GetEntries() const;
+	void Print() const;
+
+	// "source/shader_fixes/shader_hooks.cpp" -> "shader_hooks"
+	static std::string SubsystemFromFile(const char* file);
+
+private:
+	HookRegistry() = default;
+
+	Entry* Find(const void* hook);
+	Entry& AddEntry(const char* name, const char* subsystem, const void* hook, void* target);
+	void Apply(Entry& entry, bool enabled);
+
+	std::vector<Entry> m_entries;
+	mutable std::mutex m_mutex;
+};
+
+// Used by the Define_*_Hook macros
+struct HookRegistration {
+	HookRegistration(const char* name, const char* file, Detouring::Hook* hook) {
+		HookRegistry::Instance().Register(name, file, hook);
+	}
+};
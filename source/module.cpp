@@ -3,13 +3,32 @@
 #include <remix/remix_c.h>
 #include "cdll_client_int.h"
 #include "materialsystem/imaterialsystem.h"
+#include "materialsystem/imesh.h"
 #include <shaderapi/ishaderapi.h>
 #include "e_utils.h"
 #include <d3d9.h>
+#include <array>
+#include <cstring>
+#include <vector>
 #include "rtx_lights/rtx_light_manager.h"
 #include "shader_fixes/shader_hooks.h"
+#include "shader_fixes/crash_site_registry.h"
+#include "shader_fixes/particle_budget.h"
+#include "shader_fixes/async_vb_validator.h"
 #include "prop_fixes.h" 
 #include "culling_fixes.h"
+#include "module_ranges.h"
+#include "signatures/signature_registry.h"
+#include "hook_registry.h"
+#include "visibility/bsp_file.h"
+#include "visibility/environment_probe.h"
+#include "visibility/map_visibility.h"
+#include "visibility/novis_regions.h"
+#include "visibility/occlusion_culler.h"
+#include "visibility/render_bounds_updater.h"
+#include "visibility/portal_visibility.h"
+#include "visibility/spatial_index.h"
+#include "world_mesh/world_mesher.h"
 
 #ifdef GMOD_MAIN
 extern IMaterialSystem* materials = NULL;
@@ -163,6 +182,644 @@ LUA_FUNCTION(ForceDrawSkybox) {
     }
 }
 
+LUA_FUNCTION(RTXSetShaderValidationPolicy) {
+    try {
+        ValidationPolicyTable::Rule rule;
+        if (!ValidationPolicyTable::ParseTarget(LUA->CheckString(1), rule.target)) {
+            LUA->ArgError(1, "expected 'material' or 'shader'");
+            return 0;
+        }
+        rule.pattern = LUA->CheckString(2);
+        if (!ValidationPolicyTable::ParseMode(LUA->CheckString(3), rule.mode)) {
+            LUA->ArgError(3, "expected 'off', 'sampled', 'first' or 'always'");
+            return 0;
+        }
+        if (rule.mode == ValidationPolicyTable::Mode::Sampled) {
+            double interval = LUA->CheckNumber(4);
+            rule.sampleInterval = interval < 1.0 ? 1u : static_cast<uint32_t>(interval);
+        }
+
+        ValidationPolicyTable::Instance().SetRule(rule);
+        return 0;
+    }
+    catch (...) {
+        Msg("[Shader Fixes] Exception in RTXSetShaderValidationPolicy\n");
+        return 0;
+    }
+}
+
+LUA_FUNCTION(RTXRemoveShaderValidationPolicy) {
+    ValidationPolicyTable::Target target;
+    if (!ValidationPolicyTable::ParseTarget(LUA->CheckString(1), target)) {
+        LUA->ArgError(1, "expected 'material' or 'shader'");
+        return 0;
+    }
+    LUA->PushBool(ValidationPolicyTable::Instance().RemoveRule(target, LUA->CheckString(2)));
+    return 1;
+}
+
+LUA_FUNCTION(RTXReloadShaderValidationPolicies) {
+    auto& policies = ValidationPolicyTable::Instance();
+    LUA->PushBool(policies.LoadFromFile(policies.GetConfigPath().c_str()));
+    return 1;
+}
+
+// Materials are freed on map change and mat_reloadallmaterials, forget
+// which policy each address had
+LUA_FUNCTION(RTXClearShaderValidationCache) {
+    ValidationPolicyTable::Instance().InvalidateMaterials();
+    return 0;
+}
+
+LUA_FUNCTION(RTXPrintShaderValidationPolicies) {
+    ValidationPolicyTable::Instance().PrintStats();
+    return 0;
+}
+
+LUA_FUNCTION(RTXPrintShaderCrashSites) {
+    int count = LUA->IsType(1, Type::Number) ? static_cast<int>(LUA->GetNumber(1)) : 10;
+    CrashSiteRegistry::Instance().PrintTopSites(count > 0 ? static_cast<size_t>(count) : 10);
+    return 0;
+}
+
+LUA_FUNCTION(RTXGetShaderHookStates) {
+    ShaderAPIHooks::HookState states[16];
+    size_t count = ShaderAPIHooks::Instance().GetHookStates(states, 16);
+
+    LUA->CreateTable();
+    for (size_t i = 0; i < count; i++) {
+        LUA->CreateTable();
+            LUA->PushBool(states[i].armed);
+            LUA->SetField(-2, "armed");
+            LUA->PushNumber(states[i].framesSinceReject);
+            LUA->SetField(-2, "framesSinceReject");
+        LUA->SetField(-2, states[i].name);
+    }
+    return 1;
+}
+
+LUA_FUNCTION(RTXGetParticleBudgetStats) {
+    ParticleBudget::Stats stats = ParticleBudget::Instance().GetStats();
+
+    LUA->CreateTable();
+        LUA->PushNumber(stats.budget);
+        LUA->SetField(-2, "budget");
+        LUA->PushNumber(stats.admittedPrimitives);
+        LUA->SetField(-2, "admittedPrimitives");
+        LUA->PushNumber(stats.skippedDraws);
+        LUA->SetField(-2, "skippedDraws");
+        LUA->PushNumber(stats.skippedPrimitives);
+        LUA->SetField(-2, "skippedPrimitives");
+        LUA->PushNumber(stats.threshold);
+        LUA->SetField(-2, "threshold");
+    return 1;
+}
+
+LUA_FUNCTION(RTXPrintAsyncVertexBufferStats) {
+    AsyncVertexBufferValidator::Instance().PrintStats();
+    return 0;
+}
+
+LUA_FUNCTION(RTXPrintSignatures) {
+    SignatureRegistry::Instance().PrintStats();
+    return 0;
+}
+
+LUA_FUNCTION(RTXGetHooks) {
+    std::vector<HookRegistry::Entry> entries = HookRegistry::Instance().GetEntries();
+
+    LUA->CreateTable();
+    for (const auto& entry : entries) {
+        LUA->CreateTable();
+            LUA->PushString(entry.subsystem.c_str());
+            LUA->SetField(-2, "subsystem");
+            LUA->PushBool(entry.created);
+            LUA->SetField(-2, "created");
+            LUA->PushBool(entry.enabled);
+            LUA->SetField(-2, "enabled");
+            LUA->PushBool(entry.userDisabled);
+            LUA->SetField(-2, "userDisabled");
+        LUA->SetField(-2, entry.name.c_str());
+    }
+    return 1;
+}
+
+LUA_FUNCTION(RTXSetHookEnabled) {
+    const char* name = LUA->CheckString(1);
+    bool enabled = LUA->GetBool(2);
+
+    bool found = HookRegistry::Instance().SetEnabledByUser(name, enabled);
+    if (!found) {
+        Warning("[Hooks] No hook named %s\n", name);
+    }
+    LUA->PushBool(found);
+    return 1;
+}
+
+LUA_FUNCTION(RTXPrintHooks) {
+    HookRegistry::Instance().Print();
+    return 0;
+}
+
+LUA_FUNCTION(RTXLoadMapVisibility) {
+    LUA->CheckType(1, Type::String);
+    unsigned int length = 0;
+    const char* data = LUA->GetString(1, &length);
+
+    // Regions name this map's clusters, the script loads them again after
+    NoVisRegions::Instance().Clear();
+
+    bool loaded = MapVisibility::Instance().Load(reinterpret_cast<const uint8_t*>(data), length);
+    if (loaded) {
+        SpatialIndex::Instance().BuildLeafs(MapVisibility::Instance().GetBSP());
+        OcclusionCuller::Instance().BuildOccluders(MapVisibility::Instance().GetBSP());
+    } else {
+        OcclusionCuller::Instance().Clear();
+    }
+    LUA->PushBool(loaded);
+    return 1;
+}
+
+LUA_FUNCTION(RTXFindCluster) {
+    LUA->CheckType(1, Type::Vector);
+    const Vector& pos = LUA->GetVector(1);
+    float point[3] = { pos.x, pos.y, pos.z };
+
+    LUA->PushNumber(MapVisibility::Instance().FindCluster(point));
+    return 1;
+}
+
+// RTXUpdateVisibleClusters(origin, extraPoints, extraClusters, includePAS)
+LUA_FUNCTION(RTXUpdateVisibleClusters) {
+    LUA->CheckType(1, Type::Vector);
+    const Vector& pos = LUA->GetVector(1);
+    float origin[3] = { pos.x, pos.y, pos.z };
+
+    std::vector<std::array<float, 3>> points;
+    if (LUA->IsType(2, Type::Table)) {
+        int count = LUA->ObjLen(2);
+        for (int i = 1; i <= count; i++) {
+            LUA->PushNumber(i);
+            LUA->GetTable(2);
+            if (LUA->IsType(-1, Type::Vector)) {
+                const Vector& point = LUA->GetVector(-1);
+                points.push_back({ point.x, point.y, point.z });
+            }
+            LUA->Pop();
+        }
+    }
+
+    std::vector<int> clusters;
+    if (LUA->IsType(3, Type::Table)) {
+        int count = LUA->ObjLen(3);
+        for (int i = 1; i <= count; i++) {
+            LUA->PushNumber(i);
+            LUA->GetTable(3);
+            if (LUA->IsType(-1, Type::Number)) {
+                clusters.push_back(static_cast<int>(LUA->GetNumber(-1)));
+            }
+            LUA->Pop();
+        }
+    }
+
+    bool includePAS = LUA->GetBool(4);
+
+    size_t visible = MapVisibility::Instance().UpdateVisibleClusters(origin,
+        reinterpret_cast<const float(*)[3]>(points.data()), points.size(),
+        clusters.data(), clusters.size(), includePAS);
+    LUA->PushNumber(static_cast<double>(visible));
+    return 1;
+}
+
+LUA_FUNCTION(RTXIsClusterVisible) {
+    LUA->PushBool(MapVisibility::Instance().IsClusterVisible(static_cast<int>(LUA->CheckNumber(1))));
+    return 1;
+}
+
+// Takes a list of clusters, returns a list of booleans in the same order
+LUA_FUNCTION(RTXAreClustersVisible) {
+    LUA->CheckType(1, Type::Table);
+    const MapVisibility& visibility = MapVisibility::Instance();
+
+    int count = LUA->ObjLen(1);
+    LUA->CreateTable();
+    for (int i = 1; i <= count; i++) {
+        LUA->PushNumber(i);
+        LUA->GetTable(1);
+        int cluster = LUA->IsType(-1, Type::Number) ? static_cast<int>(LUA->GetNumber(-1)) : -1;
+        LUA->Pop();
+
+        LUA->PushNumber(i);
+        LUA->PushBool(visibility.IsClusterVisible(cluster));
+        LUA->SetTable(-3);
+    }
+    return 1;
+}
+
+// RTXUpdateEntityRenderBounds(entities, settings), see render_bounds_updater.h
+LUA_FUNCTION(RTXUpdateEntityRenderBounds) {
+    LUA->CheckType(1, Type::Table);
+    LUA->CheckType(2, Type::Table);
+
+    LUA->PushNumber(static_cast<double>(RenderBoundsUpdater::Instance().Update(LUA, 1, 2)));
+    return 1;
+}
+
+LUA_FUNCTION(RTXForgetRenderBoundsEntity) {
+    RenderBoundsUpdater::Instance().Forget(static_cast<int>(LUA->CheckNumber(1)));
+    return 0;
+}
+
+LUA_FUNCTION(RTXForgetRenderBoundsProp) {
+    RenderBoundsUpdater::Instance().ForgetProp(static_cast<int>(LUA->CheckNumber(1)));
+    return 0;
+}
+
+LUA_FUNCTION(RTXGetRenderBoundsStats) {
+    const RenderBoundsUpdater::Stats& stats = RenderBoundsUpdater::Instance().GetStats();
+
+    LUA->CreateTable();
+        LUA->PushNumber(static_cast<double>(stats.entities));
+        LUA->SetField(-2, "entities");
+        LUA->PushNumber(static_cast<double>(stats.due));
+        LUA->SetField(-2, "due");
+        LUA->PushNumber(static_cast<double>(stats.updated));
+        LUA->SetField(-2, "updated");
+        LUA->PushNumber(static_cast<double>(stats.visible));
+        LUA->SetField(-2, "visible");
+        LUA->PushNumber(static_cast<double>(stats.hidden));
+        LUA->SetField(-2, "hidden");
+        LUA->PushNumber(static_cast<double>(stats.reclassified));
+        LUA->SetField(-2, "reclassified");
+        LUA->PushNumber(static_cast<double>(stats.flipped));
+        LUA->SetField(-2, "flipped");
+        LUA->PushNumber(static_cast<double>(stats.occluded));
+        LUA->SetField(-2, "occluded");
+        LUA->PushNumber(stats.milliseconds);
+        LUA->SetField(-2, "milliseconds");
+    return 1;
+}
+
+LUA_FUNCTION(RTXFindLeaf) {
+    LUA->CheckType(1, Type::Vector);
+    const Vector& pos = LUA->GetVector(1);
+    float point[3] = { pos.x, pos.y, pos.z };
+
+    LUA->PushNumber(MapVisibility::Instance().GetBSP().FindLeaf(point));
+    return 1;
+}
+
+// RTXAnalyzeEnvironment(origin, aim) -> table, the open area and corridor
+// traces as one native fan, nil without a loaded map
+LUA_FUNCTION(RTXAnalyzeEnvironment) {
+    LUA->CheckType(1, Type::Vector);
+    LUA->CheckType(2, Type::Vector);
+    const Vector& pos = LUA->GetVector(1);
+    const Vector& dir = LUA->GetVector(2);
+    float origin[3] = { pos.x, pos.y, pos.z };
+    float aim[3] = { dir.x, dir.y, dir.z };
+
+    EnvironmentProbe probe;
+    if (!ProbeEnvironment(origin, aim, probe)) {
+        LUA->PushNil();
+        return 1;
+    }
+
+    LUA->CreateTable();
+        LUA->PushNumber(probe.ceiling);
+        LUA->SetField(-2, "ceiling");
+        LUA->PushNumber(probe.openSpace);
+        LUA->SetField(-2, "openSpace");
+        LUA->PushNumber(probe.corridorSpace);
+        LUA->SetField(-2, "corridorSpace");
+        LUA->PushNumber(probe.forward);
+        LUA->SetField(-2, "forward");
+        LUA->PushVector(Vector(probe.axis[0], probe.axis[1], probe.axis[2]));
+        LUA->SetField(-2, "axis");
+        LUA->PushNumber(probe.elongation);
+        LUA->SetField(-2, "elongation");
+        LUA->PushBool(probe.openArea);
+        LUA->SetField(-2, "openArea");
+        LUA->PushBool(probe.corridor);
+        LUA->SetField(-2, "corridor");
+        LUA->PushNumber(probe.milliseconds);
+        LUA->SetField(-2, "milliseconds");
+    return 1;
+}
+
+// RTXFindLeafs(points) -> leafs, clusters, one batched walk of the BSP tree
+LUA_FUNCTION(RTXFindLeafs) {
+    LUA->CheckType(1, Type::Table);
+
+    std::vector<std::array<float, 3>> points;
+    std::vector<size_t> invalid;
+    int count = LUA->ObjLen(1);
+    points.reserve(count);
+    for (int i = 1; i <= count; i++) {
+        LUA->PushNumber(i);
+        LUA->GetTable(1);
+        if (LUA->IsType(-1, Type::Vector)) {
+            const Vector& point = LUA->GetVector(-1);
+            points.push_back({ point.x, point.y, point.z });
+        } else {
+            // Keeps the outputs lined up with the input
+            invalid.push_back(points.size());
+            points.push_back({ 0.0f, 0.0f, 0.0f });
+        }
+        LUA->Pop();
+    }
+
+    std::vector<int> leafs(points.size()), clusters(points.size());
+    MapVisibility::Instance().FindLeafs(reinterpret_cast<const float(*)[3]>(points.data()), points.size(),
+        leafs.data(), clusters.data());
+    for (size_t i : invalid) {
+        leafs[i] = clusters[i] = -1;
+    }
+
+    LUA->CreateTable();
+    for (size_t i = 0; i < leafs.size(); i++) {
+        LUA->PushNumber(static_cast<double>(i + 1));
+        LUA->PushNumber(leafs[i]);
+        LUA->SetTable(-3);
+    }
+    LUA->CreateTable();
+    for (size_t i = 0; i < clusters.size(); i++) {
+        LUA->PushNumber(static_cast<double>(i + 1));
+        LUA->PushNumber(clusters[i]);
+        LUA->SetTable(-3);
+    }
+    return 2;
+}
+
+// Shared by RTXQueryLeafs and RTXQueryEntities, arguments start with the shape:
+//   "sphere", center, radius
+//   "box", mins, maxs
+//   "ray", start, end
+//   "view", origin, forward, right, up, fov, aspect
+static int PushSpatialQuery(ILuaBase* LUA, const LooseOctree& tree) {
+    const char* shape = LUA->CheckString(1);
+    auto getPoint = [LUA](int index, float out[3]) {
+        LUA->CheckType(index, Type::Vector);
+        const Vector& v = LUA->GetVector(index);
+        out[0] = v.x;
+        out[1] = v.y;
+        out[2] = v.z;
+    };
+
+    std::vector<uint32_t> ids;
+    float a[3], b[3];
+    if (strcmp(shape, "sphere") == 0) {
+        getPoint(2, a);
+        tree.QuerySphere(a, static_cast<float>(LUA->CheckNumber(3)), ids);
+    } else if (strcmp(shape, "box") == 0) {
+        getPoint(2, a);
+        getPoint(3, b);
+        tree.QueryBox(a, b, ids);
+    } else if (strcmp(shape, "ray") == 0) {
+        getPoint(2, a);
+        getPoint(3, b);
+        tree.QueryRay(a, b, ids);
+    } else if (strcmp(shape, "view") == 0) {
+        float forward[3], right[3], up[3];
+        getPoint(2, a);
+        getPoint(3, forward);
+        getPoint(4, right);
+        getPoint(5, up);
+        FrustumPlane planes[4];
+        size_t count = BuildViewFrustum(a, forward, right, up, static_cast<float>(LUA->CheckNumber(6)),
+            static_cast<float>(LUA->CheckNumber(7)), 0.0f, planes);
+        tree.QueryFrustum(planes, count, ids);
+    } else {
+        LUA->ArgError(1, "expected sphere, box, ray or view");
+    }
+
+    LUA->CreateTable();
+    for (size_t i = 0; i < ids.size(); i++) {
+        LUA->PushNumber(static_cast<double>(i + 1));
+        LUA->PushNumber(ids[i]);
+        LUA->SetTable(-3);
+    }
+    return 1;
+}
+
+// Leaf indices touching the shape, see PushSpatialQuery
+LUA_FUNCTION(RTXQueryLeafs) {
+    return PushSpatialQuery(LUA, SpatialIndex::Instance().GetLeafs());
+}
+
+// Entity indices touching the shape, as of the last RTXUpdateSpatialEntities
+LUA_FUNCTION(RTXQueryEntities) {
+    return PushSpatialQuery(LUA, SpatialIndex::Instance().GetEntities());
+}
+
+LUA_FUNCTION(RTXUpdateSpatialEntities) {
+    LUA->CheckType(1, Type::Table);
+    LUA->PushNumber(static_cast<double>(SpatialIndex::Instance().UpdateEntities(LUA, 1)));
+    return 1;
+}
+
+LUA_FUNCTION(RTXRemoveSpatialEntity) {
+    SpatialIndex::Instance().RemoveEntity(static_cast<int>(LUA->CheckNumber(1)));
+    return 0;
+}
+
+LUA_FUNCTION(RTXLoadMapPortals) {
+    LUA->CheckType(1, Type::String);
+    unsigned int length = 0;
+    const char* text = LUA->GetString(1, &length);
+
+    LUA->PushBool(PortalVisibility::Instance().Load(text, length));
+    return 1;
+}
+
+// RTXLoadNoVisRegions(text) -> region count, the map's visibility must be loaded
+LUA_FUNCTION(RTXLoadNoVisRegions) {
+    LUA->CheckType(1, Type::String);
+    unsigned int length = 0;
+    const char* text = LUA->GetString(1, &length);
+
+    LUA->PushNumber(static_cast<double>(NoVisRegions::Instance().Load(text, length)));
+    return 1;
+}
+
+// RTXUpdateNoVisRegion(origin) -> bool, whether r_forcenovis 2 disables vis now
+LUA_FUNCTION(RTXUpdateNoVisRegion) {
+    LUA->CheckType(1, Type::Vector);
+    const Vector& pos = LUA->GetVector(1);
+    float origin[3] = { pos.x, pos.y, pos.z };
+
+    LUA->PushBool(NoVisRegions::Instance().Update(origin));
+    return 1;
+}
+
+// RTXUpdatePortalVisibility(origin, forward, right, up, fov, aspect)
+LUA_FUNCTION(RTXUpdatePortalVisibility) {
+    PortalVisibility::View view;
+    float* vectors[] = { view.origin, view.forward, view.right, view.up };
+    for (int i = 0; i < 4; i++) {
+        LUA->CheckType(i + 1, Type::Vector);
+        const Vector& v = LUA->GetVector(i + 1);
+        vectors[i][0] = v.x;
+        vectors[i][1] = v.y;
+        vectors[i][2] = v.z;
+    }
+    view.fov = static_cast<float>(LUA->CheckNumber(5));
+    view.aspect = static_cast<float>(LUA->CheckNumber(6));
+
+    LUA->PushNumber(static_cast<double>(PortalVisibility::Instance().Update(view)));
+    return 1;
+}
+
+// Same rules as RTXIsClusterVisible, but against the last portal flow
+LUA_FUNCTION(RTXIsClusterInView) {
+    LUA->PushBool(PortalVisibility::Instance().IsClusterVisible(static_cast<int>(LUA->CheckNumber(1))));
+    return 1;
+}
+
+LUA_FUNCTION(RTXGetPortalVisibilityStats) {
+    const PortalVisibility::Stats& stats = PortalVisibility::Instance().GetStats();
+
+    LUA->CreateTable();
+        LUA->PushNumber(static_cast<double>(stats.portalsTested));
+        LUA->SetField(-2, "portalsTested");
+        LUA->PushNumber(static_cast<double>(stats.portalsPassed));
+        LUA->SetField(-2, "portalsPassed");
+        LUA->PushNumber(static_cast<double>(stats.clustersVisible));
+        LUA->SetField(-2, "clustersVisible");
+        LUA->PushBool(stats.truncated);
+        LUA->SetField(-2, "truncated");
+        LUA->PushBool(stats.reused);
+        LUA->SetField(-2, "reused");
+        LUA->PushNumber(stats.milliseconds);
+        LUA->SetField(-2, "milliseconds");
+    return 1;
+}
+
+// Meshes the world from the map file, one table per chunk/material/translucency
+// bucket. The welded parts stay native until RTXFillWorldMesh has copied them
+// into the script's meshes, the tables only say how many parts to create.
+LUA_FUNCTION(RTXBuildWorldMeshes) {
+    LUA->CheckType(1, Type::String);
+    unsigned int length = 0;
+    const char* data = LUA->GetString(1, &length);
+    float chunkSize = static_cast<float>(LUA->CheckNumber(2));
+
+    BSPFile bsp;
+    WorldMesher& mesher = WorldMesher::Instance();
+    if (!bsp.Load(reinterpret_cast<const uint8_t*>(data), length, true) || !mesher.Build(bsp, chunkSize)) {
+        LUA->PushBool(false);
+        return 1;
+    }
+
+    LUA->CreateTable();
+    int groupIndex = 1;
+    for (const WorldMesher::Group& group : mesher.GetGroups()) {
+        size_t vertices = 0;
+        size_t indices = 0;
+        for (const WorldMesher::Part& part : group.parts) {
+            vertices += part.vertices.size();
+            indices += part.indices.size();
+        }
+
+        LUA->PushNumber(groupIndex++);
+        LUA->CreateTable();
+            LUA->PushNumber(static_cast<double>(group.chunk));
+            LUA->SetField(-2, "chunk");
+            LUA->PushString(bsp.GetTexDataName(group.texData));
+            LUA->SetField(-2, "material");
+            LUA->PushBool(group.translucent);
+            LUA->SetField(-2, "translucent");
+            LUA->PushNumber(static_cast<double>(group.parts.size()));
+            LUA->SetField(-2, "parts");
+            LUA->PushNumber(static_cast<double>(vertices));
+            LUA->SetField(-2, "vertices");
+            LUA->PushNumber(static_cast<double>(indices));
+            LUA->SetField(-2, "indices");
+        LUA->SetTable(-3);
+    }
+    return 1;
+}
+
+// Fills a Mesh() with one part of an RTXBuildWorldMeshes group, indexed.
+// The script's mesh library can't write indices, so the vertex and index
+// buffers are written here and the mesh is drawn from Lua as usual.
+LUA_FUNCTION(RTXFillWorldMesh) {
+    IMesh* mesh = LUA->GetUserType<IMesh>(1, Type::IMesh);
+    int groupIndex = static_cast<int>(LUA->CheckNumber(2)) - 1;
+    int partIndex = static_cast<int>(LUA->CheckNumber(3)) - 1;
+
+    const std::vector<WorldMesher::Group>& groups = WorldMesher::Instance().GetGroups();
+    if (!mesh || groupIndex < 0 || static_cast<size_t>(groupIndex) >= groups.size() ||
+        partIndex < 0 || static_cast<size_t>(partIndex) >= groups[groupIndex].parts.size()) {
+        LUA->PushBool(false);
+        return 1;
+    }
+
+    const WorldMesher::Part& part = groups[groupIndex].parts[partIndex];
+    CMeshBuilder builder;
+    builder.Begin(mesh, MATERIAL_TRIANGLES, static_cast<int>(part.vertices.size()), static_cast<int>(part.indices.size()));
+    for (const WorldMesher::Vertex& vertex : part.vertices) {
+        builder.Position3fv(vertex.pos);
+        builder.Normal3fv(vertex.normal);
+        builder.TexCoord2f(0, vertex.u, vertex.v);
+        builder.Color4ub(255, 255, 255, 255);
+        builder.AdvanceVertex();
+    }
+    for (uint16_t index : part.indices) {
+        builder.Index(index);
+        builder.AdvanceIndex();
+    }
+    builder.End();
+
+    LUA->PushBool(true);
+    return 1;
+}
+
+// Frees the parts once every mesh has been filled
+LUA_FUNCTION(RTXClearWorldMeshes) {
+    WorldMesher::Instance().Clear();
+    return 0;
+}
+
+// Redraws the occluders for this view, entity bounds and API lights are
+// tested against it until it is half a second old
+LUA_FUNCTION(RTXUpdateOcclusion) {
+    OcclusionCuller::View view;
+    float* vectors[] = { view.origin, view.forward, view.right, view.up };
+    for (int i = 0; i < 4; i++) {
+        LUA->CheckType(i + 1, Type::Vector);
+        const Vector& v = LUA->GetVector(i + 1);
+        vectors[i][0] = v.x;
+        vectors[i][1] = v.y;
+        vectors[i][2] = v.z;
+    }
+    view.fov = static_cast<float>(LUA->CheckNumber(5));
+    view.aspect = static_cast<float>(LUA->CheckNumber(6));
+
+    OcclusionCuller::Instance().Update(view);
+    LUA->PushNumber(static_cast<double>(OcclusionCuller::Instance().GetStats().triangles));
+    return 1;
+}
+
+LUA_FUNCTION(RTXGetOcclusionStats) {
+    const OcclusionCuller::Stats& stats = OcclusionCuller::Instance().GetStats();
+
+    LUA->CreateTable();
+        LUA->PushNumber(static_cast<double>(OcclusionCuller::Instance().GetOccluderCount()));
+        LUA->SetField(-2, "brushes");
+        LUA->PushNumber(static_cast<double>(stats.occluders));
+        LUA->SetField(-2, "occluders");
+        LUA->PushNumber(static_cast<double>(stats.triangles));
+        LUA->SetField(-2, "triangles");
+        LUA->PushNumber(static_cast<double>(stats.tested));
+        LUA->SetField(-2, "tested");
+        LUA->PushNumber(static_cast<double>(stats.occluded));
+        LUA->SetField(-2, "occluded");
+        LUA->PushNumber(stats.milliseconds);
+        LUA->SetField(-2, "milliseconds");
+    return 1;
+}
+
 #include "cbase.h" 
 #include "iviewrender.h" 
 #include <GarrysMod/Lua/LuaConVars.h>
@@ -174,6 +831,9 @@ LUA_FUNCTION(DisableCulling) {
     return 0;
 }
 
+// Shares its registry entry with the shader fixes' device lookup
+static const RegisteredSignature s_d3d9DeviceSignature("shaderapidx9.dll", "D3D9 device", SIGNATURE("BA E1 0D 74 5E 48 89 1D ?? ?? ?? ??"));
+
 void* FindD3D9Device() {
     auto shaderapidx = GetModuleHandle("shaderapidx9.dll");
     if (!shaderapidx) {
@@ -183,8 +843,7 @@ void* FindD3D9Device() {
 
     Msg("[RTX] shaderapidx9.dll module: %p\n", shaderapidx);
 
-    static const char sign[] = "BA E1 0D 74 5E 48 89 1D ?? ?? ?? ??";
-    auto ptr = ScanSign(shaderapidx, sign, sizeof(sign) - 1);
+    auto ptr = s_d3d9DeviceSignature.Get();
     if (!ptr) { 
         Error("[RTX] Failed to find D3D9Device signature\n");
         return nullptr;
@@ -206,6 +865,9 @@ GMOD_MODULE_OPEN() {
     try {
         Msg("[RTX Remix Fixes 2] - Module loaded!\n"); 
 
+        // Address attribution for the fault handlers
+        ModuleRangeTable::Instance().Initialize();
+
         // Initialize modules
         CullingHooks::Instance().Initialize();
         ShaderAPIHooks::Instance().Initialize();
@@ -256,6 +918,126 @@ GMOD_MODULE_OPEN() {
 
             LUA->PushCFunction(DisableCulling);
             LUA->SetField(-2, "DisableCulling");
+
+            LUA->PushCFunction(RTXSetShaderValidationPolicy);
+            LUA->SetField(-2, "RTXSetShaderValidationPolicy");
+
+            LUA->PushCFunction(RTXRemoveShaderValidationPolicy);
+            LUA->SetField(-2, "RTXRemoveShaderValidationPolicy");
+
+            LUA->PushCFunction(RTXReloadShaderValidationPolicies);
+            LUA->SetField(-2, "RTXReloadShaderValidationPolicies");
+
+            LUA->PushCFunction(RTXPrintShaderValidationPolicies);
+            LUA->SetField(-2, "RTXPrintShaderValidationPolicies");
+
+            LUA->PushCFunction(RTXClearShaderValidationCache);
+            LUA->SetField(-2, "RTXClearShaderValidationCache");
+
+            LUA->PushCFunction(RTXPrintShaderCrashSites);
+            LUA->SetField(-2, "RTXPrintShaderCrashSites");
+
+            LUA->PushCFunction(RTXGetShaderHookStates);
+            LUA->SetField(-2, "RTXGetShaderHookStates");
+
+            LUA->PushCFunction(RTXGetParticleBudgetStats);
+            LUA->SetField(-2, "RTXGetParticleBudgetStats");
+
+            LUA->PushCFunction(RTXPrintAsyncVertexBufferStats);
+            LUA->SetField(-2, "RTXPrintAsyncVertexBufferStats");
+
+            LUA->PushCFunction(RTXPrintSignatures);
+            LUA->SetField(-2, "RTXPrintSignatures");
+
+            LUA->PushCFunction(RTXGetHooks);
+            LUA->SetField(-2, "RTXGetHooks");
+
+            LUA->PushCFunction(RTXSetHookEnabled);
+            LUA->SetField(-2, "RTXSetHookEnabled");
+
+            LUA->PushCFunction(RTXPrintHooks);
+            LUA->SetField(-2, "RTXPrintHooks");
+
+            LUA->PushCFunction(RTXLoadMapVisibility);
+            LUA->SetField(-2, "RTXLoadMapVisibility");
+
+            LUA->PushCFunction(RTXFindCluster);
+            LUA->SetField(-2, "RTXFindCluster");
+
+            LUA->PushCFunction(RTXUpdateVisibleClusters);
+            LUA->SetField(-2, "RTXUpdateVisibleClusters");
+
+            LUA->PushCFunction(RTXIsClusterVisible);
+            LUA->SetField(-2, "RTXIsClusterVisible");
+
+            LUA->PushCFunction(RTXAreClustersVisible);
+            LUA->SetField(-2, "RTXAreClustersVisible");
+
+            LUA->PushCFunction(RTXUpdateEntityRenderBounds);
+            LUA->SetField(-2, "RTXUpdateEntityRenderBounds");
+
+            LUA->PushCFunction(RTXForgetRenderBoundsEntity);
+            LUA->SetField(-2, "RTXForgetRenderBoundsEntity");
+
+            LUA->PushCFunction(RTXForgetRenderBoundsProp);
+            LUA->SetField(-2, "RTXForgetRenderBoundsProp");
+
+            LUA->PushCFunction(RTXGetRenderBoundsStats);
+            LUA->SetField(-2, "RTXGetRenderBoundsStats");
+
+            LUA->PushCFunction(RTXFindLeaf);
+            LUA->SetField(-2, "RTXFindLeaf");
+
+            LUA->PushCFunction(RTXFindLeafs);
+            LUA->SetField(-2, "RTXFindLeafs");
+
+            LUA->PushCFunction(RTXAnalyzeEnvironment);
+            LUA->SetField(-2, "RTXAnalyzeEnvironment");
+
+            LUA->PushCFunction(RTXQueryLeafs);
+            LUA->SetField(-2, "RTXQueryLeafs");
+
+            LUA->PushCFunction(RTXQueryEntities);
+            LUA->SetField(-2, "RTXQueryEntities");
+
+            LUA->PushCFunction(RTXUpdateSpatialEntities);
+            LUA->SetField(-2, "RTXUpdateSpatialEntities");
+
+            LUA->PushCFunction(RTXRemoveSpatialEntity);
+            LUA->SetField(-2, "RTXRemoveSpatialEntity");
+
+            LUA->PushCFunction(RTXLoadMapPortals);
+            LUA->SetField(-2, "RTXLoadMapPortals");
+
+            LUA->PushCFunction(RTXLoadNoVisRegions);
+            LUA->SetField(-2, "RTXLoadNoVisRegions");
+
+            LUA->PushCFunction(RTXUpdateNoVisRegion);
+            LUA->SetField(-2, "RTXUpdateNoVisRegion");
+
+            LUA->PushCFunction(RTXUpdatePortalVisibility);
+            LUA->SetField(-2, "RTXUpdatePortalVisibility");
+
+            LUA->PushCFunction(RTXIsClusterInView);
+            LUA->SetField(-2, "RTXIsClusterInView");
+
+            LUA->PushCFunction(RTXGetPortalVisibilityStats);
+            LUA->SetField(-2, "RTXGetPortalVisibilityStats");
+
+            LUA->PushCFunction(RTXUpdateOcclusion);
+            LUA->SetField(-2, "RTXUpdateOcclusion");
+
+            LUA->PushCFunction(RTXBuildWorldMeshes);
+            LUA->SetField(-2, "RTXBuildWorldMeshes");
+
+            LUA->PushCFunction(RTXFillWorldMesh);
+            LUA->SetField(-2, "RTXFillWorldMesh");
+
+            LUA->PushCFunction(RTXClearWorldMeshes);
+            LUA->SetField(-2, "RTXClearWorldMeshes");
+
+            LUA->PushCFunction(RTXGetOcclusionStats);
+            LUA->SetField(-2, "RTXGetOcclusionStats");
         LUA->Pop();  
     }
     catch (...) {
@@ -278,6 +1060,19 @@ GMOD_MODULE_CLOSE() {
 
         ModelRenderHooks::Instance().Shutdown();
 
+        ModuleRangeTable::Instance().Shutdown();
+
+        MapVisibility::Instance().Clear();
+        PortalVisibility::Instance().Clear();
+        NoVisRegions::Instance().Clear();
+        OcclusionCuller::Instance().Clear();
+        SpatialIndex::Instance().Clear();
+        WorldMesher::Instance().Clear();
+        RenderBoundsUpdater::Instance().Reset();
+
+        // Anything the subsystems did not take down themselves
+        HookRegistry::Instance().DisableAll();
+
         if (g_remix) {
             delete g_remix;
             g_remix = nullptr;
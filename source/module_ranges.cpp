@@ -0,0 +1,255 @@
+#include "module_ranges.h"
+#include <winternl.h>
+#include <psapi.h>
+#include <tier0/dbg.h>
+#include <algorithm>
+#include <cstring>
+#pragma comment(lib, "psapi.lib")
+
+namespace {
+	// ntdll loader notification API, not exposed by the Windows SDK headers
+	constexpr ULONG LDR_DLL_NOTIFICATION_REASON_LOADED = 1;
+	constexpr ULONG LDR_DLL_NOTIFICATION_REASON_UNLOADED = 2;
+
+	struct LdrDllNotificationData {
+		ULONG Flags;
+		const UNICODE_STRING* FullDllName;
+		const UNICODE_STRING* BaseDllName;
+		PVOID DllBase;
+		ULONG SizeOfImage;
+	};
+
+	typedef VOID(CALLBACK* LdrDllNotificationFunction)(ULONG reason, const void* data, PVOID context);
+	typedef LONG(NTAPI* LdrRegisterDllNotification_t)(ULONG flags, LdrDllNotificationFunction callback, PVOID context, PVOID* cookie);
+	typedef LONG(NTAPI* LdrUnregisterDllNotification_t)(PVOID cookie);
+
+	void CopyName(char* out, size_t outSize, const wchar_t* name, size_t nameLength) {
+		int written = WideCharToMultiByte(CP_UTF8, 0, name, static_cast<int>(nameLength),
+			out, static_cast<int>(outSize - 1), NULL, NULL);
+		out[written > 0 ? written : 0] = '\0';
+	}
+
+	bool RangeLess(const ModuleRangeTable::Range& a, const ModuleRangeTable::Range& b) {
+		return a.base < b.base;
+	}
+}
+
+class ModuleRangeTable::ReadGuard {
+public:
+	explicit ReadGuard(const ModuleRangeTable& table) : m_table(table) {
+		// seq_cst on both sides: a writer that saw no readers after swapping
+		// m_current is sure every later reader loads the new snapshot
+		m_table.m_readers.fetch_add(1);
+		m_snapshot = m_table.m_current.load();
+	}
+	~ReadGuard() { m_table.m_readers.fetch_sub(1, std::memory_order_release); }
+
+	const Snapshot* Get() const { return m_snapshot; }
+
+private:
+	const ModuleRangeTable& m_table;
+	const Snapshot* m_snapshot;
+};
+
+ModuleRangeTable& ModuleRangeTable::Instance() {
+	static ModuleRangeTable instance;
+	return instance;
+}
+
+void ModuleRangeTable::Initialize() {
+	// Registered before the first enumeration so no load falls between the two
+	auto ntdll = GetModuleHandle("ntdll.dll");
+	auto registerNotification = ntdll ? reinterpret_cast<LdrRegisterDllNotification_t>(
+		GetProcAddress(ntdll, "LdrRegisterDllNotification")) : nullptr;
+
+	if (!registerNotification || registerNotification(0, DllNotification, this, &m_notificationCookie) != 0) {
+		m_notificationCookie = nullptr;
+		Warning("[Module Ranges] Failed to register DLL notifications, table will not follow loads\n");
+	}
+
+	Refresh();
+
+	Msg("[Module Ranges] Tracking %u modules\n", static_cast<unsigned>(GetModuleCount()));
+}
+
+void ModuleRangeTable::Shutdown() {
+	if (m_notificationCookie) {
+		auto ntdll = GetModuleHandle("ntdll.dll");
+		auto unregisterNotification = ntdll ? reinterpret_cast<LdrUnregisterDllNotification_t>(
+			GetProcAddress(ntdll, "LdrUnregisterDllNotification")) : nullptr;
+		if (unregisterNotification) {
+			unregisterNotification(m_notificationCookie);
+		}
+		m_notificationCookie = nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	m_current.store(nullptr);
+	if (m_owned) m_retired.push_back(std::move(m_owned));
+
+	// A handler may still be in Find on another thread. Give it a moment,
+	// and leak the snapshots rather than free them under it.
+	for (int i = 0; i < 100 && m_readers.load() != 0; i++) {
+		Sleep(1);
+	}
+	if (m_readers.load() != 0) {
+		Warning("[Module Ranges] Lookups still running at shutdown, leaking %u snapshots\n",
+			static_cast<unsigned>(m_retired.size()));
+		for (auto& snapshot : m_retired) snapshot.release();
+		m_retired.clear();
+		return;
+	}
+	m_retired.clear();
+}
+
+void ModuleRangeTable::Refresh() {
+	// A notification that lands while the list is being read would be lost
+	// when this snapshot replaces its own, so read again until none did
+	for (int attempt = 0; attempt < 4; attempt++) {
+		uint32_t changes = m_changes.load(std::memory_order_acquire);
+
+		auto snapshot = Enumerate();
+		if (!snapshot) return;
+
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		if (m_changes.load(std::memory_order_relaxed) == changes || attempt == 3) {
+			Publish(std::move(snapshot));
+			return;
+		}
+	}
+}
+
+std::unique_ptr<ModuleRangeTable::Snapshot> ModuleRangeTable::Enumerate() {
+	HANDLE process = GetCurrentProcess();
+	std::vector<HMODULE> modules(256);
+	DWORD needed = 0;
+
+	while (true) {
+		DWORD bytes = static_cast<DWORD>(modules.size() * sizeof(HMODULE));
+		if (!EnumProcessModules(process, modules.data(), bytes, &needed)) {
+			Warning("[Module Ranges] EnumProcessModules failed\n");
+			return nullptr;
+		}
+		if (needed <= bytes) break;
+		modules.resize(needed / sizeof(HMODULE));
+	}
+	modules.resize(needed / sizeof(HMODULE));
+
+	auto snapshot = std::make_unique<Snapshot>();
+	snapshot->ranges.reserve(modules.size());
+	for (HMODULE module : modules) {
+		MODULEINFO info;
+		if (!GetModuleInformation(process, module, &info, sizeof(info))) continue;
+
+		Range range;
+		range.base = reinterpret_cast<uintptr_t>(info.lpBaseOfDll);
+		range.size = info.SizeOfImage;
+		if (!GetModuleBaseNameA(process, module, range.name, sizeof(range.name))) {
+			strcpy(range.name, "unknown");
+		}
+		snapshot->ranges.push_back(range);
+	}
+
+	std::sort(snapshot->ranges.begin(), snapshot->ranges.end(), RangeLess);
+	return snapshot;
+}
+
+void ModuleRangeTable::Publish(std::unique_ptr<Snapshot> snapshot) {
+	m_current.store(snapshot.get());
+	if (m_owned) m_retired.push_back(std::move(m_owned));
+	m_owned = std::move(snapshot);
+	FreeRetired();
+}
+
+void ModuleRangeTable::FreeRetired() {
+	// Readers that start from here on load the snapshot just published, so
+	// with none in flight nothing can still point into the retired ones
+	if (m_readers.load() == 0) {
+		m_retired.clear();
+	}
+}
+
+void ModuleRangeTable::OnModuleLoaded(uintptr_t base, size_t size, const wchar_t* name, size_t nameLength) {
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	m_changes.fetch_add(1, std::memory_order_release);
+
+	auto snapshot = std::make_unique<Snapshot>();
+	if (m_owned) {
+		snapshot->ranges = m_owned->ranges;
+	}
+
+	Range range;
+	range.base = base;
+	range.size = size;
+	CopyName(range.name, sizeof(range.name), name, nameLength);
+
+	auto it = std::lower_bound(snapshot->ranges.begin(), snapshot->ranges.end(), range, RangeLess);
+	if (it != snapshot->ranges.end() && it->base == base) {
+		*it = range;
+	} else {
+		snapshot->ranges.insert(it, range);
+	}
+	Publish(std::move(snapshot));
+}
+
+void ModuleRangeTable::OnModuleUnloaded(uintptr_t base) {
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	m_changes.fetch_add(1, std::memory_order_release);
+
+	auto snapshot = std::make_unique<Snapshot>();
+	if (m_owned) {
+		snapshot->ranges = m_owned->ranges;
+	}
+
+	snapshot->ranges.erase(std::remove_if(snapshot->ranges.begin(), snapshot->ranges.end(),
+		[base](const Range& range) { return range.base == base; }), snapshot->ranges.end());
+	Publish(std::move(snapshot));
+}
+
+VOID CALLBACK ModuleRangeTable::DllNotification(ULONG reason, const void* data, PVOID context) {
+	auto* table = static_cast<ModuleRangeTable*>(context);
+	auto* notification = static_cast<const LdrDllNotificationData*>(data);
+	if (!table || !notification) return;
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(notification->DllBase);
+	if (reason == LDR_DLL_NOTIFICATION_REASON_LOADED) {
+		const UNICODE_STRING* name = notification->BaseDllName;
+		table->OnModuleLoaded(base, notification->SizeOfImage,
+			name ? name->Buffer : L"", name ? name->Length / sizeof(wchar_t) : 0);
+	} else if (reason == LDR_DLL_NOTIFICATION_REASON_UNLOADED) {
+		table->OnModuleUnloaded(base);
+	}
+}
+
+bool ModuleRangeTable::Find(const void* address, Range& out) const {
+	ReadGuard guard(*this);
+	const Snapshot* snapshot = guard.Get();
+	if (!snapshot || snapshot->ranges.empty()) return false;
+
+	uintptr_t value = reinterpret_cast<uintptr_t>(address);
+	const auto& ranges = snapshot->ranges;
+
+	// Last module whose base is <= address
+	size_t low = 0, high = ranges.size();
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (ranges[mid].base <= value) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	if (low == 0) return false;
+
+	const Range& range = ranges[low - 1];
+	if (value - range.base >= range.size) return false;
+
+	out = range;
+	return true;
+}
+
+size_t ModuleRangeTable::GetModuleCount() const {
+	ReadGuard guard(*this);
+	const Snapshot* snapshot = guard.Get();
+	return snapshot ? snapshot->ranges.size() : 0;
+}
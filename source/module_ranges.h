@@ -0,0 +1,65 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Sorted base/size/name table of every loaded module, for attributing return
+// and fault addresses without walking the module list each time.
+//
+// Built once at startup and patched from loader notifications when a DLL is
+// loaded or unloaded. Lookups are lock-free and allocation-free, so they can
+// be used from the vectored exception handlers.
+//
+// Every change publishes a new snapshot. Readers announce themselves in a
+// counter, and replaced snapshots are freed by the next writer that sees no
+// reader in flight.
+class ModuleRangeTable {
+public:
+	struct Range {
+		uintptr_t base;
+		size_t size;
+		char name[64];
+	};
+
+	static ModuleRangeTable& Instance();
+
+	void Initialize();
+	void Shutdown();
+
+	// Rebuilds the table from the process module list
+	void Refresh();
+
+	// Binary search, copies the containing module into out
+	bool Find(const void* address, Range& out) const;
+	size_t GetModuleCount() const;
+
+private:
+	ModuleRangeTable() = default;
+
+	struct Snapshot {
+		std::vector<Range> ranges;
+	};
+
+	std::unique_ptr<Snapshot> Enumerate();
+	// Caller holds m_writeMutex
+	void Publish(std::unique_ptr<Snapshot> snapshot);
+	void FreeRetired();
+	void OnModuleLoaded(uintptr_t base, size_t size, const wchar_t* name, size_t nameLength);
+	void OnModuleUnloaded(uintptr_t base);
+
+	static VOID CALLBACK DllNotification(ULONG reason, const void* data, PVOID context);
+
+	// Pins m_current for the duration of a lookup
+	class ReadGuard;
+
+	std::atomic<const Snapshot*> m_current{ nullptr };
+	mutable std::atomic<uint32_t> m_readers{ 0 };
+	std::atomic<uint32_t> m_changes{ 0 }; // bumped by every notification
+	std::unique_ptr<Snapshot> m_owned;    // what m_current points to
+	std::vector<std::unique_ptr<Snapshot>> m_retired; // replaced while readers were in flight
+	std::mutex m_writeMutex;
+	PVOID m_notificationCookie = nullptr;
+};
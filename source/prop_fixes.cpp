@@ -5,6 +5,7 @@
 #include "materialsystem/materialsystem_config.h"
 #include "interfaces/interfaces.h"  
 #include "prop_fixes.h"  
+#include "signatures/signature_registry.h"
 
 using namespace GarrysMod::Lua;
 
@@ -19,6 +20,9 @@ Define_method_Hook(IMaterial*, R_StudioSetupSkinAndLighting, void*, IMatRenderCo
 }
 
 static StudioRenderConfig_t s_StudioRenderConfig;
+
+static const RegisteredSignature s_StudioSetupSkinAndLightingSignature("studiorender.dll", "R_StudioSetupSkinAndLighting",
+	SIGNATURE("48 89 54 24 10 48 89 4C 24 08 55 56 57 41 54 41 55 41 56 41 57 48 83 EC 50 48 8B 41 08 45 32 F6 49 63 F0 4D 8B E1 4C 8B EA 4C 8B F9 0F B6 A8 58 02 00 00 48 8B B8 50 02 00 00 40 88 AC 24 A0 00 00 00 83 FE 1F 77 20 4C 8B 84 F0 60 02 00 00 4D 85 C0 74 13 0F B6"));
  
 void ModelRenderHooks::Initialize() {
 	try { 
@@ -30,8 +34,7 @@ void ModelRenderHooks::Initialize() {
 		auto studiorenderdll = GetModuleHandle("studiorender.dll");
 		if (!studiorenderdll) { Msg("studiorender.dll == NULL\n"); }
 
-		static const char sign[] = "48 89 54 24 10 48 89 4C 24 08 55 56 57 41 54 41 55 41 56 41 57 48 83 EC 50 48 8B 41 08 45 32 F6 49 63 F0 4D 8B E1 4C 8B EA 4C 8B F9 0F B6 A8 58 02 00 00 48 8B B8 50 02 00 00 40 88 AC 24 A0 00 00 00 83 FE 1F 77 20 4C 8B 84 F0 60 02 00 00 4D 85 C0 74 13 0F B6";
-		auto R_StudioSetupSkinAndLighting = ScanSign(studiorenderdll, sign, sizeof(sign) - 1);
+		auto R_StudioSetupSkinAndLighting = s_StudioSetupSkinAndLightingSignature.Get();
 
 		if (!R_StudioSetupSkinAndLighting) { Msg("R_StudioSetupSkinAndLighting == NULL\n"); return; }
 
@@ -57,7 +60,7 @@ void ModelRenderHooks::Initialize() {
 
 void ModelRenderHooks::Shutdown() { 
 	// Existing shutdown code  
-	R_StudioSetupSkinAndLighting_hook.Disable();
+	HookRegistry::Instance().DisableSubsystem("prop_fixes");
 
 	// Log shutdown completion
 	Msg("[Prop Fixes] Shutdown complete\n");
@@ -1,4 +1,8 @@
 #include "rtx_light_manager.h"
+#include "../globalconvars.h"
+#include "../visibility/map_visibility.h"
+#include "../visibility/occlusion_culler.h"
+#include "../visibility/portal_visibility.h"
 #include <tier0/dbg.h>
 #include <algorithm>
 
@@ -185,8 +189,16 @@ void RTXLightManager::DrawLights() {
             lastDebugTime = currentTime;
         }
 
+        bool cullLights = GlobalConvars::rtx_light_cluster_culling && GlobalConvars::rtx_light_cluster_culling->GetBool() &&
+            PortalVisibility::Instance().IsValid();
+        bool occludeLights = GlobalConvars::rtx_light_occlusion_culling && GlobalConvars::rtx_light_occlusion_culling->GetBool() &&
+            OcclusionCuller::Instance().IsValid();
+
         for (const auto& light : m_lights) {
             if (light.handle) {
+                if (cullLights && !IsLightVisible(light.properties)) continue;
+                if (occludeLights && IsLightOccluded(light.properties)) continue;
+
                 auto result = m_remix->DrawLightInstance(light.handle);
                 if (!result && currentTime - lastDebugTime > 2.0f) {
                     Msg("[RTX Light Manager] Failed to draw light handle: %p\n", light.handle);
@@ -202,6 +214,37 @@ void RTXLightManager::DrawLights() {
 }
 
 // Helper functions implementation...
+bool RTXLightManager::IsLightVisible(const LightProperties& props) const {
+    // Lights reach past their own cluster, so probe a few points around the
+    // light and keep it if any of them is somewhere the camera can see
+    const float reach = (std::max)(props.size, 128.0f);
+    const float* eye = PortalVisibility::Instance().GetViewOrigin();
+    float dx = props.x - eye[0], dy = props.y - eye[1], dz = props.z - eye[2];
+    if (dx * dx + dy * dy + dz * dz <= reach * reach * 4.0f) return true;
+
+    const float offsets[7][3] = {
+        { 0, 0, 0 },
+        { reach, 0, 0 }, { -reach, 0, 0 },
+        { 0, reach, 0 }, { 0, -reach, 0 },
+        { 0, 0, reach }, { 0, 0, -reach },
+    };
+
+    const MapVisibility& visibility = MapVisibility::Instance();
+    for (const auto& offset : offsets) {
+        float probe[3] = { props.x + offset[0], props.y + offset[1], props.z + offset[2] };
+        int cluster = visibility.FindCluster(probe);
+        if (cluster >= 0 && PortalVisibility::Instance().IsClusterVisible(cluster)) return true;
+    }
+    return false;
+}
+
+bool RTXLightManager::IsLightOccluded(const LightProperties& props) const {
+    // Same reach as the cluster test, the whole sphere has to be hidden
+    const float reach = (std::max)(props.size, 128.0f);
+    const float center[3] = { props.x, props.y, props.z };
+    return !OcclusionCuller::Instance().IsSphereVisible(center, reach);
+}
+
 remixapi_LightInfoSphereEXT RTXLightManager::CreateSphereLight(const LightProperties& props) {
     remixapi_LightInfoSphereEXT sphereLight = {};
     sphereLight.sType = REMIXAPI_STRUCT_TYPE_LIGHT_INFO_SPHERE_EXT;
@@ -50,5 +50,7 @@ private:
     remixapi_LightInfoSphereEXT CreateSphereLight(const LightProperties& props);
     remixapi_LightInfo CreateLightInfo(const remixapi_LightInfoSphereEXT& sphereLight);
     uint64_t GenerateLightHash() const;
+    bool IsLightVisible(const LightProperties& props) const;
+    bool IsLightOccluded(const LightProperties& props) const;
     void LogMessage(const char* format, ...);
 };
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "async_vb_validator.h"
+#include <tier0/dbg.h>
+#include <cmath>
+#include <cstring>
+
+bool ScanParticleVertexData(const void* data, size_t size, uint32_t stride, ParticleScanResult& result) {
+    result = ParticleScanResult();
+    if (!data) return false;
+
+    const float* floatData = static_cast<const float*>(data);
+    size_t floatCount = size / sizeof(float);
+    for (size_t i = 0; i < floatCount; i++) {
+        float value = floatData[i];
+
+        ParticleScanResult::Failure failure = ParticleScanResult::None;
+        if (!std::isfinite(value)) {
+            failure = ParticleScanResult::NonFinite;
+        } else if (fabsf(value) > 1e6f) {
+            failure = ParticleScanResult::TooLarge;
+        } else if (fabsf(value) < 1e-6f) {
+            failure = ParticleScanResult::NearZero;
+        }
+
+        if (failure != ParticleScanResult::None) {
+            result.failure = failure;
+            result.failIndex = static_cast<uint32_t>(i);
+            result.failValue = value;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const char* DescribeScanFailure(ParticleScanResult::Failure failure) {
+    switch (failure) {
+        case ParticleScanResult::NonFinite: return "Invalid float";
+        case ParticleScanResult::TooLarge: return "Unreasonable value";
+        case ParticleScanResult::NearZero: return "Near-zero value";
+        default: return "No failure";
+    }
+}
+
+AsyncVertexBufferValidator& AsyncVertexBufferValidator::Instance() {
+    static AsyncVertexBufferValidator instance;
+    return instance;
+}
+
+void AsyncVertexBufferValidator::Start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) return;
+
+    m_running = true;
+    m_worker = std::thread(&AsyncVertexBufferValidator::WorkerMain, this);
+}
+
+void AsyncVertexBufferValidator::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_running = false;
+    }
+    m_wake.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.clear();
+    m_pool.clear();
+    m_entries.clear();
+}
+
+AsyncVertexBufferValidator::Result AsyncVertexBufferValidator::Query(
+    const void* buffer, uint32_t frame, bool& needsSnapshot) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[buffer];
+    entry.lastUsedFrame = frame;
+
+    needsSnapshot = entry.lastSnapshotFrame != frame;
+
+    if (entry.latest.verdict != Verdict::Unknown && entry.latestFrame < frame) {
+        return entry.latest;
+    }
+    if (entry.previous.verdict != Verdict::Unknown && entry.previousFrame < frame) {
+        return entry.previous;
+    }
+    return Result();
+}
+
+bool AsyncVertexBufferValidator::Submit(
+    const void* buffer, uint32_t stride, uint32_t frame, const void* data, size_t size) {
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_running) return false;
+
+    auto it = m_entries.find(buffer);
+    if (it != m_entries.end()) {
+        it->second.lastSnapshotFrame = frame;
+    }
+
+    if (m_jobs.size() >= kMaxPendingJobs) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Job job;
+    job.buffer = buffer;
+    job.stride = stride;
+    job.frame = frame;
+    if (!m_pool.empty()) {
+        job.data = std::move(m_pool.back());
+        m_pool.pop_back();
+    }
+
+    // The copy happens outside the lock, the job is not visible yet
+    lock.unlock();
+    job.data.resize(size);
+    memcpy(job.data.data(), data, size);
+    lock.lock();
+
+    m_jobs.push_back(std::move(job));
+    m_submitted.fetch_add(1, std::memory_order_relaxed);
+    lock.unlock();
+
+    m_wake.notify_one();
+    return true;
+}
+
+void AsyncVertexBufferValidator::EndFrame(uint32_t frame) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (frame - it->second.lastUsedFrame > kForgetAfterFrames) {
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void AsyncVertexBufferValidator::WorkerMain() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return !m_running || !m_jobs.empty(); });
+            if (!m_running) return;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        ParticleScanResult scan;
+        ScanParticleVertexData(job.data.data(), job.data.size(), job.stride, scan);
+        m_scanned.fetch_add(1, std::memory_order_relaxed);
+
+        Publish(job, scan);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pool.size() < kMaxPooledBuffers) {
+            m_pool.push_back(std::move(job.data));
+        }
+    }
+}
+
+void AsyncVertexBufferValidator::Publish(const Job& job, const ParticleScanResult& scan) {
+    Result result;
+    result.verdict = scan.failure == ParticleScanResult::None ? Verdict::Valid : Verdict::Invalid;
+    result.scan = scan;
+
+    bool newlyInvalid = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Buffers that were forgotten in the meantime stay forgotten
+        auto it = m_entries.find(job.buffer);
+        if (it == m_entries.end()) return;
+
+        Entry& entry = it->second;
+        if (entry.latest.verdict != Verdict::Unknown && job.frame < entry.latestFrame) return;
+
+        newlyInvalid = result.verdict == Verdict::Invalid && entry.latest.verdict != Verdict::Invalid;
+        if (entry.latestFrame != job.frame) {
+            entry.previous = entry.latest;
+            entry.previousFrame = entry.latestFrame;
+        }
+        entry.latest = result;
+        entry.latestFrame = job.frame;
+    }
+
+    if (result.verdict == Verdict::Invalid) {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (newlyInvalid) {
+        Warning("[Shader Fixes] Async scan: %s at index %u: %f in vertex buffer %p\n",
+            DescribeScanFailure(scan.failure), scan.failIndex, scan.failValue, job.buffer);
+    }
+}
+
+void AsyncVertexBufferValidator::PrintStats() const {
+    size_t tracked, pending;
+    bool running;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tracked = m_entries.size();
+        pending = m_jobs.size();
+        running = m_running;
+    }
+
+    Msg("[Shader Fixes] Async vertex buffer validation: %s\n", running ? "running" : "stopped");
+    Msg("  Tracked buffers: %u, pending snapshots: %u\n",
+        static_cast<unsigned>(tracked), static_cast<unsigned>(pending));
+    Msg("  Submitted: %llu, dropped (queue full): %llu, scanned: %llu, invalid: %llu\n",
+        static_cast<unsigned long long>(m_submitted.load()),
+        static_cast<unsigned long long>(m_dropped.load()),
+        static_cast<unsigned long long>(m_scanned.load()),
+        static_cast<unsigned long long>(m_rejected.load()));
+}
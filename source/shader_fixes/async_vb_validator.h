@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Outcome of scanning particle vertex data, shared by the synchronous and
+// asynchronous validation paths.
+struct ParticleScanResult {
+    enum Failure { None, NonFinite, TooLarge, NearZero };
+
+    Failure failure = None;
+    uint32_t failIndex = 0;
+    float failValue = 0.0f;
+};
+
+// Checks every float for NaN/inf, huge and near-zero values. Pure, no D3D.
+bool ScanParticleVertexData(const void* data, size_t size, uint32_t stride, ParticleScanResult& result);
+const char* DescribeScanFailure(ParticleScanResult::Failure failure);
+
+// Moves particle vertex buffer scans off the render thread.
+//
+// The SetStreamSource detour copies a buffer's contents into a pooled staging
+// buffer at most once per frame and hands it to a worker thread. The worker's
+// verdict only gates the buffer from the next frame on, so a frame never
+// waits for it. Until a buffer has a verdict, the caller falls back to the
+// optimistic or pessimistic default (rtx_shaderfix_async_vb_default).
+class AsyncVertexBufferValidator {
+public:
+    enum class Verdict { Unknown, Valid, Invalid };
+
+    struct Result {
+        Verdict verdict = Verdict::Unknown;
+        ParticleScanResult scan;
+    };
+
+    static AsyncVertexBufferValidator& Instance();
+
+    void Start();
+    void Stop();
+
+    // Render thread. Returns the newest verdict from an earlier frame, and
+    // sets needsSnapshot the first time the buffer is seen this frame.
+    Result Query(const void* buffer, uint32_t frame, bool& needsSnapshot);
+
+    // Render thread. Copies the data and queues it, false if the queue is full.
+    bool Submit(const void* buffer, uint32_t stride, uint32_t frame, const void* data, size_t size);
+
+    // Render thread, once per frame. Forgets buffers that went unused.
+    void EndFrame(uint32_t frame);
+
+    void PrintStats() const;
+
+private:
+    AsyncVertexBufferValidator() = default;
+
+    struct Job {
+        const void* buffer;
+        uint32_t stride;
+        uint32_t frame;
+        std::vector<uint8_t> data;
+    };
+
+    struct Entry {
+        uint32_t lastSnapshotFrame = UINT32_MAX;
+        uint32_t lastUsedFrame = 0;
+
+        // Two newest verdicts, so one produced during the current frame
+        // does not hide the one from the frame before
+        Result latest;
+        uint32_t latestFrame = 0;
+        Result previous;
+        uint32_t previousFrame = 0;
+    };
+
+    static constexpr size_t kMaxPendingJobs = 64;
+    static constexpr size_t kMaxPooledBuffers = 16;
+    static constexpr uint32_t kForgetAfterFrames = 300;
+
+    void WorkerMain();
+    void Publish(const Job& job, const ParticleScanResult& scan);
+
+    std::thread m_worker;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_running = false;
+
+    std::deque<Job> m_jobs;
+    std::vector<std::vector<uint8_t>> m_pool;
+    std::unordered_map<const void*, Entry> m_entries;
+
+    std::atomic<uint64_t> m_submitted{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::atomic<uint64_t> m_scanned{ 0 };
+    std::atomic<uint64_t> m_rejected{ 0 };
+};
@@ -0,0 +1,109 @@
+#include "crash_site_registry.h"
+#include <tier0/dbg.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+    size_t HashAddress(uintptr_t address) {
+        uint64_t x = static_cast<uint64_t>(address);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return static_cast<size_t>(x);
+    }
+
+    const char* SourceName(uint32_t source) {
+        switch (static_cast<CrashSiteRegistry::Source>(source)) {
+            case CrashSiteRegistry::Source::DivisionHandler: return "division VEH";
+            case CrashSiteRegistry::Source::GeneralHandler: return "general VEH";
+            case CrashSiteRegistry::Source::DivisionDetour: return "division detour";
+        }
+        return "unknown";
+    }
+}
+
+CrashSiteRegistry& CrashSiteRegistry::Instance() {
+    static CrashSiteRegistry instance;
+    return instance;
+}
+
+size_t CrashSiteRegistry::Record(const void* address, Source source, bool& firstHit) {
+    firstHit = false;
+
+    // Zero marks an empty slot
+    uintptr_t key = reinterpret_cast<uintptr_t>(address);
+    if (key == 0) key = 1;
+
+    size_t start = HashAddress(key) % kCapacity;
+    for (size_t probe = 0; probe < kCapacity; probe++) {
+        size_t slot = (start + probe) % kCapacity;
+        Site& site = m_sites[slot];
+
+        uintptr_t current = site.address.load(std::memory_order_acquire);
+        if (current == 0) {
+            uintptr_t expected = 0;
+            if (site.address.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) {
+                site.source.store(static_cast<uint32_t>(source), std::memory_order_relaxed);
+                site.hits.fetch_add(1, std::memory_order_relaxed);
+                m_siteCount.fetch_add(1, std::memory_order_relaxed);
+                firstHit = true;
+                return slot;
+            }
+            current = expected;
+        }
+
+        if (current == key) {
+            site.hits.fetch_add(1, std::memory_order_relaxed);
+            return slot;
+        }
+    }
+
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return kInvalidSlot;
+}
+
+void CrashSiteRegistry::Describe(size_t slot, const char* description) {
+    if (slot >= kCapacity || !description) return;
+
+    Site& site = m_sites[slot];
+    strncpy(site.description, description, sizeof(site.description) - 1);
+    site.description[sizeof(site.description) - 1] = '\0';
+    site.described.store(true, std::memory_order_release);
+}
+
+void CrashSiteRegistry::PrintTopSites(size_t count) const {
+    struct Snapshot {
+        uintptr_t address;
+        uint64_t hits;
+        uint32_t source;
+        const char* description;
+    };
+
+    std::vector<Snapshot> sites;
+    sites.reserve(m_siteCount.load(std::memory_order_relaxed));
+    for (const Site& site : m_sites) {
+        uintptr_t address = site.address.load(std::memory_order_acquire);
+        if (address == 0) continue;
+
+        Snapshot snapshot;
+        snapshot.address = address;
+        snapshot.hits = site.hits.load(std::memory_order_relaxed);
+        snapshot.source = site.source.load(std::memory_order_relaxed);
+        snapshot.description = site.described.load(std::memory_order_acquire) ? site.description : "";
+        sites.push_back(snapshot);
+    }
+
+    size_t shown = std::min(count, sites.size());
+    std::partial_sort(sites.begin(), sites.begin() + shown, sites.end(),
+        [](const Snapshot& a, const Snapshot& b) { return a.hits > b.hits; });
+
+    Msg("[Shader Fixes] Crash sites: %u recorded, %llu hits dropped (table full)\n",
+        static_cast<unsigned>(sites.size()), static_cast<unsigned long long>(m_dropped.load()));
+    for (size_t i = 0; i < shown; i++) {
+        const Snapshot& site = sites[i];
+        Msg("  %2u. %p  hits: %-10llu %-16s %s\n",
+            static_cast<unsigned>(i + 1), reinterpret_cast<void*>(site.address),
+            static_cast<unsigned long long>(site.hits), SourceName(site.source), site.description);
+    }
+}
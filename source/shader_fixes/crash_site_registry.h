@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size, lock-free table of fault sites seen by the exception handlers
+// and the division detour, keyed by instruction (or return) address.
+//
+// Record() is safe to call from a vectored exception handler: it never
+// allocates or locks. Only the first hit of a site reports firstHit = true,
+// so the caller can do its expensive logging once and let repeats just bump
+// the counter.
+class CrashSiteRegistry {
+public:
+    enum class Source : uint32_t {
+        DivisionHandler,
+        GeneralHandler,
+        DivisionDetour,
+    };
+
+    static constexpr size_t kCapacity = 512;
+    static constexpr size_t kInvalidSlot = static_cast<size_t>(-1);
+
+    static CrashSiteRegistry& Instance();
+
+    // Returns the slot for the address, or kInvalidSlot when the table is full.
+    size_t Record(const void* address, Source source, bool& firstHit);
+
+    // Attaches a description to a slot. Only the thread that got firstHit
+    // for the slot should call this.
+    void Describe(size_t slot, const char* description);
+
+    void PrintTopSites(size_t count) const;
+    size_t GetSiteCount() const { return m_siteCount.load(std::memory_order_relaxed); }
+
+private:
+    CrashSiteRegistry() = default;
+
+    struct Site {
+        std::atomic<uintptr_t> address{ 0 };
+        std::atomic<uint64_t> hits{ 0 };
+        std::atomic<uint32_t> source{ 0 };
+        std::atomic<bool> described{ false };
+        char description[224] = {};
+    };
+
+    Site m_sites[kCapacity];
+    std::atomic<size_t> m_siteCount{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+};
@@ -0,0 +1,137 @@
+#include "particle_budget.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // Source uploads cViewProj to c8..c11, one row per clip space component
+    constexpr uint32_t kViewProjFirstRegister = 8;
+    constexpr uint32_t kViewProjRegisterCount = 4;
+    constexpr uint32_t kViewProjComplete = (1u << kViewProjRegisterCount) - 1;
+
+    constexpr float kPi = 3.14159265f;
+}
+
+ParticleBudget& ParticleBudget::Instance() {
+    static ParticleBudget instance;
+    return instance;
+}
+
+void ParticleBudget::OnVertexShaderConstants(uint32_t startRegister, const float* data, uint32_t vector4fCount) {
+    if (!data) return;
+
+    uint32_t first = std::max(startRegister, kViewProjFirstRegister);
+    uint32_t last = std::min(startRegister + vector4fCount, kViewProjFirstRegister + kViewProjRegisterCount);
+    for (uint32_t reg = first; reg < last; reg++) {
+        uint32_t row = reg - kViewProjFirstRegister;
+        const float* source = data + (reg - startRegister) * 4;
+        for (int i = 0; i < 4; i++) {
+            m_viewProj[row][i] = source[i];
+        }
+        m_viewProjMask |= 1u << row;
+    }
+}
+
+void ParticleBudget::SetDrawBounds(const void* vertices, uint32_t vertexCount, uint32_t stride) {
+    m_hasDrawBounds = false;
+    if (!vertices || vertexCount == 0 || stride < sizeof(float) * 3) return;
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        float position[3];
+        memcpy(position, bytes + static_cast<size_t>(v) * stride, sizeof(position));
+        // Garbage is the validator's business, it would only blow up the size
+        if (!std::isfinite(position[0]) || !std::isfinite(position[1]) || !std::isfinite(position[2])) continue;
+
+        for (int i = 0; i < 3; i++) {
+            if (!m_hasDrawBounds || position[i] < m_boundsMin[i]) m_boundsMin[i] = position[i];
+            if (!m_hasDrawBounds || position[i] > m_boundsMax[i]) m_boundsMax[i] = position[i];
+        }
+        m_hasDrawBounds = true;
+    }
+}
+
+float ParticleBudget::EstimateScreenFraction() const {
+    if (!m_hasDrawBounds || m_viewProjMask != kViewProjComplete) return -1.0f;
+
+    float center[3], radiusSq = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        center[i] = (m_boundsMin[i] + m_boundsMax[i]) * 0.5f;
+        float half = (m_boundsMax[i] - m_boundsMin[i]) * 0.5f;
+        radiusSq += half * half;
+    }
+    float radius = sqrtf(radiusSq);
+
+    // Clip space w of the bounding sphere centre
+    const float* wRow = m_viewProj[3];
+    float w = center[0] * wRow[0] + center[1] * wRow[1] + center[2] * wRow[2] + wRow[3];
+    if (w <= radius) return 1.0f; // camera inside or right next to it
+
+    // Vertical projection scale, y row of the matrix
+    const float* yRow = m_viewProj[1];
+    float scale = sqrtf(yRow[0] * yRow[0] + yRow[1] * yRow[1] + yRow[2] * yRow[2]);
+
+    // NDC spans 2 units each way, so the screen is 4 square units
+    float ndcRadius = radius * scale / w;
+    return std::min(1.0f, kPi * ndcRadius * ndcRadius / 4.0f);
+}
+
+bool ParticleBudget::Admit(uint32_t primitiveCount, uint32_t budget) {
+    // Unknown size ranks as full screen, we cannot tell it is small
+    float fraction = EstimateScreenFraction();
+    if (fraction < 0.0f) fraction = 1.0f;
+
+    if (m_requests.size() < kMaxRequests) {
+        m_requests.push_back({ fraction, primitiveCount });
+    }
+
+    if (fraction < m_threshold || m_used + primitiveCount > budget) {
+        m_skippedDraws++;
+        m_skippedPrimitives += primitiveCount;
+        return false;
+    }
+
+    m_used += primitiveCount;
+    return true;
+}
+
+void ParticleBudget::EndFrame(uint32_t budget) {
+    // Largest first, the threshold is the smallest coverage that still fit
+    std::sort(m_requests.begin(), m_requests.end(),
+        [](const Request& a, const Request& b) { return a.screenFraction > b.screenFraction; });
+
+    float threshold = 0.0f;
+    uint64_t total = 0;
+    for (const Request& request : m_requests) {
+        total += request.primitives;
+        if (total > budget) break;
+        threshold = request.screenFraction;
+    }
+    if (total <= budget) {
+        threshold = 0.0f;
+    } else if (threshold == 0.0f && !m_requests.empty()) {
+        threshold = m_requests.front().screenFraction;
+    }
+
+    m_lastBudget.store(budget, std::memory_order_relaxed);
+    m_lastUsed.store(m_used, std::memory_order_relaxed);
+    m_lastSkippedDraws.store(m_skippedDraws, std::memory_order_relaxed);
+    m_lastSkippedPrimitives.store(m_skippedPrimitives, std::memory_order_relaxed);
+    m_lastThreshold.store(threshold, std::memory_order_relaxed);
+
+    m_threshold = threshold;
+    m_requests.clear();
+    m_used = 0;
+    m_skippedDraws = 0;
+    m_skippedPrimitives = 0;
+}
+
+ParticleBudget::Stats ParticleBudget::GetStats() const {
+    Stats stats;
+    stats.budget = m_lastBudget.load(std::memory_order_relaxed);
+    stats.admittedPrimitives = m_lastUsed.load(std::memory_order_relaxed);
+    stats.skippedDraws = m_lastSkippedDraws.load(std::memory_order_relaxed);
+    stats.skippedPrimitives = m_lastSkippedPrimitives.load(std::memory_order_relaxed);
+    stats.threshold = m_lastThreshold.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-frame primitive budget for particle-classified draws.
+//
+// Each admitted draw is weighted by its estimated screen coverage, taken from
+// the bounds of the vertices the draw uses and the view projection the game
+// last uploaded (vertex shader constants c8..c11). Priority is one frame
+// late: EndFrame() sorts the frame's requests by coverage and picks the
+// smallest coverage that still fit in the budget, and the next frame rejects
+// anything below it. Draws are then admitted first come until the budget is
+// spent. While a frame stays within budget no draw's bounds are read at all,
+// they rank as full screen.
+//
+// Render thread only, except GetStats().
+class ParticleBudget {
+public:
+    struct Stats {
+        uint32_t budget;
+        uint32_t admittedPrimitives;
+        uint32_t skippedDraws;
+        uint32_t skippedPrimitives;
+        float threshold;
+    };
+
+    static ParticleBudget& Instance();
+
+    // Mirrors SetVertexShaderConstantF, keeps whatever overlaps c8..c11
+    void OnVertexShaderConstants(uint32_t startRegister, const float* data, uint32_t vector4fCount);
+
+    // Bounds of the draw's vertices, the leading float3 of each is its
+    // object space position
+    void SetDrawBounds(const void* vertices, uint32_t vertexCount, uint32_t stride);
+    void ClearDrawBounds() { m_hasDrawBounds = false; }
+    // Whether the draw's size can decide if it is kept: last frame went over
+    // budget, or this draw would. Otherwise its bounds are not worth reading.
+    bool NeedsDrawBounds(uint32_t primitiveCount, uint32_t budget) const {
+        return m_threshold > 0.0f || m_used + primitiveCount > budget;
+    }
+
+    // Returns false when the draw should be skipped
+    bool Admit(uint32_t primitiveCount, uint32_t budget);
+
+    // Called once per frame from Present
+    void EndFrame(uint32_t budget);
+
+    // Fraction of the screen covered by the draw, 0..1, or -1 if unknown
+    float EstimateScreenFraction() const;
+
+    Stats GetStats() const;
+
+private:
+    ParticleBudget() = default;
+
+    struct Request {
+        float screenFraction;
+        uint32_t primitives;
+    };
+
+    static constexpr size_t kMaxRequests = 8192;
+
+    float m_viewProj[4][4] = {};
+    uint32_t m_viewProjMask = 0; // one bit per captured row
+    float m_boundsMin[3] = {};
+    float m_boundsMax[3] = {};
+    bool m_hasDrawBounds = false;
+
+    std::vector<Request> m_requests;
+    uint32_t m_used = 0;
+    uint32_t m_skippedDraws = 0;
+    uint32_t m_skippedPrimitives = 0;
+    float m_threshold = 0.0f;
+
+    // Last completed frame, for Lua
+    std::atomic<uint32_t> m_lastBudget{ 0 };
+    std::atomic<uint32_t> m_lastUsed{ 0 };
+    std::atomic<uint32_t> m_lastSkippedDraws{ 0 };
+    std::atomic<uint32_t> m_lastSkippedPrimitives{ 0 };
+    std::atomic<float> m_lastThreshold{ 0.0f };
+};
@@ -1,7 +1,12 @@
 #include "shader_hooks.h"
+#include "crash_site_registry.h"
+#include "particle_budget.h"
+#include "async_vb_validator.h"
+#include "../module_ranges.h"
+#include "../signatures/signature_registry.h"
+#include "../globalconvars.h"
+#include "../hook_registry.h"
 #include <algorithm>
-#include <psapi.h>
-#pragma comment(lib, "psapi.lib")
 
 // Define the global variables here
 IShaderAPI* g_pShaderAPI = nullptr;
@@ -17,12 +22,61 @@ ShaderAPIHooks::DrawIndexedPrimitive_t ShaderAPIHooks::g_original_DrawIndexedPri
 ShaderAPIHooks::SetVertexShaderConstantF_t ShaderAPIHooks::g_original_SetVertexShaderConstantF = nullptr;
 ShaderAPIHooks::SetStreamSource_t ShaderAPIHooks::g_original_SetStreamSource = nullptr;
 ShaderAPIHooks::SetVertexShader_t ShaderAPIHooks::g_original_SetVertexShader = nullptr;
+ShaderAPIHooks::Present_t ShaderAPIHooks::g_original_Present = nullptr;
+uint32_t ShaderAPIHooks::s_frameNumber = 0;
+ShaderAPIHooks::DrawDecision ShaderAPIHooks::s_drawDecision;
+ShaderAPIHooks::AdaptiveHook ShaderAPIHooks::s_adaptiveHooks[ShaderAPIHooks::Adaptive_Count] = {
+    { "DrawIndexedPrimitive", nullptr, true, 0 },
+    { "SetVertexShaderConstantF", nullptr, true, 0 },
+    { "SetStreamSource", nullptr, true, 0 },
+    { "SetVertexShader", nullptr, true, 0 },
+    { "Division", nullptr, true, 0 },
+};
+std::atomic<bool> ShaderAPIHooks::s_rearmRequested{ false };
+std::atomic<const char*> ShaderAPIHooks::s_rearmReason{ nullptr };
 ShaderAPIHooks::DivisionFunction_t ShaderAPIHooks::g_original_DivisionFunction = nullptr;
 ShaderAPIHooks::VertexBufferLock_t ShaderAPIHooks::g_original_VertexBufferLock = nullptr;
-std::unordered_set<uintptr_t> ShaderAPIHooks::s_problematicAddresses;
 ShaderAPIHooks::ParticleRender_t ShaderAPIHooks::g_original_ParticleRender = nullptr;
 
 namespace {
+    // Everything scanned for in shaderapidx9.dll, resolved in one pass
+    const RegisteredSignature s_shaderApiSignatures[] = {
+        { "shaderapidx9.dll", "Division instruction", SIGNATURE("48 63 C8 99 F7 F9") },
+        { "shaderapidx9.dll", "Function entry", SIGNATURE("89 51 34 89 38 48 89 D9") },
+        { "shaderapidx9.dll", "Parameter setup", SIGNATURE("8B F2 44 0F B6 C0") },
+        { "shaderapidx9.dll", "Division and multiply", SIGNATURE("F7 F9 03 C1 0F AF C1") },
+        { "shaderapidx9.dll", "Pre-crash sequence", SIGNATURE("42 89 44 24 20 44 89 44 24 28") },
+        { "shaderapidx9.dll", "Call sequence", SIGNATURE("48 8D 4C 24 20 E8") },
+    };
+
+    const RegisteredSignature s_deviceSignature("shaderapidx9.dll", "D3D9 device", SIGNATURE("BA E1 0D 74 5E 48 89 1D ?? ?? ?? ??"));
+
+    // Hooks one device method either by swapping its vtable slot or with an
+    // inline detour, registers it and returns its HookRegistry handle
+    template <typename T>
+    const void* HookDeviceMethod(void** vftable, size_t index, const char* name, bool useVTable,
+        Detouring::Hook& inlineHook, VTableHook& vtableHook, T detour, T& original) {
+        void* function = vftable[index];
+
+        if (useVTable) {
+            if (!vtableHook.Create(vftable, index, detour, &original) || !vtableHook.Enable()) {
+                Warning("[Shader Fixes] Failed to hook %s\n", name);
+                return nullptr;
+            }
+            HookRegistry::Instance().Add(name, "shader_hooks", &vtableHook, function);
+            Msg("[Shader Fixes] Hooked %s (vtable slot %u)\n", name, static_cast<unsigned>(index));
+            return &vtableHook;
+        }
+
+        Detouring::Hook::Target target(&vftable[index]);
+        inlineHook.Create(target, detour);
+        original = inlineHook.GetTrampoline<T>();
+        inlineHook.Enable();
+        HookRegistry::Instance().Add(name, "shader_hooks", &inlineHook, function);
+        Msg("[Shader Fixes] Hooked %s\n", name);
+        return &inlineHook;
+    }
+
     bool IsValidPointer(const void* ptr, size_t size) {
         if (!ptr) return false;
         MEMORY_BASIC_INFORMATION mbi = { 0 };
@@ -31,6 +85,65 @@ namespace {
         if (!(mbi.Protect & (PAGE_READONLY | PAGE_READWRITE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE))) return false;
         return true;
     }
+
+    // DbgHelp is set up once in Initialize, never from the handlers: it loads
+    // symbol files and takes the loader lock
+    bool g_symbolsInitialized = false;
+
+    // Module + symbol for an address. Slow, only used on a site's first hit.
+    // Modules loaded after Initialize get module+offset only.
+    void DescribeAddress(const void* address, char* out, size_t outSize) {
+        ModuleRangeTable::Range module = {};
+        if (!ModuleRangeTable::Instance().Find(address, module)) {
+            strcpy(module.name, "unknown");
+        }
+        const char* baseName = module.name;
+        uintptr_t moduleBase = module.base;
+
+        char symbolBuffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME] = {};
+        SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(symbolBuffer);
+        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+        symbol->MaxNameLen = MAX_SYM_NAME;
+
+        DWORD64 displacement = 0;
+        if (g_symbolsInitialized &&
+            SymFromAddr(GetCurrentProcess(), reinterpret_cast<DWORD64>(address), &displacement, symbol)) {
+            snprintf(out, outSize, "%s+0x%llX (%s+0x%llX)", baseName,
+                static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(address) - moduleBase),
+                symbol->Name, static_cast<unsigned long long>(displacement));
+        } else {
+            snprintf(out, outSize, "%s+0x%llX", baseName,
+                static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(address) - moduleBase));
+        }
+    }
+
+    // Bounds of the vertices a DrawIndexedPrimitive reads from stream 0, for
+    // the particle budget's size estimate
+    void UpdateParticleDrawBounds(IDirect3DDevice9* device, INT baseVertexIndex, UINT minVertexIndex, UINT numVertices) {
+        ParticleBudget& budget = ParticleBudget::Instance();
+        budget.ClearDrawBounds();
+
+        IDirect3DVertexBuffer9* vertexBuffer = nullptr;
+        UINT offset = 0, stride = 0;
+        if (FAILED(device->GetStreamSource(0, &vertexBuffer, &offset, &stride)) || !vertexBuffer) return;
+
+        D3DVERTEXBUFFER_DESC desc;
+        int64_t first = static_cast<int64_t>(baseVertexIndex) + minVertexIndex;
+        if (first >= 0 && stride > 0 && SUCCEEDED(vertexBuffer->GetDesc(&desc))) {
+            uint64_t start = offset + static_cast<uint64_t>(first) * stride;
+            uint64_t size = static_cast<uint64_t>(numVertices) * stride;
+            if (start < desc.Size) {
+                size = (std::min)(size, desc.Size - start);
+
+                void* data;
+                if (SUCCEEDED(vertexBuffer->Lock(static_cast<UINT>(start), static_cast<UINT>(size), &data, D3DLOCK_READONLY))) {
+                    budget.SetDrawBounds(data, static_cast<uint32_t>(size / stride), stride);
+                    vertexBuffer->Unlock();
+                }
+            }
+        }
+        vertexBuffer->Release();
+    }
 }
 
 void ShaderAPIHooks::Initialize() {
@@ -38,33 +151,50 @@ void ShaderAPIHooks::Initialize() {
         m_vehHandle = nullptr;
         m_vehHandlerDivision = nullptr;
 
+        // Per-material validation policies, optional
+        ValidationPolicyTable::Instance().LoadFromFile("garrysmod/data/rtx_fixes/validation_policy.txt");
+
+        // Symbols for the crash site descriptions, before any handler can need them
+        if (!g_symbolsInitialized) {
+            SymSetOptions(SymGetOptions() & ~SYMOPT_DEFERRED_LOADS);
+            g_symbolsInitialized = SymInitialize(GetCurrentProcess(), NULL, TRUE) != FALSE;
+            if (!g_symbolsInitialized) {
+                Warning("[Shader Fixes] SymInitialize failed, crash sites will have no symbols\n");
+            }
+        }
+
         // First install our exception handlers
         m_vehHandlerDivision = AddVectoredExceptionHandler(0, [](PEXCEPTION_POINTERS exceptionInfo) -> LONG {
             if (exceptionInfo->ExceptionRecord->ExceptionCode == EXCEPTION_INT_DIVIDE_BY_ZERO) {
                 void* crashAddress = exceptionInfo->ExceptionRecord->ExceptionAddress;
-                
-                // Get module information
-                HMODULE hModule = NULL;
-                if (GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
-                    (LPCTSTR)crashAddress, &hModule)) {
-                    char moduleName[MAX_PATH];
-                    GetModuleFileNameA(hModule, moduleName, sizeof(moduleName));
-                    Warning("[Shader Fixes] Division by zero in module: %s\n", moduleName);
-                }
 
-                // Detailed crash context
-                Warning("[Shader Fixes] Division crash details:\n");
-                Warning("  Address: %p\n", crashAddress);
-                Warning("  Thread ID: %u\n", GetCurrentThreadId());
-                
-                // Stack trace
-                void* stack[64];
-                WORD frames = CaptureStackBackTrace(0, 64, stack, NULL);
-                Warning("  Stack trace (%d frames):\n", frames);
-                for (WORD i = 0; i < frames; i++) {
-                    Warning("    %d: %p\n", i, stack[i]);
+                // Repeats of a known site only bump its counter
+                bool firstHit = false;
+                size_t slot = CrashSiteRegistry::Instance().Record(
+                    crashAddress, CrashSiteRegistry::Source::DivisionHandler, firstHit);
+
+                if (firstHit) {
+                    char description[224];
+                    DescribeAddress(crashAddress, description, sizeof(description));
+                    CrashSiteRegistry::Instance().Describe(slot, description);
+
+                    // Detailed crash context
+                    Warning("[Shader Fixes] Division by zero at %s\n", description);
+                    Warning("[Shader Fixes] Division crash details:\n");
+                    Warning("  Address: %p\n", crashAddress);
+                    Warning("  Thread ID: %u\n", GetCurrentThreadId());
+
+                    // Stack trace
+                    void* stack[64];
+                    WORD frames = CaptureStackBackTrace(0, 64, stack, NULL);
+                    Warning("  Stack trace (%d frames):\n", frames);
+                    for (WORD i = 0; i < frames; i++) {
+                        Warning("    %d: %p\n", i, stack[i]);
+                    }
                 }
 
+                RequestRearm("division exception");
+
                 // Set safe values and continue
                 exceptionInfo->ContextRecord->Rax = 1;
                 exceptionInfo->ContextRecord->Rip += 2;
@@ -84,15 +214,28 @@ void ShaderAPIHooks::Initialize() {
         m_vehHandle = AddVectoredExceptionHandler(1, [](PEXCEPTION_POINTERS exceptionInfo) -> LONG {
             if (exceptionInfo->ExceptionRecord->ExceptionCode == EXCEPTION_INT_DIVIDE_BY_ZERO) {
                 void* crashAddress = exceptionInfo->ExceptionRecord->ExceptionAddress;
-                Warning("[Shader Fixes] Caught division by zero at %p\n", crashAddress);
-                
-                Warning("[Shader Fixes] Register state:\n");
-                Warning("  RAX: %016llX\n", exceptionInfo->ContextRecord->Rax);
-                Warning("  RCX: %016llX\n", exceptionInfo->ContextRecord->Rcx);
-                Warning("  RDX: %016llX\n", exceptionInfo->ContextRecord->Rdx);
-                Warning("  R8:  %016llX\n", exceptionInfo->ContextRecord->R8);
-                Warning("  R9:  %016llX\n", exceptionInfo->ContextRecord->R9);
-                Warning("  RIP: %016llX\n", exceptionInfo->ContextRecord->Rip);
+
+                bool firstHit = false;
+                size_t slot = CrashSiteRegistry::Instance().Record(
+                    crashAddress, CrashSiteRegistry::Source::GeneralHandler, firstHit);
+
+                if (firstHit) {
+                    char description[224];
+                    DescribeAddress(crashAddress, description, sizeof(description));
+                    CrashSiteRegistry::Instance().Describe(slot, description);
+
+                    Warning("[Shader Fixes] Caught division by zero at %p (%s)\n", crashAddress, description);
+
+                    Warning("[Shader Fixes] Register state:\n");
+                    Warning("  RAX: %016llX\n", exceptionInfo->ContextRecord->Rax);
+                    Warning("  RCX: %016llX\n", exceptionInfo->ContextRecord->Rcx);
+                    Warning("  RDX: %016llX\n", exceptionInfo->ContextRecord->Rdx);
+                    Warning("  R8:  %016llX\n", exceptionInfo->ContextRecord->R8);
+                    Warning("  R9:  %016llX\n", exceptionInfo->ContextRecord->R9);
+                    Warning("  RIP: %016llX\n", exceptionInfo->ContextRecord->Rip);
+                }
+
+                RequestRearm("division exception");
 
                 exceptionInfo->ContextRecord->Rax = 1;
                 exceptionInfo->ContextRecord->Rip += 2;
@@ -116,42 +259,33 @@ void ShaderAPIHooks::Initialize() {
         }
 
         // Find and hook problematic patterns
-        static const std::pair<const char*, const char*> signatures[] = {
-            {"48 63 C8 99 F7 F9", "Division instruction"},
-            {"89 51 34 89 38 48 89 D9", "Function entry"},
-            {"8B F2 44 0F B6 C0", "Parameter setup"},
-            {"F7 F9 03 C1 0F AF C1", "Division and multiply"},
-            {"42 89 44 24 20 44 89 44 24 28", "Pre-crash sequence"},
-            {"48 8D 4C 24 20 E8", "Call sequence"}
-        };
-
-        for (const auto& sig : signatures) {
-            void* found_ptr = ScanSign(shaderapidx9, sig.first, strlen(sig.first));
+        for (const auto& sig : s_shaderApiSignatures) {
+            void* found_ptr = sig.Get();
             if (found_ptr) {
-                Msg("[Shader Fixes] Found %s at %p\n", sig.second, found_ptr);
+                Msg("[Shader Fixes] Found %s at %p\n", sig.GetName(), found_ptr);
 
                 // Log surrounding bytes for verification
                 unsigned char* bytes = reinterpret_cast<unsigned char*>(found_ptr);
-                Msg("[Shader Fixes] Bytes at %s: ", sig.second);
+                Msg("[Shader Fixes] Bytes at %s: ", sig.GetName());
                 for (int i = -8; i <= 8; i++) {
                     Msg("%02X ", bytes[i]);
                 }
                 Msg("\n");
 
                 // Hook division instructions
-                if (strstr(sig.second, "Division")) {
+                if (strstr(sig.GetName(), "Division")) {
                     Detouring::Hook::Target target(found_ptr);
                     m_DivisionFunction_hook.Create(target, DivisionFunction_detour);
                     g_original_DivisionFunction = m_DivisionFunction_hook.GetTrampoline<DivisionFunction_t>();
                     m_DivisionFunction_hook.Enable();
+                    HookRegistry::Instance().Add("DivisionFunction", "shader_hooks", &m_DivisionFunction_hook, found_ptr);
                     Msg("[Shader Fixes] Hooked division at %p\n", found_ptr);
                 }
             }
         }
 
         // Find D3D9 device
-        static const char device_sig[] = "BA E1 0D 74 5E 48 89 1D ?? ?? ?? ??";
-        auto device_ptr = ScanSign(shaderapidx9, device_sig, sizeof(device_sig) - 1);
+        auto device_ptr = s_deviceSignature.Get();
         if (device_ptr) {
             auto offset = ((uint32_t*)device_ptr)[2];
             g_pD3DDevice = *(IDirect3DDevice9**)((char*)device_ptr + offset + 12);
@@ -173,33 +307,30 @@ void ShaderAPIHooks::Initialize() {
 
         // Hook D3D9 functions
         try {
-            // DrawIndexedPrimitive (index 82)
-            Detouring::Hook::Target target_draw(&vftable[82]);
-            m_DrawIndexedPrimitive_hook.Create(target_draw, DrawIndexedPrimitive_detour);
-            g_original_DrawIndexedPrimitive = m_DrawIndexedPrimitive_hook.GetTrampoline<DrawIndexedPrimitive_t>();
-            m_DrawIndexedPrimitive_hook.Enable();
-            Msg("[Shader Fixes] Hooked DrawIndexedPrimitive\n");
-
-            // SetStreamSource (index 100)
-            Detouring::Hook::Target target_stream(&vftable[100]);
-            m_SetStreamSource_hook.Create(target_stream, SetStreamSource_detour);
-            g_original_SetStreamSource = m_SetStreamSource_hook.GetTrampoline<SetStreamSource_t>();
-            m_SetStreamSource_hook.Enable();
-            Msg("[Shader Fixes] Hooked SetStreamSource\n");
-
-            // SetVertexShader (index 92)
-            Detouring::Hook::Target target_shader(&vftable[92]);
-            m_SetVertexShader_hook.Create(target_shader, SetVertexShader_detour);
-            g_original_SetVertexShader = m_SetVertexShader_hook.GetTrampoline<SetVertexShader_t>();
-            m_SetVertexShader_hook.Enable();
-            Msg("[Shader Fixes] Hooked SetVertexShader\n");
-
-            // SetVertexShaderConstantF (index 94)
-            Detouring::Hook::Target target_const(&vftable[94]);
-            m_SetVertexShaderConstantF_hook.Create(target_const, SetVertexShaderConstantF_detour);
-            g_original_SetVertexShaderConstantF = m_SetVertexShaderConstantF_hook.GetTrampoline<SetVertexShaderConstantF_t>();
-            m_SetVertexShaderConstantF_hook.Enable();
-            Msg("[Shader Fixes] Hooked SetVertexShaderConstantF\n");
+            // Swapping vtable slots leaves the functions themselves untouched,
+            // so overlays that inline-patch them keep working
+            bool useVTable = !GlobalConvars::rtx_shaderfix_vtable_hooks || GlobalConvars::rtx_shaderfix_vtable_hooks->GetBool();
+
+            const void* drawHook = HookDeviceMethod(vftable, 82, "DrawIndexedPrimitive", useVTable,
+                m_DrawIndexedPrimitive_hook, m_DrawIndexedPrimitive_vhook, DrawIndexedPrimitive_detour, g_original_DrawIndexedPrimitive);
+            const void* streamHook = HookDeviceMethod(vftable, 100, "SetStreamSource", useVTable,
+                m_SetStreamSource_hook, m_SetStreamSource_vhook, SetStreamSource_detour, g_original_SetStreamSource);
+            const void* shaderHook = HookDeviceMethod(vftable, 92, "SetVertexShader", useVTable,
+                m_SetVertexShader_hook, m_SetVertexShader_vhook, SetVertexShader_detour, g_original_SetVertexShader);
+            const void* constHook = HookDeviceMethod(vftable, 94, "SetVertexShaderConstantF", useVTable,
+                m_SetVertexShaderConstantF_hook, m_SetVertexShaderConstantF_vhook, SetVertexShaderConstantF_detour, g_original_SetVertexShaderConstantF);
+
+            // Present (index 17), drives the frame counter
+            HookDeviceMethod(vftable, 17, "Present", useVTable,
+                m_Present_hook, m_Present_vhook, Present_detour, g_original_Present);
+
+            s_adaptiveHooks[Adaptive_DrawIndexedPrimitive].hook = drawHook;
+            s_adaptiveHooks[Adaptive_SetVertexShaderConstantF].hook = constHook;
+            s_adaptiveHooks[Adaptive_SetStreamSource].hook = streamHook;
+            s_adaptiveHooks[Adaptive_SetVertexShader].hook = shaderHook;
+            if (g_original_DivisionFunction) {
+                s_adaptiveHooks[Adaptive_Division].hook = &m_DivisionFunction_hook;
+            }
         }
         catch (...) {
             Error("[Shader Fixes] Failed to hook one or more D3D9 functions\n");
@@ -213,6 +344,7 @@ void ShaderAPIHooks::Initialize() {
             s_ConMsg_hook.Create(target, ConMsg_detour);
             g_original_ConMsg = s_ConMsg_hook.GetTrampoline<ConMsg_t>();
             s_ConMsg_hook.Enable();
+            HookRegistry::Instance().Add("ConMsg", "shader_hooks", &s_ConMsg_hook, conMsg);
             Msg("[Shader Fixes] Hooked ConMsg\n");
         } else {
             Warning("[Shader Fixes] Failed to hook ConMsg - console interception disabled\n");
@@ -285,63 +417,69 @@ void __fastcall ShaderAPIHooks::ParticleRender_detour(void* thisptr) {
 
 int __fastcall ShaderAPIHooks::DivisionFunction_detour(int a1, int a2, int dividend, int divisor) {
     void* returnAddress = _ReturnAddress();
-    
-    // Get stack pointer using intrinsic
-    void* stackPointer = _AddressOfReturnAddress();
-
-    // Log before attempting division
-    Msg("[Shader Fixes] Division operation:\n"
-        "  Return Address: %p\n"
-        "  Stack Pointer: %p\n"
-        "  Parameters: a1=%d, a2=%d, dividend=%d, divisor=%d\n",
-        returnAddress, stackPointer, a1, a2, dividend, divisor);
-
-    // Capture stack trace
-    void* stackTrace[10] = {};
-    USHORT frames = CaptureStackBackTrace(0, 10, stackTrace, nullptr);
-    Msg("[Shader Fixes] Stack trace:\n");
-    for (USHORT i = 0; i < frames; i++) {
-        Msg("  %d: %p\n", i, stackTrace[i]);
-    }
-
-    // Add module information
-    HMODULE modules[10] = {};
-    DWORD needed = 0;
-    if (EnumProcessModules(GetCurrentProcess(), modules, sizeof(modules), &needed)) {
-        for (DWORD i = 0; i < (needed / sizeof(HMODULE)); i++) {
-            char modName[MAX_PATH];
-            if (GetModuleFileNameA(modules[i], modName, sizeof(modName))) {
-                MODULEINFO modInfo;
-                if (GetModuleInformation(GetCurrentProcess(), modules[i], &modInfo, sizeof(modInfo))) {
-                    if (returnAddress >= modInfo.lpBaseOfDll && 
-                        returnAddress < (void*)((char*)modInfo.lpBaseOfDll + modInfo.SizeOfImage)) {
-                        Msg("  Module: %s Base: %p Size: %u\n", 
-                            modName, modInfo.lpBaseOfDll, modInfo.SizeOfImage);
-                    }
-                }
-            }
+
+    // Per-call logging is sampled, rtx_shaderfix_debug_sample N logs 1 in N calls
+    static uint32_t s_divisionCalls = 0;
+    int sampleRate = GlobalConvars::rtx_shaderfix_debug_sample ? GlobalConvars::rtx_shaderfix_debug_sample->GetInt() : 0;
+    bool logCall = sampleRate > 0 && (++s_divisionCalls % static_cast<uint32_t>(sampleRate)) == 0;
+
+    if (logCall) {
+        // Get stack pointer using intrinsic
+        void* stackPointer = _AddressOfReturnAddress();
+
+        Msg("[Shader Fixes] Division operation:\n"
+            "  Return Address: %p\n"
+            "  Stack Pointer: %p\n"
+            "  Parameters: a1=%d, a2=%d, dividend=%d, divisor=%d\n",
+            returnAddress, stackPointer, a1, a2, dividend, divisor);
+    }
+
+    // Stack trace and module lookup only the first time we see this caller
+    bool firstHit = false;
+    size_t slot = CrashSiteRegistry::Instance().Record(
+        returnAddress, CrashSiteRegistry::Source::DivisionDetour, firstHit);
+
+    if (firstHit) {
+        char description[224];
+        DescribeAddress(returnAddress, description, sizeof(description));
+        CrashSiteRegistry::Instance().Describe(slot, description);
+        Msg("[Shader Fixes] New division caller: %s\n", description);
+
+        void* stackTrace[10] = {};
+        USHORT frames = CaptureStackBackTrace(0, 10, stackTrace, nullptr);
+        Msg("[Shader Fixes] Stack trace:\n");
+        for (USHORT i = 0; i < frames; i++) {
+            Msg("  %d: %p\n", i, stackTrace[i]);
         }
     }
 
     __try {
         if (divisor == 0) {
-            Warning("[Shader Fixes] Prevented division by zero! Caller: %p\n", returnAddress);
+            NoteRejection(Adaptive_Division);
+            if (firstHit || logCall) {
+                Warning("[Shader Fixes] Prevented division by zero! Caller: %p\n", returnAddress);
+            }
             return 1;
         }
 
         // Validate input ranges
         if (abs(dividend) > 1000000 || abs(divisor) < 1) {
-            Warning("[Shader Fixes] Suspicious division values at %p\n", returnAddress);
+            NoteRejection(Adaptive_Division);
+            if (firstHit || logCall) {
+                Warning("[Shader Fixes] Suspicious division values at %p\n", returnAddress);
+            }
             return dividend < 0 ? -1 : 1;
         }
 
-        // Log the operation
         int result = dividend / divisor;
-        Msg("[Shader Fixes] Division result: %d = %d / %d\n", result, dividend, divisor);
-        
+        if (logCall) {
+            Msg("[Shader Fixes] Division result: %d = %d / %d\n", result, dividend, divisor);
+        }
+
         return result;
     }
     __except(EXCEPTION_EXECUTE_HANDLER) {
+        NoteRejection(Adaptive_Division);
         Warning("[Shader Fixes] Exception in division at %p\n", returnAddress);
         return 1;
     }
@@ -401,12 +539,16 @@ void ShaderAPIHooks::Shutdown() {
         m_vehHandle = nullptr;
     }
 
+    // No handler is left that could describe an address
+    if (g_symbolsInitialized) {
+        SymCleanup(GetCurrentProcess());
+        g_symbolsInitialized = false;
+    }
+
     // Existing shutdown code
-    m_DrawIndexedPrimitive_hook.Disable();
-    m_SetVertexShaderConstantF_hook.Disable();
-    m_SetStreamSource_hook.Disable();
-    m_SetVertexShader_hook.Disable();
-    s_ConMsg_hook.Disable();
+    HookRegistry::Instance().DisableSubsystem("shader_hooks");
+
+    AsyncVertexBufferValidator::Instance().Stop();
 
     // Log shutdown completion
     Msg("[Shader Fixes] Shutdown complete\n");
@@ -425,6 +567,8 @@ void __cdecl ShaderAPIHooks::ConMsg_detour(const char* fmt, ...) {
         strstr(buffer, "particle") ||
         strstr(buffer, "material")) {
         
+        RequestRearm("shader/material error");
+
         s_state.lastErrorMessage = buffer;
         s_state.lastErrorTime = GetTickCount64() / 1000.0f;
         s_state.isProcessingParticle = true;
@@ -455,19 +599,40 @@ HRESULT __stdcall ShaderAPIHooks::DrawIndexedPrimitive_detour(
     UINT PrimitiveCount) {
     
     __try {
-        if (s_state.isProcessingParticle || IsParticleSystem()) {
-            if (!ValidatePrimitiveParams(MinVertexIndex, NumVertices, PrimitiveCount)) {
+        uint32_t budget = GetParticleBudget();
+        bool isParticle = false;
+        bool validate = ShouldValidate(budget ? &isParticle : nullptr);
+        s_drawDecision.valid = false;
+        if (validate) {
+            if (!ValidatePrimitiveParams(MinVertexIndex, NumVertices, PrimitiveCount, isParticle)) {
+                NoteRejection(Adaptive_DrawIndexedPrimitive);
                 Warning("[Shader Fixes] Blocked invalid draw call for %s\n", 
                     s_state.lastMaterialName.c_str());
                 return D3D_OK;
             }
         }
 
+        // Over budget particle draws are dropped quietly, this happens every frame
+        if (isParticle) {
+            // Reading the vertices back stalls, only done when the size can
+            // decide whether the draw is kept
+            ParticleBudget& particles = ParticleBudget::Instance();
+            if (particles.NeedsDrawBounds(PrimitiveCount, budget)) {
+                UpdateParticleDrawBounds(device, BaseVertexIndex, MinVertexIndex, NumVertices);
+            } else {
+                particles.ClearDrawBounds();
+            }
+            if (!particles.Admit(PrimitiveCount, budget)) {
+                return D3D_OK;
+            }
+        }
+
         return g_original_DrawIndexedPrimitive(
             device, PrimitiveType, BaseVertexIndex, MinVertexIndex,
             NumVertices, StartIndex, PrimitiveCount);
     }
     __except(EXCEPTION_EXECUTE_HANDLER) {
+        NoteRejection(Adaptive_DrawIndexedPrimitive);
         Warning("[Shader Fixes] Exception in DrawIndexedPrimitive for %s\n", 
             s_state.lastMaterialName.c_str());
         return D3D_OK;
@@ -481,18 +646,23 @@ HRESULT __stdcall ShaderAPIHooks::SetVertexShaderConstantF_detour(
     UINT Vector4fCount) {
     
     __try {
-        if (s_state.isProcessingParticle || IsParticleSystem()) {
+        if (ShouldValidate()) {
             if (!ValidateShaderConstants(pConstantData, Vector4fCount)) {
+                NoteRejection(Adaptive_SetVertexShaderConstantF);
                 Warning("[Shader Fixes] Blocked invalid shader constants for %s\n",
                     s_state.lastMaterialName.c_str());
                 return D3D_OK;
             }
         }
 
+        // View projection for the particle budget's size estimate
+        ParticleBudget::Instance().OnVertexShaderConstants(StartRegister, pConstantData, Vector4fCount);
+
         return g_original_SetVertexShaderConstantF(
             device, StartRegister, pConstantData, Vector4fCount);
     }
     __except(EXCEPTION_EXECUTE_HANDLER) {
+        NoteRejection(Adaptive_SetVertexShaderConstantF);
         Warning("[Shader Fixes] Exception in SetVertexShaderConstantF\n");
         return D3D_OK;
     }
@@ -506,8 +676,15 @@ HRESULT __stdcall ShaderAPIHooks::SetStreamSource_detour(
     UINT Stride) {
     
     __try {
-        if (s_state.isProcessingParticle || IsParticleSystem()) {
-            if (pStreamData && !ValidateParticleVertexBuffer(pStreamData, Stride)) {
+        if (ShouldValidate() && pStreamData) {
+            ParticleScanResult scan;
+            bool async = GlobalConvars::rtx_shaderfix_async_vb && GlobalConvars::rtx_shaderfix_async_vb->GetBool();
+            bool valid = async ?
+                CheckParticleVertexBufferAsync(pStreamData, Stride, scan) :
+                ValidateParticleVertexBuffer(pStreamData, Stride, scan);
+
+            if (!valid) {
+                NoteRejection(Adaptive_SetStreamSource);
                 Warning("[Shader Fixes] Blocked invalid vertex buffer for %s\n",
                     s_state.lastMaterialName.c_str());
                 return D3D_OK;
@@ -517,6 +694,7 @@ HRESULT __stdcall ShaderAPIHooks::SetStreamSource_detour(
         return g_original_SetStreamSource(device, StreamNumber, pStreamData, OffsetInBytes, Stride);
     }
     __except(EXCEPTION_EXECUTE_HANDLER) {
+        NoteRejection(Adaptive_SetStreamSource);
         Warning("[Shader Fixes] Exception in SetStreamSource\n");
         return D3D_OK;
     }
@@ -527,8 +705,9 @@ HRESULT __stdcall ShaderAPIHooks::SetVertexShader_detour(
     IDirect3DVertexShader9* pShader) {
     
     __try {
-        if (s_state.isProcessingParticle || IsParticleSystem()) {
+        if (ShouldValidate()) {
             if (!ValidateVertexShader(pShader)) {
+                NoteRejection(Adaptive_SetVertexShader);
                 Warning("[Shader Fixes] Blocked invalid vertex shader for %s\n",
                     s_state.lastMaterialName.c_str());
                 return D3D_OK;
@@ -538,11 +717,100 @@ HRESULT __stdcall ShaderAPIHooks::SetVertexShader_detour(
         return g_original_SetVertexShader(device, pShader);
     }
     __except(EXCEPTION_EXECUTE_HANDLER) {
+        NoteRejection(Adaptive_SetVertexShader);
         Warning("[Shader Fixes] Exception in SetVertexShader\n");
         return D3D_OK;
     }
 }
 
+HRESULT __stdcall ShaderAPIHooks::Present_detour(
+    IDirect3DDevice9* device,
+    CONST RECT* pSourceRect,
+    CONST RECT* pDestRect,
+    HWND hDestWindowOverride,
+    CONST RGNDATA* pDirtyRegion) {
+
+    s_frameNumber++;
+    s_drawDecision.valid = false;
+    ParticleBudget::Instance().EndFrame(GetParticleBudget());
+
+    // The async worker only runs while the mode is on
+    if (GlobalConvars::rtx_shaderfix_async_vb && GlobalConvars::rtx_shaderfix_async_vb->GetBool()) {
+        AsyncVertexBufferValidator::Instance().Start();
+        AsyncVertexBufferValidator::Instance().EndFrame(s_frameNumber);
+    } else {
+        AsyncVertexBufferValidator::Instance().Stop();
+    }
+    UpdateAdaptiveHooks();
+
+    return g_original_Present(device, pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion);
+}
+
+void ShaderAPIHooks::RequestRearm(const char* reason) {
+    s_rearmReason.store(reason, std::memory_order_relaxed);
+    s_rearmRequested.store(true, std::memory_order_release);
+}
+
+void ShaderAPIHooks::RearmAdaptiveHooks(const char* reason) {
+    for (auto& adaptive : s_adaptiveHooks) {
+        adaptive.lastRejectFrame = s_frameNumber;
+        if (adaptive.armed || !adaptive.hook) continue;
+
+        // A guard disabled from the console stays disabled
+        if (!HookRegistry::Instance().SetEnabled(adaptive.hook, true)) continue;
+        adaptive.armed = true;
+        Msg("[Shader Fixes] Re-armed %s guard (%s)\n", adaptive.name, reason ? reason : "unknown");
+    }
+}
+
+void ShaderAPIHooks::UpdateAdaptiveHooks() {
+    // Hooks are only toggled here, on the render thread between frames
+    if (s_rearmRequested.exchange(false, std::memory_order_acquire)) {
+        RearmAdaptiveHooks(s_rearmReason.load(std::memory_order_relaxed));
+    }
+
+    bool adaptive = GlobalConvars::rtx_shaderfix_adaptive && GlobalConvars::rtx_shaderfix_adaptive->GetBool();
+    if (!adaptive) {
+        for (const auto& hook : s_adaptiveHooks) {
+            if (!hook.armed) {
+                RearmAdaptiveHooks("adaptive mode disabled");
+                break;
+            }
+        }
+        return;
+    }
+
+    int idleFrames = GlobalConvars::rtx_shaderfix_adaptive_frames ? GlobalConvars::rtx_shaderfix_adaptive_frames->GetInt() : 0;
+    if (idleFrames <= 0) return;
+
+    // The particle budget lives in these detours, they stay hooked while it is on
+    bool budgetActive = GetParticleBudget() != 0;
+
+    for (int id = 0; id < Adaptive_Count; id++) {
+        auto& hook = s_adaptiveHooks[id];
+        if (!hook.armed || !hook.hook) continue;
+        if (s_frameNumber - hook.lastRejectFrame < static_cast<uint32_t>(idleFrames)) continue;
+        if (budgetActive && (id == Adaptive_DrawIndexedPrimitive || id == Adaptive_SetVertexShaderConstantF)) continue;
+
+        HookRegistry::Instance().SetEnabled(hook.hook, false);
+        hook.armed = false;
+        Msg("[Shader Fixes] Disarmed %s guard after %d clean frames\n", hook.name, idleFrames);
+    }
+}
+
+size_t ShaderAPIHooks::GetHookStates(HookState* out, size_t maxCount) const {
+    size_t count = 0;
+    for (const auto& hook : s_adaptiveHooks) {
+        if (!hook.hook || count >= maxCount) continue;
+
+        out[count].name = hook.name;
+        out[count].armed = hook.armed;
+        out[count].framesSinceReject = s_frameNumber - hook.lastRejectFrame;
+        count++;
+    }
+    return count;
+}
+
 bool ShaderAPIHooks::ValidateVertexBuffer(
     IDirect3DVertexBuffer9* pVertexBuffer,
     UINT offsetInBytes,
@@ -601,7 +869,8 @@ bool ShaderAPIHooks::ValidateVertexBuffer(
     return false;
 }
 
-bool ShaderAPIHooks::ValidateParticleVertexBuffer(IDirect3DVertexBuffer9* pVertexBuffer, UINT stride) {
+bool ShaderAPIHooks::ValidateParticleVertexBuffer(IDirect3DVertexBuffer9* pVertexBuffer, UINT stride,
+    ParticleScanResult& scan) {
     if (!pVertexBuffer) return false;
 
     D3DVERTEXBUFFER_DESC desc;
@@ -609,31 +878,12 @@ bool ShaderAPIHooks::ValidateParticleVertexBuffer(IDirect3DVertexBuffer9* pVerte
 
     void* data;
     if (SUCCEEDED(pVertexBuffer->Lock(0, desc.Size, &data, D3DLOCK_READONLY))) {
-        bool valid = true;
-        float* floatData = static_cast<float*>(data);
-        
-        // Enhanced validation for particle data
-        for (UINT i = 0; i < desc.Size / sizeof(float); i++) {
-            // Check for invalid values
-            if (!_finite(floatData[i]) || _isnan(floatData[i])) {
-                Warning("[Shader Fixes] Invalid float detected at index %d: %f\n", i, floatData[i]);
-                valid = false;
-                break;
-            }
-            // Check for unreasonable values
-            if (fabsf(floatData[i]) > 1e6) {
-                Warning("[Shader Fixes] Unreasonable value detected at index %d: %f\n", i, floatData[i]);
-                valid = false;
-                break;
-            }
-            // Check for potential divide by zero
-            if (fabsf(floatData[i]) < 1e-6) {
-                Warning("[Shader Fixes] Near-zero value detected at index %d: %f\n", i, floatData[i]);
-                valid = false;
-                break;
-            }
+        bool valid = ScanParticleVertexData(data, desc.Size, stride, scan);
+        if (!valid) {
+            Warning("[Shader Fixes] %s detected at index %u: %f\n",
+                DescribeScanFailure(scan.failure), scan.failIndex, scan.failValue);
         }
-        
+
         pVertexBuffer->Unlock();
         return valid;
     }
@@ -641,6 +891,32 @@ bool ShaderAPIHooks::ValidateParticleVertexBuffer(IDirect3DVertexBuffer9* pVerte
     return false;
 }
 
+bool ShaderAPIHooks::CheckParticleVertexBufferAsync(IDirect3DVertexBuffer9* pVertexBuffer, UINT stride,
+    ParticleScanResult& scan) {
+    auto& validator = AsyncVertexBufferValidator::Instance();
+
+    bool needsSnapshot = false;
+    auto result = validator.Query(pVertexBuffer, s_frameNumber, needsSnapshot);
+
+    // Snapshot this frame's contents for the worker, judged from the next frame on
+    if (needsSnapshot) {
+        D3DVERTEXBUFFER_DESC desc;
+        void* data;
+        if (SUCCEEDED(pVertexBuffer->GetDesc(&desc)) &&
+            SUCCEEDED(pVertexBuffer->Lock(0, desc.Size, &data, D3DLOCK_READONLY))) {
+            validator.Submit(pVertexBuffer, stride, s_frameNumber, data, desc.Size);
+            pVertexBuffer->Unlock();
+        }
+    }
+
+    if (result.verdict == AsyncVertexBufferValidator::Verdict::Unknown) {
+        return !GlobalConvars::rtx_shaderfix_async_vb_default || GlobalConvars::rtx_shaderfix_async_vb_default->GetBool();
+    }
+
+    scan = result.scan;
+    return result.verdict == AsyncVertexBufferValidator::Verdict::Valid;
+}
+
 bool ShaderAPIHooks::ValidateShaderConstants(const float* pConstantData, UINT Vector4fCount) {
     if (!pConstantData || Vector4fCount == 0) return false;
 
@@ -663,7 +939,8 @@ bool ShaderAPIHooks::ValidateShaderConstants(const float* pConstantData, UINT Ve
 bool ShaderAPIHooks::ValidatePrimitiveParams(
     UINT MinVertexIndex,
     UINT NumVertices,
-    UINT PrimitiveCount) {
+    UINT PrimitiveCount,
+    bool budgeted) {
     
     if (NumVertices == 0 || PrimitiveCount == 0) {
         Warning("[Shader Fixes] Zero vertices or primitives\n");
@@ -675,8 +952,8 @@ bool ShaderAPIHooks::ValidatePrimitiveParams(
         return false;
     }
 
-    // Additional checks for particle system primitives
-    if (PrimitiveCount > 10000) {
+    // Particle draws under the per-frame budget are limited by it instead
+    if (!budgeted && PrimitiveCount > 10000) {
         Warning("[Shader Fixes] Excessive primitive count: %d\n", PrimitiveCount);
         return false;
     }
@@ -698,14 +975,57 @@ bool ShaderAPIHooks::ValidateVertexShader(IDirect3DVertexShader9* pShader) {
     return true;
 }
 
-bool ShaderAPIHooks::IsParticleSystem() {
+bool ShaderAPIHooks::ShouldValidate(bool* isParticle) {
+    IMaterial* currentMaterial = GetCurrentMaterial();
+
+    DrawDecision& draw = s_drawDecision;
+    if (!draw.valid || draw.material != currentMaterial) {
+        draw.material = currentMaterial;
+        draw.decision = ValidationPolicyTable::Instance().Evaluate(currentMaterial, s_frameNumber);
+        draw.valid = true;
+    }
+    auto decision = draw.decision;
+
+    // Classification is only paid for when the policy needs it or the caller asked
+    bool particle = false;
+    if (isParticle || decision == ValidationPolicyTable::Decision::Unmatched) {
+        particle = s_state.isProcessingParticle || IsParticleSystem(currentMaterial);
+    }
+    if (isParticle) *isParticle = particle;
+
+    switch (decision) {
+        case ValidationPolicyTable::Decision::Skip:
+            return false;
+        case ValidationPolicyTable::Decision::Validate:
+            return true;
+        default:
+            return particle;
+    }
+}
+
+uint32_t ShaderAPIHooks::GetParticleBudget() {
+    if (!GlobalConvars::rtx_particle_budget) return 0;
+    int budget = GlobalConvars::rtx_particle_budget->GetInt();
+    return budget > 0 ? static_cast<uint32_t>(budget) : 0;
+}
+
+IMaterial* ShaderAPIHooks::GetCurrentMaterial() {
     try {
-        if (!materials) return false;
+        if (!materials) return nullptr;
 
         IMatRenderContext* renderContext = materials->GetRenderContext();
-        if (!renderContext) return false;
+        if (!renderContext) return nullptr;
 
-        IMaterial* currentMaterial = renderContext->GetCurrentMaterial();
+        return renderContext->GetCurrentMaterial();
+    }
+    catch (...) {
+        Warning("[Shader Fixes] Exception in GetCurrentMaterial\n");
+    }
+    return nullptr;
+}
+
+bool ShaderAPIHooks::IsParticleSystem(IMaterial* currentMaterial) {
+    try {
         if (!currentMaterial) return false;
 
         const char* materialName = currentMaterial->GetName();
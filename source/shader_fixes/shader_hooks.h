@@ -1,5 +1,8 @@
 #pragma once
 #include "../e_utils.h"
+#include "../vtable_hook.h"
+#include "validation_policy.h"
+#include "async_vb_validator.h"
 #include <tier0/dbg.h>
 #include <materialsystem/imaterialsystem.h>
 #include <materialsystem/imaterial.h>
@@ -7,6 +10,7 @@
 #include <shaderapi/ishaderapi.h>
 #include <Windows.h>
 #include <d3d9.h>
+#include <atomic>
 #include <unordered_set>
 #include <string>
 #include <regex>
@@ -29,6 +33,20 @@ public:
     void Initialize();
     void Shutdown();
 
+    uint32_t GetFrameNumber() const { return s_frameNumber; }
+
+    // Adaptive mode state of the guard detours, for Lua
+    struct HookState {
+        const char* name;
+        bool armed;
+        uint32_t framesSinceReject;
+    };
+    size_t GetHookStates(HookState* out, size_t maxCount) const;
+
+    // Re-enables every disarmed guard on the next frame. Safe from any
+    // thread, including the exception handlers.
+    static void RequestRearm(const char* reason);
+
 private:
     ShaderAPIHooks() = default;
     ~ShaderAPIHooks() = default;
@@ -80,13 +98,26 @@ private:
         IDirect3DDevice9* device,
         IDirect3DVertexShader9* pShader);
 
+    static HRESULT __stdcall Present_detour(
+        IDirect3DDevice9* device,
+        CONST RECT* pSourceRect,
+        CONST RECT* pDestRect,
+        HWND hDestWindowOverride,
+        CONST RGNDATA* pDirtyRegion);
+
     // Validation helpers
     static bool ValidateVertexBuffer(IDirect3DVertexBuffer9* pVertexBuffer, UINT offsetInBytes, UINT stride);
-    static bool ValidateParticleVertexBuffer(IDirect3DVertexBuffer9* pVertexBuffer, UINT stride);
+    static bool ValidateParticleVertexBuffer(IDirect3DVertexBuffer9* pVertexBuffer, UINT stride,
+        ParticleScanResult& scan);
+    static bool CheckParticleVertexBufferAsync(IDirect3DVertexBuffer9* pVertexBuffer, UINT stride,
+        ParticleScanResult& scan);
     static bool ValidateShaderConstants(const float* pConstantData, UINT Vector4fCount);
-    static bool ValidatePrimitiveParams(UINT MinVertexIndex, UINT NumVertices, UINT PrimitiveCount);
+    static bool ValidatePrimitiveParams(UINT MinVertexIndex, UINT NumVertices, UINT PrimitiveCount, bool budgeted);
     static bool ValidateVertexShader(IDirect3DVertexShader9* pShader);
-    static bool IsParticleSystem();
+    static bool ShouldValidate(bool* isParticle = nullptr);
+    static uint32_t GetParticleBudget();
+    static IMaterial* GetCurrentMaterial();
+    static bool IsParticleSystem(IMaterial* currentMaterial);
     static void LogShaderError(const char* format, ...);
 
     // State management
@@ -99,6 +130,14 @@ private:
     Detouring::Hook m_SetVertexShaderConstantF_hook;
     Detouring::Hook m_SetStreamSource_hook;
     Detouring::Hook m_SetVertexShader_hook;
+    Detouring::Hook m_Present_hook;
+
+    // Same hooks in vtable slot mode (rtx_shaderfix_vtable_hooks)
+    VTableHook m_DrawIndexedPrimitive_vhook;
+    VTableHook m_SetVertexShaderConstantF_vhook;
+    VTableHook m_SetStreamSource_vhook;
+    VTableHook m_SetVertexShader_vhook;
+    VTableHook m_Present_vhook;
 
     // Function pointer types
     typedef HRESULT(__stdcall* DrawIndexedPrimitive_t)(
@@ -109,12 +148,54 @@ private:
         IDirect3DDevice9*, UINT, IDirect3DVertexBuffer9*, UINT, UINT);
     typedef HRESULT(__stdcall* SetVertexShader_t)(
         IDirect3DDevice9*, IDirect3DVertexShader9*);
+    typedef HRESULT(__stdcall* Present_t)(
+        IDirect3DDevice9*, CONST RECT*, CONST RECT*, HWND, CONST RGNDATA*);
 
     // Original function pointers
     static DrawIndexedPrimitive_t g_original_DrawIndexedPrimitive;
     static SetVertexShaderConstantF_t g_original_SetVertexShaderConstantF;
     static SetStreamSource_t g_original_SetStreamSource;
     static SetVertexShader_t g_original_SetVertexShader;
+    static Present_t g_original_Present;
+
+    // Frame counter, advanced by Present
+    static uint32_t s_frameNumber;
+
+    // Policy decision for the draw being set up. The state detours before a
+    // draw share it so the policy counts each draw once, DrawIndexedPrimitive
+    // and Present end it.
+    struct DrawDecision {
+        IMaterial* material = nullptr;
+        ValidationPolicyTable::Decision decision = ValidationPolicyTable::Decision::Unmatched;
+        bool valid = false;
+    };
+    static DrawDecision s_drawDecision;
+
+    // Adaptive mode, guards that go rtx_shaderfix_adaptive_frames frames
+    // without rejecting anything unhook themselves until something re-arms them
+    enum AdaptiveHookId {
+        Adaptive_DrawIndexedPrimitive,
+        Adaptive_SetVertexShaderConstantF,
+        Adaptive_SetStreamSource,
+        Adaptive_SetVertexShader,
+        Adaptive_Division,
+        Adaptive_Count
+    };
+
+    struct AdaptiveHook {
+        const char* name;
+        const void* hook; // HookRegistry handle
+        bool armed;
+        uint32_t lastRejectFrame;
+    };
+
+    static AdaptiveHook s_adaptiveHooks[Adaptive_Count];
+    static std::atomic<bool> s_rearmRequested;
+    static std::atomic<const char*> s_rearmReason;
+
+    static void NoteRejection(AdaptiveHookId id) { s_adaptiveHooks[id].lastRejectFrame = s_frameNumber; }
+    static void UpdateAdaptiveHooks();
+    static void RearmAdaptiveHooks(const char* reason);
 
     // Add new hook declarations
     Detouring::Hook m_VertexBufferLock_hook;
@@ -122,10 +203,6 @@ private:
     static VertexBufferLock_t g_original_VertexBufferLock;
     static HRESULT __stdcall VertexBufferLock_detour(void* thisptr, UINT offsetToLock, UINT sizeToLock, void** ppbData, DWORD flags);
 
-    // Add helper for tracking problematic addresses
-    static std::unordered_set<uintptr_t> s_problematicAddresses;
-    static void TrackProblematicAddress(void* address);
-
     // Division function hook
     Detouring::Hook m_DivisionFunction_hook;
     typedef int (__fastcall* DivisionFunction_t)(int a1, int a2, int dividend, int divisor);
@@ -0,0 +1,287 @@
+#include "validation_policy.h"
+#include <tier0/dbg.h>
+#include <materialsystem/imaterial.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    std::string ToLower(const char* text) {
+        std::string result(text ? text : "");
+        std::transform(result.begin(), result.end(), result.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return result;
+    }
+
+    const char* TargetName(ValidationPolicyTable::Target target) {
+        return target == ValidationPolicyTable::Target::Shader ? "shader" : "material";
+    }
+}
+
+ValidationPolicyTable& ValidationPolicyTable::Instance() {
+    static ValidationPolicyTable instance;
+    return instance;
+}
+
+bool ValidationPolicyTable::ParseMode(const char* text, Mode& mode) {
+    std::string value = ToLower(text);
+    if (value == "off") { mode = Mode::Off; return true; }
+    if (value == "sampled") { mode = Mode::Sampled; return true; }
+    if (value == "first" || value == "firstuse") { mode = Mode::FirstUse; return true; }
+    if (value == "always") { mode = Mode::Always; return true; }
+    return false;
+}
+
+bool ValidationPolicyTable::ParseTarget(const char* text, Target& target) {
+    std::string value = ToLower(text);
+    if (value == "material") { target = Target::Material; return true; }
+    if (value == "shader") { target = Target::Shader; return true; }
+    return false;
+}
+
+const char* ValidationPolicyTable::ModeName(Mode mode) {
+    switch (mode) {
+        case Mode::Off: return "off";
+        case Mode::Sampled: return "sampled";
+        case Mode::FirstUse: return "first";
+        case Mode::Always: return "always";
+    }
+    return "unknown";
+}
+
+bool ValidationPolicyTable::LoadFromFile(const char* path) {
+    m_configPath = path ? path : "";
+
+    std::ifstream file(m_configPath);
+    if (!file.is_open()) {
+        Msg("[Shader Fixes] No validation policy file at %s, using defaults\n", m_configPath.c_str());
+        return false;
+    }
+
+    auto rules = std::make_shared<RuleSet>();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::istringstream stream(line);
+        std::string target, pattern, mode;
+        if (!(stream >> target)) continue;
+
+        Rule rule;
+        if (!(stream >> pattern >> mode) ||
+            !ParseTarget(target.c_str(), rule.target) ||
+            !ParseMode(mode.c_str(), rule.mode)) {
+            Warning("[Shader Fixes] Bad validation policy at %s:%d\n", m_configPath.c_str(), lineNumber);
+            continue;
+        }
+
+        if (rule.mode == Mode::Sampled) {
+            uint32_t interval = 0;
+            if (!(stream >> interval) || interval == 0) {
+                Warning("[Shader Fixes] Sampled policy needs an interval at %s:%d\n", m_configPath.c_str(), lineNumber);
+                continue;
+            }
+            rule.sampleInterval = interval;
+        }
+
+        rule.pattern = ToLower(pattern.c_str());
+        auto entry = std::make_unique<RuleEntry>();
+        entry->rule = rule;
+        rules->push_back(std::move(entry));
+    }
+
+    Msg("[Shader Fixes] Loaded %u validation policies from %s\n",
+        static_cast<unsigned>(rules->size()), m_configPath.c_str());
+    Publish(std::move(rules));
+    return true;
+}
+
+std::shared_ptr<ValidationPolicyTable::RuleSet> ValidationPolicyTable::CopyRules(const RuleSet& rules) {
+    auto copy = std::make_shared<RuleSet>();
+    copy->reserve(rules.size());
+    for (const auto& entry : rules) {
+        auto newEntry = std::make_unique<RuleEntry>();
+        newEntry->rule = entry->rule;
+        newEntry->hits = entry->hits.load(std::memory_order_relaxed);
+        newEntry->validated = entry->validated.load(std::memory_order_relaxed);
+        copy->push_back(std::move(newEntry));
+    }
+    return copy;
+}
+
+void ValidationPolicyTable::Publish(std::shared_ptr<RuleSet> rules) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rules = std::move(rules);
+    m_generation.fetch_add(1, std::memory_order_release);
+}
+
+void ValidationPolicyTable::SetRule(const Rule& rule) {
+    Rule normalized = rule;
+    normalized.pattern = ToLower(rule.pattern.c_str());
+    if (normalized.sampleInterval == 0) {
+        normalized.sampleInterval = 1;
+    }
+
+    std::shared_ptr<RuleSet> rules;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        rules = CopyRules(*m_rules);
+    }
+
+    auto it = std::find_if(rules->begin(), rules->end(), [&](const std::unique_ptr<RuleEntry>& entry) {
+        return entry->rule.target == normalized.target && entry->rule.pattern == normalized.pattern;
+    });
+
+    if (it != rules->end()) {
+        (*it)->rule = normalized;
+    } else {
+        auto entry = std::make_unique<RuleEntry>();
+        entry->rule = normalized;
+        rules->push_back(std::move(entry));
+    }
+
+    Publish(std::move(rules));
+}
+
+bool ValidationPolicyTable::RemoveRule(Target target, const char* pattern) {
+    std::string needle = ToLower(pattern);
+
+    std::shared_ptr<RuleSet> rules;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        rules = CopyRules(*m_rules);
+    }
+
+    auto it = std::remove_if(rules->begin(), rules->end(), [&](const std::unique_ptr<RuleEntry>& entry) {
+        return entry->rule.target == target && entry->rule.pattern == needle;
+    });
+    if (it == rules->end()) {
+        return false;
+    }
+
+    rules->erase(it, rules->end());
+    Publish(std::move(rules));
+    return true;
+}
+
+void ValidationPolicyTable::Clear() {
+    Publish(std::make_shared<RuleSet>());
+}
+
+int ValidationPolicyTable::MatchRule(const RuleSet& rules, const char* materialName, const char* shaderName) const {
+    std::string material = ToLower(materialName);
+    std::string shader = ToLower(shaderName);
+
+    for (size_t i = 0; i < rules.size(); i++) {
+        const Rule& rule = rules[i]->rule;
+        const std::string& name = rule.target == Target::Shader ? shader : material;
+        if (!name.empty() && name.find(rule.pattern) != std::string::npos) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+ValidationPolicyTable::Decision ValidationPolicyTable::Evaluate(IMaterial* material, uint32_t frame) {
+    uint32_t generation = m_generation.load(std::memory_order_acquire);
+    if (generation != m_activeGeneration) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_activeRules = m_rules;
+        m_activeGeneration = m_generation.load(std::memory_order_relaxed);
+        m_materialCache.clear();
+    }
+    if (m_flushMaterials.exchange(false, std::memory_order_acquire)) {
+        m_materialCache.clear();
+    }
+
+    if (!material || !m_activeRules || m_activeRules->empty()) {
+        m_unmatched.fetch_add(1, std::memory_order_relaxed);
+        return Decision::Unmatched;
+    }
+
+    const char* name = material->GetName();
+    auto cached = m_materialCache.find(material);
+    if (cached != m_materialCache.end() && cached->second.name != name) {
+        // Freed and another material allocated in its place
+        m_materialCache.erase(cached);
+        cached = m_materialCache.end();
+    }
+    if (cached == m_materialCache.end()) {
+        if (m_materialCache.size() >= kMaxCachedMaterials) {
+            m_materialCache.clear();
+        }
+
+        CacheEntry entry;
+        entry.name = name;
+        entry.ruleIndex = MatchRule(*m_activeRules, name, material->GetShaderName());
+        entry.firstFrame = frame;
+        entry.sampleOffset = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(material) >> 4);
+        cached = m_materialCache.emplace(material, entry).first;
+    }
+
+    const CacheEntry& entry = cached->second;
+    if (entry.ruleIndex < 0) {
+        m_unmatched.fetch_add(1, std::memory_order_relaxed);
+        return Decision::Unmatched;
+    }
+
+    RuleEntry& rule = *(*m_activeRules)[entry.ruleIndex];
+    rule.hits.fetch_add(1, std::memory_order_relaxed);
+
+    bool validate = false;
+    switch (rule.rule.mode) {
+        case Mode::Off:
+            validate = false;
+            break;
+        case Mode::Sampled:
+            validate = (frame + entry.sampleOffset) % rule.rule.sampleInterval == 0;
+            break;
+        case Mode::FirstUse:
+            validate = frame == entry.firstFrame;
+            break;
+        case Mode::Always:
+            validate = true;
+            break;
+    }
+
+    if (!validate) {
+        return Decision::Skip;
+    }
+
+    rule.validated.fetch_add(1, std::memory_order_relaxed);
+    return Decision::Validate;
+}
+
+void ValidationPolicyTable::PrintStats() const {
+    std::shared_ptr<RuleSet> rules;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        rules = m_rules;
+    }
+
+    Msg("[Shader Fixes] Validation policies (%u):\n", static_cast<unsigned>(rules->size()));
+    for (const auto& entry : *rules) {
+        const Rule& rule = entry->rule;
+        if (rule.mode == Mode::Sampled) {
+            Msg("  %-8s %-32s %-7s 1/%-5u hits: %llu validated: %llu\n",
+                TargetName(rule.target), rule.pattern.c_str(), ModeName(rule.mode), rule.sampleInterval,
+                static_cast<unsigned long long>(entry->hits.load()),
+                static_cast<unsigned long long>(entry->validated.load()));
+        } else {
+            Msg("  %-8s %-32s %-13s hits: %llu validated: %llu\n",
+                TargetName(rule.target), rule.pattern.c_str(), ModeName(rule.mode),
+                static_cast<unsigned long long>(entry->hits.load()),
+                static_cast<unsigned long long>(entry->validated.load()));
+        }
+    }
+    Msg("  Unmatched draws (particle heuristics): %llu\n",
+        static_cast<unsigned long long>(m_unmatched.load()));
+}
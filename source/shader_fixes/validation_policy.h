@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class IMaterial;
+
+// Per-material validation policy for the D3D9 detours.
+//
+// Rules map a material or shader name pattern (case-insensitive substring) to
+// how often draws using it get validated. Rules are checked in order and the
+// first match wins. Draws that match no rule keep the old behaviour (validate
+// whatever IsParticleSystem() flags).
+//
+// Config file format, one rule per line, '#' starts a comment:
+//   material  effects/fire   sampled  30
+//   shader    SpriteCard     always
+//   material  particle/      first
+//   material  tools/         off
+class ValidationPolicyTable {
+public:
+    enum class Mode { Off, Sampled, FirstUse, Always };
+    enum class Target { Material, Shader };
+    enum class Decision { Unmatched, Skip, Validate };
+
+    // Materials remembered before the cache starts over
+    static constexpr size_t kMaxCachedMaterials = 4096;
+
+    struct Rule {
+        Target target = Target::Material;
+        std::string pattern;
+        Mode mode = Mode::Always;
+        uint32_t sampleInterval = 1;
+    };
+
+    static ValidationPolicyTable& Instance();
+
+    bool LoadFromFile(const char* path);
+    const std::string& GetConfigPath() const { return m_configPath; }
+
+    // Replaces the rule with the same target and pattern, or appends a new one.
+    void SetRule(const Rule& rule);
+    bool RemoveRule(Target target, const char* pattern);
+    void Clear();
+
+    // Render thread only, once per draw: every call counts a hit. Names are
+    // only matched the first time a material is seen after the rule set
+    // changed.
+    Decision Evaluate(IMaterial* material, uint32_t frame);
+
+    // Forgets every cached material on the next Evaluate. Materials are
+    // freed on map change and material reload and their addresses reused.
+    void InvalidateMaterials() { m_flushMaterials.store(true, std::memory_order_release); }
+
+    void PrintStats() const;
+
+    static bool ParseMode(const char* text, Mode& mode);
+    static bool ParseTarget(const char* text, Target& target);
+    static const char* ModeName(Mode mode);
+
+private:
+    ValidationPolicyTable() = default;
+
+    struct RuleEntry {
+        Rule rule;
+        std::atomic<uint64_t> hits{ 0 };
+        std::atomic<uint64_t> validated{ 0 };
+    };
+    using RuleSet = std::vector<std::unique_ptr<RuleEntry>>;
+
+    struct CacheEntry {
+        const char* name;       // GetName() when cached, a reused address has another
+        int ruleIndex;          // -1 if no rule matched
+        uint32_t firstFrame;    // frame the material was first seen in
+        uint32_t sampleOffset;  // spreads sampled materials across frames
+    };
+
+    void Publish(std::shared_ptr<RuleSet> rules);
+    int MatchRule(const RuleSet& rules, const char* materialName, const char* shaderName) const;
+    static std::shared_ptr<RuleSet> CopyRules(const RuleSet& rules);
+
+    mutable std::mutex m_mutex;
+    std::shared_ptr<RuleSet> m_rules = std::make_shared<RuleSet>();
+    std::atomic<uint32_t> m_generation{ 1 };
+    std::atomic<bool> m_flushMaterials{ false };
+    std::string m_configPath;
+
+    // Render thread state
+    std::shared_ptr<RuleSet> m_activeRules;
+    uint32_t m_activeGeneration = 0;
+    std::unordered_map<IMaterial*, CacheEntry> m_materialCache;
+    std::atomic<uint64_t> m_unmatched{ 0 };
+};
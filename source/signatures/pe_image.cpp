@@ -0,0 +1,187 @@
+#include "pe_image.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace {
+	constexpr uint16_t kDosMagic = 0x5A4D;       // "MZ"
+	constexpr uint32_t kNtSignature = 0x00004550; // "PE\0\0"
+	constexpr uint16_t kPe32Magic = 0x10B;
+	constexpr uint16_t kPe32PlusMagic = 0x20B;
+	constexpr size_t kFileHeaderSize = 20;
+	constexpr size_t kSectionHeaderSize = 40;
+	constexpr uint32_t kSectionCode = 0x00000020;
+	constexpr uint32_t kSectionExecute = 0x20000000;
+
+	// Chunks smaller than this are not worth a thread
+	constexpr size_t kMinChunkSize = 1024 * 1024;
+
+	template <typename T>
+	bool Read(const uint8_t* data, size_t size, size_t offset, T& out) {
+		if (offset > size || size - offset < sizeof(T)) return false;
+		memcpy(&out, data + offset, sizeof(T));
+		return true;
+	}
+
+	void HashBytes(uint64_t& hash, const uint8_t* bytes, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+}
+
+bool PEImage::Section::IsExecutable() const {
+	return (characteristics & (kSectionCode | kSectionExecute)) != 0;
+}
+
+bool PEImage::Parse(const uint8_t* data, size_t size, Layout layout) {
+	m_data = data;
+	m_size = size;
+	m_layout = layout;
+	m_sections.clear();
+
+	uint16_t dosMagic = 0;
+	uint32_t ntOffset = 0;
+	if (!data || !Read(data, size, 0, dosMagic) || dosMagic != kDosMagic) return false;
+	if (!Read(data, size, 0x3C, ntOffset)) return false;
+
+	uint32_t signature = 0;
+	if (!Read(data, size, ntOffset, signature) || signature != kNtSignature) return false;
+
+	size_t fileHeader = static_cast<size_t>(ntOffset) + 4;
+	uint16_t sectionCount = 0, optionalHeaderSize = 0;
+	if (!Read(data, size, fileHeader + 0, m_machine) ||
+		!Read(data, size, fileHeader + 2, sectionCount) ||
+		!Read(data, size, fileHeader + 4, m_timeDateStamp) ||
+		!Read(data, size, fileHeader + 16, optionalHeaderSize) ||
+		!Read(data, size, fileHeader + 18, m_characteristics)) {
+		return false;
+	}
+
+	// SizeOfImage and CheckSum sit at the same offsets in PE32 and PE32+
+	size_t optionalHeader = fileHeader + kFileHeaderSize;
+	uint16_t magic = 0;
+	uint32_t checksum = 0;
+	if (!Read(data, size, optionalHeader, magic) || (magic != kPe32Magic && magic != kPe32PlusMagic)) return false;
+	if (!Read(data, size, optionalHeader + 56, m_sizeOfImage) ||
+		!Read(data, size, optionalHeader + 64, checksum)) {
+		return false;
+	}
+
+	size_t sectionTable = optionalHeader + optionalHeaderSize;
+	size_t tableSize = static_cast<size_t>(sectionCount) * kSectionHeaderSize;
+	if (sectionTable > size || size - sectionTable < tableSize) return false;
+
+	m_headerHash = 0xcbf29ce484222325ULL;
+	HashBytes(m_headerHash, reinterpret_cast<const uint8_t*>(&checksum), sizeof(checksum));
+	HashBytes(m_headerHash, data + sectionTable, tableSize);
+
+	m_sections.resize(sectionCount);
+	for (size_t i = 0; i < sectionCount; i++) {
+		size_t header = sectionTable + i * kSectionHeaderSize;
+		Section& section = m_sections[i];
+		memcpy(section.name, data + header, 8);
+		Read(data, size, header + 8, section.virtualSize);
+		Read(data, size, header + 12, section.virtualAddress);
+		Read(data, size, header + 16, section.rawSize);
+		Read(data, size, header + 20, section.rawOffset);
+		Read(data, size, header + 36, section.characteristics);
+	}
+
+	return true;
+}
+
+bool PEImage::GetSectionSpan(const Section& section, const uint8_t*& begin, size_t& size) const {
+	size_t offset = m_layout == Layout::Mapped ? section.virtualAddress : section.rawOffset;
+	size_t length = m_layout == Layout::Mapped ? section.virtualSize : section.rawSize;
+
+	// Some linkers leave VirtualSize at zero
+	if (m_layout == Layout::Mapped && length == 0) length = section.rawSize;
+
+	if (offset >= m_size) return false;
+	length = std::min(length, m_size - offset);
+	if (length == 0) return false;
+
+	begin = m_data + offset;
+	size = length;
+	return true;
+}
+
+size_t PEImage::GetExecutableSpans(std::vector<std::pair<const uint8_t*, size_t>>& spans) const {
+	spans.clear();
+	for (const Section& section : m_sections) {
+		const uint8_t* begin;
+		size_t size;
+		if (section.IsExecutable() && GetSectionSpan(section, begin, size)) {
+			spans.emplace_back(begin, size);
+		}
+	}
+	std::sort(spans.begin(), spans.end());
+	return spans.size();
+}
+
+void FindSignaturesParallel(const uint8_t* begin, const uint8_t* end, SignatureScanJob* jobs, size_t count,
+	size_t maxThreads) {
+	std::vector<size_t> pending;
+	for (size_t i = 0; i < count; i++) {
+		if (!jobs[i].result) pending.push_back(i);
+	}
+	if (pending.empty() || begin >= end) return;
+
+	size_t length = static_cast<size_t>(end - begin);
+	size_t chunkCount = std::max<size_t>(1, std::min(maxThreads, length / kMinChunkSize));
+
+	// Each chunk owns the match starts in its range, the compare itself may
+	// read past it into the next chunk, which is what the overlap is for
+	std::vector<std::vector<SignatureScanJob>> chunkJobs(chunkCount);
+	auto scanChunk = [&](size_t chunk) {
+		const uint8_t* chunkBegin = begin + length * chunk / chunkCount;
+		const uint8_t* chunkEnd = begin + length * (chunk + 1) / chunkCount;
+
+		std::vector<SignatureScanJob>& local = chunkJobs[chunk];
+		local.resize(pending.size());
+		for (size_t i = 0; i < pending.size(); i++) {
+			local[i] = jobs[pending[i]];
+			local[i].end = std::min(local[i].end, chunkEnd);
+		}
+		FindSignatures(chunkBegin, local.data(), local.size());
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t chunk = 1; chunk < chunkCount; chunk++) {
+		workers.emplace_back(scanChunk, chunk);
+	}
+	scanChunk(0);
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	// First chunk with a hit has the lowest address
+	for (size_t i = 0; i < pending.size(); i++) {
+		for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+			if (chunkJobs[chunk][i].result) {
+				jobs[pending[i]].result = chunkJobs[chunk][i].result;
+				break;
+			}
+		}
+	}
+}
+
+void ScanImage(const PEImage& image, const uint8_t* data, size_t size, SignatureScanJob* jobs, size_t count,
+	bool allSections, size_t maxThreads) {
+	for (size_t i = 0; i < count; i++) {
+		jobs[i].result = nullptr;
+	}
+
+	if (allSections) {
+		FindSignaturesParallel(data, data + size, jobs, count, maxThreads);
+		return;
+	}
+
+	std::vector<std::pair<const uint8_t*, size_t>> spans;
+	image.GetExecutableSpans(spans);
+	for (const auto& span : spans) {
+		FindSignaturesParallel(span.first, span.first + span.second, jobs, count, maxThreads);
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "signature.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Minimal PE32/PE32+ header reader over a byte span. No Windows headers, so
+// it works the same on a loaded module and on a DLL read from disk.
+class PEImage {
+public:
+	// Mapped: the span is a loaded image, sections sit at their RVA.
+	// File: the span is the file on disk, sections sit at their raw offset.
+	enum class Layout { Mapped, File };
+
+	struct Section {
+		char name[9] = {};
+		uint32_t virtualAddress = 0;
+		uint32_t virtualSize = 0;
+		uint32_t rawOffset = 0;
+		uint32_t rawSize = 0;
+		uint32_t characteristics = 0;
+
+		bool IsExecutable() const;
+	};
+
+	bool Parse(const uint8_t* data, size_t size, Layout layout);
+
+	uint16_t GetMachine() const { return m_machine; }
+	uint32_t GetTimeDateStamp() const { return m_timeDateStamp; }
+	uint32_t GetSizeOfImage() const { return m_sizeOfImage; }
+	bool IsDll() const { return (m_characteristics & 0x2000) != 0; }
+
+	// FNV-1a of the PE checksum and the raw section headers
+	uint64_t GetHeaderHash() const { return m_headerHash; }
+
+	const std::vector<Section>& GetSections() const { return m_sections; }
+
+	// Where a section's bytes are in the span, clamped to it
+	bool GetSectionSpan(const Section& section, const uint8_t*& begin, size_t& size) const;
+
+	// Executable section spans, lowest address first
+	size_t GetExecutableSpans(std::vector<std::pair<const uint8_t*, size_t>>& spans) const;
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	Layout m_layout = Layout::Mapped;
+
+	uint16_t m_machine = 0;
+	uint16_t m_characteristics = 0;
+	uint32_t m_timeDateStamp = 0;
+	uint32_t m_sizeOfImage = 0;
+	uint64_t m_headerHash = 0;
+	std::vector<Section> m_sections;
+};
+
+// Resolves the jobs against match starts in [begin, end), each also bounded
+// by its own job.end. The range is split into chunks that are scanned on
+// worker threads; each job takes the first hit in chunk order, so results are
+// identical to one FindSignatures call. Jobs that already have a result are
+// left alone.
+void FindSignaturesParallel(const uint8_t* begin, const uint8_t* end, SignatureScanJob* jobs, size_t count,
+	size_t maxThreads);
+
+// Scans a loaded or on-disk image. Only executable sections are searched
+// unless allSections is set, in which case the whole span is.
+void ScanImage(const PEImage& image, const uint8_t* data, size_t size, SignatureScanJob* jobs, size_t count,
+	bool allSections, size_t maxThreads);
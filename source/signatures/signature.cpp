@@ -0,0 +1,268 @@
+#include "signature.h"
+#include <array>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SIGNATURE_SSE2 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+	bool MatchesAt(const uint8_t* candidate, const SignaturePattern& pattern) {
+		for (size_t i = 0; i < pattern.size; i++) {
+			if (pattern.mask[i] && candidate[i] != pattern.bytes[i]) return false;
+		}
+		return true;
+	}
+
+#ifdef SIGNATURE_SSE2
+	unsigned LowestBit(unsigned bits) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, bits);
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(__builtin_ctz(bits));
+#endif
+	}
+#endif
+}
+
+bool CompiledSignature::Compile(const char* sig, size_t len) {
+	m_bytes.clear();
+	m_mask.clear();
+	m_anchor = 0;
+	m_hasAnchor = false;
+	m_matchable = sig != nullptr;
+	m_sourceLength = len;
+	if (!sig) return false;
+
+	for (size_t i = 0; i < len; ++i) {
+		if (sig[i] == ' ') continue;
+		if (sig[i] == '?') {
+			m_bytes.push_back(0);
+			m_mask.push_back(0);
+			continue;
+		}
+
+		// Same as strtoul: the longest hex run, 0 if there is none
+		unsigned long value = 0;
+		for (size_t j = i; j < len && SignatureHexValue(sig[j]) >= 0; j++) {
+			value = value * 16 + SignatureHexValue(sig[j]);
+			if (value > 0xFF) {
+				m_matchable = false;
+				value = 0x100;
+			}
+		}
+
+		m_bytes.push_back(static_cast<uint8_t>(value));
+		m_mask.push_back(0xFF);
+		i++;
+	}
+
+	m_hasAnchor = SelectSignatureAnchor(m_mask.data(), m_bytes.data(), m_bytes.size(), m_anchor);
+	return m_matchable;
+}
+
+SignaturePattern CompiledSignature::GetPattern() const {
+	SignaturePattern pattern;
+	pattern.bytes = m_bytes.data();
+	pattern.mask = m_mask.data();
+	pattern.size = m_bytes.size();
+	pattern.anchor = m_anchor;
+	pattern.hasAnchor = m_hasAnchor;
+	return pattern;
+}
+
+bool MatchSignatureAt(const uint8_t* candidate, const SignaturePattern& pattern) {
+	return MatchesAt(candidate, pattern);
+}
+
+void CompiledSignature::Assign(const SignaturePattern& pattern, size_t sourceLength) {
+	m_bytes.assign(pattern.bytes, pattern.bytes + pattern.size);
+	m_mask.assign(pattern.mask, pattern.mask + pattern.size);
+	m_anchor = pattern.anchor;
+	m_hasAnchor = pattern.hasAnchor;
+	m_matchable = true;
+	m_sourceLength = sourceLength;
+}
+
+const uint8_t* FindSignature(const uint8_t* begin, const uint8_t* end, const SignaturePattern& pattern) {
+	if (begin >= end) return nullptr;
+
+	// All wildcards, the first position matches
+	if (!pattern.hasAnchor) return begin;
+
+	const size_t anchor = pattern.anchor;
+	const uint8_t value = pattern.bytes[anchor];
+
+	// Candidate anchor positions are [begin + anchor, end + anchor)
+	const uint8_t* cursor = begin + anchor;
+	const uint8_t* last = end + anchor;
+
+#ifdef SIGNATURE_SSE2
+	const __m128i needle = _mm_set1_epi8(static_cast<char>(value));
+	while (last - cursor >= 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+		unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+		while (bits) {
+			const uint8_t* candidate = cursor + LowestBit(bits) - anchor;
+			if (MatchesAt(candidate, pattern)) return candidate;
+			bits &= bits - 1;
+		}
+		cursor += 16;
+	}
+#endif
+
+	for (; cursor < last; cursor++) {
+		if (*cursor == value && MatchesAt(cursor - anchor, pattern)) return cursor - anchor;
+	}
+
+	return nullptr;
+}
+
+void FindSignatures(const uint8_t* begin, SignatureScanJob* jobs, size_t count) {
+	// Each job is looked for by its rarest pair of fixed bytes, next to each
+	// other or one apart, or by its anchor alone if it has neither. Single
+	// anchor bytes are rare one by one, but a few dozen of them together
+	// start a candidate every few bytes.
+	const size_t kMaxPairGap = 2;
+	// 1 for bytes outside the common list, up to 49 for 0x00
+	static const std::array<float, 256> kCost = [] {
+		std::array<float, 256> cost = {};
+		for (int value = 0; value < 256; value++) {
+			uint8_t rank = SignatureByteRank(static_cast<uint8_t>(value));
+			cost[value] = 1.0f + (rank ? rank - 207 : 0);
+		}
+		return cost;
+	}();
+
+	std::vector<size_t> anchors(count, 0);
+	std::vector<uint8_t> gaps(count, 0);
+
+	// Jobs chained per byte value at their anchor
+	int first[256];
+	for (int& head : first) head = -1;
+	std::vector<int> next(count, -1);
+
+	const uint8_t* last = begin;
+	const uint8_t* readable = begin;
+	size_t pending = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		SignatureScanJob& job = jobs[i];
+		job.result = nullptr;
+		if (begin >= job.end) continue;
+
+		const SignaturePattern& pattern = job.pattern;
+		if (!pattern.hasAnchor) {
+			job.result = begin;
+			continue;
+		}
+
+		anchors[i] = pattern.anchor;
+		float bestCost = 0.0f;
+		for (size_t gap = 1; gap <= kMaxPairGap; gap++) {
+			for (size_t b = 0; b + gap < pattern.size; b++) {
+				if (!pattern.mask[b] || !pattern.mask[b + gap]) continue;
+				float cost = kCost[pattern.bytes[b]] * kCost[pattern.bytes[b + gap]];
+				if (!gaps[i] || cost < bestCost) {
+					gaps[i] = static_cast<uint8_t>(gap);
+					bestCost = cost;
+					anchors[i] = b;
+				}
+			}
+		}
+
+		uint8_t value = pattern.bytes[anchors[i]];
+		next[i] = first[value];
+		first[value] = static_cast<int>(i);
+
+		const uint8_t* jobLast = job.end + anchors[i];
+		if (jobLast > last) last = jobLast;
+		if (job.end + pattern.size > readable) readable = job.end + pattern.size;
+		pending++;
+	}
+
+	bool resolved = false;
+	auto visit = [&](const uint8_t* position) {
+		for (int index = first[*position]; index != -1; index = next[index]) {
+			SignatureScanJob& job = jobs[index];
+			if (job.result) continue;
+
+			const size_t anchor = anchors[index];
+			if (position < begin + anchor || position >= job.end + anchor) continue;
+
+			if (MatchesAt(position - anchor, job.pattern)) {
+				job.result = position - anchor;
+				pending--;
+				resolved = true;
+			}
+		}
+	};
+
+	const uint8_t* cursor = begin;
+
+#ifdef SIGNATURE_SSE2
+	struct PairNeedle {
+		__m128i first;
+		__m128i second;
+		size_t gap;
+	};
+	std::vector<PairNeedle> needles;
+	needles.reserve(pending);
+
+	// Distinct pairs of the jobs still pending, rebuilt as they are found
+	// so padding that matched early stops costing visits
+	auto collect = [&]() {
+		needles.clear();
+		for (size_t i = 0; i < count; i++) {
+			const SignatureScanJob& job = jobs[i];
+			if (job.result || begin >= job.end) continue;
+
+			uint8_t a = job.pattern.bytes[anchors[i]];
+			// No pair compares the anchor twice
+			uint8_t b = job.pattern.bytes[anchors[i] + gaps[i]];
+			bool duplicate = false;
+			for (size_t j = 0; j < i && !duplicate; j++) {
+				duplicate = !jobs[j].result && begin < jobs[j].end && gaps[j] == gaps[i] &&
+					jobs[j].pattern.bytes[anchors[j]] == a && jobs[j].pattern.bytes[anchors[j] + gaps[j]] == b;
+			}
+			if (duplicate) continue;
+
+			needles.push_back({ _mm_set1_epi8(static_cast<char>(a)), _mm_set1_epi8(static_cast<char>(b)), gaps[i] });
+		}
+	};
+	collect();
+
+	while (pending && last - cursor >= 16 && readable - cursor >= static_cast<ptrdiff_t>(16 + kMaxPairGap)) {
+		__m128i blocks[kMaxPairGap + 1];
+		for (size_t gap = 0; gap <= kMaxPairGap; gap++) {
+			blocks[gap] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor + gap));
+		}
+
+		__m128i hits = _mm_setzero_si128();
+		for (const PairNeedle& needle : needles) {
+			hits = _mm_or_si128(hits, _mm_and_si128(_mm_cmpeq_epi8(blocks[0], needle.first),
+				_mm_cmpeq_epi8(blocks[needle.gap], needle.second)));
+		}
+
+		unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(hits));
+		while (bits && pending) {
+			visit(cursor + LowestBit(bits));
+			bits &= bits - 1;
+		}
+		if (resolved) {
+			resolved = false;
+			collect();
+		}
+		cursor += 16;
+	}
+#endif
+
+	for (; pending && cursor < last; cursor++) {
+		if (first[*cursor] != -1) visit(cursor);
+	}
+}
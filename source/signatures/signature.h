@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte pattern plus wildcard mask, with the position of its rarest fixed
+// byte. Non-owning, so patterns can live in static storage or in a
+// CompiledSignature.
+struct SignaturePattern {
+	const uint8_t* bytes = nullptr;
+	const uint8_t* mask = nullptr; // 0xFF = must match, 0x00 = wildcard
+	size_t size = 0;
+	size_t anchor = 0;             // offset of the byte used to find candidates
+	bool hasAnchor = false;        // false when the pattern is all wildcards
+};
+
+// A "0F B6 81 ? ? ? ? C3" style signature parsed once up front.
+//
+// Parsing follows the old ScanSign rules exactly: spaces are skipped, every
+// '?' is one wildcard byte, anything else is read as a hex byte and consumes
+// two characters.
+class CompiledSignature {
+public:
+	CompiledSignature() = default;
+
+	bool Compile(const char* sig, size_t len);
+
+	// Copies an already parsed pattern, e.g. from a Signature literal
+	void Assign(const SignaturePattern& pattern, size_t sourceLength);
+
+	// False if a token can never match a byte, the old parser just never found these
+	bool IsMatchable() const { return m_matchable; }
+	size_t GetSourceLength() const { return m_sourceLength; }
+	SignaturePattern GetPattern() const;
+
+private:
+	std::vector<uint8_t> m_bytes;
+	std::vector<uint8_t> m_mask;
+	size_t m_anchor = 0;
+	bool m_hasAnchor = false;
+	bool m_matchable = false;
+	size_t m_sourceLength = 0;
+};
+
+// Most frequent bytes in compiled x86/x64 code, most frequent first.
+// Anything not listed is treated as rare.
+constexpr uint8_t kCommonSignatureBytes[] = {
+	0x00, 0xFF, 0x48, 0x8B, 0x89, 0x24, 0x0F, 0x44, 0x4C, 0xE8, 0x83, 0xCC,
+	0x01, 0x8D, 0x45, 0x85, 0xC0, 0x74, 0x08, 0x10, 0x20, 0x4D, 0x49, 0x33,
+	0xC3, 0x75, 0x5C, 0x18, 0x90, 0x28, 0x04, 0x41, 0xEB, 0x30, 0x38, 0x40,
+	0x50, 0xC7, 0x84, 0x02, 0x03, 0x0C, 0xC1, 0x80, 0xF8, 0x3B, 0x8E, 0x06,
+};
+
+// Rank of a byte in typical x86/x64 code, lower is rarer
+constexpr uint8_t SignatureByteRank(uint8_t value) {
+	for (size_t i = 0; i < sizeof(kCommonSignatureBytes); i++) {
+		if (kCommonSignatureBytes[i] == value) return static_cast<uint8_t>(255 - i);
+	}
+	return 0;
+}
+
+// Picks the fixed byte with the lowest rank, earliest on ties. constexpr so
+// signature literals can pick their anchor at compile time.
+constexpr bool SelectSignatureAnchor(const uint8_t* mask, const uint8_t* bytes, size_t size, size_t& anchor) {
+	bool found = false;
+	uint8_t bestRank = 0;
+	for (size_t i = 0; i < size; i++) {
+		if (!mask[i]) continue;
+
+		uint8_t rank = SignatureByteRank(bytes[i]);
+		if (!found || rank < bestRank) {
+			found = true;
+			bestRank = rank;
+			anchor = i;
+		}
+	}
+	return found;
+}
+
+constexpr int SignatureHexValue(char c) {
+	return (c >= '0' && c <= '9') ? c - '0' :
+		(c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+		(c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+}
+
+// Masked compare of the whole pattern at one address
+bool MatchSignatureAt(const uint8_t* candidate, const SignaturePattern& pattern);
+
+// First match starting in [begin, end). The caller guarantees that
+// end + pattern.size - 1 is still readable, as ScanSign's bound does.
+const uint8_t* FindSignature(const uint8_t* begin, const uint8_t* end, const SignaturePattern& pattern);
+
+// One pattern of a multi-signature pass. end is the pattern's own exclusive
+// bound for match starts, result is filled in by FindSignatures.
+struct SignatureScanJob {
+	SignaturePattern pattern;
+	const uint8_t* end = nullptr;
+	const uint8_t* result = nullptr;
+};
+
+// Resolves every job in one walk over the image starting at begin. Each
+// result is the same address FindSignature(begin, job.end, job.pattern)
+// would return.
+void FindSignatures(const uint8_t* begin, SignatureScanJob* jobs, size_t count);
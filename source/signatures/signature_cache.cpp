@@ -0,0 +1,78 @@
+#include "signature_cache.h"
+#include <tier0/dbg.h>
+#include <fstream>
+#include <sstream>
+
+bool SignatureCache::Load(const char* path) {
+	m_path = path ? path : "";
+	m_records.clear();
+	m_dirty = false;
+
+	std::ifstream file(m_path);
+	if (!file.is_open()) return false;
+
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		if (line.empty() || line[0] == '#') continue;
+
+		std::istringstream stream(line);
+		Record record;
+		bool valid = static_cast<bool>(stream >> record.module >> std::hex >> record.key.timeDateStamp
+			>> record.key.sizeOfImage >> record.key.headerHash >> record.rva);
+		if (valid) {
+			std::getline(stream >> std::ws, record.pattern);
+		}
+
+		if (!valid || record.pattern.empty()) {
+			Warning("[Signatures] Ignoring malformed cache line %u in %s\n",
+				static_cast<unsigned>(lineNumber), m_path.c_str());
+			continue;
+		}
+
+		m_records[MakeId(record.module, record.pattern)] = record;
+	}
+
+	return true;
+}
+
+bool SignatureCache::Save() {
+	std::ofstream file(m_path, std::ios::trunc);
+	if (!file.is_open()) return false;
+
+	file << "# Resolved signature offsets, rebuilt automatically when a module changes\n";
+	for (const auto& pair : m_records) {
+		const Record& record = pair.second;
+		file << record.module << std::hex << ' ' << record.key.timeDateStamp << ' ' << record.key.sizeOfImage
+			<< ' ' << record.key.headerHash << ' ' << record.rva << ' ' << record.pattern << '\n';
+	}
+
+	m_dirty = false;
+	return file.good();
+}
+
+bool SignatureCache::Lookup(const std::string& module, const ModuleKey& key, const std::string& pattern, uint32_t& rva) const {
+	auto it = m_records.find(MakeId(module, pattern));
+	if (it == m_records.end() || !(it->second.key == key)) return false;
+
+	rva = it->second.rva;
+	return true;
+}
+
+void SignatureCache::Store(const std::string& module, const ModuleKey& key, const std::string& pattern, uint32_t rva) {
+	Record& record = m_records[MakeId(module, pattern)];
+	if (record.module == module && record.key == key && record.rva == rva) return;
+
+	record.module = module;
+	record.pattern = pattern;
+	record.key = key;
+	record.rva = rva;
+	m_dirty = true;
+}
+
+void SignatureCache::Remove(const std::string& module, const std::string& pattern) {
+	if (m_records.erase(MakeId(module, pattern))) {
+		m_dirty = true;
+	}
+}
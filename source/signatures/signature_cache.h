@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Resolved signature offsets saved between launches.
+//
+// Records are keyed by module and pattern text, and only trusted while the
+// module's PE identity (TimeDateStamp, SizeOfImage, section header hash)
+// matches the one they were found in. Callers still check the bytes at the
+// cached offset before using it.
+//
+// File format, one record per line:
+//   <module> <timestamp> <size of image> <header hash> <rva> <pattern...>
+class SignatureCache {
+public:
+	struct ModuleKey {
+		uint32_t timeDateStamp = 0;
+		uint32_t sizeOfImage = 0;
+		uint64_t headerHash = 0;
+
+		bool operator==(const ModuleKey& other) const {
+			return timeDateStamp == other.timeDateStamp && sizeOfImage == other.sizeOfImage &&
+				headerHash == other.headerHash;
+		}
+	};
+
+	bool Load(const char* path);
+	bool Save();
+
+	bool Lookup(const std::string& module, const ModuleKey& key, const std::string& pattern, uint32_t& rva) const;
+	void Store(const std::string& module, const ModuleKey& key, const std::string& pattern, uint32_t rva);
+	void Remove(const std::string& module, const std::string& pattern);
+
+	bool IsDirty() const { return m_dirty; }
+	size_t GetRecordCount() const { return m_records.size(); }
+
+private:
+	struct Record {
+		std::string module;
+		std::string pattern;
+		ModuleKey key;
+		uint32_t rva = 0;
+	};
+
+	static std::string MakeId(const std::string& module, const std::string& pattern) { return module + '\n' + pattern; }
+
+	std::string m_path;
+	std::map<std::string, Record> m_records;
+	bool m_dirty = false;
+};
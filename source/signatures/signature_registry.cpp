@@ -0,0 +1,194 @@
+#include "signature_registry.h"
+#include "pe_image.h"
+#include "../e_utils.h"
+#include "../globalconvars.h"
+#include <tier0/dbg.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <thread>
+
+namespace {
+	const char* kCacheDirectory = "garrysmod/data/rtx_fixes";
+	const char* kCachePath = "garrysmod/data/rtx_fixes/signature_cache.txt";
+
+	std::string ToLower(const char* text) {
+		std::string result = text ? text : "";
+		std::transform(result.begin(), result.end(), result.begin(),
+			[](unsigned char c) { return static_cast<char>(tolower(c)); });
+		return result;
+	}
+}
+
+SignatureRegistry& SignatureRegistry::Instance() {
+	static SignatureRegistry instance;
+	return instance;
+}
+
+size_t SignatureRegistry::Register(const char* module, const char* name, const char* sig, size_t len) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::string moduleName = ToLower(module);
+	std::string source(sig, len);
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		if (m_entries[i].module == moduleName && m_entries[i].source == source) return i;
+	}
+
+	Entry entry;
+	entry.module = moduleName;
+	entry.name = name ? name : "";
+	entry.source = source;
+	if (!entry.compiled.Compile(sig, len)) {
+		// Resolves to null, the same as the old scanner never matching
+		entry.resolved = true;
+	}
+	m_entries.push_back(std::move(entry));
+	return m_entries.size() - 1;
+}
+
+size_t SignatureRegistry::Register(const char* module, const char* name, const char* text,
+	const SignaturePattern& pattern, size_t sourceLength) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::string moduleName = ToLower(module);
+	std::string source(text, sourceLength);
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		if (m_entries[i].module == moduleName && m_entries[i].source == source) return i;
+	}
+
+	Entry entry;
+	entry.module = moduleName;
+	entry.name = name ? name : "";
+	entry.source = source;
+	entry.compiled.Assign(pattern, sourceLength);
+	m_entries.push_back(std::move(entry));
+	return m_entries.size() - 1;
+}
+
+void SignatureRegistry::ResolveModule(const char* module) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ResolveModuleLocked(ToLower(module));
+}
+
+void* SignatureRegistry::Resolve(size_t id) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (id >= m_entries.size()) return nullptr;
+
+	if (!m_entries[id].resolved) {
+		ResolveModuleLocked(m_entries[id].module);
+	}
+	return m_entries[id].address;
+}
+
+void SignatureRegistry::ResolveModuleLocked(const std::string& module) {
+	std::vector<size_t> pending;
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		if (!m_entries[i].resolved && m_entries[i].module == module) pending.push_back(i);
+	}
+	if (pending.empty()) return;
+
+	// Not loaded yet, try again on the next lookup
+	HMODULE handle = GetModuleHandleA(module.c_str());
+	DynLibInfo lib;
+	memset(&lib, 0, sizeof(DynLibInfo));
+	if (!handle || !GetLibraryInfo(handle, lib)) {
+		Warning("[Signatures] %s is not loaded, %u signatures unresolved\n",
+			module.c_str(), static_cast<unsigned>(pending.size()));
+		return;
+	}
+
+	if (!m_cacheLoaded) {
+		m_cacheLoaded = true;
+		if (m_cache.Load(kCachePath)) {
+			Msg("[Signatures] Loaded %u cached offsets\n", static_cast<unsigned>(m_cache.GetRecordCount()));
+		}
+	}
+
+	// No header hash, the build can't be told apart from another one
+	const bool cacheable = lib.headerHash != 0;
+	if (!cacheable) {
+		Warning("[Signatures] %s has unreadable section headers, scanning the whole image uncached\n", module.c_str());
+	}
+
+	SignatureCache::ModuleKey key;
+	key.timeDateStamp = lib.timeDateStamp;
+	key.sizeOfImage = static_cast<uint32_t>(lib.memorySize);
+	key.headerHash = lib.headerHash;
+
+	// Same bounds as ScanSign, each pattern stops its string length before the end
+	const uint8_t* base = static_cast<const uint8_t*>(lib.baseAddress);
+
+	// Cached offsets only need one compare each
+	size_t cached = 0;
+	std::vector<size_t> scan;
+	for (size_t index : pending) {
+		Entry& entry = m_entries[index];
+		size_t limit = lib.memorySize - entry.compiled.GetSourceLength();
+
+		uint32_t rva = 0;
+		if (cacheable && m_cache.Lookup(module, key, entry.source, rva) && rva < limit &&
+			MatchSignatureAt(base + rva, entry.compiled.GetPattern())) {
+			entry.address = const_cast<uint8_t*>(base + rva);
+			entry.resolved = true;
+			entry.fromCache = true;
+			cached++;
+		} else {
+			scan.push_back(index);
+		}
+	}
+
+	size_t found = 0;
+	if (!scan.empty()) {
+		std::vector<SignatureScanJob> jobs(scan.size());
+		for (size_t i = 0; i < scan.size(); i++) {
+			const Entry& entry = m_entries[scan[i]];
+			jobs[i].pattern = entry.compiled.GetPattern();
+			jobs[i].end = base + lib.memorySize - entry.compiled.GetSourceLength();
+		}
+
+		// Code sections only unless asked otherwise, split across threads
+		PEImage image;
+		bool allSections = !image.Parse(base, lib.memorySize, PEImage::Layout::Mapped) ||
+			(GlobalConvars::rtx_signature_scan_all_sections && GlobalConvars::rtx_signature_scan_all_sections->GetBool());
+		size_t threads = (std::min<size_t>)((std::max)(1u, std::thread::hardware_concurrency()), 8);
+
+		ScanImage(image, base, lib.memorySize, jobs.data(), jobs.size(), allSections, threads);
+		m_passes++;
+
+		for (size_t i = 0; i < scan.size(); i++) {
+			Entry& entry = m_entries[scan[i]];
+			entry.address = const_cast<uint8_t*>(jobs[i].result);
+			entry.resolved = true;
+			if (entry.address) found++;
+			if (!cacheable) continue;
+
+			if (entry.address) {
+				m_cache.Store(module, key, entry.source, static_cast<uint32_t>(jobs[i].result - base));
+			} else {
+				m_cache.Remove(module, entry.source);
+			}
+		}
+	}
+
+	Msg("[Signatures] %s: %u cached, %u/%u found by scanning\n", module.c_str(),
+		static_cast<unsigned>(cached), static_cast<unsigned>(found), static_cast<unsigned>(scan.size()));
+
+	if (m_cache.IsDirty()) {
+		CreateDirectoryA(kCacheDirectory, NULL);
+		if (!m_cache.Save()) {
+			Warning("[Signatures] Failed to write %s\n", kCachePath);
+		}
+	}
+}
+
+void SignatureRegistry::PrintStats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Msg("[Signatures] %u signatures, %u module passes\n",
+		static_cast<unsigned>(m_entries.size()), static_cast<unsigned>(m_passes));
+	for (const Entry& entry : m_entries) {
+		const char* state = !entry.resolved ? "pending" :
+			!entry.address ? "missing" : (entry.fromCache ? "cached" : "found");
+		Msg("  %-18s %-32s %-8s %p\n", entry.module.c_str(), entry.name.c_str(), state, entry.address);
+	}
+}
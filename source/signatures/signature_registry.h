@@ -0,0 +1,80 @@
+#pragma once
+#include "signature.h"
+#include "signature_cache.h"
+#include "../e_utils.h"
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Every signature the module scans for, grouped by the DLL it lives in.
+//
+// Signatures are registered up front by RegisteredSignature objects at
+// namespace scope, so by the time anything is resolved the registry knows
+// every pattern for a module. The first lookup in a module resolves all of
+// its pending signatures in a single pass over the image, and the same
+// pattern registered from two places shares one entry.
+//
+// Offsets found in earlier launches are kept in signature_cache.txt. When the
+// module build is unchanged and the bytes at the cached offset still match,
+// no scan is needed at all.
+class SignatureRegistry {
+public:
+	static constexpr size_t kInvalidId = static_cast<size_t>(-1);
+
+	static SignatureRegistry& Instance();
+
+	// Returns the existing id when the module already has this pattern
+	size_t Register(const char* module, const char* name, const char* sig, size_t len);
+
+	// Same, for a pattern parsed at compile time. The bytes are copied.
+	size_t Register(const char* module, const char* name, const char* text,
+		const SignaturePattern& pattern, size_t sourceLength);
+
+	// Resolves every pending signature of the module, one scan
+	void ResolveModule(const char* module);
+
+	// Address of a registered signature, scanning its module on first use
+	void* Resolve(size_t id);
+
+	void PrintStats() const;
+
+private:
+	SignatureRegistry() = default;
+
+	struct Entry {
+		std::string module; // lower case
+		std::string name;
+		std::string source;
+		CompiledSignature compiled;
+		void* address = nullptr;
+		bool resolved = false;
+		bool fromCache = false;
+	};
+
+	void ResolveModuleLocked(const std::string& module);
+
+	std::vector<Entry> m_entries;
+	size_t m_passes = 0;
+
+	// Offsets from earlier launches, loaded on the first resolve
+	SignatureCache m_cache;
+	bool m_cacheLoaded = false;
+	mutable std::mutex m_mutex;
+};
+
+// Static registration of one signature, resolved on first Get()
+class RegisteredSignature {
+public:
+	template <size_t N>
+	RegisteredSignature(const char* module, const char* name, const Signature<N>& sig)
+		: m_id(SignatureRegistry::Instance().Register(module, name, sig.text, sig.GetPattern(), sig.GetSourceLength())),
+		m_name(name) {}
+
+	void* Get() const { return SignatureRegistry::Instance().Resolve(m_id); }
+	const char* GetName() const { return m_name; }
+
+private:
+	size_t m_id;
+	const char* m_name;
+};
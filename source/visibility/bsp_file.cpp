@@ -0,0 +1,308 @@
+#include "bsp_file.h"
+#include <cstring>
+
+namespace {
+	constexpr uint32_t kBspIdent = 0x50534256; // "VBSP"
+	constexpr uint32_t kLzmaIdent = 0x414D5A4C; // "LZMA"
+	constexpr size_t kHeaderSize = 8 + BSPFile::Lump_Count * 16 + 4;
+
+	constexpr size_t kPlaneSize = 20;
+	constexpr size_t kNodeSize = 32;
+	constexpr size_t kModelSize = 48;
+	constexpr size_t kBrushSize = 12;
+	constexpr size_t kBrushSideSize = 8;
+	constexpr size_t kLeafSizeV0 = 56; // with the ambient lighting cube
+	constexpr size_t kLeafSizeV1 = 32;
+	constexpr size_t kEdgeSize = 4;
+	constexpr size_t kFaceSize = 56;
+	constexpr size_t kTexInfoSize = 72;
+	constexpr size_t kTexDataSize = 32;
+	constexpr size_t kDispInfoSize = 176;
+	constexpr size_t kDispVertSize = 20;
+
+	template <typename T>
+	T ReadAt(const uint8_t* data, size_t offset) {
+		T value;
+		memcpy(&value, data + offset, sizeof(T));
+		return value;
+	}
+}
+
+bool BSPFile::Fail(const char* error) {
+	Clear();
+	m_error = error;
+	return false;
+}
+
+void BSPFile::Clear() {
+	m_data = nullptr;
+	m_size = 0;
+	m_loaded = false;
+	m_version = 0;
+	m_error.clear();
+	m_planes.clear();
+	m_nodes.clear();
+	m_leafs.clear();
+	m_models.clear();
+	m_leafBrushes.clear();
+	m_brushes.clear();
+	m_brushSides.clear();
+	m_visibility.clear();
+	m_vertexes.clear();
+	m_edges.clear();
+	m_surfEdges.clear();
+	m_faces.clear();
+	m_leafFaces.clear();
+	m_texInfos.clear();
+	m_texDatas.clear();
+	m_dispInfos.clear();
+	m_dispVerts.clear();
+	m_texDataStrings.clear();
+	m_texDataStringTable.clear();
+}
+
+bool BSPFile::GetLump(Lump lump, const uint8_t*& begin, size_t& length) const {
+	const LumpInfo& info = m_lumps[lump];
+	if (info.offset > m_size || m_size - info.offset < info.length) return false;
+
+	begin = m_data + info.offset;
+	length = info.length;
+	return true;
+}
+
+bool BSPFile::GetGeometryLump(Lump lump, const uint8_t*& begin, size_t& length) const {
+	if (!GetLump(lump, begin, length)) return false;
+	return length < 4 || ReadAt<uint32_t>(begin, 0) != kLzmaIdent;
+}
+
+bool BSPFile::Load(const uint8_t* data, size_t size, bool withGeometry) {
+	Clear();
+	if (!data || size < kHeaderSize) return Fail("file too small");
+	if (ReadAt<uint32_t>(data, 0) != kBspIdent) return Fail("not a VBSP file");
+
+	m_data = data;
+	m_size = size;
+	m_version = ReadAt<int32_t>(data, 4);
+	if (m_version < 19 || m_version > 21) return Fail("unsupported BSP version");
+
+	for (size_t i = 0; i < Lump_Count; i++) {
+		size_t header = 8 + i * 16;
+		m_lumps[i].offset = ReadAt<uint32_t>(data, header);
+		m_lumps[i].length = ReadAt<uint32_t>(data, header + 4);
+		m_lumps[i].version = ReadAt<uint32_t>(data, header + 8);
+	}
+
+	const uint8_t* lump;
+	size_t length;
+	for (Lump id : { Lump_Planes, Lump_Visibility, Lump_Nodes, Lump_Leafs, Lump_Models,
+		Lump_LeafBrushes, Lump_Brushes, Lump_BrushSides }) {
+		if (!GetLump(id, lump, length)) return Fail("lump out of bounds");
+		if (length >= 4 && ReadAt<uint32_t>(lump, 0) == kLzmaIdent) return Fail("compressed lumps are not supported");
+	}
+
+	GetLump(Lump_Planes, lump, length);
+	m_planes.resize(length / kPlaneSize);
+	for (size_t i = 0; i < m_planes.size(); i++) {
+		memcpy(&m_planes[i], lump + i * kPlaneSize, kPlaneSize);
+	}
+
+	GetLump(Lump_Nodes, lump, length);
+	m_nodes.resize(length / kNodeSize);
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		const uint8_t* in = lump + i * kNodeSize;
+		Node& node = m_nodes[i];
+		node.planeNum = ReadAt<int32_t>(in, 0);
+		node.children[0] = ReadAt<int32_t>(in, 4);
+		node.children[1] = ReadAt<int32_t>(in, 8);
+		memcpy(node.mins, in + 12, sizeof(node.mins));
+		memcpy(node.maxs, in + 18, sizeof(node.maxs));
+	}
+
+	// Version 19 maps and some version 20 ones still store the lighting cube
+	GetLump(Lump_Leafs, lump, length);
+	size_t leafSize = m_lumps[Lump_Leafs].version == 0 ? kLeafSizeV0 : kLeafSizeV1;
+	m_leafs.resize(length / leafSize);
+	for (size_t i = 0; i < m_leafs.size(); i++) {
+		const uint8_t* in = lump + i * leafSize;
+		Leaf& leaf = m_leafs[i];
+		leaf.contents = ReadAt<int32_t>(in, 0);
+		leaf.cluster = ReadAt<int16_t>(in, 4);
+		leaf.area = ReadAt<int16_t>(in, 6) & 0x1FF;
+		memcpy(leaf.mins, in + 8, sizeof(leaf.mins));
+		memcpy(leaf.maxs, in + 14, sizeof(leaf.maxs));
+		leaf.firstLeafFace = ReadAt<uint16_t>(in, 20);
+		leaf.numLeafFaces = ReadAt<uint16_t>(in, 22);
+		leaf.firstLeafBrush = ReadAt<uint16_t>(in, 24);
+		leaf.numLeafBrushes = ReadAt<uint16_t>(in, 26);
+	}
+
+	GetLump(Lump_Models, lump, length);
+	m_models.resize(length / kModelSize);
+	for (size_t i = 0; i < m_models.size(); i++) {
+		memcpy(&m_models[i], lump + i * kModelSize, kModelSize);
+	}
+
+	GetLump(Lump_LeafBrushes, lump, length);
+	m_leafBrushes.resize(length / sizeof(uint16_t));
+	if (!m_leafBrushes.empty()) memcpy(m_leafBrushes.data(), lump, m_leafBrushes.size() * sizeof(uint16_t));
+
+	GetLump(Lump_Brushes, lump, length);
+	m_brushes.resize(length / kBrushSize);
+	for (size_t i = 0; i < m_brushes.size(); i++) {
+		memcpy(&m_brushes[i], lump + i * kBrushSize, kBrushSize);
+	}
+
+	// Version 21 splits the bevel short into bevel and thin bytes, the low
+	// byte is the bevel flag either way
+	GetLump(Lump_BrushSides, lump, length);
+	m_brushSides.resize(length / kBrushSideSize);
+	for (size_t i = 0; i < m_brushSides.size(); i++) {
+		const uint8_t* in = lump + i * kBrushSideSize;
+		BrushSide& side = m_brushSides[i];
+		side.planeNum = ReadAt<uint16_t>(in, 0);
+		side.texInfo = ReadAt<int16_t>(in, 2);
+		side.dispInfo = ReadAt<int16_t>(in, 4);
+		side.bevel = in[6];
+	}
+
+	// What the brush sides' texinfo points at, the surface flags say which
+	// sides draw. Optional like the geometry.
+	if (GetGeometryLump(Lump_TexInfo, lump, length)) {
+		m_texInfos.resize(length / kTexInfoSize);
+		for (size_t i = 0; i < m_texInfos.size(); i++) {
+			const uint8_t* in = lump + i * kTexInfoSize;
+			TexInfo& texInfo = m_texInfos[i];
+			memcpy(texInfo.textureVecs, in, sizeof(texInfo.textureVecs));
+			texInfo.flags = ReadAt<int32_t>(in, 64);
+			texInfo.texData = ReadAt<int32_t>(in, 68);
+		}
+	}
+
+	GetLump(Lump_Visibility, lump, length);
+	m_visibility.assign(lump, lump + length);
+
+	if (withGeometry) LoadGeometry();
+
+	// Only valid during Load()
+	m_data = nullptr;
+	m_size = 0;
+
+	if (m_nodes.empty() || m_leafs.empty() || m_models.empty()) return Fail("map has no BSP tree");
+	m_loaded = true;
+	return true;
+}
+
+void BSPFile::LoadGeometry() {
+	const uint8_t* lump;
+	size_t length;
+
+	if (GetGeometryLump(Lump_Vertexes, lump, length)) {
+		m_vertexes.resize(length / 12);
+		if (!m_vertexes.empty()) memcpy(m_vertexes.data(), lump, m_vertexes.size() * 12);
+	}
+
+	if (GetGeometryLump(Lump_Edges, lump, length)) {
+		m_edges.resize(length / kEdgeSize);
+		if (!m_edges.empty()) memcpy(m_edges.data(), lump, m_edges.size() * kEdgeSize);
+	}
+
+	if (GetGeometryLump(Lump_SurfEdges, lump, length)) {
+		m_surfEdges.resize(length / sizeof(int32_t));
+		if (!m_surfEdges.empty()) memcpy(m_surfEdges.data(), lump, m_surfEdges.size() * sizeof(int32_t));
+	}
+
+	if (GetGeometryLump(Lump_LeafFaces, lump, length)) {
+		m_leafFaces.resize(length / sizeof(uint16_t));
+		if (!m_leafFaces.empty()) memcpy(m_leafFaces.data(), lump, m_leafFaces.size() * sizeof(uint16_t));
+	}
+
+	// Maps built with HDR only can leave the LDR faces empty
+	bool faces = GetGeometryLump(Lump_Faces, lump, length) && length >= kFaceSize;
+	if (!faces) faces = GetGeometryLump(Lump_FacesHDR, lump, length);
+	if (faces) {
+		m_faces.resize(length / kFaceSize);
+		for (size_t i = 0; i < m_faces.size(); i++) {
+			const uint8_t* in = lump + i * kFaceSize;
+			Face& face = m_faces[i];
+			face.planeNum = ReadAt<uint16_t>(in, 0);
+			face.side = in[2];
+			face.firstEdge = ReadAt<int32_t>(in, 4);
+			face.numEdges = ReadAt<int16_t>(in, 8);
+			face.texInfo = ReadAt<int16_t>(in, 10);
+			face.dispInfo = ReadAt<int16_t>(in, 12);
+		}
+	}
+
+	if (GetGeometryLump(Lump_TexData, lump, length)) {
+		m_texDatas.resize(length / kTexDataSize);
+		for (size_t i = 0; i < m_texDatas.size(); i++) {
+			const uint8_t* in = lump + i * kTexDataSize;
+			TexData& texData = m_texDatas[i];
+			texData.nameIndex = ReadAt<int32_t>(in, 12);
+			texData.width = ReadAt<int32_t>(in, 16);
+			texData.height = ReadAt<int32_t>(in, 20);
+		}
+	}
+
+	if (GetGeometryLump(Lump_TexDataStringTable, lump, length)) {
+		m_texDataStringTable.resize(length / sizeof(int32_t));
+		if (!m_texDataStringTable.empty()) memcpy(m_texDataStringTable.data(), lump, m_texDataStringTable.size() * sizeof(int32_t));
+	}
+
+	// Terminated so a bad offset can't read past the end
+	if (GetGeometryLump(Lump_TexDataStringData, lump, length)) {
+		m_texDataStrings.assign(lump, lump + length);
+		m_texDataStrings.push_back('\0');
+	}
+
+	if (GetGeometryLump(Lump_DispInfo, lump, length)) {
+		m_dispInfos.resize(length / kDispInfoSize);
+		for (size_t i = 0; i < m_dispInfos.size(); i++) {
+			const uint8_t* in = lump + i * kDispInfoSize;
+			DispInfo& dispInfo = m_dispInfos[i];
+			memcpy(dispInfo.startPosition, in, sizeof(dispInfo.startPosition));
+			dispInfo.dispVertStart = ReadAt<int32_t>(in, 12);
+			dispInfo.power = ReadAt<int32_t>(in, 20);
+		}
+	}
+
+	if (GetGeometryLump(Lump_DispVerts, lump, length)) {
+		m_dispVerts.resize(length / kDispVertSize);
+		if (!m_dispVerts.empty()) memcpy(m_dispVerts.data(), lump, m_dispVerts.size() * kDispVertSize);
+	}
+}
+
+const char* BSPFile::GetTexDataName(int texData) const {
+	if (texData < 0 || static_cast<size_t>(texData) >= m_texDatas.size()) return "";
+
+	int32_t nameIndex = m_texDatas[texData].nameIndex;
+	if (nameIndex < 0 || static_cast<size_t>(nameIndex) >= m_texDataStringTable.size()) return "";
+
+	int32_t offset = m_texDataStringTable[nameIndex];
+	if (offset < 0 || static_cast<size_t>(offset) >= m_texDataStrings.size()) return "";
+	return m_texDataStrings.data() + offset;
+}
+
+int BSPFile::FindLeaf(const float pos[3]) const {
+	if (m_models.empty() || m_nodes.empty()) return -1;
+
+	int node = m_models[0].headNode;
+	while (node >= 0) {
+		if (static_cast<size_t>(node) >= m_nodes.size()) return -1;
+
+		const Node& n = m_nodes[node];
+		if (static_cast<size_t>(n.planeNum) >= m_planes.size()) return -1;
+
+		const Plane& plane = m_planes[n.planeNum];
+		float d = plane.normal[0] * pos[0] + plane.normal[1] * pos[1] + plane.normal[2] * pos[2] - plane.dist;
+		node = n.children[d >= 0.0f ? 0 : 1];
+	}
+
+	int leaf = -1 - node;
+	return static_cast<size_t>(leaf) < m_leafs.size() ? leaf : -1;
+}
+
+int BSPFile::FindCluster(const float pos[3]) const {
+	int leaf = FindLeaf(pos);
+	return leaf >= 0 ? m_leafs[leaf].cluster : -1;
+}
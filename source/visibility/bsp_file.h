@@ -0,0 +1,199 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reader for the parts of a Source BSP (VBSP 19-21) the native visibility
+// and world mesh code needs. Lumps are copied out, so the source buffer can
+// go away after Load(). No SDK headers, the layouts are spelled out here.
+class BSPFile {
+public:
+	enum Lump {
+		Lump_Planes = 1,
+		Lump_TexData = 2,
+		Lump_Vertexes = 3,
+		Lump_Visibility = 4,
+		Lump_Nodes = 5,
+		Lump_TexInfo = 6,
+		Lump_Faces = 7,
+		Lump_Leafs = 10,
+		Lump_Edges = 12,
+		Lump_SurfEdges = 13,
+		Lump_Models = 14,
+		Lump_LeafFaces = 16,
+		Lump_LeafBrushes = 17,
+		Lump_Brushes = 18,
+		Lump_BrushSides = 19,
+		Lump_DispInfo = 26,
+		Lump_DispVerts = 33,
+		Lump_TexDataStringData = 43,
+		Lump_TexDataStringTable = 44,
+		Lump_FacesHDR = 58,
+		Lump_Count = 64
+	};
+
+	struct Plane {
+		float normal[3];
+		float dist;
+		int32_t type;
+	};
+
+	struct Node {
+		int32_t planeNum;
+		int32_t children[2]; // negative: -1 - leaf index
+		int16_t mins[3];
+		int16_t maxs[3];
+	};
+
+	struct Leaf {
+		int32_t contents;
+		int16_t cluster; // -1 for solid leafs
+		int16_t area;
+		int16_t mins[3];
+		int16_t maxs[3];
+		uint16_t firstLeafFace;
+		uint16_t numLeafFaces;
+		uint16_t firstLeafBrush;
+		uint16_t numLeafBrushes;
+	};
+
+	struct Model {
+		float mins[3];
+		float maxs[3];
+		float origin[3];
+		int32_t headNode;
+		int32_t firstFace;
+		int32_t numFaces;
+	};
+
+	struct Brush {
+		int32_t firstSide;
+		int32_t numSides;
+		int32_t contents;
+	};
+
+	struct BrushSide {
+		uint16_t planeNum;
+		int16_t texInfo;
+		int16_t dispInfo;
+		uint8_t bevel;
+	};
+
+	struct Edge {
+		uint16_t v[2];
+	};
+
+	struct Face {
+		uint16_t planeNum;
+		uint8_t side;     // faces the other way from its plane
+		int32_t firstEdge; // into the surfedges, negative ones run backwards
+		int16_t numEdges;
+		int16_t texInfo;
+		int16_t dispInfo; // -1 unless it is a displacement's base face
+	};
+
+	struct TexInfo {
+		float textureVecs[2][4]; // s and t, texels = dot(xyz, pos) + w
+		int32_t flags;           // SURF_*
+		int32_t texData;
+	};
+
+	struct TexData {
+		int32_t nameIndex; // into the texdata string table
+		int32_t width;
+		int32_t height;
+	};
+
+	struct DispInfo {
+		float startPosition[3]; // the base face corner the grid starts at
+		int32_t dispVertStart;
+		int32_t power;          // (1 << power) + 1 vertices on a side
+	};
+
+	struct DispVert {
+		float vec[3]; // offset direction from the flat grid
+		float dist;
+		float alpha;
+	};
+
+	// The world geometry lumps are only read with withGeometry, visibility
+	// and traces need none of them
+	bool Load(const uint8_t* data, size_t size, bool withGeometry = false);
+	void Clear();
+
+	bool IsLoaded() const { return m_loaded; }
+	int GetVersion() const { return m_version; }
+	const std::string& GetError() const { return m_error; }
+
+	const std::vector<Plane>& GetPlanes() const { return m_planes; }
+	const std::vector<Node>& GetNodes() const { return m_nodes; }
+	const std::vector<Leaf>& GetLeafs() const { return m_leafs; }
+	const std::vector<Model>& GetModels() const { return m_models; }
+	const std::vector<uint16_t>& GetLeafBrushes() const { return m_leafBrushes; }
+	const std::vector<Brush>& GetBrushes() const { return m_brushes; }
+	const std::vector<BrushSide>& GetBrushSides() const { return m_brushSides; }
+	// Empty when the lump is missing or compressed, like the geometry
+	const std::vector<TexInfo>& GetTexInfos() const { return m_texInfos; }
+	const std::vector<uint8_t>& GetVisibility() const { return m_visibility; }
+
+	// World geometry, empty unless loaded with it, or when the lumps are
+	// missing or compressed
+	const std::vector<std::array<float, 3>>& GetVertexes() const { return m_vertexes; }
+	const std::vector<Edge>& GetEdges() const { return m_edges; }
+	const std::vector<int32_t>& GetSurfEdges() const { return m_surfEdges; }
+	const std::vector<Face>& GetFaces() const { return m_faces; }
+	const std::vector<uint16_t>& GetLeafFaces() const { return m_leafFaces; }
+	const std::vector<TexData>& GetTexDatas() const { return m_texDatas; }
+	const std::vector<DispInfo>& GetDispInfos() const { return m_dispInfos; }
+	const std::vector<DispVert>& GetDispVerts() const { return m_dispVerts; }
+	// Material name of a texdata, "" if it has none
+	const char* GetTexDataName(int texData) const;
+
+	// Leaf containing the point in the world model, -1 if there is no tree
+	int FindLeaf(const float pos[3]) const;
+	int FindCluster(const float pos[3]) const;
+
+private:
+	struct LumpInfo {
+		uint32_t offset;
+		uint32_t length;
+		uint32_t version;
+	};
+
+	bool Fail(const char* error);
+	bool GetLump(Lump lump, const uint8_t*& begin, size_t& length) const;
+	// Like GetLump, but false for compressed lumps instead of failing Load()
+	bool GetGeometryLump(Lump lump, const uint8_t*& begin, size_t& length) const;
+	void LoadGeometry();
+
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	LumpInfo m_lumps[Lump_Count] = {};
+
+	bool m_loaded = false;
+	int m_version = 0;
+	std::string m_error;
+
+	std::vector<Plane> m_planes;
+	std::vector<Node> m_nodes;
+	std::vector<Leaf> m_leafs;
+	std::vector<Model> m_models;
+	std::vector<uint16_t> m_leafBrushes;
+	std::vector<Brush> m_brushes;
+	std::vector<BrushSide> m_brushSides;
+	std::vector<uint8_t> m_visibility;
+
+	std::vector<std::array<float, 3>> m_vertexes;
+	std::vector<Edge> m_edges;
+	std::vector<int32_t> m_surfEdges;
+	std::vector<Face> m_faces;
+	std::vector<uint16_t> m_leafFaces;
+	std::vector<TexInfo> m_texInfos;
+	std::vector<TexData> m_texDatas;
+	std::vector<DispInfo> m_dispInfos;
+	std::vector<DispVert> m_dispVerts;
+	std::vector<char> m_texDataStrings;
+	std::vector<int32_t> m_texDataStringTable;
+};
@@ -0,0 +1,151 @@
+#include "cluster_entity_index.h"
+#include "map_visibility.h"
+#include <cfloat>
+#include <emmintrin.h>
+
+void ClusterEntityIndex::Clear() {
+	m_x.clear();
+	m_y.clear();
+	m_z.clear();
+	m_cluster.clear();
+	m_next.clear();
+	m_prev.clear();
+	m_heads.clear();
+	m_clusterCount = 0;
+}
+
+size_t ClusterEntityIndex::Bucket(int cluster) const {
+	return cluster >= 0 && static_cast<size_t>(cluster) < m_clusterCount ? static_cast<size_t>(cluster) : m_clusterCount;
+}
+
+void ClusterEntityIndex::Link(uint32_t id, int cluster) {
+	size_t bucket = Bucket(cluster);
+	m_cluster[id] = cluster;
+	m_prev[id] = -1;
+	m_next[id] = m_heads[bucket];
+	if (m_next[id] >= 0) m_prev[m_next[id]] = static_cast<int32_t>(id);
+	m_heads[bucket] = static_cast<int32_t>(id);
+}
+
+void ClusterEntityIndex::Unlink(uint32_t id) {
+	if (m_prev[id] >= 0) {
+		m_next[m_prev[id]] = m_next[id];
+	} else {
+		m_heads[Bucket(m_cluster[id])] = m_next[id];
+	}
+	if (m_next[id] >= 0) m_prev[m_next[id]] = m_prev[id];
+
+	m_cluster[id] = kUntracked;
+	m_prev[id] = m_next[id] = -1;
+}
+
+void ClusterEntityIndex::Remove(uint32_t id) {
+	if (Contains(id)) Unlink(id);
+}
+
+void ClusterEntityIndex::GetPosition(uint32_t id, float out[3]) const {
+	if (!Contains(id)) {
+		out[0] = out[1] = out[2] = 0.0f;
+		return;
+	}
+	out[0] = m_x[id];
+	out[1] = m_y[id];
+	out[2] = m_z[id];
+}
+
+int32_t ClusterEntityIndex::First(int cluster) const {
+	return m_heads.empty() ? -1 : m_heads[Bucket(cluster)];
+}
+
+size_t ClusterEntityIndex::Update(const uint32_t* ids, const float (*positions)[3], size_t count, float threshold, int* clusters) {
+	const MapVisibility& visibility = MapVisibility::Instance();
+
+	// A different map, none of the old clusters mean anything
+	if (m_heads.empty() || visibility.GetClusterCount() != m_clusterCount) {
+		Clear();
+		m_clusterCount = visibility.GetClusterCount();
+		m_heads.assign(m_clusterCount + 1, -1);
+	}
+
+	// Old and new positions side by side, padded so the compare runs in
+	// whole groups of four. Untracked ids get an old position nothing is
+	// ever within the threshold of.
+	size_t padded = (count + 3) & ~static_cast<size_t>(3);
+	m_oldX.assign(padded, 0.0f);
+	m_oldY.assign(padded, 0.0f);
+	m_oldZ.assign(padded, 0.0f);
+	m_newX.assign(padded, 0.0f);
+	m_newY.assign(padded, 0.0f);
+	m_newZ.assign(padded, 0.0f);
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t id = ids[i];
+		if (Contains(id)) {
+			m_oldX[i] = m_x[id];
+			m_oldY[i] = m_y[id];
+			m_oldZ[i] = m_z[id];
+		} else {
+			m_oldX[i] = m_oldY[i] = m_oldZ[i] = FLT_MAX;
+		}
+		m_newX[i] = positions[i][0];
+		m_newY[i] = positions[i][1];
+		m_newZ[i] = positions[i][2];
+	}
+
+	m_moved.clear();
+	const __m128 limit = _mm_set1_ps(threshold * threshold);
+	for (size_t i = 0; i < padded; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&m_newX[i]), _mm_loadu_ps(&m_oldX[i]));
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&m_newY[i]), _mm_loadu_ps(&m_oldY[i]));
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(&m_newZ[i]), _mm_loadu_ps(&m_oldZ[i]));
+		__m128 distSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		int mask = _mm_movemask_ps(_mm_cmpgt_ps(distSqr, limit));
+		while (mask) {
+			int lane = 0;
+			while (!(mask & (1 << lane))) lane++;
+			mask &= ~(1 << lane);
+			m_moved.push_back(static_cast<uint32_t>(i + lane));
+		}
+	}
+
+	// Only the movers go down the tree, still in one batch
+	m_movedPoints.resize(m_moved.size());
+	for (size_t m = 0; m < m_moved.size(); m++) {
+		uint32_t i = m_moved[m];
+		m_movedPoints[m] = { positions[i][0], positions[i][1], positions[i][2] };
+	}
+	m_movedClusters.assign(m_moved.size(), -1);
+	if (!m_moved.empty()) {
+		visibility.FindLeafs(reinterpret_cast<const float(*)[3]>(m_movedPoints.data()), m_movedPoints.size(),
+			nullptr, m_movedClusters.data());
+	}
+
+	for (size_t m = 0; m < m_moved.size(); m++) {
+		uint32_t id = ids[m_moved[m]];
+		if (id >= m_cluster.size()) {
+			m_x.resize(id + 1, 0.0f);
+			m_y.resize(id + 1, 0.0f);
+			m_z.resize(id + 1, 0.0f);
+			m_cluster.resize(id + 1, kUntracked);
+			m_next.resize(id + 1, -1);
+			m_prev.resize(id + 1, -1);
+		}
+
+		m_x[id] = m_movedPoints[m][0];
+		m_y[id] = m_movedPoints[m][1];
+		m_z[id] = m_movedPoints[m][2];
+
+		int cluster = m_movedClusters[m];
+		if (Contains(id)) {
+			if (m_cluster[id] == cluster) continue;
+			Unlink(id);
+		}
+		Link(id, cluster);
+	}
+
+	if (clusters) {
+		for (size_t i = 0; i < count; i++) clusters[i] = m_cluster[ids[i]];
+	}
+	return m_moved.size();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Which entities are in which cluster, kept up to date incrementally.
+//
+// Positions are remembered from the last time each entity was classified.
+// Update() gathers the old and new positions of a batch into packed arrays
+// and compares them four at a time, only entities that moved further than
+// the threshold are reclassified (as one batch) and moved to another
+// cluster's list. Everything else keeps its cluster without touching the
+// BSP tree.
+class ClusterEntityIndex {
+public:
+	void Clear();
+
+	// ids are entity indices, clusters receives each entity's cluster.
+	// Returns how many of them had to be reclassified.
+	size_t Update(const uint32_t* ids, const float (*positions)[3], size_t count, float threshold, int* clusters);
+	void Remove(uint32_t id);
+
+	bool Contains(uint32_t id) const { return id < m_cluster.size() && m_cluster[id] != kUntracked; }
+	int GetCluster(uint32_t id) const { return Contains(id) ? m_cluster[id] : -1; }
+	void GetPosition(uint32_t id, float out[3]) const;
+
+	// Walk a cluster's entities: for (id = First(c); id >= 0; id = Next(id))
+	int32_t First(int cluster) const;
+	int32_t Next(uint32_t id) const { return m_next[id]; }
+
+private:
+	static constexpr int kUntracked = -2;
+
+	void Link(uint32_t id, int cluster);
+	void Unlink(uint32_t id);
+	size_t Bucket(int cluster) const;
+
+	// By entity index, structure of arrays
+	std::vector<float> m_x, m_y, m_z;
+	std::vector<int> m_cluster;
+	std::vector<int32_t> m_next, m_prev;
+
+	// One list per cluster, the last one holds entities outside the vis data
+	std::vector<int32_t> m_heads;
+	size_t m_clusterCount = 0;
+
+	// Packed per batch for the movement compare
+	std::vector<float> m_oldX, m_oldY, m_oldZ, m_newX, m_newY, m_newZ;
+	std::vector<uint32_t> m_moved;
+	std::vector<std::array<float, 3>> m_movedPoints;
+	std::vector<int> m_movedClusters;
+};
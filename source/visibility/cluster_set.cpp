@@ -0,0 +1,81 @@
+#include "cluster_set.h"
+#include <algorithm>
+#include <emmintrin.h>
+
+void ClusterSet::Resize(size_t clusterCount) {
+	m_count = clusterCount;
+	m_words.assign(WordsFor(clusterCount), 0);
+}
+
+void ClusterSet::Clear() {
+	std::fill(m_words.begin(), m_words.end(), 0);
+}
+
+void ClusterSet::SetAll() {
+	std::fill(m_words.begin(), m_words.end(), ~0ULL);
+
+	// Keep the bits past the last cluster clear so Count() stays exact
+	if (m_count & 63) m_words.back() = (1ULL << (m_count & 63)) - 1;
+}
+
+void ClusterSet::Set(int cluster) {
+	if (cluster < 0 || static_cast<size_t>(cluster) >= m_count) return;
+	m_words[cluster >> 6] |= 1ULL << (cluster & 63);
+}
+
+void ClusterSet::Or(const uint64_t* row) {
+	uint64_t* words = m_words.data();
+	size_t count = m_words.size();
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(words + i), _mm_or_si128(a, b));
+	}
+	for (; i < count; i++) {
+		words[i] |= row[i];
+	}
+}
+
+void ClusterSet::And(const uint64_t* row) {
+	uint64_t* words = m_words.data();
+	size_t count = m_words.size();
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(words + i), _mm_and_si128(a, b));
+	}
+	for (; i < count; i++) {
+		words[i] &= row[i];
+	}
+}
+
+void ClusterSet::Xor(const uint64_t* row) {
+	uint64_t* words = m_words.data();
+	size_t count = m_words.size();
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(words + i), _mm_xor_si128(a, b));
+	}
+	for (; i < count; i++) {
+		words[i] ^= row[i];
+	}
+}
+
+size_t ClusterSet::Count() const {
+	size_t count = 0;
+	for (uint64_t word : m_words) {
+		// Portable popcount, this is only used for stats
+		while (word) {
+			word &= word - 1;
+			count++;
+		}
+	}
+	return count;
+}
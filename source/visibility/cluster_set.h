@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packed set of BSP clusters, one bit each, in the same bit order as the
+// decompressed vis rows so rows can be OR'd in directly.
+class ClusterSet {
+public:
+	void Resize(size_t clusterCount);
+	void Clear();
+	void SetAll();
+
+	void Set(int cluster);
+	bool Test(int cluster) const {
+		return cluster >= 0 && static_cast<size_t>(cluster) < m_count &&
+			(m_words[cluster >> 6] >> (cluster & 63)) & 1;
+	}
+
+	// this |= row, row holds GetWordCount() words
+	void Or(const uint64_t* row);
+	void Or(const ClusterSet& other) { Or(other.GetWords()); }
+
+	// this &= row
+	void And(const uint64_t* row);
+	void And(const ClusterSet& other) { And(other.GetWords()); }
+
+	// this ^= row, leaves the clusters that differ
+	void Xor(const uint64_t* row);
+	void Xor(const ClusterSet& other) { Xor(other.GetWords()); }
+
+	size_t Count() const;
+	size_t GetClusterCount() const { return m_count; }
+	size_t GetWordCount() const { return m_words.size(); }
+	const uint64_t* GetWords() const { return m_words.data(); }
+
+	static size_t WordsFor(size_t clusterCount) { return (clusterCount + 63) / 64; }
+
+private:
+	std::vector<uint64_t> m_words;
+	size_t m_count = 0;
+};
@@ -0,0 +1,85 @@
+#include "environment_probe.h"
+#include "map_visibility.h"
+#include <chrono>
+#include <cmath>
+
+namespace {
+	constexpr float kPi = 3.14159265358979f;
+
+	constexpr int kLongRays = 8;
+	constexpr int kShortRays = 4;
+	constexpr float kLongDistance = 1000.0f;
+	constexpr float kShortDistance = 256.0f;
+	constexpr float kForwardDistance = 512.0f;
+
+	// Ray layout in the fan
+	constexpr int kUp = 0;
+	constexpr int kFirstLong = 1;
+	constexpr int kFirstShort = kFirstLong + kLongRays;
+	constexpr int kForward = kFirstShort + kShortRays;
+	constexpr int kRayCount = kForward + 1;
+}
+
+bool ProbeEnvironment(const float origin[3], const float aim[3], EnvironmentProbe& out) {
+	const MapVisibility& visibility = MapVisibility::Instance();
+	if (!visibility.IsLoaded()) return false;
+
+	auto start = std::chrono::steady_clock::now();
+
+	float deltas[kRayCount][3] = {};
+	deltas[kUp][2] = kLongDistance;
+	for (int i = 0; i < kLongRays; i++) {
+		float yaw = i * (2.0f * kPi / kLongRays);
+		deltas[kFirstLong + i][0] = cosf(yaw) * kLongDistance;
+		deltas[kFirstLong + i][1] = sinf(yaw) * kLongDistance;
+	}
+	for (int i = 0; i < kShortRays; i++) {
+		float yaw = i * (2.0f * kPi / kShortRays);
+		deltas[kFirstShort + i][0] = cosf(yaw) * kShortDistance;
+		deltas[kFirstShort + i][1] = sinf(yaw) * kShortDistance;
+	}
+	for (int k = 0; k < 3; k++) deltas[kForward][k] = aim[k] * kForwardDistance;
+
+	float fractions[kRayCount];
+	visibility.TraceRays(origin, deltas, kRayCount, fractions);
+
+	out = EnvironmentProbe();
+	out.ceiling = fractions[kUp];
+	out.forward = fractions[kForward];
+
+	// Free distance squared, weighted on the doubled angle so opposite
+	// directions add up along the same axis
+	float sum = 0.0f;
+	float axisX = 0.0f;
+	float axisY = 0.0f;
+	out.openSpace = 0.0f;
+	for (int i = 0; i < kLongRays; i++) {
+		float fraction = fractions[kFirstLong + i];
+		float yaw = i * (2.0f * kPi / kLongRays);
+		float weight = fraction * fraction;
+
+		out.openSpace += fraction;
+		sum += weight;
+		axisX += weight * cosf(2.0f * yaw);
+		axisY += weight * sinf(2.0f * yaw);
+	}
+	out.openSpace /= kLongRays;
+
+	if (sum > 0.0f) {
+		float axisYaw = 0.5f * atan2f(axisY, axisX);
+		out.axis[0] = cosf(axisYaw);
+		out.axis[1] = sinf(axisYaw);
+		out.elongation = sqrtf(axisX * axisX + axisY * axisY) / sum;
+	}
+
+	out.corridorSpace = 0.0f;
+	for (int i = 0; i < kShortRays; i++) out.corridorSpace += fractions[kFirstShort + i];
+	out.corridorSpace /= kShortRays;
+
+	// Same thresholds as the script's traces
+	out.openArea = out.ceiling > 0.5f && out.openSpace > 0.7f;
+	out.corridor = out.corridorSpace < 0.4f && out.forward > 0.7f;
+
+	out.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// The frustum script's open area and corridor checks (IsInOpenArea,
+// IsInCorridor) as one native fan of 14 world traces: straight up, eight
+// long and four short horizontal rays, and one along the aim.
+struct EnvironmentProbe {
+	float ceiling = 1.0f;       // fraction of the 1000 unit trace up
+	float openSpace = 1.0f;     // average fraction of the eight 1000 unit horizontal traces
+	float corridorSpace = 1.0f; // average fraction of the four 256 unit horizontal traces
+	float forward = 1.0f;       // fraction of the 512 unit trace along the aim
+
+	// Main direction of the free space around the origin, from the long
+	// horizontal traces. elongation is 0 when every direction is equally
+	// open and approaches 1 in a straight corridor along axis.
+	float axis[3] = { 1.0f, 0.0f, 0.0f };
+	float elongation = 0.0f;
+
+	bool openArea = false;
+	bool corridor = false;
+	double milliseconds = 0.0;
+};
+
+// False when no map is loaded
+bool ProbeEnvironment(const float origin[3], const float aim[3], EnvironmentProbe& out);
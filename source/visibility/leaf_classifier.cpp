@@ -0,0 +1,94 @@
+#include "leaf_classifier.h"
+#include "bsp_file.h"
+#include <emmintrin.h>
+#include <utility>
+
+void LeafClassifier::Classify(const BSPFile& bsp, const float (*points)[3], size_t count, int* leafs, int* clusters) {
+	if (!count) return;
+
+	const std::vector<BSPFile::Node>& nodes = bsp.GetNodes();
+	const std::vector<BSPFile::Plane>& planes = bsp.GetPlanes();
+	const std::vector<BSPFile::Leaf>& bspLeafs = bsp.GetLeafs();
+
+	if (!bsp.IsLoaded() || bsp.GetModels().empty()) {
+		for (size_t i = 0; i < count; i++) {
+			if (leafs) leafs[i] = -1;
+			if (clusters) clusters[i] = -1;
+		}
+		return;
+	}
+
+	// Padded to a multiple of four so the SIMD loop never needs a tail
+	size_t padded = (count + 3) & ~static_cast<size_t>(3);
+	m_x.resize(padded);
+	m_y.resize(padded);
+	m_z.resize(padded);
+	m_index.resize(count);
+	m_front.resize(padded);
+	for (size_t i = 0; i < count; i++) {
+		m_x[i] = points[i][0];
+		m_y[i] = points[i][1];
+		m_z[i] = points[i][2];
+		m_index[i] = static_cast<uint32_t>(i);
+	}
+
+	m_queue.clear();
+	m_queue.push_back({ bsp.GetModels()[0].headNode, 0, static_cast<uint32_t>(count) });
+
+	for (size_t head = 0; head < m_queue.size(); head++) {
+		Range range = m_queue[head];
+		int leaf = -1;
+
+		if (range.node < 0) {
+			leaf = -1 - range.node;
+			if (static_cast<size_t>(leaf) >= bspLeafs.size()) leaf = -1;
+		} else if (static_cast<size_t>(range.node) >= nodes.size() ||
+			static_cast<size_t>(nodes[range.node].planeNum) >= planes.size()) {
+			leaf = -1;
+		} else {
+			const BSPFile::Node& node = nodes[range.node];
+			const BSPFile::Plane& plane = planes[node.planeNum];
+
+			// Plane distances four points at a time. Loads start at the
+			// aligned-down index, lanes outside the range are ignored below.
+			__m128 nx = _mm_set1_ps(plane.normal[0]);
+			__m128 ny = _mm_set1_ps(plane.normal[1]);
+			__m128 nz = _mm_set1_ps(plane.normal[2]);
+			__m128 dist = _mm_set1_ps(plane.dist);
+			for (uint32_t i = range.begin & ~3u; i < range.end; i += 4) {
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_x[i]), nx), _mm_mul_ps(_mm_loadu_ps(&m_y[i]), ny)),
+					_mm_mul_ps(_mm_loadu_ps(&m_z[i]), nz));
+				int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(d, dist), _mm_setzero_ps()));
+				m_front[i] = mask & 1;
+				m_front[i + 1] = (mask >> 1) & 1;
+				m_front[i + 2] = (mask >> 2) & 1;
+				m_front[i + 3] = (mask >> 3) & 1;
+			}
+
+			// Front points to the start of the range, back points to the end
+			uint32_t lo = range.begin, hi = range.end;
+			while (lo < hi) {
+				if (m_front[lo]) {
+					lo++;
+					continue;
+				}
+				hi--;
+				std::swap(m_x[lo], m_x[hi]);
+				std::swap(m_y[lo], m_y[hi]);
+				std::swap(m_z[lo], m_z[hi]);
+				std::swap(m_index[lo], m_index[hi]);
+				std::swap(m_front[lo], m_front[hi]);
+			}
+
+			if (lo > range.begin) m_queue.push_back({ node.children[0], range.begin, lo });
+			if (lo < range.end) m_queue.push_back({ node.children[1], lo, range.end });
+			continue;
+		}
+
+		int cluster = leaf >= 0 ? bspLeafs[leaf].cluster : -1;
+		for (uint32_t i = range.begin; i < range.end; i++) {
+			if (leafs) leafs[m_index[i]] = leaf;
+			if (clusters) clusters[m_index[i]] = cluster;
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BSPFile;
+
+// Classifies a whole batch of points into BSP leafs at once.
+//
+// The points are copied into structure-of-arrays form and walked down the
+// world model's node tree breadth first. At each node the points that
+// reached it sit next to each other, so their plane distances are taken
+// four at a time with SSE, then the range is partitioned into the front
+// and back children. Same answers as BSPFile::FindLeaf, a point exactly on
+// a plane goes to the front.
+class LeafClassifier {
+public:
+	// leafs and clusters (either may be null) receive count ids, -1 when
+	// the point is outside the tree
+	void Classify(const BSPFile& bsp, const float (*points)[3], size_t count, int* leafs, int* clusters);
+
+private:
+	struct Range {
+		int node;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	std::vector<float> m_x, m_y, m_z;
+	std::vector<uint32_t> m_index; // original position of each point
+	std::vector<uint8_t> m_front;
+	std::vector<Range> m_queue;
+};
@@ -0,0 +1,239 @@
+#include "loose_octree.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+	struct SphereShape {
+		float center[3];
+		float radiusSqr;
+
+		bool Touches(const float mins[3], const float maxs[3]) const {
+			float distSqr = 0.0f;
+			for (int i = 0; i < 3; i++) {
+				float d = center[i] < mins[i] ? mins[i] - center[i] : center[i] > maxs[i] ? center[i] - maxs[i] : 0.0f;
+				distSqr += d * d;
+			}
+			return distSqr <= radiusSqr;
+		}
+	};
+
+	struct BoxShape {
+		float mins[3];
+		float maxs[3];
+
+		bool Touches(const float boxMins[3], const float boxMaxs[3]) const {
+			for (int i = 0; i < 3; i++) {
+				if (boxMins[i] > maxs[i] || boxMaxs[i] < mins[i]) return false;
+			}
+			return true;
+		}
+	};
+
+	// Segment from start to start + delta, slab test
+	struct RayShape {
+		float start[3];
+		float delta[3];
+		float invDelta[3];
+
+		bool Touches(const float mins[3], const float maxs[3]) const {
+			float tmin = 0.0f, tmax = 1.0f;
+			for (int i = 0; i < 3; i++) {
+				if (fabsf(delta[i]) < 1e-6f) {
+					if (start[i] < mins[i] || start[i] > maxs[i]) return false;
+					continue;
+				}
+				float t1 = (mins[i] - start[i]) * invDelta[i];
+				float t2 = (maxs[i] - start[i]) * invDelta[i];
+				if (t1 > t2) std::swap(t1, t2);
+				tmin = (std::max)(tmin, t1);
+				tmax = (std::min)(tmax, t2);
+				if (tmin > tmax) return false;
+			}
+			return true;
+		}
+	};
+
+	struct FrustumShape {
+		const FrustumPlane* planes;
+		size_t count;
+
+		// Outside if the corner furthest along any plane normal is behind it
+		bool Touches(const float mins[3], const float maxs[3]) const {
+			for (size_t p = 0; p < count; p++) {
+				const FrustumPlane& plane = planes[p];
+				float d = 0.0f;
+				for (int i = 0; i < 3; i++) d += plane.normal[i] * (plane.normal[i] >= 0.0f ? maxs[i] : mins[i]);
+				if (d < plane.dist) return false;
+			}
+			return true;
+		}
+	};
+}
+
+void LooseOctree::Reset(const float mins[3], const float maxs[3], int maxDepth) {
+	Clear();
+	m_maxDepth = maxDepth;
+
+	Node root = {};
+	float half = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		root.center[i] = (mins[i] + maxs[i]) * 0.5f;
+		half = (std::max)(half, (maxs[i] - mins[i]) * 0.5f);
+	}
+	root.half = half + 1.0f;
+	std::fill(std::begin(root.children), std::end(root.children), -1);
+	root.parent = -1;
+	root.firstItem = -1;
+	m_nodes.push_back(root);
+}
+
+void LooseOctree::Clear() {
+	m_nodes.clear();
+	m_items.clear();
+	m_count = 0;
+}
+
+int32_t LooseOctree::FindNode(const float center[3], float extent) {
+	// Centres outside the world stay in the root, which is never culled
+	const Node& root = m_nodes[0];
+	for (int i = 0; i < 3; i++) {
+		if (fabsf(center[i] - root.center[i]) > root.half) return 0;
+	}
+
+	int32_t node = 0;
+	for (int depth = 0; depth < m_maxDepth; depth++) {
+		float childHalf = m_nodes[node].half * 0.5f;
+		if (extent > childHalf) break;
+
+		int octant = 0;
+		for (int i = 0; i < 3; i++) {
+			if (center[i] >= m_nodes[node].center[i]) octant |= 1 << i;
+		}
+
+		int32_t child = m_nodes[node].children[octant];
+		if (child < 0) {
+			Node created = {};
+			for (int i = 0; i < 3; i++) {
+				created.center[i] = m_nodes[node].center[i] + ((octant >> i) & 1 ? childHalf : -childHalf);
+			}
+			created.half = childHalf;
+			std::fill(std::begin(created.children), std::end(created.children), -1);
+			created.parent = node;
+			created.firstItem = -1;
+
+			child = static_cast<int32_t>(m_nodes.size());
+			m_nodes.push_back(created);
+			m_nodes[node].children[octant] = child;
+		}
+		node = child;
+	}
+	return node;
+}
+
+void LooseOctree::Link(uint32_t id, int32_t node) {
+	Item& item = m_items[id];
+	item.node = node;
+	item.prev = -1;
+	item.next = m_nodes[node].firstItem;
+	if (item.next >= 0) m_items[item.next].prev = static_cast<int32_t>(id);
+	m_nodes[node].firstItem = static_cast<int32_t>(id);
+
+	for (int32_t n = node; n >= 0; n = m_nodes[n].parent) m_nodes[n].subtreeCount++;
+	m_count++;
+}
+
+void LooseOctree::Unlink(uint32_t id) {
+	Item& item = m_items[id];
+	if (item.prev >= 0) {
+		m_items[item.prev].next = item.next;
+	} else {
+		m_nodes[item.node].firstItem = item.next;
+	}
+	if (item.next >= 0) m_items[item.next].prev = item.prev;
+
+	for (int32_t n = item.node; n >= 0; n = m_nodes[n].parent) m_nodes[n].subtreeCount--;
+	m_count--;
+
+	item.node = item.prev = item.next = -1;
+}
+
+void LooseOctree::Insert(uint32_t id, const float mins[3], const float maxs[3]) {
+	if (m_nodes.empty()) return;
+	if (id >= m_items.size()) m_items.resize(id + 1);
+
+	float center[3];
+	float extent = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		center[i] = (mins[i] + maxs[i]) * 0.5f;
+		extent = (std::max)(extent, (maxs[i] - mins[i]) * 0.5f);
+	}
+
+	int32_t node = FindNode(center, extent);
+	Item& item = m_items[id];
+	for (int i = 0; i < 3; i++) {
+		item.mins[i] = mins[i];
+		item.maxs[i] = maxs[i];
+	}
+
+	// Still in the same cell, the new bounds are all that changes
+	if (item.node == node) return;
+	if (item.node >= 0) Unlink(id);
+	Link(id, node);
+}
+
+void LooseOctree::Remove(uint32_t id) {
+	if (Contains(id)) Unlink(id);
+}
+
+template <typename Shape>
+void LooseOctree::Query(int32_t index, const Shape& shape, std::vector<uint32_t>& out) const {
+	const Node& node = m_nodes[index];
+	if (!node.subtreeCount) return;
+
+	if (index != 0) {
+		float mins[3], maxs[3];
+		for (int i = 0; i < 3; i++) {
+			mins[i] = node.center[i] - node.half * 2.0f;
+			maxs[i] = node.center[i] + node.half * 2.0f;
+		}
+		if (!shape.Touches(mins, maxs)) return;
+	}
+
+	for (int32_t id = node.firstItem; id >= 0; id = m_items[id].next) {
+		if (shape.Touches(m_items[id].mins, m_items[id].maxs)) out.push_back(static_cast<uint32_t>(id));
+	}
+
+	for (int32_t child : node.children) {
+		if (child >= 0) Query(child, shape, out);
+	}
+}
+
+void LooseOctree::QuerySphere(const float center[3], float radius, std::vector<uint32_t>& out) const {
+	if (m_nodes.empty()) return;
+	SphereShape shape = { { center[0], center[1], center[2] }, radius * radius };
+	Query(0, shape, out);
+}
+
+void LooseOctree::QueryBox(const float mins[3], const float maxs[3], std::vector<uint32_t>& out) const {
+	if (m_nodes.empty()) return;
+	BoxShape shape = { { mins[0], mins[1], mins[2] }, { maxs[0], maxs[1], maxs[2] } };
+	Query(0, shape, out);
+}
+
+void LooseOctree::QueryRay(const float start[3], const float end[3], std::vector<uint32_t>& out) const {
+	if (m_nodes.empty()) return;
+	RayShape shape;
+	for (int i = 0; i < 3; i++) {
+		shape.start[i] = start[i];
+		shape.delta[i] = end[i] - start[i];
+		shape.invDelta[i] = fabsf(shape.delta[i]) < 1e-6f ? 0.0f : 1.0f / shape.delta[i];
+	}
+	Query(0, shape, out);
+}
+
+void LooseOctree::QueryFrustum(const FrustumPlane* planes, size_t planeCount, std::vector<uint32_t>& out) const {
+	if (m_nodes.empty()) return;
+	FrustumShape shape = { planes, planeCount };
+	Query(0, shape, out);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "view_frustum.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Loose octree over axis aligned boxes, keyed by small integer ids (entity
+// or leaf indices).
+//
+// Every node's bounds are doubled, so an item lives in exactly one node:
+// the deepest one at least as big as the item that contains its centre.
+// Moving an item only relinks it when it leaves that node, which makes
+// per-frame updates of mostly still entities cheap. Queries append the ids
+// of every item whose box touches the shape.
+class LooseOctree {
+public:
+	// Cube around the given box, cells stop splitting at maxDepth
+	void Reset(const float mins[3], const float maxs[3], int maxDepth);
+	void Clear();
+	bool IsInitialized() const { return !m_nodes.empty(); }
+
+	void Insert(uint32_t id, const float mins[3], const float maxs[3]);
+	void Remove(uint32_t id);
+	bool Contains(uint32_t id) const { return id < m_items.size() && m_items[id].node >= 0; }
+	size_t GetCount() const { return m_count; }
+
+	void QuerySphere(const float center[3], float radius, std::vector<uint32_t>& out) const;
+	void QueryBox(const float mins[3], const float maxs[3], std::vector<uint32_t>& out) const;
+	void QueryRay(const float start[3], const float end[3], std::vector<uint32_t>& out) const;
+	void QueryFrustum(const FrustumPlane* planes, size_t planeCount, std::vector<uint32_t>& out) const;
+
+private:
+	struct Node {
+		float center[3];
+		float half;       // tight half size, the loose bounds are twice that
+		int32_t children[8];
+		int32_t parent;
+		int32_t firstItem;
+		uint32_t subtreeCount; // items here and below, empty branches are skipped
+	};
+
+	struct Item {
+		float mins[3];
+		float maxs[3];
+		int32_t node = -1;
+		int32_t prev = -1;
+		int32_t next = -1;
+	};
+
+	int32_t FindNode(const float center[3], float extent);
+	void Link(uint32_t id, int32_t node);
+	void Unlink(uint32_t id);
+
+	template <typename Shape>
+	void Query(int32_t node, const Shape& shape, std::vector<uint32_t>& out) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<Item> m_items; // indexed by id
+	size_t m_count = 0;
+	int m_maxDepth = 0;
+};
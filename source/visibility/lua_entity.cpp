@@ -0,0 +1,19 @@
+#include "lua_entity.h"
+#include "GarrysMod/Lua/Interface.h"
+
+using namespace GarrysMod::Lua;
+
+bool CallEntityMethod(ILuaBase* LUA, int ent, const char* name, int results) {
+	LUA->GetField(ent, name);
+	if (!LUA->IsType(-1, Type::Function)) {
+		LUA->Pop();
+		return false;
+	}
+
+	LUA->Push(ent);
+	if (LUA->PCall(1, results, 0) != 0) {
+		LUA->Pop();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace GarrysMod { namespace Lua { class ILuaBase; } }
+
+// Calls ent:name() on the entity at absolute stack index ent, leaving
+// `results` values on the stack. False, with nothing pushed, if the method
+// is missing or errors.
+bool CallEntityMethod(GarrysMod::Lua::ILuaBase* LUA, int ent, const char* name, int results);
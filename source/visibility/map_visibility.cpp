@@ -0,0 +1,170 @@
+#include "map_visibility.h"
+#include <tier0/dbg.h>
+#include <cstring>
+
+namespace {
+	// Above this the rows are decompressed per query instead of up front
+	constexpr size_t kMaxEagerBytes = 64 * 1024 * 1024;
+	constexpr size_t kMaxClusters = 65536;
+
+	enum { Row_PVS = 0, Row_PAS = 1 };
+}
+
+MapVisibility& MapVisibility::Instance() {
+	static MapVisibility instance;
+	return instance;
+}
+
+void MapVisibility::Clear() {
+	m_bsp.Clear();
+	m_clusterCount = 0;
+	m_rowWords = 0;
+	for (int kind = 0; kind < 2; kind++) {
+		m_rowOffsets[kind].clear();
+		m_rows[kind].clear();
+		m_scratch[kind].clear();
+	}
+	m_hasVis = false;
+	m_eager = true;
+	m_visible.Resize(0);
+	m_visibleValid = false;
+}
+
+bool MapVisibility::Load(const uint8_t* data, size_t size) {
+	Clear();
+
+	if (!m_bsp.Load(data, size)) {
+		Warning("[Visibility] Failed to load map: %s\n", m_bsp.GetError().c_str());
+		return false;
+	}
+
+	if (!DecompressRows()) {
+		// Still usable for FindCluster, everything just counts as visible
+		Warning("[Visibility] Map has no usable vis data, cluster culling disabled\n");
+		m_hasVis = false;
+	}
+
+	m_visible.Resize(m_clusterCount);
+	Msg("[Visibility] Loaded %u leafs, %u clusters (%s)\n", static_cast<unsigned>(m_bsp.GetLeafs().size()),
+		static_cast<unsigned>(m_clusterCount), !m_hasVis ? "no vis" : m_eager ? "rows cached" : "rows on demand");
+	return true;
+}
+
+bool MapVisibility::DecompressRows() {
+	const std::vector<uint8_t>& vis = m_bsp.GetVisibility();
+	if (vis.size() < 4) return false;
+
+	int32_t clusters;
+	memcpy(&clusters, vis.data(), sizeof(clusters));
+	if (clusters <= 0 || static_cast<size_t>(clusters) > kMaxClusters) return false;
+	if (vis.size() < 4 + static_cast<size_t>(clusters) * 8) return false;
+
+	m_clusterCount = static_cast<size_t>(clusters);
+	m_rowWords = ClusterSet::WordsFor(m_clusterCount);
+	for (int kind = 0; kind < 2; kind++) {
+		m_rowOffsets[kind].resize(m_clusterCount);
+		for (size_t c = 0; c < m_clusterCount; c++) {
+			memcpy(&m_rowOffsets[kind][c], vis.data() + 4 + c * 8 + kind * 4, sizeof(uint32_t));
+		}
+	}
+
+	m_eager = m_clusterCount * m_rowWords * sizeof(uint64_t) * 2 <= kMaxEagerBytes;
+	if (m_eager) {
+		for (int kind = 0; kind < 2; kind++) {
+			m_rows[kind].assign(m_clusterCount * m_rowWords, 0);
+			for (size_t c = 0; c < m_clusterCount; c++) {
+				if (!DecompressRow(m_rowOffsets[kind][c], &m_rows[kind][c * m_rowWords])) return false;
+			}
+		}
+	} else {
+		for (int kind = 0; kind < 2; kind++) {
+			m_scratch[kind].assign(m_rowWords, 0);
+		}
+	}
+
+	m_hasVis = true;
+	return true;
+}
+
+bool MapVisibility::DecompressRow(uint32_t offset, uint64_t* out) const {
+	const std::vector<uint8_t>& vis = m_bsp.GetVisibility();
+	uint8_t* row = reinterpret_cast<uint8_t*>(out);
+	size_t rowBytes = (m_clusterCount + 7) / 8;
+
+	memset(out, 0, m_rowWords * sizeof(uint64_t));
+
+	// Zero bytes are run-length encoded as 0, count
+	size_t in = offset;
+	size_t c = 0;
+	while (c < rowBytes) {
+		if (in >= vis.size()) return false;
+
+		if (vis[in]) {
+			row[c++] = vis[in++];
+			continue;
+		}
+
+		if (in + 1 >= vis.size()) return false;
+		c += vis[in + 1];
+		in += 2;
+	}
+
+	// A run may overshoot into the padding, keep it clear
+	if (m_clusterCount & 63) out[m_rowWords - 1] &= (1ULL << (m_clusterCount & 63)) - 1;
+	return true;
+}
+
+const uint64_t* MapVisibility::GetRow(int cluster, int kind) const {
+	if (!m_hasVis || cluster < 0 || static_cast<size_t>(cluster) >= m_clusterCount) return nullptr;
+	if (m_eager) return &m_rows[kind][cluster * m_rowWords];
+
+	if (!DecompressRow(m_rowOffsets[kind][cluster], m_scratch[kind].data())) return nullptr;
+	return m_scratch[kind].data();
+}
+
+const uint64_t* MapVisibility::GetPVS(int cluster) const {
+	return GetRow(cluster, Row_PVS);
+}
+
+const uint64_t* MapVisibility::GetPAS(int cluster) const {
+	return GetRow(cluster, Row_PAS);
+}
+
+size_t MapVisibility::UpdateVisibleClusters(const float origin[3], const float (*points)[3], size_t pointCount,
+	const int* clusters, size_t clusterCount, bool includePAS) {
+	m_visibleValid = false;
+	if (!m_hasVis) return 0;
+
+	m_visible.Clear();
+
+	int originCluster = m_bsp.FindCluster(origin);
+	if (originCluster < 0) {
+		m_visible.SetAll();
+		m_visibleValid = true;
+		return m_visible.Count();
+	}
+
+	m_visible.Set(originCluster);
+	if (const uint64_t* row = GetPVS(originCluster)) m_visible.Or(row);
+	if (includePAS) {
+		if (const uint64_t* row = GetPAS(originCluster)) m_visible.Or(row);
+	}
+
+	for (size_t i = 0; i < pointCount; i++) {
+		int cluster = m_bsp.FindCluster(points[i]);
+		m_visible.Set(cluster);
+		if (const uint64_t* row = GetPVS(cluster)) m_visible.Or(row);
+	}
+
+	for (size_t i = 0; i < clusterCount; i++) {
+		m_visible.Set(clusters[i]);
+	}
+
+	m_visibleValid = true;
+	return m_visible.Count();
+}
+
+bool MapVisibility::IsClusterVisible(int cluster) const {
+	if (!m_visibleValid || cluster < 0 || static_cast<size_t>(cluster) >= m_clusterCount) return true;
+	return m_visible.Test(cluster);
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "bsp_file.h"
+#include "cluster_set.h"
+#include "leaf_classifier.h"
+#include "ray_caster.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Cluster visibility for the current map, built from the BSP vis lump.
+//
+// Every cluster's PVS and PAS row is decompressed once at load into packed
+// bitsets, so building the visible set each update is a handful of SIMD ORs
+// instead of merging Lua tables.
+class MapVisibility {
+public:
+	static MapVisibility& Instance();
+
+	bool Load(const uint8_t* data, size_t size);
+	void Clear();
+
+	bool IsLoaded() const { return m_bsp.IsLoaded(); }
+	const BSPFile& GetBSP() const { return m_bsp; }
+	size_t GetClusterCount() const { return m_clusterCount; }
+
+	// Decompressed rows, nullptr when the cluster is out of range
+	const uint64_t* GetPVS(int cluster) const;
+	const uint64_t* GetPAS(int cluster) const;
+
+	int FindCluster(const float pos[3]) const { return m_bsp.FindCluster(pos); }
+
+	// Batched FindLeaf/FindCluster, either output may be null
+	void FindLeafs(const float (*points)[3], size_t count, int* leafs, int* clusters) const {
+		m_classifier.Classify(m_bsp, points, count, leafs, clusters);
+	}
+
+	// Fan of world traces from one origin, see RayCaster
+	void TraceRays(const float origin[3], const float (*deltas)[3], size_t count, float* fractions) const {
+		m_rayCaster.Cast(m_bsp, origin, deltas, count, RayCaster::kMaskSolid, fractions);
+	}
+
+	// Rebuilds the visible set: the PVS (and optionally PAS) of the origin,
+	// the PVS of every extra point and the extra clusters themselves. An
+	// origin outside the world makes everything visible, like the engine.
+	size_t UpdateVisibleClusters(const float origin[3], const float (*points)[3], size_t pointCount,
+		const int* clusters, size_t clusterCount, bool includePAS);
+
+	// Clusters outside the vis data (-1 for solid leafs, maps without vis)
+	// count as visible so nothing disappears when we know nothing.
+	bool IsClusterVisible(int cluster) const;
+
+	const ClusterSet& GetVisibleClusters() const { return m_visible; }
+	bool HasVisibleClusters() const { return m_visibleValid; }
+
+private:
+	MapVisibility() = default;
+
+	bool DecompressRows();
+	bool DecompressRow(uint32_t offset, uint64_t* out) const;
+	const uint64_t* GetRow(int cluster, int kind) const;
+
+	BSPFile m_bsp;
+	size_t m_clusterCount = 0;
+	size_t m_rowWords = 0;
+	std::vector<uint32_t> m_rowOffsets[2]; // PVS, PAS
+	std::vector<uint64_t> m_rows[2];
+	bool m_hasVis = false;
+
+	// Maps too big to keep every row decompressed use these per query
+	bool m_eager = true;
+	mutable std::vector<uint64_t> m_scratch[2];
+
+	ClusterSet m_visible;
+	bool m_visibleValid = false;
+
+	mutable LeafClassifier m_classifier;
+	mutable RayCaster m_rayCaster;
+};
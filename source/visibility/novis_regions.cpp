@@ -0,0 +1,111 @@
+#include "novis_regions.h"
+#include "map_visibility.h"
+#include <tier0/dbg.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+NoVisRegions& NoVisRegions::Instance() {
+	static NoVisRegions instance;
+	return instance;
+}
+
+void NoVisRegions::Clear() {
+	m_clusters.Resize(0);
+	m_clusterCount = 0;
+	m_boxes.clear();
+	m_spheres.clear();
+	m_viewCluster = -1;
+	m_active.store(false, std::memory_order_relaxed);
+}
+
+size_t NoVisRegions::Load(const char* text, size_t length) {
+	Clear();
+	if (!text) return 0;
+
+	const MapVisibility& visibility = MapVisibility::Instance();
+	m_clusters.Resize(visibility.GetClusterCount());
+
+	const char* pos = text;
+	const char* end = text + length;
+	int lineNumber = 0;
+	while (pos < end) {
+		const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+		if (!lineEnd) lineEnd = end;
+		std::string line(pos, lineEnd);
+		pos = lineEnd + 1;
+		lineNumber++;
+
+		size_t comment = (std::min)(line.find("//"), line.find('#'));
+		if (comment != std::string::npos) line.resize(comment);
+
+		char kind[16];
+		if (sscanf(line.c_str(), "%15s", kind) != 1) continue;
+
+		float v[6];
+		int cluster;
+		if (strcmp(kind, "cluster") == 0 && sscanf(line.c_str(), "%*s %d", &cluster) == 1) {
+			if (!m_clusters.Test(cluster)) {
+				if (cluster < 0 || static_cast<size_t>(cluster) >= visibility.GetClusterCount()) {
+					Warning("[Visibility] novis line %d: cluster %d is not in this map\n", lineNumber, cluster);
+					continue;
+				}
+				m_clusters.Set(cluster);
+				m_clusterCount++;
+			}
+		} else if (strcmp(kind, "point") == 0 && sscanf(line.c_str(), "%*s %f %f %f", &v[0], &v[1], &v[2]) == 3) {
+			cluster = visibility.FindCluster(v);
+			if (cluster < 0) {
+				Warning("[Visibility] novis line %d: point is outside the map's clusters\n", lineNumber);
+				continue;
+			}
+			if (!m_clusters.Test(cluster)) {
+				m_clusters.Set(cluster);
+				m_clusterCount++;
+			}
+		} else if (strcmp(kind, "box") == 0 && sscanf(line.c_str(), "%*s %f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) == 6) {
+			Box box;
+			for (int k = 0; k < 3; k++) {
+				box.mins[k] = (std::min)(v[k], v[k + 3]);
+				box.maxs[k] = (std::max)(v[k], v[k + 3]);
+			}
+			m_boxes.push_back(box);
+		} else if (strcmp(kind, "sphere") == 0 && sscanf(line.c_str(), "%*s %f %f %f %f", &v[0], &v[1], &v[2], &v[3]) == 4) {
+			m_spheres.push_back({ { v[0], v[1], v[2] }, v[3] * v[3] });
+		} else {
+			Warning("[Visibility] novis line %d: can't parse \"%s\"\n", lineNumber, line.c_str());
+		}
+	}
+
+	if (GetCount()) {
+		Msg("[Visibility] Loaded %u novis regions (%u clusters, %u boxes, %u spheres)\n", static_cast<unsigned>(GetCount()),
+			static_cast<unsigned>(m_clusterCount), static_cast<unsigned>(m_boxes.size()), static_cast<unsigned>(m_spheres.size()));
+	}
+	return GetCount();
+}
+
+bool NoVisRegions::Update(const float origin[3]) {
+	bool active = false;
+	if (GetCount()) {
+		m_viewCluster = MapVisibility::Instance().FindCluster(origin);
+		active = m_clusters.Test(m_viewCluster);
+
+		for (size_t i = 0; !active && i < m_boxes.size(); i++) {
+			const Box& box = m_boxes[i];
+			active = origin[0] >= box.mins[0] && origin[0] <= box.maxs[0] &&
+				origin[1] >= box.mins[1] && origin[1] <= box.maxs[1] &&
+				origin[2] >= box.mins[2] && origin[2] <= box.maxs[2];
+		}
+		for (size_t i = 0; !active && i < m_spheres.size(); i++) {
+			const Sphere& sphere = m_spheres[i];
+			float dx = origin[0] - sphere.center[0];
+			float dy = origin[1] - sphere.center[1];
+			float dz = origin[2] - sphere.center[2];
+			active = dx * dx + dy * dy + dz * dz <= sphere.radiusSqr;
+		}
+	}
+
+	m_active.store(active, std::memory_order_relaxed);
+	return active;
+}
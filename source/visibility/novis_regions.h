@@ -0,0 +1,54 @@
+#pragma once
+#include "cluster_set.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Parts of the current map whose vis data can't be trusted (leaks, vbsp's
+// FindPortalSide failures), so r_forcenovis 2 only disables engine vis
+// while the camera is in one of them.
+//
+// Loaded from maps/<map>_novis.txt, one region per line:
+//   cluster <index>
+//   point <x> <y> <z>                          (the cluster containing it)
+//   box <x1> <y1> <z1> <x2> <y2> <z2>
+//   sphere <x> <y> <z> <radius>
+// Anything after // or # is a comment.
+class NoVisRegions {
+public:
+	static NoVisRegions& Instance();
+
+	// Clusters and points need the map's visibility loaded first. Returns
+	// the number of regions.
+	size_t Load(const char* text, size_t length);
+	void Clear();
+
+	// Once per frame with the view origin, one tree walk plus the shapes
+	bool Update(const float origin[3]);
+	// Read by the ShouldForceNoVis hook
+	bool IsActive() const { return m_active.load(std::memory_order_relaxed); }
+
+	size_t GetCount() const { return m_clusterCount + m_boxes.size() + m_spheres.size(); }
+	int GetViewCluster() const { return m_viewCluster; }
+
+private:
+	NoVisRegions() = default;
+
+	struct Box {
+		float mins[3];
+		float maxs[3];
+	};
+
+	struct Sphere {
+		float center[3];
+		float radiusSqr;
+	};
+
+	ClusterSet m_clusters;
+	size_t m_clusterCount = 0;
+	std::vector<Box> m_boxes;
+	std::vector<Sphere> m_spheres;
+
+	int m_viewCluster = -1;
+	std::atomic<bool> m_active{ false };
+};
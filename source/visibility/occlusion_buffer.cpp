@@ -0,0 +1,321 @@
+#include "occlusion_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+void OcclusionBuffer::Begin(float tanHalfX, float tanHalfY, float nearZ) {
+	m_tanHalfX = tanHalfX;
+	m_tanHalfY = tanHalfY;
+	m_nearZ = nearZ;
+	m_polygons.clear();
+	m_edges.clear();
+	m_triangleCount = 0;
+
+	m_depth.assign(static_cast<size_t>(kWidth) * kHeight, 0.0f);
+	m_tileMin.assign(static_cast<size_t>(kTilesX) * kTilesY, 0.0f);
+}
+
+void OcclusionBuffer::AddPolygon(const float (*points)[3], size_t count) {
+	if (count < 3) return;
+
+	m_clipA.assign(&points[0][0], &points[0][0] + count * 3);
+
+	// Near plane and the four sides, inside where ax + by + cz + d >= 0.
+	// Clipping here keeps the projected points on screen, so the edge
+	// functions never see huge coordinates.
+	const float planes[5][4] = {
+		{ 0.0f, 0.0f, 1.0f, -m_nearZ },
+		{ 1.0f, 0.0f, m_tanHalfX, 0.0f },
+		{ -1.0f, 0.0f, m_tanHalfX, 0.0f },
+		{ 0.0f, 1.0f, m_tanHalfY, 0.0f },
+		{ 0.0f, -1.0f, m_tanHalfY, 0.0f },
+	};
+
+	for (const float* plane : planes) {
+		size_t in = m_clipA.size() / 3;
+		m_clipB.clear();
+		for (size_t i = 0; i < in; i++) {
+			const float* a = &m_clipA[i * 3];
+			const float* b = &m_clipA[((i + 1) % in) * 3];
+			float da = plane[0] * a[0] + plane[1] * a[1] + plane[2] * a[2] + plane[3];
+			float db = plane[0] * b[0] + plane[1] * b[1] + plane[2] * b[2] + plane[3];
+
+			if (da >= 0.0f) m_clipB.insert(m_clipB.end(), a, a + 3);
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				float t = da / (da - db);
+				for (int k = 0; k < 3; k++) m_clipB.push_back(a[k] + (b[k] - a[k]) * t);
+			}
+		}
+		m_clipA.swap(m_clipB);
+		if (m_clipA.size() < 9) return;
+	}
+
+	// Project
+	size_t n = m_clipA.size() / 3;
+	if (n > kMaxEdges) return;
+	for (size_t i = 0; i < n; i++) {
+		float* p = &m_clipA[i * 3];
+		float invZ = 1.0f / (std::max)(p[2], m_nearZ);
+		float sx = (p[0] * invZ / m_tanHalfX * 0.5f + 0.5f) * kWidth;
+		float sy = (0.5f - p[1] * invZ / m_tanHalfY * 0.5f) * kHeight;
+		p[0] = sx;
+		p[1] = sy;
+		p[2] = invZ;
+	}
+
+	// Signed area, and the fan triangle with the most of it for the depth plane
+	const float* v0 = &m_clipA[0];
+	float area = 0.0f, largest = 0.0f;
+	size_t planeVertex = 1;
+	for (size_t i = 1; i + 1 < n; i++) {
+		const float* a = &m_clipA[i * 3];
+		const float* b = &m_clipA[(i + 1) * 3];
+		float part = (a[0] - v0[0]) * (b[1] - v0[1]) - (b[0] - v0[0]) * (a[1] - v0[1]);
+		area += part;
+		if (std::fabs(part) > std::fabs(largest)) {
+			largest = part;
+			planeVertex = i;
+		}
+	}
+	if (std::fabs(area) < 1e-6f || std::fabs(largest) < 1e-6f) return;
+
+	Polygon polygon;
+	polygon.firstEdge = static_cast<uint32_t>(m_edges.size());
+	polygon.edgeCount = static_cast<uint32_t>(n);
+
+	// Edge i runs from vertex i to vertex i + 1: e(p) = A px + B py + C, all
+	// >= 0 inside. The polygon is rasterized whole rather than as a fan, so
+	// only its outline is pulled in by half a pixel: occluders never claim
+	// more than they cover, and no cracks open up between their triangles.
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	float minX = static_cast<float>(kWidth), maxX = 0.0f;
+	float minY = static_cast<float>(kHeight), maxY = 0.0f;
+	for (size_t i = 0; i < n; i++) {
+		const float* a = &m_clipA[i * 3];
+		const float* b = &m_clipA[((i + 1) % n) * 3];
+		Edge edge;
+		edge.a = (a[1] - b[1]) * sign;
+		edge.b = (b[0] - a[0]) * sign;
+		edge.c = -(edge.a * a[0] + edge.b * a[1]) - 0.5f * (std::fabs(edge.a) + std::fabs(edge.b));
+		m_edges.push_back(edge);
+
+		minX = (std::min)(minX, a[0]);
+		maxX = (std::max)(maxX, a[0]);
+		minY = (std::min)(minY, a[1]);
+		maxY = (std::max)(maxY, a[1]);
+	}
+
+	// 1/z is linear in screen space, taken at the farthest corner of each pixel
+	const float* v1 = &m_clipA[planeVertex * 3];
+	const float* v2 = &m_clipA[(planeVertex + 1) * 3];
+	polygon.dzdx = ((v1[2] - v0[2]) * (v2[1] - v0[1]) - (v2[2] - v0[2]) * (v1[1] - v0[1])) / largest;
+	polygon.dzdy = ((v2[2] - v0[2]) * (v1[0] - v0[0]) - (v1[2] - v0[2]) * (v2[0] - v0[0])) / largest;
+	polygon.dzc = v0[2] - polygon.dzdx * v0[0] - polygon.dzdy * v0[1] - 0.5f * (std::fabs(polygon.dzdx) + std::fabs(polygon.dzdy));
+
+	// Rows whose pixel centres can be inside
+	polygon.minX = minX;
+	polygon.maxX = maxX;
+	polygon.minRow = (std::max)(0, static_cast<int>(std::floor(minY - 0.5f)));
+	polygon.maxRow = (std::min)(kHeight, static_cast<int>(std::ceil(maxY + 0.5f)));
+	if (polygon.minRow >= polygon.maxRow) {
+		m_edges.resize(polygon.firstEdge);
+		return;
+	}
+
+	m_polygons.push_back(polygon);
+	m_triangleCount += n - 2;
+}
+
+void OcclusionBuffer::RasterizePolygon(const Polygon& polygon, int rowBegin, int rowEnd) {
+	const Edge* edges = &m_edges[polygon.firstEdge];
+	const uint32_t edgeCount = polygon.edgeCount;
+
+	int first = (std::max)(rowBegin, polygon.minRow);
+	int last = (std::min)(rowEnd, polygon.maxRow);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 depthStep = _mm_set1_ps(polygon.dzdx);
+	float rowTerms[kMaxEdges];
+
+	for (int row = first; row < last; row++) {
+		float py = row + 0.5f;
+		__m128 rowDepth = _mm_set1_ps(polygon.dzdy * py + polygon.dzc);
+		float* out = &m_depth[static_cast<size_t>(row) * kWidth];
+
+		// Span where every edge can be inside on this row, the masks below
+		// settle the pixels at its ends
+		float spanBegin = polygon.minX - 0.5f;
+		float spanEnd = polygon.maxX + 0.5f;
+		for (uint32_t i = 0; i < edgeCount; i++) {
+			float rowTerm = edges[i].b * py + edges[i].c;
+			rowTerms[i] = rowTerm;
+			if (edges[i].a > 0.0f) {
+				spanBegin = (std::max)(spanBegin, -rowTerm / edges[i].a - 0.5f);
+			} else if (edges[i].a < 0.0f) {
+				spanEnd = (std::min)(spanEnd, -rowTerm / edges[i].a + 0.5f);
+			} else if (rowTerm < 0.0f) {
+				spanEnd = spanBegin;
+			}
+		}
+		if (spanEnd <= spanBegin) continue;
+
+		int columnBegin = (std::max)(0, static_cast<int>(std::floor(spanBegin - 0.5f))) & ~3;
+		int columnEnd = (std::min)(kWidth, static_cast<int>(std::ceil(spanEnd + 0.5f)));
+
+		for (int column = columnBegin; column < columnEnd; column += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(column)), laneOffsets);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[0].a), px), _mm_set1_ps(rowTerms[0])), zero);
+			for (uint32_t i = 1; i < edgeCount; i++) {
+				__m128 e = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[i].a), px), _mm_set1_ps(rowTerms[i]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+			}
+			if (!_mm_movemask_ps(inside)) continue;
+
+			__m128 depth = _mm_add_ps(_mm_mul_ps(depthStep, px), rowDepth);
+			__m128 current = _mm_loadu_ps(out + column);
+			__m128 nearest = _mm_max_ps(current, depth);
+			_mm_storeu_ps(out + column, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+		}
+	}
+}
+
+void OcclusionBuffer::RenderBand(size_t band, size_t bandCount) {
+	int tileRowBegin = static_cast<int>(band * kTilesY / bandCount);
+	int tileRowEnd = static_cast<int>((band + 1) * kTilesY / bandCount);
+	int rowBegin = tileRowBegin * kTileSize;
+	int rowEnd = tileRowEnd * kTileSize;
+
+	for (const Polygon& polygon : m_polygons) {
+		if (polygon.maxRow <= rowBegin || polygon.minRow >= rowEnd) continue;
+		RasterizePolygon(polygon, rowBegin, rowEnd);
+	}
+
+	for (int tileY = tileRowBegin; tileY < tileRowEnd; tileY++) {
+		for (int tileX = 0; tileX < kTilesX; tileX++) {
+			__m128 farthest = _mm_set1_ps(INFINITY);
+			for (int row = 0; row < kTileSize; row++) {
+				const float* in = &m_depth[static_cast<size_t>(tileY * kTileSize + row) * kWidth + tileX * kTileSize];
+				for (int column = 0; column < kTileSize; column += 4) farthest = _mm_min_ps(farthest, _mm_loadu_ps(in + column));
+			}
+
+			float lanes[4];
+			_mm_storeu_ps(lanes, farthest);
+			m_tileMin[tileY * kTilesX + tileX] = (std::min)((std::min)(lanes[0], lanes[1]), (std::min)(lanes[2], lanes[3]));
+		}
+	}
+}
+
+void OcclusionBuffer::Render(size_t threads) {
+	threads = (std::min)((std::max)(threads, static_cast<size_t>(1)), static_cast<size_t>(kTilesY));
+	if (threads == 1) {
+		RenderBand(0, 1);
+		m_polygons.clear();
+		m_edges.clear();
+		return;
+	}
+
+	if (m_workers.size() != threads - 1) StartWorkers(threads - 1);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bandCount = threads;
+		m_pending = threads - 1;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	RenderBand(0, threads);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_pending == 0; });
+	m_polygons.clear();
+	m_edges.clear();
+}
+
+void OcclusionBuffer::StartWorkers(size_t count) {
+	StopWorkers();
+
+	// Workers start from the current generation, the next Render is their first job
+	uint64_t generation = m_generation;
+	for (size_t i = 0; i < count; i++) {
+		m_workers.emplace_back([this, i, generation] {
+			uint64_t seen = generation;
+			size_t band = i + 1;
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			for (;;) {
+				m_wake.wait(lock, [this, &seen] { return m_stopping || m_generation != seen; });
+				if (m_stopping) return;
+
+				seen = m_generation;
+				size_t bandCount = m_bandCount;
+				lock.unlock();
+				RenderBand(band, bandCount);
+				lock.lock();
+
+				if (--m_pending == 0) m_done.notify_one();
+			}
+		});
+	}
+}
+
+void OcclusionBuffer::StopWorkers() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& worker : m_workers) {
+		if (worker.joinable()) worker.join();
+	}
+	m_workers.clear();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stopping = false;
+}
+
+bool OcclusionBuffer::ArePointsVisible(const float (*points)[3], size_t count) const {
+	if (count == 0 || m_depth.empty()) return true;
+
+	float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+	float nearestZ = INFINITY;
+	for (size_t i = 0; i < count; i++) {
+		float z = points[i][2];
+		if (z <= m_nearZ) return true;
+
+		float sx = (points[i][0] / z / m_tanHalfX * 0.5f + 0.5f) * kWidth;
+		float sy = (0.5f - points[i][1] / z / m_tanHalfY * 0.5f) * kHeight;
+		minX = (std::min)(minX, sx);
+		maxX = (std::max)(maxX, sx);
+		minY = (std::min)(minY, sy);
+		maxY = (std::max)(maxY, sy);
+		nearestZ = (std::min)(nearestZ, z);
+	}
+
+	// Nothing is known past the screen edge
+	if (minX < 0.0f || minY < 0.0f || maxX > kWidth || maxY > kHeight) return true;
+
+	int x0 = static_cast<int>(minX);
+	int y0 = static_cast<int>(minY);
+	int x1 = (std::min)(static_cast<int>(maxX), kWidth - 1);
+	int y1 = (std::min)(static_cast<int>(maxY), kHeight - 1);
+	float nearestInvZ = 1.0f / nearestZ;
+
+	for (int tileY = y0 / kTileSize; tileY <= y1 / kTileSize; tileY++) {
+		for (int tileX = x0 / kTileSize; tileX <= x1 / kTileSize; tileX++) {
+			// Even the farthest occluder in the tile is in front
+			if (m_tileMin[tileY * kTilesX + tileX] > nearestInvZ) continue;
+
+			int rowBegin = (std::max)(y0, tileY * kTileSize), rowEnd = (std::min)(y1, tileY * kTileSize + kTileSize - 1);
+			int columnBegin = (std::max)(x0, tileX * kTileSize), columnEnd = (std::min)(x1, tileX * kTileSize + kTileSize - 1);
+			for (int row = rowBegin; row <= rowEnd; row++) {
+				const float* in = &m_depth[static_cast<size_t>(row) * kWidth];
+				for (int column = columnBegin; column <= columnEnd; column++) {
+					if (in[column] <= nearestInvZ) return true;
+				}
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Coarse software depth buffer for occlusion tests.
+//
+// Occluder polygons come in camera space (x right, y up, z forward), are
+// clipped to the view, projected and rasterized as 1/z with the nearest
+// surface winning. The screen is split into horizontal bands, one per
+// thread, and each band walks its polygons four pixels at a time with SSE
+// edge functions. A second level keeps the farthest depth of every tile,
+// so most tests are settled without looking at single pixels.
+class OcclusionBuffer {
+public:
+	static constexpr int kWidth = 256;
+	static constexpr int kHeight = 128;
+	static constexpr int kTileSize = 8;
+	static constexpr int kTilesX = kWidth / kTileSize;
+	static constexpr int kTilesY = kHeight / kTileSize;
+	// Polygons with more edges after clipping are dropped
+	static constexpr size_t kMaxEdges = 32;
+
+	~OcclusionBuffer() { StopWorkers(); }
+
+	// Clears the buffer, projection half tangents and near plane for the
+	// polygons that follow
+	void Begin(float tanHalfX, float tanHalfY, float nearZ);
+	// Convex polygon in camera space, the caller drops back faces
+	void AddPolygon(const float (*points)[3], size_t count);
+	// Rasterizes what was added since the last Render on up to `threads`
+	// threads. Tests in between see the occluders drawn so far.
+	void Render(size_t threads);
+
+	// Camera space points of an occludee (box corners). True unless every
+	// pixel its screen rectangle touches has an occluder in front of its
+	// nearest point. Anything crossing the near plane or the screen edge
+	// counts as visible.
+	bool ArePointsVisible(const float (*points)[3], size_t count) const;
+
+	// What the polygons added since Begin would make as a triangle fan
+	size_t GetTriangleCount() const { return m_triangleCount; }
+	const float* GetDepth() const { return m_depth.data(); }
+
+	void StopWorkers();
+
+private:
+	struct Edge {
+		float a, b, c;
+	};
+
+	struct Polygon {
+		uint32_t firstEdge; // into m_edges
+		uint32_t edgeCount;
+		float dzdx, dzdy, dzc;
+		float minX, maxX;
+		int minRow;
+		int maxRow;
+	};
+
+	void RenderBand(size_t band, size_t bandCount);
+	void RasterizePolygon(const Polygon& polygon, int rowBegin, int rowEnd);
+	void StartWorkers(size_t count);
+
+	float m_tanHalfX = 1.0f;
+	float m_tanHalfY = 1.0f;
+	float m_nearZ = 1.0f;
+
+	std::vector<Polygon> m_polygons; // waiting for the next Render
+	std::vector<Edge> m_edges;
+	size_t m_triangleCount = 0;
+	std::vector<float> m_depth;    // kWidth * kHeight, 1/z, 0 where nothing was drawn
+	std::vector<float> m_tileMin;  // kTilesX * kTilesY, farthest 1/z in each tile
+	std::vector<float> m_clipA, m_clipB; // 3 floats per point
+
+	// Band workers, band 0 is always the calling thread
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_generation = 0;
+	size_t m_pending = 0;
+	size_t m_bandCount = 1;
+	bool m_stopping = false;
+};
@@ -0,0 +1,336 @@
+#include "occlusion_culler.h"
+#include "bsp_file.h"
+#include "view_frustum.h"
+#include <tier0/dbg.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+	constexpr float kDegToRad = 3.14159265358979f / 180.0f;
+
+	constexpr int32_t kContentsSolid = 0x1;
+	constexpr int32_t kContentsTranslucent = 0x10000000;
+	// Sides with these never draw anything to hide behind
+	constexpr int32_t kSurfSky = 0x4;
+	constexpr int32_t kSurfTrans = 0x10;
+	constexpr int32_t kSurfNoDraw = 0x80;
+	constexpr int32_t kSurfSeeThrough = kSurfSky | kSurfTrans | kSurfNoDraw;
+
+	// A brush has to be at least this big on its two larger axes to be
+	// worth drawing, which keeps trim, pillars and stairs out
+	constexpr float kMinOccluderSize = 64.0f;
+
+	constexpr size_t kMaxOccluders = 2048;
+	// Drawn before the rest are tested against them
+	constexpr size_t kFirstPassOccluders = 64;
+	constexpr float kNearZ = 4.0f;
+	constexpr double kMaxAgeSeconds = 0.5;
+	constexpr float kWindingSize = 32768.0f;
+	constexpr float kClipEpsilon = 0.01f;
+
+	float Dot(const float a[3], const float b[3]) {
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Square on the plane, bigger than any map
+	void BaseWinding(const float normal[3], float dist, std::vector<std::array<float, 3>>& out) {
+		int axis = 0;
+		for (int i = 1; i < 3; i++) {
+			if (std::fabs(normal[i]) > std::fabs(normal[axis])) axis = i;
+		}
+
+		float up[3] = { 0.0f, 0.0f, 0.0f };
+		up[axis == 2 ? 0 : 2] = 1.0f;
+		float d = Dot(up, normal);
+		for (int i = 0; i < 3; i++) up[i] -= normal[i] * d;
+		float length = std::sqrt(Dot(up, up));
+		for (int i = 0; i < 3; i++) up[i] = up[i] / length * kWindingSize;
+
+		float right[3] = {
+			(up[1] * normal[2] - up[2] * normal[1]),
+			(up[2] * normal[0] - up[0] * normal[2]),
+			(up[0] * normal[1] - up[1] * normal[0]),
+		};
+
+		out.resize(4);
+		for (int i = 0; i < 3; i++) {
+			float origin = normal[i] * dist;
+			out[0][i] = origin - right[i] + up[i];
+			out[1][i] = origin + right[i] + up[i];
+			out[2][i] = origin + right[i] - up[i];
+			out[3][i] = origin - right[i] - up[i];
+		}
+	}
+
+	// Keeps the part behind the plane (inside the brush)
+	void ClipWinding(std::vector<std::array<float, 3>>& winding, const float normal[3], float dist,
+		std::vector<std::array<float, 3>>& scratch) {
+		scratch.clear();
+		size_t count = winding.size();
+		for (size_t i = 0; i < count; i++) {
+			const std::array<float, 3>& a = winding[i];
+			const std::array<float, 3>& b = winding[(i + 1) % count];
+			float da = Dot(normal, a.data()) - dist;
+			float db = Dot(normal, b.data()) - dist;
+
+			if (da <= kClipEpsilon) scratch.push_back(a);
+			if ((da <= kClipEpsilon) != (db <= kClipEpsilon)) {
+				float t = da / (da - db);
+				scratch.push_back({ a[0] + (b[0] - a[0]) * t, a[1] + (b[1] - a[1]) * t, a[2] + (b[2] - a[2]) * t });
+			}
+		}
+		winding.swap(scratch);
+	}
+}
+
+OcclusionCuller& OcclusionCuller::Instance() {
+	static OcclusionCuller instance;
+	return instance;
+}
+
+void OcclusionCuller::Clear() {
+	m_occluders.clear();
+	m_faces.clear();
+	m_points.clear();
+	m_valid = false;
+	m_stats = Stats();
+	m_buffer.StopWorkers();
+}
+
+void OcclusionCuller::BuildOccluders(const BSPFile& bsp) {
+	Clear();
+	if (!bsp.IsLoaded()) return;
+
+	const std::vector<BSPFile::Node>& nodes = bsp.GetNodes();
+	const std::vector<BSPFile::Leaf>& leafs = bsp.GetLeafs();
+	const std::vector<BSPFile::Plane>& planes = bsp.GetPlanes();
+	const std::vector<BSPFile::Brush>& brushes = bsp.GetBrushes();
+	const std::vector<BSPFile::BrushSide>& sides = bsp.GetBrushSides();
+	const std::vector<BSPFile::TexInfo>& texInfos = bsp.GetTexInfos();
+	const std::vector<uint16_t>& leafBrushes = bsp.GetLeafBrushes();
+
+	// Only brushes in the world model's leafs, doors and other brush
+	// entities have their own trees and can move or vanish
+	std::vector<uint8_t> isWorld(brushes.size(), 0);
+	std::vector<int> stack = { bsp.GetModels()[0].headNode };
+	while (!stack.empty()) {
+		int node = stack.back();
+		stack.pop_back();
+
+		if (node < 0) {
+			int leaf = -1 - node;
+			if (static_cast<size_t>(leaf) >= leafs.size()) continue;
+			for (uint32_t k = 0; k < leafs[leaf].numLeafBrushes; k++) {
+				size_t slot = static_cast<size_t>(leafs[leaf].firstLeafBrush) + k;
+				if (slot < leafBrushes.size() && leafBrushes[slot] < brushes.size()) isWorld[leafBrushes[slot]] = 1;
+			}
+			continue;
+		}
+		if (static_cast<size_t>(node) >= nodes.size()) continue;
+		stack.push_back(nodes[node].children[0]);
+		stack.push_back(nodes[node].children[1]);
+	}
+
+	std::vector<std::array<float, 3>> winding, scratch;
+	for (size_t b = 0; b < brushes.size(); b++) {
+		const BSPFile::Brush& brush = brushes[b];
+		if (!isWorld[b]) continue;
+		if (!(brush.contents & kContentsSolid) || (brush.contents & kContentsTranslucent)) continue;
+		if (brush.firstSide < 0 || brush.numSides < 4 || static_cast<size_t>(brush.firstSide) + brush.numSides > sides.size()) continue;
+
+		Occluder occluder;
+		occluder.firstFace = static_cast<uint32_t>(m_faces.size());
+		occluder.faceCount = 0;
+		for (int i = 0; i < 3; i++) {
+			occluder.mins[i] = INFINITY;
+			occluder.maxs[i] = -INFINITY;
+		}
+		size_t firstPoint = m_points.size();
+		int closedSides = 0;
+
+		for (int s = 0; s < brush.numSides; s++) {
+			const BSPFile::BrushSide& side = sides[brush.firstSide + s];
+			if (side.bevel || side.planeNum >= planes.size()) continue;
+			const BSPFile::Plane& plane = planes[side.planeNum];
+
+			BaseWinding(plane.normal, plane.dist, winding);
+			for (int o = 0; o < brush.numSides && winding.size() >= 3; o++) {
+				const BSPFile::BrushSide& other = sides[brush.firstSide + o];
+				if (o == s || other.bevel || other.planeNum >= planes.size()) continue;
+				const BSPFile::Plane& clip = planes[other.planeNum];
+				ClipWinding(winding, clip.normal, clip.dist, scratch);
+			}
+			if (winding.size() < 3) continue;
+
+			// Still part of the brush's shape and bounds, but not drawn
+			closedSides++;
+			for (const std::array<float, 3>& point : winding) {
+				for (int i = 0; i < 3; i++) {
+					occluder.mins[i] = (std::min)(occluder.mins[i], point[i]);
+					occluder.maxs[i] = (std::max)(occluder.maxs[i], point[i]);
+				}
+			}
+			if (side.texInfo >= 0 && static_cast<size_t>(side.texInfo) < texInfos.size() &&
+				(texInfos[side.texInfo].flags & kSurfSeeThrough)) continue;
+
+			Face face;
+			for (int i = 0; i < 3; i++) face.normal[i] = plane.normal[i];
+			face.dist = plane.dist;
+			face.firstPoint = static_cast<uint32_t>(m_points.size());
+			face.pointCount = static_cast<uint32_t>(winding.size());
+			m_points.insert(m_points.end(), winding.begin(), winding.end());
+			m_faces.push_back(face);
+			occluder.faceCount++;
+		}
+
+		float extents[3];
+		for (int i = 0; i < 3; i++) extents[i] = occluder.maxs[i] - occluder.mins[i];
+		std::sort(extents, extents + 3);
+		if (closedSides < 4 || occluder.faceCount == 0 || extents[1] < kMinOccluderSize) {
+			m_faces.resize(occluder.firstFace);
+			m_points.resize(firstPoint);
+			continue;
+		}
+		m_occluders.push_back(occluder);
+	}
+
+	Msg("[Visibility] Built %u occluders (%u faces) from %u brushes\n", static_cast<unsigned>(m_occluders.size()),
+		static_cast<unsigned>(m_faces.size()), static_cast<unsigned>(brushes.size()));
+}
+
+void OcclusionCuller::Update(const View& view) {
+	auto start = std::chrono::steady_clock::now();
+	m_stats = Stats();
+	m_view = view;
+
+	float tanHalf = tanf(view.fov * 0.5f * kDegToRad);
+	float tanHalfX = tanHalf * view.aspect * 0.75f;
+	float tanHalfY = tanHalf * 0.75f;
+	m_buffer.Begin(tanHalfX, tanHalfY, kNearZ);
+
+	FrustumPlane frustum[4];
+	size_t planeCount = BuildViewFrustum(view.origin, view.forward, view.right, view.up, view.fov, view.aspect, 0.0f, frustum);
+
+	// Occluders in the view, nearest first
+	m_candidates.clear();
+	for (uint32_t i = 0; i < m_occluders.size(); i++) {
+		const Occluder& occluder = m_occluders[i];
+
+		bool outside = false;
+		for (size_t p = 0; p < planeCount && !outside; p++) {
+			const FrustumPlane& plane = frustum[p];
+			float corner[3];
+			for (int k = 0; k < 3; k++) corner[k] = plane.normal[k] >= 0.0f ? occluder.maxs[k] : occluder.mins[k];
+			outside = Dot(plane.normal, corner) < plane.dist;
+		}
+		if (outside) continue;
+
+		float distSqr = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			float d = (std::max)((std::max)(occluder.mins[k] - view.origin[k], view.origin[k] - occluder.maxs[k]), 0.0f);
+			distSqr += d * d;
+		}
+		m_candidates.push_back({ distSqr, i });
+	}
+	if (m_candidates.size() > kMaxOccluders) {
+		std::nth_element(m_candidates.begin(), m_candidates.begin() + kMaxOccluders, m_candidates.end());
+		m_candidates.resize(kMaxOccluders);
+	}
+	std::sort(m_candidates.begin(), m_candidates.end());
+
+	size_t threads = (std::min)((std::max)(1u, std::thread::hardware_concurrency()), 4u);
+
+	// The nearest occluders go in first, anything they already hide
+	// would only add overdraw
+	for (size_t c = 0; c < m_candidates.size(); c++) {
+		if (c == kFirstPassOccluders) m_buffer.Render(threads);
+
+		const Occluder& occluder = m_occluders[m_candidates[c].second];
+		if (c >= kFirstPassOccluders) {
+			float corners[8][3];
+			for (int i = 0; i < 8; i++) {
+				float rel[3] = {
+					((i & 1) ? occluder.maxs[0] : occluder.mins[0]) - view.origin[0],
+					((i & 2) ? occluder.maxs[1] : occluder.mins[1]) - view.origin[1],
+					((i & 4) ? occluder.maxs[2] : occluder.mins[2]) - view.origin[2],
+				};
+				corners[i][0] = Dot(rel, view.right);
+				corners[i][1] = Dot(rel, view.up);
+				corners[i][2] = Dot(rel, view.forward);
+			}
+			if (!m_buffer.ArePointsVisible(corners, 8)) continue;
+		}
+
+		m_stats.occluders++;
+		for (uint32_t f = 0; f < occluder.faceCount; f++) {
+			const Face& face = m_faces[occluder.firstFace + f];
+
+			// Faces pointing away are hidden behind the brush's front ones
+			if (Dot(face.normal, view.origin) - face.dist <= 0.0f) continue;
+
+			m_polygon.resize(face.pointCount);
+			for (uint32_t p = 0; p < face.pointCount; p++) {
+				const std::array<float, 3>& point = m_points[face.firstPoint + p];
+				float rel[3] = { point[0] - view.origin[0], point[1] - view.origin[1], point[2] - view.origin[2] };
+				m_polygon[p] = { Dot(rel, view.right), Dot(rel, view.up), Dot(rel, view.forward) };
+			}
+			m_buffer.AddPolygon(reinterpret_cast<const float(*)[3]>(m_polygon.data()), m_polygon.size());
+		}
+	}
+
+	m_buffer.Render(threads);
+
+	m_valid = true;
+	m_updated = std::chrono::steady_clock::now();
+	m_stats.triangles = m_buffer.GetTriangleCount();
+	m_stats.milliseconds = std::chrono::duration<double, std::milli>(m_updated - start).count();
+}
+
+bool OcclusionCuller::IsValid() const {
+	return m_valid && std::chrono::duration<double>(std::chrono::steady_clock::now() - m_updated).count() < kMaxAgeSeconds;
+}
+
+bool OcclusionCuller::ArePointsVisible(const float (*points)[3], size_t count) {
+	float camera[8][3];
+	for (size_t i = 0; i < count; i++) {
+		float rel[3] = { points[i][0] - m_view.origin[0], points[i][1] - m_view.origin[1], points[i][2] - m_view.origin[2] };
+		camera[i][0] = Dot(rel, m_view.right);
+		camera[i][1] = Dot(rel, m_view.up);
+		camera[i][2] = Dot(rel, m_view.forward);
+	}
+
+	bool visible = m_buffer.ArePointsVisible(camera, count);
+	m_stats.tested++;
+	if (!visible) m_stats.occluded++;
+	return visible;
+}
+
+bool OcclusionCuller::IsBoxVisible(const float mins[3], const float maxs[3]) {
+	if (!IsValid()) return true;
+
+	float corners[8][3];
+	for (int i = 0; i < 8; i++) {
+		corners[i][0] = (i & 1) ? maxs[0] : mins[0];
+		corners[i][1] = (i & 2) ? maxs[1] : mins[1];
+		corners[i][2] = (i & 4) ? maxs[2] : mins[2];
+	}
+	return ArePointsVisible(corners, 8);
+}
+
+bool OcclusionCuller::IsSphereVisible(const float center[3], float radius) {
+	if (!IsValid()) return true;
+
+	// Cube around the sphere lined up with the view, its screen rectangle
+	// and nearest depth cover the sphere's
+	float corners[8][3];
+	for (int i = 0; i < 8; i++) {
+		float sx = (i & 1) ? radius : -radius;
+		float sy = (i & 2) ? radius : -radius;
+		float sz = (i & 4) ? radius : -radius;
+		for (int k = 0; k < 3; k++) {
+			corners[i][k] = center[k] + m_view.right[k] * sx + m_view.up[k] * sy + m_view.forward[k] * sz;
+		}
+	}
+	return ArePointsVisible(corners, 8);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "occlusion_buffer.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BSPFile;
+
+// Software occlusion for entities and lights, since engine culling is off
+// and everything in the radius would otherwise reach Remix.
+//
+// The occluders are the world model's large solid brushes, turned into face
+// polygons once per map. Every frame the nearest ones in the view are drawn
+// into an OcclusionBuffer, and boxes or spheres are tested against it. A
+// buffer more than half a second old isn't trusted, so everything passes
+// when nobody keeps it up to date.
+class OcclusionCuller {
+public:
+	struct View {
+		float origin[3];
+		float forward[3];
+		float right[3];
+		float up[3];
+		float fov;    // engine fov, horizontal at 4:3
+		float aspect; // width / height
+	};
+
+	struct Stats {
+		size_t occluders = 0;
+		size_t triangles = 0;
+		size_t tested = 0;
+		size_t occluded = 0;
+		double milliseconds = 0.0;
+	};
+
+	static OcclusionCuller& Instance();
+
+	void BuildOccluders(const BSPFile& bsp);
+	void Clear();
+	size_t GetOccluderCount() const { return m_occluders.size(); }
+
+	void Update(const View& view);
+	bool IsValid() const;
+
+	bool IsBoxVisible(const float mins[3], const float maxs[3]);
+	bool IsSphereVisible(const float center[3], float radius);
+
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	OcclusionCuller() = default;
+
+	struct Face {
+		float normal[3];
+		float dist;
+		uint32_t firstPoint;
+		uint32_t pointCount;
+	};
+
+	struct Occluder {
+		float mins[3];
+		float maxs[3];
+		uint32_t firstFace;
+		uint32_t faceCount;
+	};
+
+	bool ArePointsVisible(const float (*points)[3], size_t count);
+
+	std::vector<Occluder> m_occluders;
+	std::vector<Face> m_faces;
+	std::vector<std::array<float, 3>> m_points;
+
+	OcclusionBuffer m_buffer;
+	View m_view = {};
+	bool m_valid = false;
+	std::chrono::steady_clock::time_point m_updated;
+
+	std::vector<std::pair<float, uint32_t>> m_candidates; // distance squared, occluder
+	std::vector<std::array<float, 3>> m_polygon;
+	Stats m_stats;
+};
@@ -0,0 +1,152 @@
+#include "portal_graph.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	// Minimal cursor over the text, the files are small but strtod on a
+	// std::string per token would still be wasteful
+	struct Reader {
+		const char* pos;
+		const char* end;
+
+		void SkipSpace() {
+			while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n')) pos++;
+		}
+
+		bool Expect(char c) {
+			SkipSpace();
+			if (pos >= end || *pos != c) return false;
+			pos++;
+			return true;
+		}
+
+		bool ReadLong(long& value) {
+			SkipSpace();
+			char buffer[32];
+			size_t n = 0;
+			while (pos < end && n < sizeof(buffer) - 1 && (*pos == '-' || (*pos >= '0' && *pos <= '9'))) buffer[n++] = *pos++;
+			if (n == 0) return false;
+			buffer[n] = '\0';
+			value = strtol(buffer, nullptr, 10);
+			return true;
+		}
+
+		bool ReadFloat(float& value) {
+			SkipSpace();
+			char buffer[64];
+			size_t n = 0;
+			while (pos < end && n < sizeof(buffer) - 1 && strchr("+-.0123456789eE", *pos)) buffer[n++] = *pos++;
+			if (n == 0) return false;
+			buffer[n] = '\0';
+			value = strtof(buffer, nullptr);
+			return true;
+		}
+	};
+}
+
+bool PortalGraph::Fail(const char* error) {
+	Clear();
+	m_error = error;
+	return false;
+}
+
+void PortalGraph::Clear() {
+	m_clusterCount = 0;
+	m_portals.clear();
+	m_points.clear();
+	m_linkStart.clear();
+	m_links.clear();
+	m_error.clear();
+}
+
+bool PortalGraph::Load(const char* text, size_t length) {
+	Clear();
+	if (!text || length < 4 || strncmp(text, "PRT1", 4) != 0) return Fail("not a PRT1 file");
+
+	Reader reader = { text + 4, text + length };
+	long clusters, portals;
+	if (!reader.ReadLong(clusters) || !reader.ReadLong(portals)) return Fail("missing header counts");
+	if (clusters <= 0 || clusters > 65536 || portals < 0 || portals > 1 << 20) return Fail("bad header counts");
+
+	m_clusterCount = static_cast<size_t>(clusters);
+	m_portals.reserve(portals);
+
+	std::vector<uint32_t> linkCounts(m_clusterCount, 0);
+	for (long i = 0; i < portals; i++) {
+		long points, a, b;
+		if (!reader.ReadLong(points) || !reader.ReadLong(a) || !reader.ReadLong(b)) return Fail("truncated portal");
+		if (points < 3 || points > 256) return Fail("bad portal point count");
+		if (a < 0 || b < 0 || a >= clusters || b >= clusters) return Fail("portal cluster out of range");
+
+		Portal portal = {};
+		portal.clusters[0] = static_cast<int>(a);
+		portal.clusters[1] = static_cast<int>(b);
+		portal.firstPoint = static_cast<uint32_t>(m_points.size());
+		portal.pointCount = static_cast<uint32_t>(points);
+
+		for (long p = 0; p < points; p++) {
+			Vec3 point;
+			if (!reader.Expect('(') || !reader.ReadFloat(point.x) || !reader.ReadFloat(point.y) ||
+				!reader.ReadFloat(point.z) || !reader.Expect(')')) {
+				return Fail("bad portal point");
+			}
+			m_points.push_back(point);
+			portal.center.x += point.x;
+			portal.center.y += point.y;
+			portal.center.z += point.z;
+		}
+		portal.center.x /= points;
+		portal.center.y /= points;
+		portal.center.z /= points;
+
+		// Newell's method, robust for the slightly non-planar windings vbsp writes
+		const Vec3* w = &m_points[portal.firstPoint];
+		Vec3 normal = { 0, 0, 0 };
+		for (long p = 0; p < points; p++) {
+			const Vec3& c = w[p];
+			const Vec3& n = w[(p + 1) % points];
+			normal.x += (c.y - n.y) * (c.z + n.z);
+			normal.y += (c.z - n.z) * (c.x + n.x);
+			normal.z += (c.x - n.x) * (c.y + n.y);
+		}
+		float len = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		if (len > 0.0f) {
+			normal.x /= len;
+			normal.y /= len;
+			normal.z /= len;
+		}
+		portal.normal = normal;
+		portal.dist = normal.x * portal.center.x + normal.y * portal.center.y + normal.z * portal.center.z;
+
+		m_portals.push_back(portal);
+		linkCounts[a]++;
+		linkCounts[b]++;
+	}
+
+	// Adjacency as one flat array per cluster
+	m_linkStart.assign(m_clusterCount + 1, 0);
+	for (size_t c = 0; c < m_clusterCount; c++) {
+		m_linkStart[c + 1] = m_linkStart[c] + linkCounts[c];
+	}
+	m_links.resize(m_linkStart[m_clusterCount]);
+
+	std::vector<uint32_t> fill(m_linkStart.begin(), m_linkStart.end() - 1);
+	for (uint32_t i = 0; i < m_portals.size(); i++) {
+		const Portal& portal = m_portals[i];
+		m_links[fill[portal.clusters[0]]++] = { i, portal.clusters[1] };
+		m_links[fill[portal.clusters[1]]++] = { i, portal.clusters[0] };
+	}
+
+	return true;
+}
+
+const PortalGraph::Link* PortalGraph::GetLinks(int cluster, size_t& count) const {
+	if (cluster < 0 || static_cast<size_t>(cluster) >= m_clusterCount) {
+		count = 0;
+		return nullptr;
+	}
+
+	count = m_linkStart[cluster + 1] - m_linkStart[cluster];
+	return m_links.data() + m_linkStart[cluster];
+}
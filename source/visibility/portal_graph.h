@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cluster/portal graph from a vbsp .prt file (PRT1).
+//
+//   PRT1
+//   <clusters>
+//   <portals>
+//   <points> <cluster a> <cluster b> (x y z ) (x y z ) ...
+//
+// Cluster numbers are the vis clusters of the compiled BSP.
+class PortalGraph {
+public:
+	struct Vec3 {
+		float x, y, z;
+	};
+
+	struct Portal {
+		int clusters[2];
+		uint32_t firstPoint;
+		uint32_t pointCount;
+		Vec3 normal; // plane of the winding
+		float dist;
+		Vec3 center;
+	};
+
+	// One side of a portal as seen from a cluster
+	struct Link {
+		uint32_t portal;
+		int neighbor;
+	};
+
+	bool Load(const char* text, size_t length);
+	void Clear();
+
+	bool IsLoaded() const { return !m_portals.empty(); }
+	const std::string& GetError() const { return m_error; }
+
+	size_t GetClusterCount() const { return m_clusterCount; }
+	const std::vector<Portal>& GetPortals() const { return m_portals; }
+	const Vec3* GetPoints(const Portal& portal) const { return &m_points[portal.firstPoint]; }
+
+	// Portals leading out of a cluster
+	const Link* GetLinks(int cluster, size_t& count) const;
+
+private:
+	bool Fail(const char* error);
+
+	size_t m_clusterCount = 0;
+	std::vector<Portal> m_portals;
+	std::vector<Vec3> m_points;
+	std::vector<uint32_t> m_linkStart; // m_clusterCount + 1 offsets into m_links
+	std::vector<Link> m_links;
+	std::string m_error;
+};
@@ -0,0 +1,285 @@
+#include "portal_visibility.h"
+#include "map_visibility.h"
+#include <tier0/dbg.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+namespace {
+	// Limits on the flood, past them the camera PVS is used as is
+	constexpr int kMaxDepth = 1024;
+	constexpr size_t kMaxPortalTests = 200000;
+	// Each extra path into a cluster can only widen what is seen through it,
+	// a few are enough in practice and keep the flood from going exponential
+	constexpr uint8_t kMaxVisits = 8;
+
+	// Slack so entities on the screen edge and the fov lerp don't pop
+	constexpr float kFovMarginDegrees = 5.0f;
+	// Every plane goes through the eye, so the slack a point gets is
+	// proportional to its distance, 0.1 units at 1000. A fixed one would
+	// open up a portal right in front of the eye by degrees, and every
+	// portal after it inherits that.
+	constexpr float kClipSlope = 1e-4f;
+	// Sine of the smallest angle an edge, or the opening from the centre of a
+	// clipped winding to its edges, can span. A winding clipped down to a
+	// sliver has no inside to face the next frustum's planes towards, and
+	// nothing shows through it anyway.
+	constexpr float kMinOpening = 1e-4f;
+	constexpr float kOnPlaneEpsilon = 1.0f;
+	// Past this the camera has moved on, the set is not trusted any more
+	constexpr double kMaxAgeSeconds = 0.5;
+	// A camera this close to the last flow's keeps its result. Turning only
+	// moves the view planes, which the fov margin covers many times over.
+	// Moving shifts every plane built from a portal, so that has to stay
+	// well inside the clip slack.
+	constexpr float kReuseDistance = 0.1f;
+	constexpr float kReuseCosine = 0.99999f; // about a quarter of a degree
+
+	using Vec3 = PortalGraph::Vec3;
+
+	float Dot(const float a[3], const Vec3& b) {
+		return a[0] * b.x + a[1] * b.y + a[2] * b.z;
+	}
+
+	float Distance(const float a[3], const Vec3& b) {
+		float x = b.x - a[0], y = b.y - a[1], z = b.z - a[2];
+		return sqrtf(x * x + y * y + z * z);
+	}
+
+	float Dot(const float a[3], const float b[3]) {
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	bool IsSameView(const PortalVisibility::View& a, const PortalVisibility::View& b) {
+		float offset[3] = { a.origin[0] - b.origin[0], a.origin[1] - b.origin[1], a.origin[2] - b.origin[2] };
+		return Dot(offset, offset) < kReuseDistance * kReuseDistance && Dot(a.forward, b.forward) > kReuseCosine &&
+			Dot(a.up, b.up) > kReuseCosine && a.fov == b.fov && a.aspect == b.aspect;
+	}
+}
+
+PortalVisibility& PortalVisibility::Instance() {
+	static PortalVisibility instance;
+	return instance;
+}
+
+void PortalVisibility::Clear() {
+	m_graph.Clear();
+	m_visible.Resize(0);
+	m_onPath.clear();
+	m_visits.clear();
+	m_pvs = nullptr;
+	m_cameraCluster = -1;
+	m_stats = Stats();
+	m_valid = false;
+}
+
+bool PortalVisibility::Load(const char* text, size_t length) {
+	Clear();
+
+	if (!m_graph.Load(text, length)) {
+		Warning("[Visibility] Failed to load portals: %s\n", m_graph.GetError().c_str());
+		return false;
+	}
+
+	size_t clusters = m_graph.GetClusterCount();
+	m_visible.Resize(clusters);
+	m_onPath.assign(clusters, 0);
+	m_visits.assign(clusters, 0);
+	m_frusta.resize(kMaxDepth + 2);
+
+	Msg("[Visibility] Loaded %u portals between %u clusters\n", static_cast<unsigned>(m_graph.GetPortals().size()),
+		static_cast<unsigned>(clusters));
+	return true;
+}
+
+size_t PortalVisibility::Update(const View& view) {
+	// The graph has to belong to the loaded BSP, the camera cluster comes from it
+	const MapVisibility& visibility = MapVisibility::Instance();
+	if (!visibility.IsLoaded() || (visibility.GetClusterCount() && visibility.GetClusterCount() != m_graph.GetClusterCount())) {
+		m_stats = Stats();
+		m_valid = false;
+		m_view = view;
+		return 0;
+	}
+
+	int cameraCluster = visibility.FindCluster(view.origin);
+	return Update(view, cameraCluster, visibility.GetPVS(cameraCluster));
+}
+
+size_t PortalVisibility::Update(const View& view, int cameraCluster, const uint64_t* pvs) {
+	auto start = std::chrono::steady_clock::now();
+
+	// The flood is 1.3 ms on average on flatgrass and 5 at the 99th
+	// percentile, skip it while the camera stands still
+	if (m_valid && cameraCluster == m_cameraCluster && pvs == m_pvs && IsSameView(view, m_view)) {
+		m_updated = start;
+		m_stats.reused = true;
+		m_stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return m_stats.clustersVisible;
+	}
+
+	m_stats = Stats();
+	m_valid = false;
+	m_view = view;
+	if (!IsLoaded()) return 0;
+
+	size_t clusters = m_graph.GetClusterCount();
+	if (cameraCluster < 0 || static_cast<size_t>(cameraCluster) >= clusters) return 0;
+
+	m_visible.Clear();
+	std::fill(m_visits.begin(), m_visits.end(), 0);
+	m_pvs = pvs;
+	m_cameraCluster = cameraCluster;
+
+	// View frustum, side planes only and all through the eye
+	std::vector<FrustumPlane>& frustum = m_frusta[0];
+	frustum.resize(4);
+	BuildViewFrustum(view.origin, view.forward, view.right, view.up, view.fov, view.aspect, kFovMarginDegrees, frustum.data());
+
+	Flow(cameraCluster, frustum.data(), frustum.size(), 0);
+
+	if (m_stats.truncated) {
+		// Never show less than the engine would
+		if (m_pvs) {
+			m_visible.Or(m_pvs);
+		} else {
+			m_visible.SetAll();
+		}
+	}
+
+	m_valid = true;
+	m_updated = std::chrono::steady_clock::now();
+	m_stats.clustersVisible = m_visible.Count();
+	m_stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return m_stats.clustersVisible;
+}
+
+void PortalVisibility::Flow(int cluster, const FrustumPlane* frustum, size_t planeCount, int depth) {
+	m_visible.Set(cluster);
+	if (m_stats.truncated) return;
+	if (depth >= kMaxDepth) {
+		m_stats.truncated = true;
+		return;
+	}
+
+	m_onPath[cluster] = 1;
+
+	size_t linkCount;
+	const PortalGraph::Link* links = m_graph.GetLinks(cluster, linkCount);
+	const std::vector<PortalGraph::Portal>& portals = m_graph.GetPortals();
+	const float* eye = m_view.origin;
+
+	for (size_t i = 0; i < linkCount && !m_stats.truncated; i++) {
+		int neighbor = links[i].neighbor;
+		if (m_onPath[neighbor] || m_visits[neighbor] >= kMaxVisits) continue;
+		if (m_pvs && !((m_pvs[neighbor >> 6] >> (neighbor & 63)) & 1)) continue;
+
+		if (++m_stats.portalsTested > kMaxPortalTests) {
+			m_stats.truncated = true;
+			break;
+		}
+
+		const PortalGraph::Portal& portal = portals[links[i].portal];
+
+		// Standing in the portal, it can't narrow anything
+		if (fabsf(Dot(eye, portal.normal) - portal.dist) < kOnPlaneEpsilon) {
+			m_stats.portalsPassed++;
+			m_visits[neighbor]++;
+			Flow(neighbor, frustum, planeCount, depth + 1);
+			continue;
+		}
+
+		if (!ClipPortal(portal, frustum, planeCount)) continue;
+
+		// New frustum: one plane through the eye per edge of what is left of
+		// the winding, facing its centre
+		Vec3 center = { 0, 0, 0 };
+		for (const Vec3& p : m_clipA) {
+			center.x += p.x;
+			center.y += p.y;
+			center.z += p.z;
+		}
+		float inv = 1.0f / m_clipA.size();
+		center = { center.x * inv - eye[0], center.y * inv - eye[1], center.z * inv - eye[2] };
+		float centerLength = sqrtf(center.x * center.x + center.y * center.y + center.z * center.z);
+
+		std::vector<FrustumPlane>& next = m_frusta[depth + 1];
+		next.clear();
+		bool sliver = false;
+		for (size_t p = 0; p < m_clipA.size() && !sliver; p++) {
+			const Vec3& a = m_clipA[p];
+			const Vec3& b = m_clipA[(p + 1) % m_clipA.size()];
+			float ax = a.x - eye[0], ay = a.y - eye[1], az = a.z - eye[2];
+			float bx = b.x - eye[0], by = b.y - eye[1], bz = b.z - eye[2];
+
+			FrustumPlane plane;
+			plane.normal[0] = ay * bz - az * by;
+			plane.normal[1] = az * bx - ax * bz;
+			plane.normal[2] = ax * by - ay * bx;
+			float len = sqrtf(plane.normal[0] * plane.normal[0] + plane.normal[1] * plane.normal[1] + plane.normal[2] * plane.normal[2]);
+			// Edges too short to see from here, left by the clip epsilon
+			if (len < kMinOpening * sqrtf((ax * ax + ay * ay + az * az) * (bx * bx + by * by + bz * bz))) continue;
+
+			float side = Dot(plane.normal, center) / len;
+			if (fabsf(side) < kMinOpening * centerLength) sliver = true;
+
+			float sign = side < 0.0f ? -1.0f : 1.0f;
+			for (float& n : plane.normal) n *= sign / len;
+			plane.dist = plane.normal[0] * eye[0] + plane.normal[1] * eye[1] + plane.normal[2] * eye[2];
+			next.push_back(plane);
+		}
+		if (sliver || next.size() < 3) continue;
+
+		// Planes rebuilt from clipped windings drift a little at every step,
+		// down a long path that adds up to degrees. Keeping the view's own
+		// planes stops anything outside the view from getting through.
+		next.insert(next.end(), m_frusta[0].begin(), m_frusta[0].end());
+
+		m_stats.portalsPassed++;
+		m_visits[neighbor]++;
+		Flow(neighbor, next.data(), next.size(), depth + 1);
+	}
+
+	m_onPath[cluster] = 0;
+}
+
+bool PortalVisibility::ClipPortal(const PortalGraph::Portal& portal, const FrustumPlane* frustum, size_t planeCount) {
+	const Vec3* points = m_graph.GetPoints(portal);
+	m_clipA.assign(points, points + portal.pointCount);
+	const float* eye = m_view.origin;
+
+	// Sutherland-Hodgman, one frustum plane at a time
+	for (size_t p = 0; p < planeCount && !m_clipA.empty(); p++) {
+		const FrustumPlane& plane = frustum[p];
+		m_clipB.clear();
+
+		size_t count = m_clipA.size();
+		for (size_t i = 0; i < count; i++) {
+			const Vec3& a = m_clipA[i];
+			const Vec3& b = m_clipA[(i + 1) % count];
+			// Against the plane opened up by the slack, the cut has to be
+			// made where the test changes or it lands outside the edge
+			float da = Dot(plane.normal, a) - plane.dist + kClipSlope * Distance(eye, a);
+			float db = Dot(plane.normal, b) - plane.dist + kClipSlope * Distance(eye, b);
+
+			if (da >= 0.0f) m_clipB.push_back(a);
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				float t = da / (da - db);
+				m_clipB.push_back({ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t });
+			}
+		}
+		std::swap(m_clipA, m_clipB);
+	}
+
+	return m_clipA.size() >= 3;
+}
+
+bool PortalVisibility::IsValid() const {
+	return m_valid && std::chrono::duration<double>(std::chrono::steady_clock::now() - m_updated).count() < kMaxAgeSeconds;
+}
+
+bool PortalVisibility::IsClusterVisible(int cluster) const {
+	if (!IsValid() || cluster < 0 || static_cast<size_t>(cluster) >= m_visible.GetClusterCount()) return true;
+	return m_visible.Test(cluster);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "cluster_set.h"
+#include "portal_graph.h"
+#include "view_frustum.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Camera dependent cluster visibility from the map's portal graph.
+//
+// The PVS answers "could anything in cluster B ever be seen from cluster A",
+// which is far too generous once you are standing in a room looking at a
+// wall. Update() instead floods out from the camera cluster and only steps
+// through a portal if its winding survives clipping against the view
+// frustum, narrowing the frustum to the clipped winding at every step. The
+// result is a subset of the PVS that the entity and light culling can share.
+class PortalVisibility {
+public:
+	struct View {
+		float origin[3];
+		float forward[3];
+		float right[3];
+		float up[3];
+		float fov;    // engine fov, horizontal at 4:3
+		float aspect; // width / height
+	};
+
+	struct Stats {
+		size_t portalsTested = 0;
+		size_t portalsPassed = 0;
+		size_t clustersVisible = 0;
+		bool truncated = false; // hit the work limit, fell back to the PVS
+		bool reused = false;    // same view as the last flow, its result was kept
+		double milliseconds = 0.0;
+	};
+
+	static PortalVisibility& Instance();
+
+	bool Load(const char* text, size_t length);
+	void Clear();
+
+	bool IsLoaded() const { return m_graph.IsLoaded(); }
+	const PortalGraph& GetGraph() const { return m_graph; }
+
+	// Rebuilds the visible set for this view, returns the visible cluster count.
+	// A view that has not moved since the last flow keeps its result.
+	size_t Update(const View& view);
+	// Same from a camera cluster and PVS row already known, pvs may be null
+	size_t Update(const View& view, int cameraCluster, const uint64_t* pvs);
+
+	// Unknown clusters and a stale or missing update count as visible, same
+	// as MapVisibility
+	bool IsClusterVisible(int cluster) const;
+	// Updated within the last half second
+	bool IsValid() const;
+
+	const float* GetViewOrigin() const { return m_view.origin; }
+	const ClusterSet& GetVisibleClusters() const { return m_visible; }
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	PortalVisibility() = default;
+
+	void Flow(int cluster, const FrustumPlane* frustum, size_t planeCount, int depth);
+	// Clips the portal winding into m_clipA, false if nothing is left
+	bool ClipPortal(const PortalGraph::Portal& portal, const FrustumPlane* frustum, size_t planeCount);
+
+	PortalGraph m_graph;
+	ClusterSet m_visible;
+	std::vector<uint8_t> m_onPath; // stops cycles
+	std::vector<uint8_t> m_visits; // bounds the paths into one cluster
+	const uint64_t* m_pvs = nullptr;
+	int m_cameraCluster = -1;
+	View m_view = {};
+	Stats m_stats;
+	bool m_valid = false;
+	std::chrono::steady_clock::time_point m_updated;
+
+	// Per depth scratch, reused across updates
+	std::vector<std::vector<FrustumPlane>> m_frusta;
+	std::vector<PortalGraph::Vec3> m_clipA;
+	std::vector<PortalGraph::Vec3> m_clipB;
+};
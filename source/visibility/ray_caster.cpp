@@ -0,0 +1,186 @@
+#include "ray_caster.h"
+#include "bsp_file.h"
+#include <algorithm>
+
+namespace {
+	// Brush faces are pulled back by this much, same as the engine
+	constexpr float kDistEpsilon = 0.03125f;
+
+	float Dot(const float a[3], const float b[3]) {
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+}
+
+float RayCaster::ClipBrush(const BSPFile& bsp, int brushIndex, const float delta[3]) const {
+	const BSPFile::Brush& brush = bsp.GetBrushes()[brushIndex];
+	const std::vector<BSPFile::BrushSide>& sides = bsp.GetBrushSides();
+	const std::vector<BSPFile::Plane>& planes = bsp.GetPlanes();
+	if (brush.firstSide < 0 || brush.numSides <= 0 || static_cast<size_t>(brush.firstSide) + brush.numSides > sides.size()) return 1.0f;
+
+	float enter = -1.0f;
+	float exit = 1.0f;
+	bool startOut = false;
+
+	for (int i = 0; i < brush.numSides; i++) {
+		const BSPFile::BrushSide& side = sides[brush.firstSide + i];
+
+		// Bevels only matter to box traces
+		if (side.bevel) continue;
+		if (side.planeNum >= planes.size()) continue;
+
+		const BSPFile::Plane& plane = planes[side.planeNum];
+		float d1 = Dot(plane.normal, m_origin) - plane.dist;
+		float d2 = d1 + Dot(plane.normal, delta);
+
+		if (d1 > 0.0f) startOut = true;
+
+		// Completely in front of this face, can't touch the brush
+		if (d1 > 0.0f && (d2 >= kDistEpsilon || d2 >= d1)) return 1.0f;
+		if (d1 <= 0.0f && d2 <= 0.0f) continue;
+
+		if (d1 > d2) {
+			float f = (d1 - kDistEpsilon) / (d1 - d2);
+			if (f > enter) enter = f;
+		} else {
+			float f = (d1 + kDistEpsilon) / (d1 - d2);
+			if (f < exit) exit = f;
+		}
+	}
+
+	// Started inside, the trace goes nowhere
+	if (!startOut) return 0.0f;
+	if (enter > -1.0f && enter < exit) return (std::max)(enter, 0.0f);
+	return 1.0f;
+}
+
+void RayCaster::TestLeaf(const BSPFile& bsp, int leafIndex, uint32_t begin, uint32_t end, int32_t mask) {
+	if (leafIndex < 0 || static_cast<size_t>(leafIndex) >= bsp.GetLeafs().size()) return;
+	const BSPFile::Leaf& leaf = bsp.GetLeafs()[leafIndex];
+
+	// Structural solid, the ray stops where it entered the leaf
+	if (leaf.contents & mask) {
+		for (uint32_t i = begin; i < end; i++) {
+			const Segment& segment = m_segments[i];
+			m_hits[segment.ray] = (std::min)(m_hits[segment.ray], segment.t0);
+		}
+		return;
+	}
+
+	// Detail brushes don't split the tree, they are only listed in the leafs
+	const std::vector<uint16_t>& leafBrushes = bsp.GetLeafBrushes();
+	const std::vector<BSPFile::Brush>& brushes = bsp.GetBrushes();
+	for (uint32_t k = 0; k < leaf.numLeafBrushes; k++) {
+		size_t slot = static_cast<size_t>(leaf.firstLeafBrush) + k;
+		if (slot >= leafBrushes.size()) break;
+
+		int brush = leafBrushes[slot];
+		if (static_cast<size_t>(brush) >= brushes.size() || !(brushes[brush].contents & mask)) continue;
+
+		for (uint32_t i = begin; i < end; i++) {
+			uint32_t ray = m_segments[i].ray;
+			float hit = ClipBrush(bsp, brush, &m_deltas[ray * 3]);
+			if (hit < m_hits[ray]) m_hits[ray] = hit;
+		}
+	}
+}
+
+void RayCaster::Cast(const BSPFile& bsp, const float origin[3], const float (*deltas)[3], size_t count, int32_t mask, float* fractions) {
+	for (size_t i = 0; i < count; i++) fractions[i] = 1.0f;
+	if (count == 0 || bsp.GetModels().empty() || bsp.GetNodes().empty()) return;
+
+	const std::vector<BSPFile::Node>& nodes = bsp.GetNodes();
+	const std::vector<BSPFile::Plane>& planes = bsp.GetPlanes();
+
+	m_origin[0] = origin[0];
+	m_origin[1] = origin[1];
+	m_origin[2] = origin[2];
+	m_deltas.resize(count * 3);
+	for (size_t i = 0; i < count; i++) {
+		m_deltas[i * 3 + 0] = deltas[i][0];
+		m_deltas[i * 3 + 1] = deltas[i][1];
+		m_deltas[i * 3 + 2] = deltas[i][2];
+	}
+	m_hits.assign(count, 1.0f);
+
+	m_segments.clear();
+	for (size_t i = 0; i < count; i++) m_segments.push_back({ static_cast<uint32_t>(i), 0.0f, 1.0f });
+
+	m_stack.clear();
+	m_stack.push_back({ bsp.GetModels()[0].headNode, 0, static_cast<uint32_t>(count) });
+
+	while (!m_stack.empty()) {
+		Entry entry = m_stack.back();
+		m_stack.pop_back();
+
+		// The entry on top owns the tail of the pool, whatever is past it
+		// belonged to entries that are finished
+		m_segments.resize(entry.end);
+
+		// Anything starting behind a hit found since this was pushed is done
+		uint32_t end = entry.begin;
+		for (uint32_t i = entry.begin; i < entry.end; i++) {
+			Segment segment = m_segments[i];
+			float hit = m_hits[segment.ray];
+			if (segment.t0 >= hit) continue;
+			segment.t1 = (std::min)(segment.t1, hit);
+			m_segments[end++] = segment;
+		}
+		if (end == entry.begin) continue;
+
+		if (entry.node < 0) {
+			TestLeaf(bsp, -1 - entry.node, entry.begin, end, mask);
+			continue;
+		}
+		if (static_cast<size_t>(entry.node) >= nodes.size()) continue;
+
+		const BSPFile::Node& node = nodes[entry.node];
+		if (static_cast<size_t>(node.planeNum) >= planes.size()) continue;
+		const BSPFile::Plane& plane = planes[node.planeNum];
+
+		// Shared by the whole packet
+		float dStart = Dot(plane.normal, m_origin) - plane.dist;
+		int nearSide = dStart >= 0.0f ? 0 : 1;
+
+		// Far parts go straight onto the pool, near parts after them so the
+		// near child ends up on top
+		m_segments.resize(end);
+		m_near.clear();
+		uint32_t farBegin = end;
+		for (uint32_t i = entry.begin; i < end; i++) {
+			Segment segment = m_segments[i];
+			float dd = Dot(plane.normal, &m_deltas[segment.ray * 3]);
+			int side0 = dStart + segment.t0 * dd >= 0.0f ? 0 : 1;
+			int side1 = dStart + segment.t1 * dd >= 0.0f ? 0 : 1;
+
+			if (side0 == side1) {
+				if (side0 == nearSide) {
+					m_near.push_back(segment);
+				} else {
+					m_segments.push_back(segment);
+				}
+				continue;
+			}
+
+			// Crosses the plane, each side gets its part
+			float cross = (std::min)((std::max)(-dStart / dd, segment.t0), segment.t1);
+			Segment first = { segment.ray, segment.t0, cross };
+			Segment second = { segment.ray, cross, segment.t1 };
+			if (side0 == nearSide) {
+				m_near.push_back(first);
+				m_segments.push_back(second);
+			} else {
+				m_near.push_back(second);
+				m_segments.push_back(first);
+			}
+		}
+
+		uint32_t farEnd = static_cast<uint32_t>(m_segments.size());
+		m_segments.insert(m_segments.end(), m_near.begin(), m_near.end());
+		uint32_t nearEnd = static_cast<uint32_t>(m_segments.size());
+
+		if (farEnd > farBegin) m_stack.push_back({ node.children[1 - nearSide], farBegin, farEnd });
+		if (nearEnd > farEnd) m_stack.push_back({ node.children[nearSide], farEnd, nearEnd });
+	}
+
+	for (size_t i = 0; i < count; i++) fractions[i] = m_hits[i];
+}
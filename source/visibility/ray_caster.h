@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BSPFile;
+
+// Casts a fan of rays from one origin against the world model's brushes.
+//
+// The rays go down the node tree as one packet. The origin's distance to
+// each plane is shared, so a node costs one dot product plus one per ray,
+// and the packet is split into the part of each ray in front of and behind
+// the plane. The origin's side is walked first and every ray keeps its
+// closest hit, so far segments behind a hit are dropped when they come off
+// the stack. Leafs test their brushes like the engine's point traces.
+// Displacements and entities are not hit.
+class RayCaster {
+public:
+	// CONTENTS_SOLID | WINDOW | GRATE | MOVEABLE | MONSTER
+	static constexpr int32_t kMaskSolid = 0x200400B;
+
+	// Ray i runs from origin to origin + deltas[i], fractions[i] receives
+	// how far along it the first brush in mask is, 1 when nothing is hit
+	void Cast(const BSPFile& bsp, const float origin[3], const float (*deltas)[3], size_t count, int32_t mask, float* fractions);
+
+private:
+	struct Segment {
+		uint32_t ray;
+		float t0;
+		float t1;
+	};
+
+	struct Entry {
+		int node;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	void TestLeaf(const BSPFile& bsp, int leaf, uint32_t begin, uint32_t end, int32_t mask);
+	float ClipBrush(const BSPFile& bsp, int brush, const float delta[3]) const;
+
+	float m_origin[3];
+	std::vector<float> m_deltas; // 3 per ray
+	std::vector<float> m_hits;
+	std::vector<Segment> m_segments; // every live entry's range, the top one last
+	std::vector<Segment> m_near;
+	std::vector<Entry> m_stack;
+};
@@ -0,0 +1,536 @@
+#include "render_bounds_updater.h"
+#include "lua_entity.h"
+#include "map_visibility.h"
+#include "occlusion_culler.h"
+#include "portal_visibility.h"
+#include "GarrysMod/Lua/Interface.h"
+#include "mathlib/vector.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace GarrysMod::Lua;
+
+const float RenderBoundsUpdater::kTierDistanceSqr[kTierCount] = {
+	256.0f * 256.0f, 512.0f * 512.0f, 1024.0f * 1024.0f, 2048.0f * 2048.0f, 4096.0f * 4096.0f
+};
+
+namespace {
+	// Entity field holding a clientside static prop's PropBounds slot, 1 based
+	const char* const kPropSlotField = "RTXBoundsSlot";
+
+	const char* const kLightUpdaterModels[] = {
+		"models/hunter/plates/plate.mdl",
+		"models/hunter/blocks/cube025x025x025.mdl",
+	};
+
+	struct Settings {
+		double time = 0.0;
+		float boundsSize = 10000.0f;
+		bool staticProps = true;
+		bool pvs = true;
+		float radius = 512.0f;
+		float minRadius = 512.0f;
+		bool openArea = false;
+		bool portalFlow = false;
+		bool corridor = false;
+		float moveThreshold = 32.0f;
+		bool occlusion = false;
+		Vector origin;
+		Vector aim;
+		float frequencies[RenderBoundsUpdater::kTierCount] = { 0.1f, 0.25f, 0.5f, 1.0f, 2.0f };
+	};
+
+	double GetNumberField(ILuaBase* LUA, int table, const char* name, double fallback) {
+		LUA->GetField(table, name);
+		double value = LUA->IsType(-1, Type::Number) ? LUA->GetNumber(-1) : fallback;
+		LUA->Pop();
+		return value;
+	}
+
+	bool GetBoolField(ILuaBase* LUA, int table, const char* name, bool fallback) {
+		LUA->GetField(table, name);
+		bool value = LUA->IsType(-1, Type::Bool) ? LUA->GetBool(-1) : fallback;
+		LUA->Pop();
+		return value;
+	}
+
+	Vector GetVectorField(ILuaBase* LUA, int table, const char* name) {
+		LUA->GetField(table, name);
+		Vector value = LUA->IsType(-1, Type::Vector) ? LUA->GetVector(-1) : Vector(0, 0, 0);
+		LUA->Pop();
+		return value;
+	}
+
+	Settings ReadSettings(ILuaBase* LUA, int table) {
+		Settings settings;
+		settings.time = GetNumberField(LUA, table, "time", 0.0);
+		settings.boundsSize = static_cast<float>(GetNumberField(LUA, table, "boundsSize", settings.boundsSize));
+		settings.staticProps = GetBoolField(LUA, table, "staticProps", settings.staticProps);
+		settings.pvs = GetBoolField(LUA, table, "pvs", settings.pvs);
+		settings.radius = static_cast<float>(GetNumberField(LUA, table, "radius", settings.radius));
+		settings.minRadius = static_cast<float>(GetNumberField(LUA, table, "minRadius", settings.minRadius));
+		settings.openArea = GetBoolField(LUA, table, "openArea", false);
+		settings.portalFlow = GetBoolField(LUA, table, "portalFlow", false);
+		settings.corridor = GetBoolField(LUA, table, "corridor", false);
+		settings.moveThreshold = static_cast<float>(GetNumberField(LUA, table, "moveThreshold", settings.moveThreshold));
+		settings.occlusion = GetBoolField(LUA, table, "occlusion", false);
+		settings.origin = GetVectorField(LUA, table, "origin");
+		settings.aim = GetVectorField(LUA, table, "aim");
+
+		LUA->GetField(table, "frequencies");
+		if (LUA->IsType(-1, Type::Table)) {
+			int frequencies = LUA->Top();
+			for (int i = 0; i < RenderBoundsUpdater::kTierCount; i++) {
+				LUA->PushNumber(i + 1);
+				LUA->GetTable(frequencies);
+				if (LUA->IsType(-1, Type::Number)) settings.frequencies[i] = static_cast<float>(LUA->GetNumber(-1));
+				LUA->Pop();
+			}
+		}
+		LUA->Pop();
+		return settings;
+	}
+
+	// ent:SetRenderBounds with two Vectors already on top of the stack
+	void SetRenderBounds(ILuaBase* LUA, int ent) {
+		LUA->GetField(ent, "SetRenderBounds");
+		LUA->Push(ent);
+		LUA->Push(-4);
+		LUA->Push(-4);
+		if (LUA->PCall(3, 0, 0) != 0) LUA->Pop();
+		LUA->Pop(2);
+	}
+
+	void SetRenderBounds(ILuaBase* LUA, int ent, int settings, const char* mins, const char* maxs) {
+		LUA->GetField(settings, mins);
+		LUA->GetField(settings, maxs);
+		SetRenderBounds(LUA, ent);
+	}
+
+	bool IsLightUpdaterModel(const char* model) {
+		if (!model) return false;
+		for (const char* updater : kLightUpdaterModels) {
+			if (strcmp(model, updater) == 0) return true;
+		}
+		return false;
+	}
+
+	// ShouldRenderEntity from the frustum script, the nearby leaf list is the
+	// smart radius sphere. cluster comes from the cluster index.
+	bool ShouldRender(const Settings& settings, const Vector& pos, int cluster) {
+		if (!settings.pvs) return true;
+		if (cluster < 0) return true;
+
+		const MapVisibility& visibility = MapVisibility::Instance();
+
+		Vector toEnt = pos - settings.origin;
+		float distSqr = toEnt.LengthSqr();
+		float dist = sqrtf(distSqr);
+		float dot = dist > 0.0f ? settings.aim.Dot(toEnt) / dist : 1.0f;
+
+		// More lenient in corridors
+		if (settings.corridor && dot > -0.7f) return true;
+
+		if (visibility.IsClusterVisible(cluster) &&
+			(!settings.portalFlow || PortalVisibility::Instance().IsClusterVisible(cluster))) {
+			return true;
+		}
+
+		if (distSqr <= settings.radius * settings.radius) {
+			if (settings.openArea) {
+				return dot > -0.5f || distSqr < settings.minRadius * settings.minRadius;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// Behind the world in this frame's occlusion buffer. Anything without
+	// bounds, or tested against a stale buffer, is not occluded.
+	bool IsOccluded(ILuaBase* LUA, int ent) {
+		OcclusionCuller& culler = OcclusionCuller::Instance();
+		if (!culler.IsValid()) return false;
+
+		int base = LUA->Top();
+		bool occluded = false;
+		if (CallEntityMethod(LUA, ent, "WorldSpaceAABB", 2) && LUA->IsType(-2, Type::Vector) && LUA->IsType(-1, Type::Vector)) {
+			Vector mins = LUA->GetVector(-2);
+			Vector maxs = LUA->GetVector(-1);
+			float boxMins[3] = { mins.x, mins.y, mins.z };
+			float boxMaxs[3] = { maxs.x, maxs.y, maxs.z };
+			occluded = !culler.IsBoxVisible(boxMins, boxMaxs);
+		}
+		LUA->Pop(LUA->Top() - base);
+		return occluded;
+	}
+
+	enum class Verdict { Visible, Hidden, Occluded };
+
+	Verdict Decide(ILuaBase* LUA, int ent, const Settings& settings, const Vector& pos, int cluster) {
+		if (!ShouldRender(settings, pos, cluster)) return Verdict::Hidden;
+		if (settings.occlusion && IsOccluded(LUA, ent)) return Verdict::Occluded;
+		return Verdict::Visible;
+	}
+
+	// Hidden, model scaled or huge bounds depending on ShouldRender and the
+	// occlusion test, true if visible
+	bool ApplyBounds(ILuaBase* LUA, int ent, int settingsTable, const Settings& settings, const Vector& pos, int cluster, bool isStaticProp,
+		bool* occluded = nullptr) {
+		Verdict verdict = Decide(LUA, ent, settings, pos, cluster);
+		if (verdict != Verdict::Visible) {
+			SetRenderBounds(LUA, ent, settingsTable, "hiddenMins", "hiddenMaxs");
+			if (occluded && verdict == Verdict::Occluded) *occluded = true;
+			return false;
+		}
+
+		if (isStaticProp) {
+			// Model bounds scaled by the bounds size, left alone if there are none
+			if (CallEntityMethod(LUA, ent, "GetModelBounds", 2) && LUA->IsType(-2, Type::Vector) && LUA->IsType(-1, Type::Vector)) {
+				Vector mins = LUA->GetVector(-2) * settings.boundsSize;
+				Vector maxs = LUA->GetVector(-1) * settings.boundsSize;
+				LUA->PushVector(mins);
+				LUA->PushVector(maxs);
+				SetRenderBounds(LUA, ent);
+			}
+		} else {
+			SetRenderBounds(LUA, ent, settingsTable, "hugeMins", "hugeMaxs");
+		}
+		return true;
+	}
+
+	// Entity(index), nothing pushed if it is not a valid entity
+	bool PushEntity(ILuaBase* LUA, int index) {
+		int base = LUA->Top();
+		LUA->PushSpecial(SPECIAL_GLOB);
+		LUA->GetField(-1, "Entity");
+		LUA->PushNumber(index);
+		if (LUA->PCall(1, 1, 0) != 0 || !LUA->IsType(-1, Type::Entity)) {
+			LUA->Pop(LUA->Top() - base);
+			return false;
+		}
+
+		LUA->Remove(-2);
+		int ent = LUA->Top();
+		bool valid = CallEntityMethod(LUA, ent, "IsValid", 1) && LUA->GetBool(-1);
+		LUA->Pop(LUA->Top() - ent);
+		if (!valid) LUA->Pop();
+		return valid;
+	}
+}
+
+RenderBoundsUpdater& RenderBoundsUpdater::Instance() {
+	static RenderBoundsUpdater instance;
+	return instance;
+}
+
+int RenderBoundsUpdater::GetTier(float distSqr) {
+	for (int tier = 0; tier < kTierCount; tier++) {
+		if (distSqr <= kTierDistanceSqr[tier]) return tier;
+	}
+	return kTierCount - 1;
+}
+
+void RenderBoundsUpdater::Reset() {
+	// Props keep their slots, only what was set on them is forgotten
+	for (PropBounds& prop : m_props) prop.applied = -1;
+
+	m_schedule.Reset(0.0);
+	m_due.clear();
+	m_lastTime = 0.0;
+	m_index.Clear();
+	m_visible.Resize(0);
+	m_decided.clear();
+	m_pass = 0;
+}
+
+void RenderBoundsUpdater::Forget(int index) {
+	if (index <= 0) return;
+	m_schedule.Cancel(static_cast<uint32_t>(index));
+	m_index.Remove(static_cast<uint32_t>(index));
+}
+
+void RenderBoundsUpdater::ForgetProp(int slot) {
+	if (slot <= 0 || static_cast<size_t>(slot) > m_props.size() || !m_props[slot - 1].used) return;
+	m_props[slot - 1] = PropBounds();
+	m_freeProps.push_back(slot);
+}
+
+RenderBoundsUpdater::PropBounds& RenderBoundsUpdater::GetPropBounds(ILuaBase* LUA, int ent, float boundsSize) {
+	LUA->GetField(ent, kPropSlotField);
+	int slot = LUA->IsType(-1, Type::Number) ? static_cast<int>(LUA->GetNumber(-1)) : 0;
+	LUA->Pop();
+
+	if (slot <= 0 || static_cast<size_t>(slot) > m_props.size() || !m_props[slot - 1].used) {
+		if (!m_freeProps.empty()) {
+			slot = m_freeProps.back();
+			m_freeProps.pop_back();
+		} else {
+			m_props.emplace_back();
+			slot = static_cast<int>(m_props.size());
+		}
+		m_props[slot - 1].used = true;
+
+		LUA->PushNumber(slot);
+		LUA->SetField(ent, kPropSlotField);
+	}
+
+	// Model bounds scaled by the bounds size, a prop without any is left alone
+	PropBounds& prop = m_props[slot - 1];
+	if (prop.boundsSize != boundsSize) {
+		int base = LUA->Top();
+		prop.hasBounds = CallEntityMethod(LUA, ent, "GetModelBounds", 2) && LUA->IsType(-2, Type::Vector) && LUA->IsType(-1, Type::Vector);
+		if (prop.hasBounds) {
+			prop.mins = LUA->GetVector(-2) * boundsSize;
+			prop.maxs = LUA->GetVector(-1) * boundsSize;
+		}
+		LUA->Pop(LUA->Top() - base);
+		prop.boundsSize = boundsSize;
+		prop.applied = -1;
+	}
+	return prop;
+}
+
+size_t RenderBoundsUpdater::Update(ILuaBase* LUA, int entities, int settingsTable) {
+	auto start = std::chrono::steady_clock::now();
+
+	Settings settings = ReadSettings(LUA, settingsTable);
+	m_stats = Stats();
+
+	// CurTime starts over on a new map
+	if (settings.time < m_lastTime) {
+		m_schedule.Reset(settings.time);
+		for (PropBounds& prop : m_props) prop.applied = -1;
+	}
+	m_lastTime = settings.time;
+
+	m_due.clear();
+	m_schedule.Advance(settings.time, m_due);
+	m_stats.due = m_due.size();
+
+	m_candidates.clear();
+	m_ids.clear();
+	m_points.clear();
+	m_pass++;
+
+	int count = LUA->ObjLen(entities);
+	m_stats.entities = static_cast<size_t>(count);
+
+	for (int i = 1; i <= count; i++) {
+		int base = LUA->Top();
+		LUA->PushNumber(i);
+		LUA->GetTable(entities);
+		int ent = base + 1;
+
+		if (!LUA->IsType(ent, Type::Entity)) {
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+
+		// Still waiting on its tier, the index is all we need to know that.
+		// Clientside models have no index and are looked at every pass.
+		int index = CallEntityMethod(LUA, ent, "EntIndex", 1) && LUA->IsType(-1, Type::Number) ? static_cast<int>(LUA->GetNumber(-1)) : -1;
+		if (index > 0 && m_schedule.IsScheduled(static_cast<uint32_t>(index))) {
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+
+		bool noDraw = CallEntityMethod(LUA, ent, "GetNoDraw", 1) && LUA->GetBool(-1);
+		const char* className = CallEntityMethod(LUA, ent, "GetClass", 1) && LUA->IsType(-1, Type::String) ? LUA->GetString(-1) : "";
+		const char* model = CallEntityMethod(LUA, ent, "GetModel", 1) && LUA->IsType(-1, Type::String) ? LUA->GetString(-1) : nullptr;
+
+		// Hidden entities, light updaters and lights are looked at every pass
+		if (noDraw) {
+			if (index > 0) m_schedule.Schedule(static_cast<uint32_t>(index), settings.time);
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+
+		if (strcmp(className, "rtx_lightupdater") == 0 || strcmp(className, "rtx_lightupdatermanager") == 0) {
+			SetRenderBounds(LUA, ent, settingsTable, "updaterMins", "updaterMaxs");
+			m_stats.updated++;
+			if (index > 0) m_schedule.Schedule(static_cast<uint32_t>(index), settings.time);
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+		if (IsLightUpdaterModel(model)) {
+			SetRenderBounds(LUA, ent, settingsTable, "fullMins", "fullMaxs");
+			m_stats.updated++;
+			if (index > 0) m_schedule.Schedule(static_cast<uint32_t>(index), settings.time);
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+		if (strstr(className, "light")) {
+			SetRenderBounds(LUA, ent, settingsTable, "lightMins", "lightMaxs");
+			m_stats.updated++;
+			if (index > 0) m_schedule.Schedule(static_cast<uint32_t>(index), settings.time);
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+
+		Vector pos(0, 0, 0);
+		if (CallEntityMethod(LUA, ent, "GetPos", 1) && LUA->IsType(-1, Type::Vector)) pos = LUA->GetVector(-1);
+
+		// Next refresh on the entity's distance tier
+		if (index > 0) {
+			float distSqr = (pos - settings.origin).LengthSqr();
+			m_schedule.Schedule(static_cast<uint32_t>(index), settings.time + settings.frequencies[GetTier(distSqr)]);
+		}
+
+		LUA->GetField(ent, "IsStaticProp");
+		bool isStaticProp = LUA->GetBool(-1);
+		if ((isStaticProp && !settings.staticProps) || !model || !*model) {
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+
+		// Decided below, once every position has a cluster
+		m_candidates.push_back({ i, index, pos, isStaticProp });
+		if (index > 0) {
+			m_ids.push_back(static_cast<uint32_t>(index));
+			m_points.push_back({ pos.x, pos.y, pos.z });
+		}
+		LUA->Pop(LUA->Top() - base);
+	}
+
+	const MapVisibility& visibility = MapVisibility::Instance();
+
+	// Indexed entities keep their cluster until they move, clientside ones
+	// have nothing to key it on and are looked up each time
+	m_clusters.assign(m_candidates.size(), -1);
+	if (settings.pvs && !m_candidates.empty()) {
+		m_indexedClusters.assign(m_ids.size(), -1);
+		m_stats.reclassified = m_index.Update(m_ids.data(), reinterpret_cast<const float(*)[3]>(m_points.data()), m_ids.size(),
+			settings.moveThreshold, m_indexedClusters.data());
+
+		size_t indexed = 0;
+		for (size_t c = 0; c < m_candidates.size(); c++) {
+			const Candidate& candidate = m_candidates[c];
+			if (candidate.index > 0) {
+				m_clusters[c] = m_indexedClusters[indexed++];
+			} else {
+				float pos[3] = { candidate.pos.x, candidate.pos.y, candidate.pos.z };
+				m_clusters[c] = visibility.FindCluster(pos);
+			}
+		}
+	}
+
+	for (size_t c = 0; c < m_candidates.size(); c++) {
+		const Candidate& candidate = m_candidates[c];
+		int base = LUA->Top();
+		LUA->PushNumber(candidate.item);
+		LUA->GetTable(entities);
+		int ent = base + 1;
+
+		bool occluded = false;
+		if (candidate.index <= 0 && candidate.isStaticProp) {
+			PropBounds& prop = GetPropBounds(LUA, ent, settings.boundsSize);
+			Verdict verdict = Decide(LUA, ent, settings, candidate.pos, m_clusters[c]);
+			int8_t visible = verdict == Verdict::Visible ? 1 : 0;
+			occluded = verdict == Verdict::Occluded;
+
+			// Set again on its tier's refresh in case a script changed them
+			if (visible != prop.applied || settings.time >= prop.refreshAt) {
+				if (!visible) {
+					SetRenderBounds(LUA, ent, settingsTable, "hiddenMins", "hiddenMaxs");
+				} else if (prop.hasBounds) {
+					LUA->PushVector(prop.mins);
+					LUA->PushVector(prop.maxs);
+					SetRenderBounds(LUA, ent);
+				}
+				prop.applied = visible;
+				prop.refreshAt = settings.time + settings.frequencies[GetTier((candidate.pos - settings.origin).LengthSqr())];
+				m_stats.updated++;
+			}
+			if (visible) {
+				m_stats.visible++;
+			} else {
+				m_stats.hidden++;
+			}
+		} else {
+			m_stats.updated++;
+			if (ApplyBounds(LUA, ent, settingsTable, settings, candidate.pos, m_clusters[c], candidate.isStaticProp, &occluded)) {
+				m_stats.visible++;
+			} else {
+				m_stats.hidden++;
+			}
+		}
+
+		// Occlusion changes with every step the camera takes, anything
+		// hidden by it comes back on the closest tier's refresh
+		if (occluded) {
+			m_stats.occluded++;
+			if (candidate.index > 0) m_schedule.Schedule(static_cast<uint32_t>(candidate.index), settings.time + settings.frequencies[0]);
+		}
+
+		if (candidate.index > 0) {
+			if (static_cast<size_t>(candidate.index) >= m_decided.size()) m_decided.resize(candidate.index + 1, 0);
+			m_decided[candidate.index] = m_pass;
+		}
+		LUA->Pop(LUA->Top() - base);
+	}
+
+	// The clusters that became visible or hidden since last pass, the same
+	// test ShouldRender makes. Their entities are redone now instead of
+	// whenever their tier comes around.
+	bool compare = false;
+	if (settings.pvs && visibility.HasVisibleClusters()) {
+		m_changed = visibility.GetVisibleClusters();
+
+		const PortalVisibility& portals = PortalVisibility::Instance();
+		if (settings.portalFlow && portals.IsValid() &&
+			portals.GetVisibleClusters().GetClusterCount() == m_changed.GetClusterCount()) {
+			m_changed.And(portals.GetVisibleClusters());
+		}
+
+		compare = m_visible.GetClusterCount() == m_changed.GetClusterCount();
+		std::swap(m_visible, m_changed);
+		if (compare) m_changed.Xor(m_visible);
+	} else {
+		m_visible.Resize(0);
+	}
+
+	if (compare) {
+		const uint64_t* words = m_changed.GetWords();
+		for (size_t w = 0; w < m_changed.GetWordCount(); w++) {
+			uint64_t bits = words[w];
+			for (int bit = 0; bits; bit++, bits >>= 1) {
+				if (!(bits & 1)) continue;
+				int cluster = static_cast<int>(w * 64) + bit;
+
+				for (int32_t id = m_index.First(cluster); id >= 0; id = m_index.Next(id)) {
+					if (static_cast<size_t>(id) < m_decided.size() && m_decided[id] == m_pass) continue;
+
+					int base = LUA->Top();
+					if (!PushEntity(LUA, id)) continue;
+					int ent = base + 1;
+
+					bool noDraw = CallEntityMethod(LUA, ent, "GetNoDraw", 1) && LUA->GetBool(-1);
+					LUA->GetField(ent, "IsStaticProp");
+					bool isStaticProp = LUA->GetBool(-1);
+					if (!noDraw && (!isStaticProp || settings.staticProps)) {
+						float cached[3];
+						m_index.GetPosition(static_cast<uint32_t>(id), cached);
+
+						m_stats.updated++;
+						m_stats.flipped++;
+						bool occluded = false;
+						if (ApplyBounds(LUA, ent, settingsTable, settings, Vector(cached[0], cached[1], cached[2]), cluster, isStaticProp, &occluded)) {
+							m_stats.visible++;
+						} else {
+							m_stats.hidden++;
+						}
+						if (occluded) {
+							m_stats.occluded++;
+							m_schedule.Schedule(static_cast<uint32_t>(id), settings.time + settings.frequencies[0]);
+						}
+					}
+					LUA->Pop(LUA->Top() - base);
+				}
+			}
+		}
+	}
+
+	m_stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return m_stats.updated;
+}
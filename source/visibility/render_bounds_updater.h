@@ -0,0 +1,112 @@
+#pragma once
+#include "cluster_entity_index.h"
+#include "cluster_set.h"
+#include "timing_wheel.h"
+#include "mathlib/vector.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GarrysMod { namespace Lua { class ILuaBase; } }
+
+// Native replacement for the frustum script's queue of SetHugeRenderBounds
+// calls. One Update() walks the entity list, applies the same policy (light
+// updaters, lights, props, static props, PVS result) and calls
+// SetRenderBounds directly, no per-entity tables, closures or timers.
+//
+// The settings table is filled in by the script from its convars:
+//   time, boundsSize, staticProps,
+//   pvs, portalFlow, radius, minRadius, openArea, corridor, origin (Vector), aim (Vector),
+//   moveThreshold (units an entity moves before its cluster is looked up again),
+//   occlusion (hide entities behind the world, see OcclusionCuller),
+//   frequencies (5 numbers, closest tier first)
+// and the Vectors it reuses for bounds:
+//   hugeMins/hugeMaxs, lightMins/lightMaxs, updaterMins/updaterMaxs,
+//   fullMins/fullMaxs, hiddenMins/hiddenMaxs
+class RenderBoundsUpdater {
+public:
+	struct Stats {
+		size_t entities = 0;
+		size_t due = 0;
+		size_t updated = 0;
+		size_t visible = 0;
+		size_t hidden = 0;
+		size_t reclassified = 0; // moved past the threshold, looked up in the tree
+		size_t flipped = 0;      // not due, redone because their cluster changed visibility
+		size_t occluded = 0;     // in a visible cluster but behind the world
+		double milliseconds = 0.0;
+	};
+
+	static RenderBoundsUpdater& Instance();
+
+	// entities and settings are absolute stack indices
+	size_t Update(GarrysMod::Lua::ILuaBase* LUA, int entities, int settings);
+
+	void Reset();
+	// Drops a deleted entity's schedule so a reused index starts fresh
+	void Forget(int index);
+	// Frees a removed clientside static prop's slot, see kPropSlotField
+	void ForgetProp(int slot);
+	const Stats& GetStats() const { return m_stats; }
+
+	// Distance tiers of the frustum_freq_* convars, squared units
+	static constexpr int kTierCount = 5;
+	static const float kTierDistanceSqr[kTierCount];
+	static int GetTier(float distSqr);
+
+private:
+	RenderBoundsUpdater() = default;
+
+	// Entities waiting for their tier's next refresh, by entity index. Due
+	// ones are unscheduled by Advance, anything not listed again is simply
+	// never rescheduled.
+	TimingWheel m_schedule;
+	std::vector<uint32_t> m_due;
+	double m_lastTime = 0.0;
+
+	// Entities whose bounds depend on their cluster
+	struct Candidate {
+		int item; // position in the entity list
+		int index;
+		Vector pos;
+		bool isStaticProp;
+	};
+	std::vector<Candidate> m_candidates;
+	std::vector<int> m_clusters;
+
+	// Cluster of every indexed entity, looked up again only once it moves.
+	// The ids/points of this pass's indexed candidates are gathered for it.
+	// Bounds are still decided entity by entity, the per cluster lists are
+	// only walked when a cluster's visibility flips.
+	ClusterEntityIndex m_index;
+	std::vector<uint32_t> m_ids;
+	std::vector<std::array<float, 3>> m_points;
+	std::vector<int> m_indexedClusters;
+
+	// Clusters visible last pass, the ones that changed since get their
+	// entities redone even when they are not due yet
+	ClusterSet m_visible;
+	ClusterSet m_changed;
+	std::vector<uint32_t> m_decided; // pass number each entity was last decided in
+	uint32_t m_pass = 0;
+
+	// Clientside static props have no index to schedule them by, so they are
+	// decided every pass. Their scaled model bounds are worked out once, in
+	// a slot whose number is kept on the entity, and set again only when the
+	// decision changes or their tier comes around.
+	struct PropBounds {
+		Vector mins;
+		Vector maxs;
+		float boundsSize = 0.0f; // scale mins/maxs were made for, 0 before the first lookup
+		bool hasBounds = false;
+		bool used = false;
+		int8_t applied = -1;     // 1 visible, 0 hidden, -1 not set since the lookup
+		double refreshAt = 0.0;
+	};
+	std::vector<PropBounds> m_props;
+	std::vector<int> m_freeProps;
+	PropBounds& GetPropBounds(GarrysMod::Lua::ILuaBase* LUA, int ent, float boundsSize);
+
+	Stats m_stats;
+};
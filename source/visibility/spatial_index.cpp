@@ -0,0 +1,100 @@
+#include "spatial_index.h"
+#include "bsp_file.h"
+#include "lua_entity.h"
+#include "GarrysMod/Lua/Interface.h"
+#include "mathlib/vector.h"
+
+using namespace GarrysMod::Lua;
+
+namespace {
+	// Smallest cells are 128 units for entities, 32 for the (tighter) leafs
+	constexpr int kEntityDepth = 8;
+	constexpr int kLeafDepth = 10;
+	constexpr float kWorldExtent = 16384.0f;
+}
+
+SpatialIndex& SpatialIndex::Instance() {
+	static SpatialIndex instance;
+	return instance;
+}
+
+void SpatialIndex::Clear() {
+	m_leafs.Clear();
+	m_entities.Clear();
+	m_seen.clear();
+	m_pass = 0;
+}
+
+void SpatialIndex::BuildLeafs(const BSPFile& bsp) {
+	const std::vector<BSPFile::Leaf>& leafs = bsp.GetLeafs();
+	const BSPFile::Model& world = bsp.GetModels()[0];
+	m_leafs.Reset(world.mins, world.maxs, kLeafDepth);
+
+	for (size_t i = 0; i < leafs.size(); i++) {
+		const BSPFile::Leaf& leaf = leafs[i];
+		if (leaf.cluster < 0) continue;
+
+		float mins[3], maxs[3];
+		for (int axis = 0; axis < 3; axis++) {
+			mins[axis] = leaf.mins[axis];
+			maxs[axis] = leaf.maxs[axis];
+		}
+		m_leafs.Insert(static_cast<uint32_t>(i), mins, maxs);
+	}
+}
+
+size_t SpatialIndex::UpdateEntities(ILuaBase* LUA, int entities) {
+	if (!m_entities.IsInitialized()) {
+		const float mins[3] = { -kWorldExtent, -kWorldExtent, -kWorldExtent };
+		const float maxs[3] = { kWorldExtent, kWorldExtent, kWorldExtent };
+		m_entities.Reset(mins, maxs, kEntityDepth);
+	}
+	m_pass++;
+
+	int count = LUA->ObjLen(entities);
+	for (int i = 1; i <= count; i++) {
+		int base = LUA->Top();
+		LUA->PushNumber(i);
+		LUA->GetTable(entities);
+		int ent = base + 1;
+
+		int index = LUA->IsType(ent, Type::Entity) && CallEntityMethod(LUA, ent, "EntIndex", 1) && LUA->IsType(-1, Type::Number) ?
+			static_cast<int>(LUA->GetNumber(-1)) : -1;
+		if (index <= 0) {
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+
+		Vector mins, maxs;
+		if (CallEntityMethod(LUA, ent, "WorldSpaceAABB", 2) && LUA->IsType(-2, Type::Vector) && LUA->IsType(-1, Type::Vector)) {
+			mins = LUA->GetVector(-2);
+			maxs = LUA->GetVector(-1);
+		} else if (CallEntityMethod(LUA, ent, "GetPos", 1) && LUA->IsType(-1, Type::Vector)) {
+			mins = maxs = LUA->GetVector(-1);
+		} else {
+			LUA->Pop(LUA->Top() - base);
+			continue;
+		}
+
+		float boxMins[3] = { mins.x, mins.y, mins.z };
+		float boxMaxs[3] = { maxs.x, maxs.y, maxs.z };
+		m_entities.Insert(static_cast<uint32_t>(index), boxMins, boxMaxs);
+		if (static_cast<size_t>(index) >= m_seen.size()) m_seen.resize(index + 1, 0);
+		m_seen[index] = m_pass;
+
+		LUA->Pop(LUA->Top() - base);
+	}
+
+	// Anything not listed this pass is gone
+	for (size_t index = 0; index < m_seen.size(); index++) {
+		if (m_seen[index] != m_pass && m_entities.Contains(static_cast<uint32_t>(index))) {
+			m_entities.Remove(static_cast<uint32_t>(index));
+		}
+	}
+
+	return m_entities.GetCount();
+}
+
+void SpatialIndex::RemoveEntity(int index) {
+	if (index > 0) m_entities.Remove(static_cast<uint32_t>(index));
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "loose_octree.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GarrysMod { namespace Lua { class ILuaBase; } }
+class BSPFile;
+
+// Loose octrees over the current map's leafs and the client's entities,
+// so the frustum script can ask "which leafs/entities touch this sphere,
+// box, ray or view" without walking NikNaks tables from Lua.
+//
+// Leaf ids are BSP leaf indices (0 based, solid leafs left out), entity
+// ids are EntIndex() values, so clientside entities are not indexed.
+class SpatialIndex {
+public:
+	static SpatialIndex& Instance();
+
+	void BuildLeafs(const BSPFile& bsp);
+	void Clear();
+
+	// entities is an absolute stack index. Boxes are refreshed in place,
+	// entities missing from the list are dropped.
+	size_t UpdateEntities(GarrysMod::Lua::ILuaBase* LUA, int entities);
+	void RemoveEntity(int index);
+
+	const LooseOctree& GetLeafs() const { return m_leafs; }
+	const LooseOctree& GetEntities() const { return m_entities; }
+
+private:
+	SpatialIndex() = default;
+
+	LooseOctree m_leafs;
+	LooseOctree m_entities;
+	std::vector<uint32_t> m_seen; // pass number each entity was last listed in
+	uint32_t m_pass = 0;
+};
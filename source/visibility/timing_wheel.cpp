@@ -0,0 +1,116 @@
+#include "timing_wheel.h"
+#include <algorithm>
+#include <iterator>
+
+void TimingWheel::Reset(double now) {
+	m_entries.clear();
+	std::fill(std::begin(m_heads), std::end(m_heads), -1);
+	m_tick = ToTick(now);
+	m_count = 0;
+}
+
+uint64_t TimingWheel::ToTick(double time) const {
+	return time > 0.0 ? static_cast<uint64_t>(time * kTicksPerSecond) : 0;
+}
+
+void TimingWheel::Place(uint32_t id) {
+	Entry& entry = m_entries[id];
+
+	// Anything past the last level waits in its furthest slot
+	const uint64_t horizon = (1ULL << (kSlotBits * kLevels)) - 1;
+	if (entry.expires - m_tick > horizon) entry.expires = m_tick + horizon;
+
+	uint64_t delta = entry.expires - m_tick;
+	int level = 0;
+	while (level < kLevels - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) level++;
+
+	int32_t slot = level * kSlots + static_cast<int32_t>((entry.expires >> (kSlotBits * level)) & (kSlots - 1));
+	entry.slot = slot;
+	entry.prev = -1;
+	entry.next = m_heads[slot];
+	if (entry.next >= 0) m_entries[entry.next].prev = static_cast<int32_t>(id);
+	m_heads[slot] = static_cast<int32_t>(id);
+	m_count++;
+}
+
+void TimingWheel::Unlink(uint32_t id) {
+	Entry& entry = m_entries[id];
+	if (entry.prev >= 0) {
+		m_entries[entry.prev].next = entry.next;
+	} else {
+		m_heads[entry.slot] = entry.next;
+	}
+	if (entry.next >= 0) m_entries[entry.next].prev = entry.prev;
+
+	entry.slot = entry.prev = entry.next = -1;
+	m_count--;
+}
+
+void TimingWheel::Schedule(uint32_t id, double when) {
+	if (id >= m_entries.size()) m_entries.resize(id + 1);
+	if (IsScheduled(id)) Unlink(id);
+
+	// Never in the current tick, it has already been handed out
+	m_entries[id].expires = (std::max)(ToTick(when), m_tick + 1);
+	Place(id);
+}
+
+void TimingWheel::Cancel(uint32_t id) {
+	if (IsScheduled(id)) Unlink(id);
+}
+
+void TimingWheel::Cascade(int level) {
+	int32_t slot = level * kSlots + static_cast<int32_t>((m_tick >> (kSlotBits * level)) & (kSlots - 1));
+
+	m_cascade.clear();
+	for (int32_t id = m_heads[slot]; id >= 0; id = m_entries[id].next) m_cascade.push_back(static_cast<uint32_t>(id));
+	for (uint32_t id : m_cascade) {
+		Unlink(id);
+		Place(id);
+	}
+}
+
+void TimingWheel::Advance(double now, std::vector<uint32_t>& due) {
+	uint64_t target = ToTick(now);
+	if (target <= m_tick) return;
+
+	// After a long stall (map change, pause) one pass over everything beats
+	// stepping through thousands of empty ticks
+	if (target - m_tick >= (1ULL << (kSlotBits * 2))) {
+		m_cascade.clear();
+		for (int32_t slot = 0; slot < kLevels * kSlots; slot++) {
+			for (int32_t id = m_heads[slot]; id >= 0; id = m_entries[id].next) m_cascade.push_back(static_cast<uint32_t>(id));
+		}
+
+		for (uint32_t id : m_cascade) Unlink(id);
+
+		m_tick = target;
+		for (uint32_t id : m_cascade) {
+			if (m_entries[id].expires <= target) {
+				due.push_back(id);
+			} else {
+				Place(id);
+			}
+		}
+		return;
+	}
+
+	while (m_tick < target) {
+		m_tick++;
+
+		int32_t index = static_cast<int32_t>(m_tick & (kSlots - 1));
+		if (index == 0) {
+			for (int level = kLevels - 1; level > 0; level--) {
+				// A level only turns over when every level below it has
+				if ((m_tick & ((1ULL << (kSlotBits * level)) - 1)) == 0) Cascade(level);
+			}
+		}
+
+		for (int32_t id = m_heads[index]; id >= 0;) {
+			int32_t next = m_entries[id].next;
+			Unlink(static_cast<uint32_t>(id));
+			due.push_back(static_cast<uint32_t>(id));
+			id = next;
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timing wheel keyed by small integer ids (entity indices).
+//
+// Three levels of 64 slots at 64 ticks per second: the first covers the
+// next second tick by tick, the next two a minute and an hour in coarser
+// slots that are cascaded down as time reaches them. Schedule, reschedule
+// and cancel are O(1) list splices, and Advance only touches the slots
+// that actually expire, so the per-frame cost follows the number of due
+// ids rather than the number scheduled.
+class TimingWheel {
+public:
+	static constexpr int kTicksPerSecond = 64;
+
+	TimingWheel() { Reset(0.0); }
+
+	void Reset(double now);
+
+	// Due at the first Advance() at or past `when`, replaces any earlier schedule
+	void Schedule(uint32_t id, double when);
+	void Cancel(uint32_t id);
+	bool IsScheduled(uint32_t id) const { return id < m_entries.size() && m_entries[id].slot >= 0; }
+	size_t GetCount() const { return m_count; }
+
+	// Moves time forward, appending every id that came due to `due`
+	void Advance(double now, std::vector<uint32_t>& due);
+
+private:
+	static constexpr int kSlotBits = 6;
+	static constexpr int kSlots = 1 << kSlotBits;
+	static constexpr int kLevels = 3;
+
+	struct Entry {
+		uint64_t expires = 0;
+		int32_t slot = -1; // level * kSlots + index, -1 when not scheduled
+		int32_t prev = -1;
+		int32_t next = -1;
+	};
+
+	uint64_t ToTick(double time) const;
+	void Place(uint32_t id);
+	void Unlink(uint32_t id);
+	void Cascade(int level);
+
+	std::vector<Entry> m_entries; // indexed by id
+	int32_t m_heads[kLevels * kSlots];
+	uint64_t m_tick = 0;
+	size_t m_count = 0;
+	std::vector<uint32_t> m_cascade;
+};
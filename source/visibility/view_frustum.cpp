@@ -0,0 +1,29 @@
+#include "view_frustum.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	constexpr float kDegToRad = 3.14159265358979f / 180.0f;
+}
+
+size_t BuildViewFrustum(const float origin[3], const float forward[3], const float right[3], const float up[3],
+	float fov, float aspect, float marginDegrees, FrustumPlane out[4]) {
+	float tanHalf = tanf(fov * 0.5f * kDegToRad);
+	float margin = marginDegrees * kDegToRad;
+	float halfX = (std::min)(atanf(tanHalf * aspect * 0.75f) + margin, 89.0f * kDegToRad);
+	float halfY = (std::min)(atanf(tanHalf * 0.75f) + margin, 89.0f * kDegToRad);
+
+	const struct { const float* axis; float sign; float half; } sides[] = {
+		{ right, 1.0f, halfX }, { right, -1.0f, halfX },
+		{ up, 1.0f, halfY }, { up, -1.0f, halfY },
+	};
+
+	// Rotating forward by the half angle towards -axis gives the inward normal
+	for (int s = 0; s < 4; s++) {
+		FrustumPlane& plane = out[s];
+		float sine = sinf(sides[s].half), cosine = cosf(sides[s].half);
+		for (int i = 0; i < 3; i++) plane.normal[i] = forward[i] * sine - sides[s].axis[i] * sides[s].sign * cosine;
+		plane.dist = plane.normal[0] * origin[0] + plane.normal[1] * origin[1] + plane.normal[2] * origin[2];
+	}
+	return 4;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+// Plane with the inside where dot(normal, p) >= dist
+struct FrustumPlane {
+	float normal[3];
+	float dist;
+};
+
+// Side planes of a view, all through the origin. fov is the engine's
+// horizontal fov at 4:3, widened to the real aspect, and every half angle
+// gets marginDegrees of slack. Returns the plane count (4).
+size_t BuildViewFrustum(const float origin[3], const float forward[3], const float right[3], const float up[3],
+	float fov, float aspect, float marginDegrees, FrustumPlane out[4]);
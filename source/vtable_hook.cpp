@@ -0,0 +1,83 @@
+#include "vtable_hook.h"
+#include <Windows.h>
+#include <tier0/dbg.h>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+	// Hooks installed on each slot, bottom of the stack first
+	std::mutex s_chainMutex;
+	std::unordered_map<void**, std::vector<VTableHook*>> s_chains;
+
+	bool WriteSlot(void** slot, void* value) {
+		DWORD oldProtect;
+		if (!VirtualProtect(slot, sizeof(void*), PAGE_READWRITE, &oldProtect)) return false;
+
+		InterlockedExchangePointer(reinterpret_cast<PVOID volatile*>(slot), value);
+
+		DWORD unused;
+		VirtualProtect(slot, sizeof(void*), oldProtect, &unused);
+		return true;
+	}
+}
+
+bool VTableHook::Create(void** vtable, size_t index, void* detour, void** original) {
+	if (!vtable || !detour || m_enabled) return false;
+
+	m_slot = &vtable[index];
+	m_detour = detour;
+	m_originalOut = original;
+	SetOriginal(*m_slot);
+	return true;
+}
+
+void VTableHook::SetOriginal(void* original) {
+	m_original = original;
+	if (m_originalOut) *m_originalOut = original;
+}
+
+bool VTableHook::Enable() {
+	if (!m_slot) return false;
+
+	std::lock_guard<std::mutex> lock(s_chainMutex);
+	if (m_enabled) return true;
+
+	// Chain onto whatever is there now, which may be another hook
+	SetOriginal(*m_slot);
+	if (!WriteSlot(m_slot, m_detour)) {
+		Warning("[Hooks] Failed to unprotect vtable slot %p\n", m_slot);
+		return false;
+	}
+
+	s_chains[m_slot].push_back(this);
+	m_enabled = true;
+	return true;
+}
+
+bool VTableHook::Disable() {
+	std::lock_guard<std::mutex> lock(s_chainMutex);
+	if (!m_enabled) return true;
+
+	std::vector<VTableHook*>& chain = s_chains[m_slot];
+	auto it = std::find(chain.begin(), chain.end(), this);
+
+	if (*m_slot == m_detour) {
+		if (!WriteSlot(m_slot, m_original)) {
+			Warning("[Hooks] Failed to unprotect vtable slot %p\n", m_slot);
+			return false;
+		}
+	} else if (it != chain.end() && it + 1 != chain.end()) {
+		// One of ours sits above, make it skip this hook
+		(*(it + 1))->SetOriginal(m_original);
+	} else {
+		Warning("[Hooks] Vtable slot %p was replaced by another module, leaving hook in place\n", m_slot);
+		return false;
+	}
+
+	if (it != chain.end()) chain.erase(it);
+	if (chain.empty()) s_chains.erase(m_slot);
+	m_enabled = false;
+	return true;
+}
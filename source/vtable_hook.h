@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+
+// Interception by swapping a COM-style vtable slot instead of patching code.
+//
+// Enable() atomically replaces the slot with the detour and the detour calls
+// whatever the slot held before through a plain saved pointer, so there is no
+// trampoline and overlays that inline-patch the function itself keep working.
+//
+// Hooks stack: a second hook on the same slot chains to the first. Disabling a
+// hook that is not on top relinks the one above it onto its original. If a
+// foreign module swapped the slot after us the hook cannot be unlinked and
+// stays in place.
+//
+// The caller's original pointer is passed to Create() and kept up to date by
+// relinks, detours call through it as they would through a trampoline.
+class VTableHook {
+public:
+	VTableHook() = default;
+
+	VTableHook(const VTableHook&) = delete;
+	VTableHook& operator=(const VTableHook&) = delete;
+
+	template <typename T>
+	bool Create(void** vtable, size_t index, T detour, T* original) {
+		return Create(vtable, index, reinterpret_cast<void*>(detour), reinterpret_cast<void**>(original));
+	}
+	bool Create(void** vtable, size_t index, void* detour, void** original);
+
+	bool Enable();
+	bool Disable();
+
+	bool IsCreated() const { return m_slot != nullptr; }
+	bool IsEnabled() const { return m_enabled; }
+
+	// Function the slot held when the hook was enabled
+	void* GetOriginal() const { return m_original; }
+
+private:
+	void SetOriginal(void* original);
+
+	void** m_slot = nullptr;
+	void* m_detour = nullptr;
+	void* m_original = nullptr;
+	void** m_originalOut = nullptr;
+	bool m_enabled = false;
+};
@@ -0,0 +1,181 @@
+#include "vertex_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	// The weights from Forsyth's paper
+	constexpr float kCacheDecayPower = 1.5f;
+	constexpr float kLastTriangleScore = 0.75f;
+	constexpr float kValenceBoostScale = 2.0f;
+	constexpr float kValenceBoostPower = 0.5f;
+	constexpr uint32_t kValenceTableSize = 32;
+
+	// Both terms only depend on small integers, so they are looked up
+	// rather than calling pow for every vertex the cache touches
+	struct ScoreTables {
+		float cache[VertexCacheOptimizer::kCacheSize];
+		float valence[kValenceTableSize];
+
+		ScoreTables() {
+			const int cacheSize = VertexCacheOptimizer::kCacheSize;
+			for (int position = 0; position < cacheSize; position++) {
+				if (position < 3) {
+					// Just used, a fixed score so a triangle isn't picked only
+					// for sharing all three with the last one
+					cache[position] = kLastTriangleScore;
+				} else {
+					float scale = 1.0f / (cacheSize - 3);
+					cache[position] = std::pow(1.0f - (position - 3) * scale, kCacheDecayPower);
+				}
+			}
+			valence[0] = 0.0f;
+			for (uint32_t remaining = 1; remaining < kValenceTableSize; remaining++) {
+				valence[remaining] = kValenceBoostScale * std::pow(static_cast<float>(remaining), -kValenceBoostPower);
+			}
+		}
+	};
+
+	const ScoreTables& GetScoreTables() {
+		static const ScoreTables tables;
+		return tables;
+	}
+}
+
+float VertexCacheOptimizer::VertexScore(uint32_t vertex) const {
+	uint32_t remaining = m_remaining[vertex];
+	if (remaining == 0) return -1.0f;
+
+	const ScoreTables& tables = GetScoreTables();
+	int position = m_cachePosition[vertex];
+	float score = position >= 0 ? tables.cache[position] : 0.0f;
+
+	// Vertices with few triangles left are worth finishing off
+	if (remaining < kValenceTableSize) {
+		score += tables.valence[remaining];
+	} else {
+		score += kValenceBoostScale * std::pow(static_cast<float>(remaining), -kValenceBoostPower);
+	}
+	return score;
+}
+
+void VertexCacheOptimizer::Optimize(uint16_t* indices, size_t indexCount, size_t vertexCount) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2 || vertexCount == 0) return;
+
+	m_cachePosition.assign(vertexCount, -1);
+	m_remaining.assign(vertexCount, 0);
+	m_firstTriangle.assign(vertexCount + 1, 0);
+	m_score.assign(vertexCount, 0.0f);
+
+	for (size_t i = 0; i < triangleCount * 3; i++) m_remaining[indices[i]]++;
+	for (size_t v = 0; v < vertexCount; v++) m_firstTriangle[v + 1] = m_firstTriangle[v] + m_remaining[v];
+
+	m_adjacency.resize(triangleCount * 3);
+	m_cursor.assign(m_firstTriangle.begin(), m_firstTriangle.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++) m_adjacency[m_cursor[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+	}
+
+	for (size_t v = 0; v < vertexCount; v++) m_score[v] = VertexScore(static_cast<uint32_t>(v));
+
+	m_triangleScore.resize(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		m_triangleScore[t] = m_score[indices[t * 3]] + m_score[indices[t * 3 + 1]] + m_score[indices[t * 3 + 2]];
+	}
+	m_emitted.assign(triangleCount, 0);
+	m_output.clear();
+	m_output.reserve(triangleCount * 3);
+
+	// The simulated cache, three spare slots for the triangle being added
+	uint32_t cache[kCacheSize + 3];
+	int cacheCount = 0;
+
+	size_t scan = 0; // every triangle before this one is emitted
+	int64_t best = -1;
+	for (size_t emitted = 0; emitted < triangleCount; emitted++) {
+		// Nothing around the cache is left, carry on from the first
+		// triangle still waiting. scan only moves forward, so this stays
+		// linear over the whole run.
+		if (best < 0) {
+			while (scan < triangleCount && m_emitted[scan]) scan++;
+			if (scan == triangleCount) break;
+			best = static_cast<int64_t>(scan);
+		}
+
+		size_t triangle = static_cast<size_t>(best);
+		m_emitted[triangle] = 1;
+		const uint16_t* corners = indices + triangle * 3;
+		m_output.insert(m_output.end(), corners, corners + 3);
+
+		// Take the triangle out of its vertices' waiting lists
+		for (int k = 0; k < 3; k++) {
+			uint32_t vertex = corners[k];
+			uint32_t begin = m_firstTriangle[vertex];
+			uint32_t end = begin + m_remaining[vertex];
+			for (uint32_t a = begin; a < end; a++) {
+				if (m_adjacency[a] == triangle) {
+					std::swap(m_adjacency[a], m_adjacency[end - 1]);
+					break;
+				}
+			}
+			m_remaining[vertex]--;
+		}
+
+		// Its vertices go to the front, the rest shift back
+		uint32_t updated[kCacheSize + 3];
+		int updatedCount = 0;
+		for (int k = 0; k < 3; k++) updated[updatedCount++] = corners[k];
+		for (int c = 0; c < cacheCount; c++) {
+			uint32_t vertex = cache[c];
+			if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) updated[updatedCount++] = vertex;
+		}
+
+		for (int c = 0; c < updatedCount; c++) {
+			m_cachePosition[updated[c]] = c < kCacheSize ? c : -1;
+		}
+		cacheCount = (std::min)(updatedCount, kCacheSize);
+		memcpy(cache, updated, cacheCount * sizeof(uint32_t));
+
+		// Rescore everything that moved, the next triangle is the best
+		// one waiting on those vertices
+		for (int c = 0; c < updatedCount; c++) {
+			uint32_t vertex = updated[c];
+			float delta = VertexScore(vertex) - m_score[vertex];
+			m_score[vertex] += delta;
+			uint32_t begin = m_firstTriangle[vertex];
+			for (uint32_t a = begin; a < begin + m_remaining[vertex]; a++) m_triangleScore[m_adjacency[a]] += delta;
+		}
+
+		best = -1;
+		float bestScore = -1.0f;
+		for (int c = 0; c < cacheCount; c++) {
+			uint32_t vertex = cache[c];
+			uint32_t begin = m_firstTriangle[vertex];
+			for (uint32_t a = begin; a < begin + m_remaining[vertex]; a++) {
+				uint32_t t = m_adjacency[a];
+				if (m_triangleScore[t] > bestScore) {
+					bestScore = m_triangleScore[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	memcpy(indices, m_output.data(), m_output.size() * sizeof(uint16_t));
+}
+
+float VertexCacheOptimizer::GetACMR(const uint16_t* indices, size_t indexCount, size_t vertexCount, int cacheSize) {
+	if (indexCount < 3) return 0.0f;
+
+	// FIFO, a vertex is in the cache while its stamp is within the last cacheSize misses
+	std::vector<int64_t> stamp(vertexCount, INT64_MIN / 2);
+	int64_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		if (misses - stamp[indices[i]] > cacheSize) {
+			stamp[indices[i]] = misses;
+			misses++;
+		}
+	}
+	return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Reorders an indexed triangle list for the post-transform vertex cache,
+// Tom Forsyth's linear-speed optimizer.
+//
+// Every vertex scores by its position in a simulated LRU cache and by how
+// many of its triangles are still waiting, and the next triangle is the
+// best scoring one around the vertices that were just used. Only the
+// triangle order changes, the vertices and each triangle's winding stay.
+class VertexCacheOptimizer {
+public:
+	static constexpr int kCacheSize = 32;
+
+	void Optimize(uint16_t* indices, size_t indexCount, size_t vertexCount);
+
+	// Average cache miss ratio of an index list in a FIFO cache, vertices
+	// transformed per triangle. 3 is the worst, 0.5 about the best possible.
+	static float GetACMR(const uint16_t* indices, size_t indexCount, size_t vertexCount, int cacheSize);
+
+private:
+	float VertexScore(uint32_t vertex) const;
+
+	// Per vertex
+	std::vector<int32_t> m_cachePosition;
+	std::vector<uint32_t> m_remaining;  // triangles not emitted yet
+	std::vector<uint32_t> m_firstTriangle; // into m_adjacency
+	std::vector<uint32_t> m_cursor;
+	std::vector<float> m_score;
+
+	std::vector<uint32_t> m_adjacency; // triangles of each vertex, emitted ones moved to the end
+	std::vector<float> m_triangleScore;
+	std::vector<uint8_t> m_emitted;
+	std::vector<uint16_t> m_output;
+};
@@ -0,0 +1,435 @@
+#include "world_mesher.h"
+#include "../visibility/bsp_file.h"
+#include <tier0/dbg.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	constexpr int kChunkBits = 17;
+	constexpr int kChunkBias = 1 << (kChunkBits - 1);
+
+	float Dot(const float a[3], const float b[3]) {
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void Cross(const float a[3], const float b[3], float out[3]) {
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	// Normal of the triangle, length twice its area
+	void TriangleNormal(const float a[3], const float b[3], const float c[3], float out[3]) {
+		float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		Cross(ab, ac, out);
+	}
+
+	// Texture coordinates in texture widths, what NikNaks handed the script
+	void SetTexCoords(const BSPFile::TexInfo& texInfo, float width, float height, WorldMesher::Vertex& vertex, const float pos[3]) {
+		vertex.u = (Dot(texInfo.textureVecs[0], pos) + texInfo.textureVecs[0][3]) / width;
+		vertex.v = (Dot(texInfo.textureVecs[1], pos) + texInfo.textureVecs[1][3]) / height;
+	}
+
+	// -0 and 0 weld together
+	void Canonicalize(WorldMesher::Vertex& vertex) {
+		for (int k = 0; k < 3; k++) {
+			vertex.pos[k] += 0.0f;
+			vertex.normal[k] += 0.0f;
+		}
+		vertex.u += 0.0f;
+		vertex.v += 0.0f;
+	}
+
+	uint32_t HashVertex(const WorldMesher::Vertex& vertex) {
+		uint32_t words[sizeof(WorldMesher::Vertex) / 4];
+		memcpy(words, &vertex, sizeof(words));
+
+		uint32_t hash = 2166136261u;
+		for (uint32_t word : words) hash = (hash ^ word) * 16777619u;
+		return hash ^ (hash >> 15);
+	}
+
+	void GetTextureSize(const BSPFile& bsp, const BSPFile::TexInfo& texInfo, float& width, float& height) {
+		width = 1.0f;
+		height = 1.0f;
+		if (texInfo.texData < 0 || static_cast<size_t>(texInfo.texData) >= bsp.GetTexDatas().size()) return;
+
+		const BSPFile::TexData& texData = bsp.GetTexDatas()[texInfo.texData];
+		if (texData.width > 0) width = static_cast<float>(texData.width);
+		if (texData.height > 0) height = static_cast<float>(texData.height);
+	}
+}
+
+WorldMesher& WorldMesher::Instance() {
+	static WorldMesher instance;
+	return instance;
+}
+
+int64_t WorldMesher::ChunkKey(int x, int y, int z) {
+	auto pack = [](int value) {
+		return static_cast<int64_t>((std::min)((std::max)(value + kChunkBias, 0), (1 << kChunkBits) - 1));
+	};
+	return (pack(x) << (kChunkBits * 2)) | (pack(y) << kChunkBits) | pack(z);
+}
+
+bool WorldMesher::FaceRef::operator<(const FaceRef& other) const {
+	if (translucent != other.translucent) return !translucent;
+	if (chunk != other.chunk) return chunk < other.chunk;
+	if (texData != other.texData) return texData < other.texData;
+	return face < other.face;
+}
+
+void WorldMesher::Clear() {
+	m_faces.clear();
+	m_groups.clear();
+	m_groups.shrink_to_fit();
+	m_stats = Stats();
+
+	// The scratch grows to the largest group, give it back with the parts
+	std::vector<Vertex>().swap(m_triangleList);
+	std::vector<Vertex>().swap(m_unique);
+	std::vector<uint32_t>().swap(m_welded);
+	std::vector<uint32_t>().swap(m_buckets);
+	std::vector<uint32_t>().swap(m_partOf);
+	std::vector<uint16_t>().swap(m_local);
+	m_optimizer = VertexCacheOptimizer();
+	m_missesBefore = 0.0;
+	m_missesAfter = 0.0;
+}
+
+void WorldMesher::FinishGroup(Group& group) {
+	size_t count = m_triangleList.size() / 3 * 3;
+	m_stats.vertices += count;
+
+	// Weld, every distinct vertex once
+	size_t mask = 1;
+	while (mask < count * 2) mask <<= 1;
+	m_buckets.assign(mask, 0);
+	mask--;
+
+	m_unique.clear();
+	m_welded.clear();
+	for (size_t i = 0; i < count; i += 3) {
+		uint32_t corners[3];
+		for (int k = 0; k < 3; k++) {
+			Vertex vertex = m_triangleList[i + k];
+			Canonicalize(vertex);
+
+			size_t slot = HashVertex(vertex) & mask;
+			while (m_buckets[slot] && memcmp(&m_unique[m_buckets[slot] - 1], &vertex, sizeof(Vertex)) != 0) slot = (slot + 1) & mask;
+			if (!m_buckets[slot]) {
+				m_unique.push_back(vertex);
+				m_buckets[slot] = static_cast<uint32_t>(m_unique.size());
+			}
+			corners[k] = m_buckets[slot] - 1;
+		}
+
+		// Slivers that welded down to a line draw nothing
+		if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2]) continue;
+		m_welded.insert(m_welded.end(), corners, corners + 3);
+	}
+	m_triangleList.clear();
+
+	// Split in triangle order, which keeps each part's faces together
+	m_partOf.assign(m_unique.size(), UINT32_MAX);
+	m_local.resize(m_unique.size());
+	for (size_t i = 0; i < m_welded.size(); i += 3) {
+		uint32_t partIndex = static_cast<uint32_t>(group.parts.size()) - 1;
+		size_t added = 0;
+		if (!group.parts.empty()) {
+			for (int k = 0; k < 3; k++) added += m_partOf[m_welded[i + k]] != partIndex;
+		}
+		if (group.parts.empty() || group.parts.back().vertices.size() + added > kMaxPartVertices) {
+			group.parts.emplace_back();
+			partIndex++;
+		}
+
+		Part& part = group.parts.back();
+		for (int k = 0; k < 3; k++) {
+			uint32_t vertex = m_welded[i + k];
+			if (m_partOf[vertex] != partIndex) {
+				m_partOf[vertex] = partIndex;
+				m_local[vertex] = static_cast<uint16_t>(part.vertices.size());
+				part.vertices.push_back(m_unique[vertex]);
+			}
+			part.indices.push_back(m_local[vertex]);
+		}
+	}
+
+	for (Part& part : group.parts) {
+		size_t triangles = part.indices.size() / 3;
+		m_missesBefore += VertexCacheOptimizer::GetACMR(part.indices.data(), part.indices.size(), part.vertices.size(), 32) * triangles;
+		m_optimizer.Optimize(part.indices.data(), part.indices.size(), part.vertices.size());
+		m_missesAfter += VertexCacheOptimizer::GetACMR(part.indices.data(), part.indices.size(), part.vertices.size(), 32) * triangles;
+
+		m_stats.welded += part.vertices.size();
+		m_stats.indices += part.indices.size();
+		m_stats.parts++;
+	}
+}
+
+bool WorldMesher::GetFaceVertexes(const BSPFile& bsp, uint32_t faceIndex) {
+	const BSPFile::Face& face = bsp.GetFaces()[faceIndex];
+	const std::vector<int32_t>& surfEdges = bsp.GetSurfEdges();
+	const std::vector<BSPFile::Edge>& edges = bsp.GetEdges();
+
+	m_corners.clear();
+	if (face.numEdges < 3 || face.firstEdge < 0 || static_cast<size_t>(face.firstEdge) + face.numEdges > surfEdges.size()) return false;
+
+	for (int e = 0; e < face.numEdges; e++) {
+		int32_t surfEdge = surfEdges[face.firstEdge + e];
+		uint32_t edge = surfEdge >= 0 ? static_cast<uint32_t>(surfEdge) : 0u - static_cast<uint32_t>(surfEdge);
+		if (edge >= edges.size()) return false;
+
+		uint16_t vertex = edges[edge].v[surfEdge >= 0 ? 0 : 1];
+		if (vertex >= bsp.GetVertexes().size()) return false;
+		m_corners.push_back(vertex);
+	}
+	return true;
+}
+
+void WorldMesher::EmitFace(const BSPFile& bsp, uint32_t faceIndex, std::vector<Vertex>& out) {
+	const BSPFile::Face& face = bsp.GetFaces()[faceIndex];
+	if (face.planeNum >= bsp.GetPlanes().size()) return;
+
+	const BSPFile::TexInfo& texInfo = bsp.GetTexInfos()[face.texInfo];
+	float width, height;
+	GetTextureSize(bsp, texInfo, width, height);
+
+	const float* planeNormal = bsp.GetPlanes()[face.planeNum].normal;
+	float sign = face.side ? -1.0f : 1.0f;
+
+	m_grid.resize(m_corners.size());
+	for (size_t i = 0; i < m_corners.size(); i++) {
+		const float* pos = bsp.GetVertexes()[m_corners[i]].data();
+		Vertex& vertex = m_grid[i];
+		for (int k = 0; k < 3; k++) {
+			vertex.pos[k] = pos[k];
+			vertex.normal[k] = planeNormal[k] * sign;
+		}
+		SetTexCoords(texInfo, width, height, vertex, pos);
+	}
+
+	for (size_t i = 1; i + 1 < m_grid.size(); i++) {
+		out.push_back(m_grid[0]);
+		out.push_back(m_grid[i]);
+		out.push_back(m_grid[i + 1]);
+	}
+}
+
+void WorldMesher::EmitDisplacement(const BSPFile& bsp, uint32_t faceIndex, std::vector<Vertex>& out) {
+	const BSPFile::Face& face = bsp.GetFaces()[faceIndex];
+	if (face.planeNum >= bsp.GetPlanes().size() || m_corners.size() != 4) return;
+	if (static_cast<size_t>(face.dispInfo) >= bsp.GetDispInfos().size()) return;
+
+	const BSPFile::DispInfo& dispInfo = bsp.GetDispInfos()[face.dispInfo];
+	if (dispInfo.power < 1 || dispInfo.power > 4) return;
+
+	int side = 1 << dispInfo.power;
+	int size = side + 1;
+	const std::vector<BSPFile::DispVert>& dispVerts = bsp.GetDispVerts();
+	if (dispInfo.dispVertStart < 0 || static_cast<size_t>(dispInfo.dispVertStart) + size * size > dispVerts.size()) return;
+
+	const BSPFile::TexInfo& texInfo = bsp.GetTexInfos()[face.texInfo];
+	float width, height;
+	GetTextureSize(bsp, texInfo, width, height);
+
+	float frontNormal[3];
+	const float* planeNormal = bsp.GetPlanes()[face.planeNum].normal;
+	for (int k = 0; k < 3; k++) frontNormal[k] = face.side ? -planeNormal[k] : planeNormal[k];
+
+	// The grid starts at the corner closest to the start position
+	int start = 0;
+	float bestDistSqr = INFINITY;
+	for (int i = 0; i < 4; i++) {
+		const float* corner = bsp.GetVertexes()[m_corners[i]].data();
+		float d[3] = { corner[0] - dispInfo.startPosition[0], corner[1] - dispInfo.startPosition[1], corner[2] - dispInfo.startPosition[2] };
+		float distSqr = Dot(d, d);
+		if (distSqr < bestDistSqr) {
+			bestDistSqr = distSqr;
+			start = i;
+		}
+	}
+
+	const float* p[4];
+	for (int i = 0; i < 4; i++) p[i] = bsp.GetVertexes()[m_corners[(start + i) % 4]].data();
+
+	// Rows run from the p0-p3 edge to the p1-p2 edge, the flat position
+	// gives the texture coordinates and the offset moves it
+	m_grid.resize(static_cast<size_t>(size) * size);
+	for (int row = 0; row < size; row++) {
+		float t = static_cast<float>(row) / side;
+		float left[3], right[3];
+		for (int k = 0; k < 3; k++) {
+			left[k] = p[0][k] + (p[1][k] - p[0][k]) * t;
+			right[k] = p[3][k] + (p[2][k] - p[3][k]) * t;
+		}
+
+		for (int col = 0; col < size; col++) {
+			float s = static_cast<float>(col) / side;
+			const BSPFile::DispVert& dispVert = dispVerts[dispInfo.dispVertStart + row * size + col];
+			Vertex& vertex = m_grid[row * size + col];
+
+			float flat[3];
+			for (int k = 0; k < 3; k++) {
+				flat[k] = left[k] + (right[k] - left[k]) * s;
+				vertex.pos[k] = flat[k] + dispVert.vec[k] * dispVert.dist;
+				vertex.normal[k] = 0.0f;
+			}
+			SetTexCoords(texInfo, width, height, vertex, flat);
+		}
+	}
+
+	// Same winding as the brush faces around it
+	float faceNormal[3], gridNormal[3];
+	TriangleNormal(p[0], p[1], p[2], faceNormal);
+	TriangleNormal(p[0], p[3], p[1], gridNormal);
+	bool flip = (Dot(faceNormal, frontNormal) > 0.0f) != (Dot(gridNormal, frontNormal) > 0.0f);
+	float outward = Dot(faceNormal, frontNormal) > 0.0f ? 1.0f : -1.0f;
+
+	// Diagonals alternate like the engine's, so the surface doesn't ridge
+	m_triangles.clear();
+	auto addTriangle = [this, flip](uint32_t a, uint32_t b, uint32_t c) {
+		m_triangles.push_back(a);
+		m_triangles.push_back(flip ? c : b);
+		m_triangles.push_back(flip ? b : c);
+	};
+	for (int row = 0; row < side; row++) {
+		for (int col = 0; col < side; col++) {
+			uint32_t a = row * size + col;
+			uint32_t b = a + 1;
+			uint32_t c = a + size + 1;
+			uint32_t d = a + size;
+			if ((row + col) & 1) {
+				addTriangle(a, b, c);
+				addTriangle(a, c, d);
+			} else {
+				addTriangle(a, b, d);
+				addTriangle(b, c, d);
+			}
+		}
+	}
+
+	// Smooth normals, area weighted over the triangles around each vertex
+	for (size_t i = 0; i < m_triangles.size(); i += 3) {
+		Vertex& a = m_grid[m_triangles[i]];
+		Vertex& b = m_grid[m_triangles[i + 1]];
+		Vertex& c = m_grid[m_triangles[i + 2]];
+		float normal[3];
+		TriangleNormal(a.pos, b.pos, c.pos, normal);
+		for (int k = 0; k < 3; k++) {
+			float n = normal[k] * outward;
+			a.normal[k] += n;
+			b.normal[k] += n;
+			c.normal[k] += n;
+		}
+	}
+	for (Vertex& vertex : m_grid) {
+		float length = std::sqrt(Dot(vertex.normal, vertex.normal));
+		for (int k = 0; k < 3; k++) vertex.normal[k] = length > 0.0f ? vertex.normal[k] / length : frontNormal[k];
+	}
+
+	for (uint32_t index : m_triangles) out.push_back(m_grid[index]);
+}
+
+bool WorldMesher::Build(const BSPFile& bsp, float chunkSize) {
+	auto start = std::chrono::steady_clock::now();
+	Clear();
+
+	const std::vector<BSPFile::Face>& faces = bsp.GetFaces();
+	if (!bsp.IsLoaded() || bsp.GetModels().empty() || faces.empty() || bsp.GetVertexes().empty()) return false;
+	chunkSize = (std::max)(chunkSize, 1.0f);
+
+	// The script skipped leafs outside the map, faces only those list
+	// are dropped the same way. Displacements aren't in the leaf lists.
+	std::vector<uint8_t> inMap(faces.size(), 0);
+	bool listed = false;
+	const std::vector<uint16_t>& leafFaces = bsp.GetLeafFaces();
+	for (const BSPFile::Leaf& leaf : bsp.GetLeafs()) {
+		if (leaf.cluster < 0) continue;
+		for (uint32_t k = 0; k < leaf.numLeafFaces; k++) {
+			size_t slot = static_cast<size_t>(leaf.firstLeafFace) + k;
+			if (slot < leafFaces.size() && leafFaces[slot] < faces.size()) {
+				inMap[leafFaces[slot]] = 1;
+				listed = true;
+			}
+		}
+	}
+
+	// Brush entities have their own models, only the world's faces
+	const BSPFile::Model& world = bsp.GetModels()[0];
+	size_t first = static_cast<size_t>((std::max)(world.firstFace, 0));
+	size_t last = (std::min)(first + static_cast<size_t>((std::max)(world.numFaces, 0)), faces.size());
+
+	for (size_t f = first; f < last; f++) {
+		const BSPFile::Face& face = faces[f];
+		if (face.texInfo < 0 || static_cast<size_t>(face.texInfo) >= bsp.GetTexInfos().size()) {
+			m_stats.skipped++;
+			continue;
+		}
+
+		const BSPFile::TexInfo& texInfo = bsp.GetTexInfos()[face.texInfo];
+		bool displacement = face.dispInfo >= 0;
+		if ((texInfo.flags & kSkipFlags) || (!displacement && listed && !inMap[f]) ||
+			!GetFaceVertexes(bsp, static_cast<uint32_t>(f))) {
+			m_stats.skipped++;
+			continue;
+		}
+
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t vertex : m_corners) {
+			for (int k = 0; k < 3; k++) center[k] += bsp.GetVertexes()[vertex][k];
+		}
+		int chunk[3];
+		for (int k = 0; k < 3; k++) chunk[k] = static_cast<int>(std::floor(center[k] / m_corners.size() / chunkSize));
+
+		m_faces.push_back({ (texInfo.flags & kTranslucentFlag) != 0, ChunkKey(chunk[0], chunk[1], chunk[2]), texInfo.texData,
+			static_cast<uint32_t>(f) });
+	}
+
+	std::sort(m_faces.begin(), m_faces.end());
+
+	m_triangleList.clear();
+	for (const FaceRef& ref : m_faces) {
+		if (m_groups.empty() || m_groups.back().translucent != ref.translucent || m_groups.back().chunk != ref.chunk ||
+			m_groups.back().texData != ref.texData) {
+			if (!m_groups.empty()) FinishGroup(m_groups.back());
+			m_groups.push_back({ ref.chunk, ref.texData, ref.translucent, {} });
+		}
+
+		GetFaceVertexes(bsp, ref.face);
+		if (faces[ref.face].dispInfo >= 0) {
+			EmitDisplacement(bsp, ref.face, m_triangleList);
+			m_stats.displacements++;
+		} else {
+			EmitFace(bsp, ref.face, m_triangleList);
+		}
+		m_stats.faces++;
+	}
+	if (!m_groups.empty()) FinishGroup(m_groups.back());
+
+	m_groups.erase(std::remove_if(m_groups.begin(), m_groups.end(), [](const Group& group) { return group.parts.empty(); }), m_groups.end());
+
+	size_t triangles = m_stats.indices / 3;
+	if (triangles > 0) {
+		m_stats.acmrBefore = static_cast<float>(m_missesBefore / triangles);
+		m_stats.acmrAfter = static_cast<float>(m_missesAfter / triangles);
+	}
+
+	// What the vertex and index buffers take, against the old unindexed lists
+	double before = static_cast<double>(m_stats.vertices) * sizeof(Vertex) / (1024.0 * 1024.0);
+	double after = (static_cast<double>(m_stats.welded) * sizeof(Vertex) + static_cast<double>(m_stats.indices) * sizeof(uint16_t)) / (1024.0 * 1024.0);
+
+	m_stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	Msg("[World Mesh] Meshed %u faces (%u displacements, %u skipped) into %u groups, %u parts in %.1f ms\n",
+		static_cast<unsigned>(m_stats.faces), static_cast<unsigned>(m_stats.displacements), static_cast<unsigned>(m_stats.skipped),
+		static_cast<unsigned>(m_groups.size()), static_cast<unsigned>(m_stats.parts), m_stats.milliseconds);
+	Msg("[World Mesh] Welded %u vertices to %u (-%.1f%%), %.2f MB -> %.2f MB with indices, ACMR %.2f -> %.2f\n",
+		static_cast<unsigned>(m_stats.vertices), static_cast<unsigned>(m_stats.welded),
+		m_stats.vertices ? 100.0 * (1.0 - static_cast<double>(m_stats.welded) / m_stats.vertices) : 0.0,
+		before, after, m_stats.acmrBefore, m_stats.acmrAfter);
+	return !m_groups.empty();
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "vertex_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BSPFile;
+
+// Native replacement for the meshed world renderer's BuildMapMeshes.
+//
+// The world model's faces are read straight from the BSP, skipped by the
+// same texinfo flags the script used, and bucketed by chunk, material and
+// translucency under integer keys. Displacements are built from their grids,
+// brush faces are fanned from their first vertex.
+//
+// Each bucket's triangles are then welded on identical position, normal and
+// uv, split into parts that fit 16-bit indices, and every part's triangles
+// are reordered for the vertex cache. The parts stay here until the script
+// has filled its meshes from them.
+class WorldMesher {
+public:
+	// SURF_SKY2D | SKY | TRIGGER | NODRAW | SKIP
+	static constexpr int32_t kSkipFlags = 0x2 | 0x4 | 0x40 | 0x80 | 0x200;
+	// SURF_TRANS
+	static constexpr int32_t kTranslucentFlag = 0x10;
+	// Vertices in one part, the most 16-bit indices can address
+	static constexpr size_t kMaxPartVertices = 65535;
+
+	struct Vertex {
+		float pos[3];
+		float normal[3];
+		float u;
+		float v;
+	};
+
+	struct Part {
+		std::vector<Vertex> vertices;
+		std::vector<uint16_t> indices; // three per triangle
+	};
+
+	struct Group {
+		int64_t chunk; // packed chunk coordinates, see ChunkKey
+		int32_t texData;
+		bool translucent;
+		std::vector<Part> parts;
+	};
+
+	struct Stats {
+		size_t faces = 0;
+		size_t displacements = 0;
+		size_t skipped = 0;
+		size_t vertices = 0; // as triangle lists, before welding
+		size_t welded = 0;
+		size_t indices = 0;
+		size_t parts = 0;
+		float acmrBefore = 0.0f; // vertices transformed per triangle, 32 entry FIFO
+		float acmrAfter = 0.0f;
+		double milliseconds = 0.0;
+	};
+
+	static WorldMesher& Instance();
+
+	// False if the map has no world geometry to mesh
+	bool Build(const BSPFile& bsp, float chunkSize);
+	void Clear();
+
+	// Ordered by translucency, then chunk, then material
+	const std::vector<Group>& GetGroups() const { return m_groups; }
+	const Stats& GetStats() const { return m_stats; }
+
+	// Chunk coordinates packed 17 bits each, so the key is exact as a Lua number
+	static int64_t ChunkKey(int x, int y, int z);
+
+private:
+	WorldMesher() = default;
+
+	struct FaceRef {
+		bool translucent;
+		int64_t chunk;
+		int32_t texData;
+		uint32_t face;
+
+		bool operator<(const FaceRef& other) const;
+	};
+
+	bool GetFaceVertexes(const BSPFile& bsp, uint32_t face);
+	void EmitFace(const BSPFile& bsp, uint32_t face, std::vector<Vertex>& out);
+	void EmitDisplacement(const BSPFile& bsp, uint32_t face, std::vector<Vertex>& out);
+	// Welds, splits and orders the triangle list gathered for the group
+	void FinishGroup(Group& group);
+
+	std::vector<FaceRef> m_faces;
+	std::vector<Group> m_groups;
+	Stats m_stats;
+
+	// Scratch for the face being emitted
+	std::vector<uint32_t> m_corners;
+	std::vector<Vertex> m_grid;
+	std::vector<uint32_t> m_triangles; // into m_grid, three per triangle
+
+	// Scratch for the group being finished
+	std::vector<Vertex> m_triangleList;
+	std::vector<Vertex> m_unique;
+	std::vector<uint32_t> m_welded; // into m_unique, three per triangle
+	std::vector<uint32_t> m_buckets; // open addressing, unique index + 1
+	std::vector<uint32_t> m_partOf;  // part each unique vertex was last given to
+	std::vector<uint16_t> m_local;   // its index in that part
+	VertexCacheOptimizer m_optimizer;
+	double m_missesBefore = 0.0;
+	double m_missesAfter = 0.0;
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include "test_support.h"
+#include "../source/visibility/bsp_file.h"
+
+// Writes a VBSP 20 file out of the lumps the visibility code reads, for
+// trees and brushes small enough to know the answers for
+class BspWriter {
+public:
+	int AddPlane(float nx, float ny, float nz, float dist) {
+		BSPFile::Plane plane = { { nx, ny, nz }, dist, 0 };
+		m_planes.push_back(plane);
+		return static_cast<int>(m_planes.size() - 1);
+	}
+
+	// Children are node indices, or -1 - leaf index as in the file
+	int AddNode(int planeNum, int front = 0, int back = 0) {
+		BSPFile::Node node = {};
+		node.planeNum = planeNum;
+		node.children[0] = front;
+		node.children[1] = back;
+		m_nodes.push_back(node);
+		return static_cast<int>(m_nodes.size() - 1);
+	}
+
+	void SetChild(int node, int side, int child) { m_nodes[node].children[side] = child; }
+
+	// Returns the child id that points at the new leaf
+	int AddLeaf(int cluster, int32_t contents = 0, const std::vector<int>& brushes = {}) {
+		BSPFile::Leaf leaf = {};
+		leaf.contents = contents;
+		leaf.cluster = static_cast<int16_t>(cluster);
+		leaf.firstLeafBrush = static_cast<uint16_t>(m_leafBrushes.size());
+		leaf.numLeafBrushes = static_cast<uint16_t>(brushes.size());
+		for (int brush : brushes) m_leafBrushes.push_back(static_cast<uint16_t>(brush));
+		m_leafs.push_back(leaf);
+		return -1 - static_cast<int>(m_leafs.size() - 1);
+	}
+
+	// Surface flags only, the texture vectors stay zero
+	int AddTexInfo(int32_t flags) {
+		m_texInfoFlags.push_back(flags);
+		return static_cast<int>(m_texInfoFlags.size() - 1);
+	}
+
+	// Axis aligned box, six sides with outward planes. Returns the brush
+	// index for AddLeaf.
+	int AddBoxBrush(const float mins[3], const float maxs[3], int32_t contents = 1, int texInfo = -1) {
+		BSPFile::Brush brush = { static_cast<int32_t>(m_brushSides.size()), 6, contents };
+		for (int axis = 0; axis < 3; axis++) {
+			float normal[3] = { 0.0f, 0.0f, 0.0f };
+			normal[axis] = 1.0f;
+			int front = AddPlane(normal[0], normal[1], normal[2], maxs[axis]);
+			int back = AddPlane(-normal[0], -normal[1], -normal[2], -mins[axis]);
+			for (int plane : { front, back }) {
+				BSPFile::BrushSide side = {};
+				side.planeNum = static_cast<uint16_t>(plane);
+				side.texInfo = static_cast<int16_t>(texInfo);
+				side.dispInfo = -1;
+				m_brushSides.push_back(side);
+			}
+		}
+		m_brushes.push_back(brush);
+		return static_cast<int>(m_brushes.size() - 1);
+	}
+
+	// World model, the tree starts at headNode
+	void SetHeadNode(int headNode) { m_headNode = headNode; }
+
+	size_t GetNodeCount() const { return m_nodes.size(); }
+	size_t GetLeafCount() const { return m_leafs.size(); }
+
+	std::vector<uint8_t> Build() const {
+		std::vector<uint8_t> lumps[BSPFile::Lump_Count];
+		uint32_t versions[BSPFile::Lump_Count] = {};
+
+		for (const BSPFile::Plane& plane : m_planes) {
+			Append(lumps[BSPFile::Lump_Planes], plane.normal, sizeof(plane.normal));
+			Append(lumps[BSPFile::Lump_Planes], &plane.dist, 4);
+			Append(lumps[BSPFile::Lump_Planes], &plane.type, 4);
+		}
+
+		for (const BSPFile::Node& node : m_nodes) {
+			std::vector<uint8_t>& out = lumps[BSPFile::Lump_Nodes];
+			Append(out, &node.planeNum, 4);
+			Append(out, node.children, 8);
+			Append(out, node.mins, 6);
+			Append(out, node.maxs, 6);
+			Pad(out, 8); // faces, area and padding
+		}
+
+		// Version 1 leafs, no lighting cube
+		versions[BSPFile::Lump_Leafs] = 1;
+		for (const BSPFile::Leaf& leaf : m_leafs) {
+			std::vector<uint8_t>& out = lumps[BSPFile::Lump_Leafs];
+			Append(out, &leaf.contents, 4);
+			Append(out, &leaf.cluster, 2);
+			Append(out, &leaf.area, 2);
+			Append(out, leaf.mins, 6);
+			Append(out, leaf.maxs, 6);
+			Append(out, &leaf.firstLeafFace, 2);
+			Append(out, &leaf.numLeafFaces, 2);
+			Append(out, &leaf.firstLeafBrush, 2);
+			Append(out, &leaf.numLeafBrushes, 2);
+			Pad(out, 4);
+		}
+
+		Append(lumps[BSPFile::Lump_LeafBrushes], m_leafBrushes.data(), m_leafBrushes.size() * sizeof(uint16_t));
+		for (const BSPFile::Brush& brush : m_brushes) {
+			Append(lumps[BSPFile::Lump_Brushes], &brush, sizeof(brush));
+		}
+		for (const BSPFile::BrushSide& side : m_brushSides) {
+			std::vector<uint8_t>& out = lumps[BSPFile::Lump_BrushSides];
+			Append(out, &side.planeNum, 2);
+			Append(out, &side.texInfo, 2);
+			Append(out, &side.dispInfo, 2);
+			Append(out, &side.bevel, 1);
+			Pad(out, 1);
+		}
+		for (int32_t flags : m_texInfoFlags) {
+			std::vector<uint8_t>& out = lumps[BSPFile::Lump_TexInfo];
+			Pad(out, 64); // texture and lightmap vectors
+			Append(out, &flags, 4);
+			Pad(out, 4);
+		}
+
+		BSPFile::Model world = {};
+		world.headNode = m_headNode;
+		Append(lumps[BSPFile::Lump_Models], &world, sizeof(world));
+
+		// Header: ident, version, 64 lump entries and the map revision
+		const size_t headerSize = 8 + BSPFile::Lump_Count * 16 + 4;
+		std::vector<uint8_t> file(headerSize, 0);
+		const uint32_t ident = 0x50534256, version = 20;
+		memcpy(file.data(), &ident, 4);
+		memcpy(file.data() + 4, &version, 4);
+		for (size_t i = 0; i < BSPFile::Lump_Count; i++) {
+			uint32_t entry[3] = { static_cast<uint32_t>(file.size()), static_cast<uint32_t>(lumps[i].size()), versions[i] };
+			memcpy(file.data() + 8 + i * 16, entry, sizeof(entry));
+			file.insert(file.end(), lumps[i].begin(), lumps[i].end());
+		}
+		return file;
+	}
+
+private:
+	static void Append(std::vector<uint8_t>& out, const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	}
+
+	static void Pad(std::vector<uint8_t>& out, size_t size) { out.insert(out.end(), size, 0); }
+
+	std::vector<BSPFile::Plane> m_planes;
+	std::vector<BSPFile::Node> m_nodes;
+	std::vector<BSPFile::Leaf> m_leafs;
+	std::vector<uint16_t> m_leafBrushes;
+	std::vector<BSPFile::Brush> m_brushes;
+	std::vector<BSPFile::BrushSide> m_brushSides;
+	std::vector<int32_t> m_texInfoFlags;
+	int m_headNode = 0;
+};
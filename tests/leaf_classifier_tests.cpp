@@ -0,0 +1,174 @@
+// LeafClassifier against BSPFile::FindLeaf on random node trees, then both
+// timed over the same batch of points.
+//
+//   leaf_classifier_tests
+//
+// Trees mix axial planes at whole units with slanted ones, and a share of
+// the points sit on whole units so they land exactly on the axial planes,
+// where both have to pick the front.
+#include "bsp_support.h"
+#include "../source/visibility/leaf_classifier.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+	constexpr int kTrees = 8;
+	constexpr int kMaxDepth = 14;
+	constexpr float kExtent = 4096.0f;
+	constexpr size_t kTimedPoints = 200000;
+	constexpr int kRepeats = 10;
+
+	struct Random {
+		uint32_t state;
+
+		uint32_t Next() {
+			state = state * 1664525u + 1013904223u;
+			return state >> 8;
+		}
+
+		// [-1, 1)
+		float Signed() { return (Next() & 0xFFFF) / 32768.0f - 1.0f; }
+	};
+
+	int BuildTree(BspWriter& writer, Random& random, int depth) {
+		// Thin out towards the bottom, so leafs sit at every depth
+		if (depth >= kMaxDepth || (depth > 2 && random.Next() % 8 == 0)) {
+			return writer.AddLeaf(static_cast<int>(random.Next() % 257) - 1);
+		}
+
+		int plane;
+		if (random.Next() % 2) {
+			float normal[3] = { 0.0f, 0.0f, 0.0f };
+			normal[random.Next() % 3] = 1.0f;
+			float dist = std::round(random.Signed() * kExtent);
+			plane = writer.AddPlane(normal[0], normal[1], normal[2], dist);
+		} else {
+			float x = random.Signed(), y = random.Signed(), z = random.Signed();
+			float length = sqrtf(x * x + y * y + z * z) + 1e-3f;
+			plane = writer.AddPlane(x / length, y / length, z / length, random.Signed() * kExtent);
+		}
+
+		int node = writer.AddNode(plane);
+		writer.SetChild(node, 0, BuildTree(writer, random, depth + 1));
+		writer.SetChild(node, 1, BuildTree(writer, random, depth + 1));
+		return node;
+	}
+
+	std::vector<std::array<float, 3>> MakePoints(Random& random, size_t count) {
+		std::vector<std::array<float, 3>> points(count);
+		for (size_t i = 0; i < count; i++) {
+			for (float& v : points[i]) {
+				v = random.Signed() * kExtent;
+				if (i % 4 == 0) v = std::round(v);
+			}
+		}
+		return points;
+	}
+
+	void CheckBatch(const char* name, const BSPFile& bsp, const std::vector<std::array<float, 3>>& points, size_t count) {
+		LeafClassifier classifier;
+		std::vector<int> leafs(count + 1, -2), clusters(count + 1, -2);
+		classifier.Classify(bsp, reinterpret_cast<const float (*)[3]>(points.data()), count, leafs.data(), clusters.data());
+
+		size_t wrong = 0;
+		for (size_t i = 0; i < count; i++) {
+			int leaf = bsp.FindLeaf(points[i].data());
+			int cluster = bsp.FindCluster(points[i].data());
+			if (leafs[i] != leaf || clusters[i] != cluster) {
+				if (wrong++ < 5) {
+					CHECK(false, "%s: point %zu (%g %g %g) in leaf %d cluster %d, FindLeaf says %d cluster %d", name, i,
+						points[i][0], points[i][1], points[i][2], leafs[i], clusters[i], leaf, cluster);
+				}
+			}
+		}
+		CHECK(wrong == 0, "%s: %zu of %zu points differ", name, wrong, count);
+		CHECK(leafs[count] == -2 && clusters[count] == -2, "%s: wrote past %zu points", name, count);
+	}
+
+	void CheckTrees() {
+		Random random = { 12345 };
+		for (int tree = 0; tree < kTrees; tree++) {
+			BspWriter writer;
+			writer.SetHeadNode(BuildTree(writer, random, 0));
+			std::vector<uint8_t> file = writer.Build();
+
+			BSPFile bsp;
+			CHECK(bsp.Load(file.data(), file.size()), "tree %d does not load: %s", tree, bsp.GetError().c_str());
+			CHECK(bsp.GetNodes().size() == writer.GetNodeCount() && bsp.GetLeafs().size() == writer.GetLeafCount(),
+				"tree %d: %zu nodes and %zu leafs read back", tree, bsp.GetNodes().size(), bsp.GetLeafs().size());
+
+			char name[32];
+			snprintf(name, sizeof(name), "tree %d", tree);
+			// Batches that are not a multiple of the SIMD width
+			std::vector<std::array<float, 3>> points = MakePoints(random, 4099);
+			for (size_t count : { 1, 2, 3, 5, 4099 }) {
+				CheckBatch(name, bsp, points, count);
+			}
+		}
+	}
+
+	// Children past the end of the tree give -1, as FindLeaf does
+	void CheckBrokenTree() {
+		BspWriter writer;
+		int plane = writer.AddPlane(1.0f, 0.0f, 0.0f, 0.0f);
+		int front = writer.AddLeaf(3);
+		writer.SetHeadNode(writer.AddNode(plane, front, -1 - 1000));
+		std::vector<uint8_t> file = writer.Build();
+
+		BSPFile bsp;
+		CHECK(bsp.Load(file.data(), file.size()), "broken tree does not load: %s", bsp.GetError().c_str());
+
+		std::vector<std::array<float, 3>> points = { { { 10.0f, 0.0f, 0.0f } }, { { -10.0f, 0.0f, 0.0f } }, { { 0.0f, 5.0f, 5.0f } } };
+		CheckBatch("broken tree", bsp, points, points.size());
+
+		// Nothing loaded, every point is outside
+		BSPFile empty;
+		LeafClassifier classifier;
+		int leafs[3], clusters[3];
+		classifier.Classify(empty, reinterpret_cast<const float (*)[3]>(points.data()), 3, leafs, clusters);
+		CHECK(leafs[0] == -1 && leafs[2] == -1 && clusters[1] == -1, "points classified without a map");
+	}
+
+	void TimeClassify() {
+		Random random = { 777 };
+		BspWriter writer;
+		writer.SetHeadNode(BuildTree(writer, random, 0));
+		std::vector<uint8_t> file = writer.Build();
+		BSPFile bsp;
+		bsp.Load(file.data(), file.size());
+
+		std::vector<std::array<float, 3>> points = MakePoints(random, kTimedPoints);
+		const float (*raw)[3] = reinterpret_cast<const float (*)[3]>(points.data());
+		std::vector<int> leafs(kTimedPoints);
+
+		LeafClassifier classifier;
+		double single = 0.0, batch = 0.0;
+		for (int repeat = 0; repeat < kRepeats; repeat++) {
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < kTimedPoints; i++) {
+				leafs[i] = bsp.FindLeaf(raw[i]);
+			}
+			double elapsed = MillisecondsSince(start);
+			single = repeat ? std::min(single, elapsed) : elapsed;
+
+			start = std::chrono::steady_clock::now();
+			classifier.Classify(bsp, raw, kTimedPoints, leafs.data(), nullptr);
+			elapsed = MillisecondsSince(start);
+			batch = repeat ? std::min(batch, elapsed) : elapsed;
+		}
+
+		printf("%zu nodes, %zu points: FindLeaf %.2f ms (%.1f ns/point), Classify %.2f ms (%.1f ns/point), %.2fx\n",
+			bsp.GetNodes().size(), kTimedPoints, single, single * 1e6 / kTimedPoints, batch, batch * 1e6 / kTimedPoints,
+			single / batch);
+	}
+}
+
+int main() {
+	CheckTrees();
+	CheckBrokenTree();
+	TimeClassify();
+
+	printf("%d failures\n", g_failures);
+	return g_failures ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+// OcclusionBuffer with known occluders in camera space, OcclusionCuller on
+// a map of box brushes written by BspWriter, then the culler timed on a
+// grid of pillars.
+//
+//   occlusion_tests
+//
+// The buffer has to be conservative: an occluder never claims a pixel it
+// only partly covers, and a test is only occluded if every pixel in its
+// rectangle has something in front of it.
+#include "bsp_support.h"
+#include "../source/visibility/occlusion_buffer.h"
+#include "../source/visibility/occlusion_culler.h"
+#include <cmath>
+
+namespace {
+	constexpr int kGridSize = 32;
+	constexpr float kGridSpacing = 256.0f;
+	constexpr int kTimedUpdates = 50;
+	constexpr size_t kTimedTests = 20000;
+
+	float DepthAt(const OcclusionBuffer& buffer, int x, int y) {
+		return buffer.GetDepth()[static_cast<size_t>(y) * OcclusionBuffer::kWidth + x];
+	}
+
+	// Square facing the camera at depth z, half size h
+	void AddSquare(OcclusionBuffer& buffer, float cx, float cy, float h, float z) {
+		const float square[4][3] = {
+			{ cx - h, cy - h, z },
+			{ cx + h, cy - h, z },
+			{ cx + h, cy + h, z },
+			{ cx - h, cy + h, z },
+		};
+		buffer.AddPolygon(square, 4);
+	}
+
+	bool IsBoxVisible(const OcclusionBuffer& buffer, const float mins[3], const float maxs[3]) {
+		float corners[8][3];
+		for (int i = 0; i < 8; i++) {
+			corners[i][0] = (i & 1) ? maxs[0] : mins[0];
+			corners[i][1] = (i & 2) ? maxs[1] : mins[1];
+			corners[i][2] = (i & 4) ? maxs[2] : mins[2];
+		}
+		return buffer.ArePointsVisible(corners, 8);
+	}
+
+	void CheckBuffer() {
+		// 90 degrees both ways, so a square of half size z/2 covers the
+		// middle half of the screen: columns 64-191, rows 32-95
+		OcclusionBuffer single, banded;
+		for (OcclusionBuffer* buffer : { &single, &banded }) {
+			buffer->Begin(1.0f, 1.0f, 1.0f);
+			AddSquare(*buffer, 0.0f, 0.0f, 50.0f, 100.0f);
+			// Farther and larger, only shows around the first one
+			AddSquare(*buffer, 0.0f, 0.0f, 240.0f, 300.0f);
+		}
+		single.Render(1);
+		banded.Render(4);
+
+		CHECK(single.GetTriangleCount() == 4, "%zu triangles drawn", single.GetTriangleCount());
+		CHECK(memcmp(single.GetDepth(), banded.GetDepth(), sizeof(float) * OcclusionBuffer::kWidth * OcclusionBuffer::kHeight) == 0,
+			"four bands draw differently from one");
+
+		CHECK(std::fabs(DepthAt(single, 128, 64) - 0.01f) < 1e-6f, "centre 1/z %g, the nearest square is 0.01", DepthAt(single, 128, 64));
+		CHECK(std::fabs(DepthAt(single, 66, 64) - 0.01f) < 1e-6f, "just inside the near square 1/z %g", DepthAt(single, 66, 64));
+		CHECK(std::fabs(DepthAt(single, 62, 64) - 1.0f / 300.0f) < 1e-6f, "just outside the near square 1/z %g", DepthAt(single, 62, 64));
+		CHECK(DepthAt(single, 1, 1) == 0.0f, "corner 1/z %g, nothing covers it", DepthAt(single, 1, 1));
+
+		// Every pixel inside the near square, including along the diagonal
+		// its triangles would share
+		size_t gaps = 0;
+		for (int y = 33; y < 95; y++) {
+			for (int x = 65; x < 191; x++) {
+				if (std::fabs(DepthAt(single, x, y) - 0.01f) > 1e-6f) gaps++;
+			}
+		}
+		CHECK(gaps == 0, "%zu pixels inside the near square are not at its depth", gaps);
+
+		struct Query {
+			const char* name;
+			float mins[3];
+			float maxs[3];
+			bool visible;
+		};
+		const Query queries[] = {
+			{ "behind the near square", { -20, -20, 200 }, { 20, 20, 220 }, false },
+			{ "behind both squares", { -100, -100, 400 }, { 100, 100, 420 }, false },
+			{ "in front of the near square", { -5, -5, 50 }, { 5, 5, 60 }, true },
+			{ "between the squares, sticking out", { 60, -10, 200 }, { 150, 10, 210 }, true },
+			{ "past the far square's edge", { 300, -10, 400 }, { 400, 10, 410 }, true },
+			{ "through the near plane", { -5, -5, 0.5f }, { 5, 5, 300 }, true },
+			{ "off screen", { 500, -10, 200 }, { 600, 10, 210 }, true },
+		};
+		for (const Query& query : queries) {
+			CHECK(IsBoxVisible(single, query.mins, query.maxs) == query.visible, "%s is %s", query.name,
+				query.visible ? "hidden" : "visible");
+		}
+
+		// Begin starts over
+		single.Begin(1.0f, 1.0f, 1.0f);
+		single.Render(1);
+		CHECK(IsBoxVisible(single, queries[0].mins, queries[0].maxs), "hidden after clearing");
+	}
+
+	OcclusionCuller::View MakeView(const float origin[3]) {
+		// Looking down +x
+		OcclusionCuller::View view = {
+			{ origin[0], origin[1], origin[2] },
+			{ 1.0f, 0.0f, 0.0f },
+			{ 0.0f, -1.0f, 0.0f },
+			{ 0.0f, 0.0f, 1.0f },
+			90.0f,
+			16.0f / 9.0f,
+		};
+		return view;
+	}
+
+	// One leaf holding every brush, behind a single node
+	std::vector<uint8_t> FinishMap(BspWriter& writer, const std::vector<int>& worldBrushes) {
+		int plane = writer.AddPlane(1.0f, 0.0f, 0.0f, -100000.0f);
+		int world = writer.AddLeaf(0, 0, worldBrushes);
+		int outside = writer.AddLeaf(-1);
+		writer.SetHeadNode(writer.AddNode(plane, world, outside));
+		return writer.Build();
+	}
+
+	void CheckCuller() {
+		BspWriter writer;
+		const float wallMins[3] = { 500, -512, -512 }, wallMaxs[3] = { 532, 512, 512 };
+		const float trimMins[3] = { 300, -8, -8 }, trimMaxs[3] = { 316, 8, 8 };
+		const float skyMins[3] = { 250, -512, -512 }, skyMaxs[3] = { 260, 512, 512 };
+		const float doorMins[3] = { 100, -512, -512 }, doorMaxs[3] = { 110, 512, 512 };
+
+		int wall = writer.AddBoxBrush(wallMins, wallMaxs);
+		// Too small, sky on every side, and outside the world tree
+		int trim = writer.AddBoxBrush(trimMins, trimMaxs);
+		int sky = writer.AddBoxBrush(skyMins, skyMaxs, 1, writer.AddTexInfo(0x4));
+		writer.AddBoxBrush(doorMins, doorMaxs);
+		std::vector<uint8_t> file = FinishMap(writer, { wall, trim, sky });
+
+		BSPFile bsp;
+		CHECK(bsp.Load(file.data(), file.size()), "map does not load: %s", bsp.GetError().c_str());
+
+		OcclusionCuller& culler = OcclusionCuller::Instance();
+		CHECK(culler.IsBoxVisible(wallMins, wallMaxs), "box hidden before any update");
+
+		culler.BuildOccluders(bsp);
+		CHECK(culler.GetOccluderCount() == 1, "%zu occluders, only the wall is one", culler.GetOccluderCount());
+
+		const float origin[3] = { 0.0f, 0.0f, 0.0f };
+		culler.Update(MakeView(origin));
+		CHECK(culler.IsValid() && culler.GetStats().occluders == 1, "wall not drawn");
+
+		const float behindMins[3] = { 800, -50, -50 }, behindMaxs[3] = { 840, 50, 50 };
+		const float frontMins[3] = { 200, -50, -50 }, frontMaxs[3] = { 240, 50, 50 };
+		const float besideMins[3] = { 800, 900, -10 }, besideMaxs[3] = { 820, 950, 10 };
+		CHECK(!culler.IsBoxVisible(behindMins, behindMaxs), "box behind the wall is visible");
+		CHECK(culler.IsBoxVisible(frontMins, frontMaxs), "box in front of the wall is hidden");
+		CHECK(culler.IsBoxVisible(besideMins, besideMaxs), "box past the wall's end is hidden");
+
+		const float behind[3] = { 900, 0, 0 }, front[3] = { 200, 0, 0 };
+		CHECK(!culler.IsSphereVisible(behind, 20.0f), "sphere behind the wall is visible");
+		CHECK(culler.IsSphereVisible(front, 20.0f), "sphere in front of the wall is hidden");
+		CHECK(culler.GetStats().tested == 5 && culler.GetStats().occluded == 2, "%zu tested, %zu occluded",
+			culler.GetStats().tested, culler.GetStats().occluded);
+
+		// From the far side the wall is behind the camera
+		const float past[3] = { 1000, 0, 0 };
+		culler.Update(MakeView(past));
+		CHECK(culler.IsBoxVisible(behindMins, behindMaxs) && culler.GetStats().occluders == 0, "wall behind the camera hides things");
+
+		culler.Clear();
+		CHECK(culler.IsBoxVisible(behindMins, behindMaxs), "box hidden after Clear");
+	}
+
+	void TimeCuller() {
+		// Pillars on a grid, the camera at one corner looking across it
+		BspWriter writer;
+		std::vector<int> brushes;
+		for (int x = 0; x < kGridSize; x++) {
+			for (int y = 0; y < kGridSize; y++) {
+				float mins[3] = { x * kGridSpacing, y * kGridSpacing, 0.0f };
+				float maxs[3] = { mins[0] + 128.0f, mins[1] + 128.0f, 512.0f };
+				brushes.push_back(writer.AddBoxBrush(mins, maxs));
+			}
+		}
+		std::vector<uint8_t> file = FinishMap(writer, brushes);
+
+		BSPFile bsp;
+		bsp.Load(file.data(), file.size());
+
+		OcclusionCuller& culler = OcclusionCuller::Instance();
+		auto start = std::chrono::steady_clock::now();
+		culler.BuildOccluders(bsp);
+		double build = MillisecondsSince(start);
+
+		const float origin[3] = { -200.0f, 192.0f, 64.0f };
+		OcclusionCuller::View view = MakeView(origin);
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < kTimedUpdates; i++) {
+			culler.Update(view);
+		}
+		double update = MillisecondsSince(start) / kTimedUpdates;
+		size_t occluders = culler.GetStats().occluders, triangles = culler.GetStats().triangles;
+
+		// Small boxes spread over the grid, most of them hidden
+		uint32_t state = 99;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < kTimedTests; i++) {
+			state = state * 1664525u + 1013904223u;
+			float mins[3] = { static_cast<float>((state >> 8) % 8000), static_cast<float>((state >> 4) % 8000), 32.0f };
+			float maxs[3] = { mins[0] + 32.0f, mins[1] + 32.0f, 96.0f };
+			culler.IsBoxVisible(mins, maxs);
+		}
+		double tests = MillisecondsSince(start);
+
+		printf("%zu occluders built in %.2f ms, update %.3f ms (%zu drawn, %zu triangles), %zu box tests %.2f ms (%zu hidden)\n",
+			culler.GetOccluderCount(), build, update, occluders, triangles, kTimedTests, tests, culler.GetStats().occluded);
+		CHECK(culler.GetOccluderCount() == brushes.size(), "%zu of %zu pillars are occluders", culler.GetOccluderCount(), brushes.size());
+		CHECK(culler.GetStats().occluded > 0, "the grid hides nothing");
+		culler.Clear();
+	}
+}
+
+int main() {
+	CheckBuffer();
+	CheckCuller();
+	TimeCuller();
+
+	printf("%d failures\n", g_failures);
+	return g_failures ? 1 : 0;
+}
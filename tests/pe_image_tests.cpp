@@ -0,0 +1,238 @@
+// PEImage and the section-aware parallel scan, on real PE images read from
+// disk.
+//
+//   pe_image_tests <image.dll|exe> ...
+//
+// Each image is parsed as a file, then laid out at its RVAs the way the
+// loader would and parsed again as a mapped image; both must describe the
+// same sections and bytes. Scans limited to the executable sections, and
+// split across threads, must find what a serial scan of the same spans does.
+#include "test_support.h"
+#include "../source/signatures/pe_image.h"
+#include "../source/signatures/signature.h"
+#include <algorithm>
+
+namespace {
+	constexpr size_t kGeneratedSignatures = 32;
+	const size_t kThreadCounts[] = { 1, 2, 4, 16 };
+
+	// Sections copied to their virtual addresses, headers up to the first section
+	std::vector<uint8_t> MapImage(const PEImage& image, const std::vector<uint8_t>& file) {
+		std::vector<uint8_t> mapped(image.GetSizeOfImage(), 0);
+
+		size_t headers = file.size();
+		for (const PEImage::Section& section : image.GetSections()) {
+			if (section.rawSize) headers = std::min<size_t>(headers, section.rawOffset);
+		}
+		memcpy(mapped.data(), file.data(), std::min(headers, mapped.size()));
+
+		for (const PEImage::Section& section : image.GetSections()) {
+			if (section.rawOffset >= file.size() || section.virtualAddress >= mapped.size()) continue;
+			size_t length = section.virtualSize ? std::min(section.rawSize, section.virtualSize) : section.rawSize;
+			length = std::min({ length, file.size() - section.rawOffset, mapped.size() - section.virtualAddress });
+			memcpy(mapped.data() + section.virtualAddress, file.data() + section.rawOffset, length);
+		}
+		return mapped;
+	}
+
+	void CheckLayouts(const char* path, const PEImage& file, const std::vector<uint8_t>& fileData) {
+		std::vector<uint8_t> mappedData = MapImage(file, fileData);
+		PEImage mapped;
+		if (!mapped.Parse(mappedData.data(), mappedData.size(), PEImage::Layout::Mapped)) {
+			CHECK(false, "%s: the mapped copy does not parse", path);
+			return;
+		}
+
+		CHECK(mapped.GetMachine() == file.GetMachine(), "%s", path);
+		CHECK(mapped.GetTimeDateStamp() == file.GetTimeDateStamp(), "%s", path);
+		CHECK(mapped.GetHeaderHash() == file.GetHeaderHash(), "%s: header hash differs between layouts", path);
+		CHECK(mapped.GetSections().size() == file.GetSections().size(), "%s", path);
+
+		for (size_t i = 0; i < file.GetSections().size() && i < mapped.GetSections().size(); i++) {
+			const PEImage::Section& section = file.GetSections()[i];
+			CHECK(strcmp(section.name, mapped.GetSections()[i].name) == 0, "%s: section %zu", path, i);
+			if (!section.IsExecutable()) continue;
+
+			const uint8_t *fileBegin, *mappedBegin;
+			size_t fileSize, mappedSize;
+			bool inFile = file.GetSectionSpan(section, fileBegin, fileSize);
+			bool inMapped = mapped.GetSectionSpan(section, mappedBegin, mappedSize);
+			CHECK(inFile && inMapped, "%s: executable section %s has no span", path, section.name);
+			if (!inFile || !inMapped) continue;
+
+			CHECK(fileBegin == fileData.data() + section.rawOffset, "%s: %s", path, section.name);
+			CHECK(mappedBegin == mappedData.data() + section.virtualAddress, "%s: %s", path, section.name);
+
+			size_t common = std::min(fileSize, mappedSize);
+			CHECK(memcmp(fileBegin, mappedBegin, common) == 0, "%s: %s differs between layouts", path, section.name);
+		}
+	}
+
+	// First hit over the executable spans in address order, one job at a time
+	const uint8_t* SerialScan(const std::vector<std::pair<const uint8_t*, size_t>>& spans, const SignatureScanJob& job) {
+		for (const auto& span : spans) {
+			const uint8_t* end = std::min(span.first + span.second, job.end);
+			if (const uint8_t* found = FindSignature(span.first, end, job.pattern)) return found;
+		}
+		return nullptr;
+	}
+
+	void CheckScan(const char* path, const PEImage& image, const std::vector<uint8_t>& data,
+		const std::vector<std::pair<const uint8_t*, size_t>>& spans) {
+		// Cut from the code, plus the shipped ones that mostly miss
+		std::vector<std::string> sources(std::begin(kShippedSignatures), std::end(kShippedSignatures));
+		for (const auto& span : spans) {
+			std::vector<std::string> generated = MakeSignatures(span.first, span.second, kGeneratedSignatures,
+				static_cast<uint32_t>(span.second));
+			sources.insert(sources.end(), generated.begin(), generated.end());
+		}
+
+		std::vector<CompiledSignature> compiled(sources.size());
+		std::vector<SignatureScanJob> jobs(sources.size());
+		for (size_t i = 0; i < sources.size(); i++) {
+			compiled[i].Compile(sources[i].c_str(), sources[i].size());
+			jobs[i].pattern = compiled[i].GetPattern();
+			jobs[i].end = data.data() + data.size() - sources[i].size();
+		}
+
+		size_t hits = 0;
+		for (size_t threads : kThreadCounts) {
+			ScanImage(image, data.data(), data.size(), jobs.data(), jobs.size(), false, threads);
+			for (size_t i = 0; i < jobs.size(); i++) {
+				const uint8_t* expected = SerialScan(spans, jobs[i]);
+				CHECK(jobs[i].result == expected, "%s: '%s' with %zu threads", path, sources[i].c_str(), threads);
+				if (threads == 1 && expected) hits++;
+			}
+
+			ScanImage(image, data.data(), data.size(), jobs.data(), jobs.size(), true, threads);
+			for (size_t i = 0; i < jobs.size(); i++) {
+				const uint8_t* expected = FindSignature(data.data(), jobs[i].end, jobs[i].pattern);
+				CHECK(jobs[i].result == expected, "%s: '%s' all sections, %zu threads", path, sources[i].c_str(), threads);
+			}
+		}
+		CHECK(hits >= sources.size() - std::size(kShippedSignatures),
+			"%s: only %zu of the signatures cut from the code were found", path, hits);
+	}
+
+	void CheckMalformed(const std::vector<uint8_t>& data) {
+		PEImage image;
+		CHECK(!image.Parse(nullptr, 0, PEImage::Layout::File), "null span");
+		CHECK(!image.Parse(data.data(), 0x40, PEImage::Layout::File), "truncated to the DOS header");
+
+		std::vector<uint8_t> broken = data;
+		broken[0] = 'X';
+		CHECK(!image.Parse(broken.data(), broken.size(), PEImage::Layout::File), "bad DOS magic");
+
+		broken = data;
+		uint32_t ntOffset;
+		memcpy(&ntOffset, data.data() + 0x3C, sizeof(ntOffset));
+		broken[ntOffset] = 'X';
+		CHECK(!image.Parse(broken.data(), broken.size(), PEImage::Layout::File), "bad NT signature");
+
+		broken = data;
+		uint32_t farAway = 0x7FFFFFF0;
+		memcpy(broken.data() + 0x3C, &farAway, sizeof(farAway));
+		CHECK(!image.Parse(broken.data(), broken.size(), PEImage::Layout::File), "NT header past the end");
+	}
+
+	std::string CutSignature(const uint8_t* data, size_t length) {
+		std::string sig;
+		for (size_t i = 0; i < length; i++) {
+			char byte[4];
+			snprintf(byte, sizeof(byte), i ? " %02X" : "%02X", data[i]);
+			sig += byte;
+		}
+		return sig;
+	}
+
+	// Chunked scanning only kicks in past a megabyte per chunk, far more than
+	// one small image. The images are scanned back to back as one span,
+	// repeated with every copy xored differently until there is enough for
+	// nine chunks, so signatures cut from a later copy only hit there.
+	void CheckParallelChunks(const std::vector<uint8_t>& images) {
+		const size_t kTargetSize = 9 * 1024 * 1024;
+		std::vector<uint8_t> combined;
+		for (uint8_t copy = 0; combined.size() < kTargetSize; copy++) {
+			for (uint8_t byte : images) combined.push_back(byte ^ static_cast<uint8_t>(copy * 0x5B));
+		}
+
+		std::vector<std::string> sources(std::begin(kShippedSignatures), std::end(kShippedSignatures));
+		std::vector<std::string> generated = MakeSignatures(combined.data(), combined.size(), 64, 1234567u);
+		sources.insert(sources.end(), generated.begin(), generated.end());
+
+		// And some that straddle the chunk boundaries
+		for (size_t chunks : kThreadCounts) {
+			for (size_t c = 1; c < chunks; c++) {
+				size_t boundary = combined.size() * c / chunks;
+				sources.push_back(CutSignature(combined.data() + boundary - 5, 12));
+			}
+		}
+
+		std::vector<CompiledSignature> compiled(sources.size());
+		std::vector<SignatureScanJob> serial(sources.size());
+		for (size_t i = 0; i < sources.size(); i++) {
+			compiled[i].Compile(sources[i].c_str(), sources[i].size());
+			serial[i].pattern = compiled[i].GetPattern();
+			serial[i].end = combined.data() + combined.size() - sources[i].size();
+		}
+		std::vector<SignatureScanJob> parallel = serial;
+		FindSignatures(combined.data(), serial.data(), serial.size());
+
+		for (size_t threads : kThreadCounts) {
+			for (SignatureScanJob& job : parallel) job.result = nullptr;
+			FindSignaturesParallel(combined.data(), combined.data() + combined.size(), parallel.data(), parallel.size(), threads);
+			for (size_t i = 0; i < sources.size(); i++) {
+				CHECK(parallel[i].result == serial[i].result, "'%s' over %zu bytes with %zu threads",
+					sources[i].c_str(), combined.size(), threads);
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	std::vector<uint8_t> combined;
+	int images = 0;
+	for (int i = 1; i < argc; i++) {
+		std::vector<uint8_t> data;
+		if (!ReadWholeFile(argv[i], data)) {
+			printf("Skipping %s, unreadable\n", argv[i]);
+			continue;
+		}
+		const char* name = strrchr(argv[i], '/');
+		name = name ? name + 1 : argv[i];
+
+		PEImage image;
+		if (!image.Parse(data.data(), data.size(), PEImage::Layout::File)) {
+			CHECK(false, "%s does not parse as a PE file", name);
+			continue;
+		}
+
+		std::vector<std::pair<const uint8_t*, size_t>> spans;
+		size_t executable = image.GetExecutableSpans(spans);
+		CHECK(executable > 0, "%s has no executable section", name);
+		for (const auto& span : spans) {
+			CHECK(span.first >= data.data() && span.first + span.second <= data.data() + data.size(),
+				"%s: executable span outside the file", name);
+		}
+
+		printf("%-28s machine %04X, %zu sections, %zu executable, image %u bytes\n", name, image.GetMachine(),
+			image.GetSections().size(), executable, image.GetSizeOfImage());
+
+		CheckLayouts(name, image, data);
+		CheckScan(name, image, data, spans);
+		if (images == 0) CheckMalformed(data);
+
+		combined.insert(combined.end(), data.begin(), data.end());
+		images++;
+	}
+
+	if (images == 0) {
+		printf("No PE images given, set RTX_FIXES_PE_FILES when configuring\n");
+		return kSkipExitCode;
+	}
+
+	CheckParallelChunks(combined);
+
+	printf("%d images, %d failures\n", images, g_failures);
+	return g_failures ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+// PortalVisibility::Update on the .prt files the addon ships, one view per
+// cluster and direction, the way the RenderScene hook runs it every frame.
+//
+//   portal_flow_bench <map.prt> ...
+#include "portal_support.h"
+#include <algorithm>
+
+namespace {
+	constexpr int kYawSteps = 8;
+	constexpr int kRepeats = 3;
+
+	void BenchMap(const char* path) {
+		PortalVisibility& portals = PortalVisibility::Instance();
+		const PortalGraph& graph = portals.GetGraph();
+
+		std::vector<PortalVisibility::View> views;
+		std::vector<int> cameras;
+		for (size_t cluster = 0; cluster < graph.GetClusterCount(); cluster++) {
+			float origin[3];
+			if (!GetClusterCentroid(graph, static_cast<int>(cluster), origin)) continue;
+			for (int step = 0; step < kYawSteps; step++) {
+				views.push_back(MakeView(origin, 360.0f * step / kYawSteps, 90.0f, 16.0f / 9.0f));
+				cameras.push_back(static_cast<int>(cluster));
+			}
+		}
+		if (views.empty()) {
+			CHECK(false, "%s: no cluster to stand in", path);
+			return;
+		}
+
+		std::vector<double> times(views.size(), 0.0);
+		size_t visible = 0, tested = 0, truncated = 0;
+		for (int repeat = 0; repeat < kRepeats; repeat++) {
+			for (size_t v = 0; v < views.size(); v++) {
+				auto start = std::chrono::steady_clock::now();
+				size_t count = portals.Update(views[v], cameras[v], nullptr);
+				double elapsed = MillisecondsSince(start);
+				times[v] = repeat ? std::min(times[v], elapsed) : elapsed;
+
+				if (repeat == 0) {
+					visible += count;
+					tested += portals.GetStats().portalsTested;
+					truncated += portals.GetStats().truncated;
+				}
+			}
+		}
+
+		std::sort(times.begin(), times.end());
+		double total = 0.0;
+		for (double t : times) total += t;
+
+		printf("%-36s %5zu views  mean %.4f ms  p50 %.4f  p99 %.4f  max %.4f  |  %.1f of %zu clusters visible, %.0f portals tested, %zu truncated\n",
+			path, views.size(), total / views.size(), times[times.size() / 2], times[times.size() * 99 / 100], times.back(),
+			static_cast<double>(visible) / views.size(), graph.GetClusterCount(), static_cast<double>(tested) / views.size(), truncated);
+	}
+}
+
+int main(int argc, char** argv) {
+	int maps = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!LoadPortalFile(argv[i])) {
+			CHECK(false, "%s does not load", argv[i]);
+			continue;
+		}
+		const char* name = strrchr(argv[i], '/');
+		BenchMap(name ? name + 1 : argv[i]);
+		maps++;
+	}
+
+	if (maps == 0) {
+		printf("No portal files given\n");
+		return kSkipExitCode;
+	}
+	return g_failures ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "test_support.h"
+#include "../source/visibility/portal_visibility.h"
+#include <cmath>
+
+// Views for flooding the shipped .prt files without their BSP: the camera
+// sits at the middle of a cluster's portals and the cluster is given
+// directly instead of found in the tree.
+
+// Average of the portal centres around a cluster, inside it when the
+// cluster is convex and near enough to it otherwise
+inline bool GetClusterCentroid(const PortalGraph& graph, int cluster, float out[3]) {
+	size_t count;
+	const PortalGraph::Link* links = graph.GetLinks(cluster, count);
+	if (!links || !count) return false;
+
+	out[0] = out[1] = out[2] = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		const PortalGraph::Vec3& center = graph.GetPortals()[links[i].portal].center;
+		out[0] += center.x;
+		out[1] += center.y;
+		out[2] += center.z;
+	}
+	for (int axis = 0; axis < 3; axis++) out[axis] /= count;
+	return true;
+}
+
+// Level view turned yawDegrees around z, the engine's forward/right/up
+inline PortalVisibility::View MakeView(const float origin[3], float yawDegrees, float fov, float aspect) {
+	float yaw = yawDegrees * 3.14159265f / 180.0f;
+	PortalVisibility::View view = {
+		{ origin[0], origin[1], origin[2] },
+		{ cosf(yaw), sinf(yaw), 0.0f },
+		{ sinf(yaw), -cosf(yaw), 0.0f },
+		{ 0.0f, 0.0f, 1.0f },
+		fov,
+		aspect,
+	};
+	return view;
+}
+
+inline bool LoadPortalFile(const char* path) {
+	std::vector<uint8_t> data;
+	if (!ReadWholeFile(path, data)) return false;
+	return PortalVisibility::Instance().Load(reinterpret_cast<const char*>(data.data()), data.size());
+}
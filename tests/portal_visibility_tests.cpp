@@ -0,0 +1,204 @@
+// PortalGraph and the PortalVisibility flood on the .prt files the addon
+// ships (addon/maps).
+//
+//   portal_visibility_tests <map.prt> ...
+//
+// The BSPs are not shipped, so every view is flooded from a cluster given
+// directly (see portal_support.h). Every cluster the flood reaches has to be
+// next to one it came from through a portal that is in the view at all, a
+// PVS row has to bound the result, and the result has to go stale.
+#include "portal_support.h"
+#include "../source/visibility/view_frustum.h"
+#include <thread>
+
+namespace {
+	// The flood's own 5 degrees of slack, plus one for the clip epsilon it
+	// lets through at every portal, which adds up down a long path
+	constexpr float kFovMarginDegrees = 6.0f;
+	// Same as the flood's on plane test
+	constexpr float kOnPlaneEpsilon = 1.0f;
+	const float kYaws[] = { 0.0f, 45.0f, 90.0f, 135.0f, 180.0f, 225.0f, 270.0f, 315.0f };
+
+	// Counts in the PRT1 header
+	bool ReadHeader(const char* path, size_t& clusters, size_t& portals) {
+		FILE* file = fopen(path, "r");
+		if (!file) return false;
+		char magic[8] = {};
+		bool ok = fscanf(file, "%7s %zu %zu", magic, &clusters, &portals) == 3 && strcmp(magic, "PRT1") == 0;
+		fclose(file);
+		return ok;
+	}
+
+	float Dot(const float a[3], const PortalGraph::Vec3& b) {
+		return a[0] * b.x + a[1] * b.y + a[2] * b.z;
+	}
+
+	// Whether any of the winding is inside all the planes
+	bool IsWindingInFrustum(const PortalGraph& graph, const PortalGraph::Portal& portal, const FrustumPlane* frustum, size_t planeCount) {
+		const PortalGraph::Vec3* points = graph.GetPoints(portal);
+		std::vector<PortalGraph::Vec3> winding(points, points + portal.pointCount), clipped;
+
+		for (size_t p = 0; p < planeCount && !winding.empty(); p++) {
+			clipped.clear();
+			for (size_t i = 0; i < winding.size(); i++) {
+				const PortalGraph::Vec3& a = winding[i];
+				const PortalGraph::Vec3& b = winding[(i + 1) % winding.size()];
+				float da = Dot(frustum[p].normal, a) - frustum[p].dist;
+				float db = Dot(frustum[p].normal, b) - frustum[p].dist;
+				if (da >= 0.0f) clipped.push_back(a);
+				if ((da >= 0.0f) != (db >= 0.0f)) {
+					float t = da / (da - db);
+					clipped.push_back({ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t });
+				}
+			}
+			winding.swap(clipped);
+		}
+		return !winding.empty();
+	}
+
+	// Every visible cluster but the camera's was stepped into from a visible
+	// neighbour, through a portal the eye stands in or the view can see
+	void CheckFlow(const char* path, const PortalVisibility::View& view, int camera, float yaw) {
+		const PortalVisibility& portals = PortalVisibility::Instance();
+		const PortalGraph& graph = portals.GetGraph();
+		const ClusterSet& visible = portals.GetVisibleClusters();
+		CHECK(visible.Test(camera), "%s: camera cluster %d is not visible", path, camera);
+		if (portals.GetStats().truncated) return;
+
+		FrustumPlane frustum[4];
+		size_t planeCount = BuildViewFrustum(view.origin, view.forward, view.right, view.up, view.fov, view.aspect,
+			kFovMarginDegrees, frustum);
+
+		for (size_t cluster = 0; cluster < graph.GetClusterCount(); cluster++) {
+			if (static_cast<int>(cluster) == camera || !visible.Test(static_cast<int>(cluster))) continue;
+
+			size_t count;
+			const PortalGraph::Link* links = graph.GetLinks(static_cast<int>(cluster), count);
+			bool reached = false;
+			for (size_t i = 0; i < count && !reached; i++) {
+				if (!visible.Test(links[i].neighbor)) continue;
+				const PortalGraph::Portal& portal = graph.GetPortals()[links[i].portal];
+				reached = fabsf(Dot(view.origin, portal.normal) - portal.dist) < kOnPlaneEpsilon ||
+					IsWindingInFrustum(graph, portal, frustum, planeCount);
+			}
+			CHECK(reached, "%s: cluster %zu visible from %d, yaw %.0f, without a portal in view", path, cluster, camera, yaw);
+		}
+	}
+
+	void CheckMap(const char* file, const char* path) {
+		PortalVisibility& portals = PortalVisibility::Instance();
+		const PortalGraph& graph = portals.GetGraph();
+
+		size_t headerClusters = 0, headerPortals = 0;
+		CHECK(ReadHeader(file, headerClusters, headerPortals), "%s: no PRT1 header", path);
+		CHECK(graph.GetClusterCount() == headerClusters, "%s: %zu clusters, header says %zu", path, graph.GetClusterCount(), headerClusters);
+		CHECK(graph.GetPortals().size() == headerPortals, "%s: %zu portals, header says %zu", path, graph.GetPortals().size(), headerPortals);
+
+		// Both sides of every portal link back to it
+		std::vector<size_t> sides(graph.GetPortals().size(), 0);
+		for (size_t cluster = 0; cluster < graph.GetClusterCount(); cluster++) {
+			size_t count;
+			const PortalGraph::Link* links = graph.GetLinks(static_cast<int>(cluster), count);
+			for (size_t i = 0; i < count; i++) {
+				const PortalGraph::Portal& portal = graph.GetPortals()[links[i].portal];
+				bool matches = (portal.clusters[0] == static_cast<int>(cluster) && portal.clusters[1] == links[i].neighbor) ||
+					(portal.clusters[1] == static_cast<int>(cluster) && portal.clusters[0] == links[i].neighbor);
+				CHECK(matches, "%s: link from %zu through portal %u", path, cluster, links[i].portal);
+				sides[links[i].portal]++;
+			}
+		}
+		for (size_t p = 0; p < sides.size(); p++) {
+			CHECK(sides[p] == 2, "%s: portal %zu is linked from %zu clusters", path, p, sides[p]);
+		}
+
+		// A PVS row that drops every other cluster, besides the camera's
+		std::vector<uint64_t> pvs(ClusterSet::WordsFor(graph.GetClusterCount()), 0x5555555555555555ull);
+
+		size_t views = 0, visibleTotal = 0;
+		for (size_t cluster = 0; cluster < graph.GetClusterCount(); cluster++) {
+			float origin[3];
+			if (!GetClusterCentroid(graph, static_cast<int>(cluster), origin)) continue;
+
+			for (float yaw : kYaws) {
+				PortalVisibility::View view = MakeView(origin, yaw, 90.0f, 16.0f / 9.0f);
+				size_t count = portals.Update(view, static_cast<int>(cluster), nullptr);
+				CHECK(count > 0 && portals.IsValid(), "%s: no result from cluster %zu", path, cluster);
+				CheckFlow(path, view, static_cast<int>(cluster), yaw);
+				views++;
+				visibleTotal += count;
+
+				// The same view keeps the set, turning by a degree floods again
+				ClusterSet first = portals.GetVisibleClusters();
+				CHECK(portals.Update(view, static_cast<int>(cluster), nullptr) == count && portals.GetStats().reused,
+					"%s: cluster %zu, yaw %.0f not reused", path, cluster, yaw);
+				first.Xor(portals.GetVisibleClusters());
+				CHECK(first.Count() == 0, "%s: cluster %zu, yaw %.0f differs between updates", path, cluster, yaw);
+				portals.Update(MakeView(origin, yaw + 1.0f, 90.0f, 16.0f / 9.0f), static_cast<int>(cluster), nullptr);
+				CHECK(!portals.GetStats().reused, "%s: cluster %zu, yaw %.0f reused after turning", path, cluster, yaw);
+
+				portals.Update(view, static_cast<int>(cluster), pvs.data());
+				for (size_t other = 0; other < graph.GetClusterCount(); other++) {
+					if (other == cluster || !portals.GetVisibleClusters().Test(static_cast<int>(other))) continue;
+					CHECK((pvs[other >> 6] >> (other & 63)) & 1, "%s: cluster %zu visible outside the PVS", path, other);
+				}
+			}
+		}
+		CHECK(views > 0, "%s: no cluster to stand in", path);
+
+		printf("%-36s %5zu clusters %5zu portals, %zu views, %.1f clusters visible on average\n", path,
+			graph.GetClusterCount(), graph.GetPortals().size(), views, views ? static_cast<double>(visibleTotal) / views : 0.0);
+
+		// Out of range camera clusters give nothing, and nothing is hidden
+		float zero[3] = { 0.0f, 0.0f, 0.0f };
+		CHECK(portals.Update(MakeView(zero, 0.0f, 90.0f, 1.0f), static_cast<int>(graph.GetClusterCount()), nullptr) == 0,
+			"%s: out of range camera cluster", path);
+		CHECK(!portals.IsValid() && portals.IsClusterVisible(0), "%s: invalid update is used", path);
+	}
+
+	// An update is only trusted for half a second
+	void CheckStale() {
+		PortalVisibility& portals = PortalVisibility::Instance();
+		const PortalGraph& graph = portals.GetGraph();
+
+		float origin[3];
+		if (!GetClusterCentroid(graph, 0, origin)) return;
+		portals.Update(MakeView(origin, 0.0f, 10.0f, 1.0f), 0, nullptr);
+
+		int hidden = -1;
+		for (size_t cluster = 0; cluster < graph.GetClusterCount() && hidden < 0; cluster++) {
+			if (!portals.IsClusterVisible(static_cast<int>(cluster))) hidden = static_cast<int>(cluster);
+		}
+		CHECK(portals.IsValid() && hidden >= 0, "a narrow view hides nothing");
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(600));
+		CHECK(!portals.IsValid(), "still valid after 600 ms");
+		CHECK(portals.IsClusterVisible(hidden), "cluster %d still hidden by a stale update", hidden);
+	}
+}
+
+int main(int argc, char** argv) {
+	int maps = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!LoadPortalFile(argv[i])) {
+			CHECK(false, "%s does not load", argv[i]);
+			continue;
+		}
+		const char* name = strrchr(argv[i], '/');
+		CheckMap(argv[i], name ? name + 1 : argv[i]);
+		maps++;
+	}
+
+	if (maps == 0) {
+		printf("No portal files given\n");
+		return kSkipExitCode;
+	}
+
+	// No BSP behind the graph, the MapVisibility path refuses to run
+	float origin[3] = { 0.0f, 0.0f, 0.0f };
+	CHECK(PortalVisibility::Instance().Update(MakeView(origin, 0.0f, 90.0f, 1.0f)) == 0, "updated without a map");
+
+	CheckStale();
+
+	printf("%d maps, %d failures\n", maps, g_failures);
+	return g_failures ? 1 : 0;
+}
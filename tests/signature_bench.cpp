@@ -0,0 +1,105 @@
+// Compiled, anchor searched signatures against the old string parsing
+// ScanSign over real PE images read from disk.
+//
+//   signature_bench <image.dll|exe> ...
+//
+// Every signature is resolved by the old scanner, by FindSignature one at a
+// time and by FindSignatures in a single pass; all three must agree.
+#include "test_support.h"
+#include "../source/signatures/signature.h"
+
+namespace {
+	constexpr size_t kGeneratedSignatures = 24;
+	constexpr int kRepeats = 20;
+
+	struct Totals {
+		double megabytes = 0.0;
+		double reference = 0.0;
+		double single = 0.0;
+		double multi = 0.0;
+	};
+
+	void BenchImage(const char* path, const std::vector<uint8_t>& data, Totals& totals) {
+		std::vector<std::string> sources(std::begin(kShippedSignatures), std::end(kShippedSignatures));
+		std::vector<std::string> generated = MakeSignatures(data.data(), data.size(), kGeneratedSignatures,
+			static_cast<uint32_t>(data.size()));
+		sources.insert(sources.end(), generated.begin(), generated.end());
+
+		std::vector<CompiledSignature> compiled(sources.size());
+		for (size_t i = 0; i < sources.size(); i++) {
+			compiled[i].Compile(sources[i].c_str(), sources[i].size());
+		}
+
+		// The old scanner, once, it is slow enough
+		auto start = std::chrono::steady_clock::now();
+		std::vector<const uint8_t*> expected(sources.size());
+		for (size_t i = 0; i < sources.size(); i++) {
+			expected[i] = ReferenceScanSign(data.data(), data.size(), sources[i].c_str(), sources[i].size());
+		}
+		double reference = MillisecondsSince(start);
+
+		const uint8_t* begin = data.data();
+		start = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < kRepeats; repeat++) {
+			for (size_t i = 0; i < sources.size(); i++) {
+				const uint8_t* end = begin + data.size() - sources[i].size();
+				const uint8_t* found = FindSignature(begin, end, compiled[i].GetPattern());
+				if (repeat == 0) {
+					CHECK(found == expected[i], "%s: '%s' FindSignature at %td, old scanner at %td", path,
+						sources[i].c_str(), found ? found - begin : -1, expected[i] ? expected[i] - begin : -1);
+				}
+			}
+		}
+		double single = MillisecondsSince(start) / kRepeats;
+
+		std::vector<SignatureScanJob> jobs(sources.size());
+		start = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < kRepeats; repeat++) {
+			for (size_t i = 0; i < sources.size(); i++) {
+				jobs[i].pattern = compiled[i].GetPattern();
+				jobs[i].end = begin + data.size() - sources[i].size();
+			}
+			FindSignatures(begin, jobs.data(), jobs.size());
+		}
+		double multi = MillisecondsSince(start) / kRepeats;
+
+		for (size_t i = 0; i < sources.size(); i++) {
+			CHECK(jobs[i].result == expected[i], "%s: '%s' FindSignatures at %td, old scanner at %td", path,
+				sources[i].c_str(), jobs[i].result ? jobs[i].result - begin : -1, expected[i] ? expected[i] - begin : -1);
+		}
+
+		double megabytes = data.size() / (1024.0 * 1024.0);
+		printf("%-40s %7.2f MB %3zu sigs  old %9.2f ms  single %7.3f ms (%6.0fx)  one pass %7.3f ms (%6.0fx)\n",
+			path, megabytes, sources.size(), reference, single, reference / single, multi, reference / multi);
+
+		totals.megabytes += megabytes;
+		totals.reference += reference;
+		totals.single += single;
+		totals.multi += multi;
+	}
+}
+
+int main(int argc, char** argv) {
+	Totals totals;
+	int images = 0;
+	for (int i = 1; i < argc; i++) {
+		std::vector<uint8_t> data;
+		if (!ReadWholeFile(argv[i], data) || data.size() < 4096) {
+			printf("Skipping %s, unreadable or too small\n", argv[i]);
+			continue;
+		}
+		const char* name = strrchr(argv[i], '/');
+		BenchImage(name ? name + 1 : argv[i], data, totals);
+		images++;
+	}
+
+	if (images == 0) {
+		printf("No PE images given, set RTX_FIXES_PE_FILES when configuring\n");
+		return kSkipExitCode;
+	}
+
+	printf("\n%d images, %.2f MB: old %.1f ms, single %.2f ms (%.0fx), one pass %.2f ms (%.0fx)\n",
+		images, totals.megabytes, totals.reference, totals.single, totals.reference / totals.single,
+		totals.multi, totals.reference / totals.multi);
+	return g_failures ? 1 : 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdint>
+
+// Stand-in for the few Win32 calls vtable_hook.cpp makes, over mprotect and
+// the GCC atomics
+typedef unsigned long DWORD;
+typedef void* PVOID;
+typedef int BOOL;
+
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+
+// Linux can't report a page's old protection, vtables are read-only so
+// that is what is handed back
+inline BOOL VirtualProtect(void* address, size_t size, DWORD protect, DWORD* oldProtect) {
+	uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	uintptr_t first = reinterpret_cast<uintptr_t>(address) & ~(page - 1);
+	uintptr_t last = reinterpret_cast<uintptr_t>(address) + size;
+	int flags = protect == PAGE_READWRITE ? PROT_READ | PROT_WRITE : PROT_READ;
+
+	if (oldProtect) *oldProtect = PAGE_READONLY;
+	return mprotect(reinterpret_cast<void*>(first), last - first, flags) == 0;
+}
+
+inline PVOID InterlockedExchangePointer(PVOID volatile* target, PVOID value) {
+	return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdarg>
+#include <cstdio>
+
+// Stand-in for the SDK's tier0 logging so the visibility code builds
+// without the game, everything goes to stdout
+inline void Msg(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
+inline void Warning(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Shared bits of the Linux test and benchmark programs. No framework: a
+// program counts its failed checks and exits non-zero if there were any, or
+// with kSkipExitCode when it had no input to work on.
+
+constexpr int kSkipExitCode = 77;
+
+inline int g_failures = 0;
+
+#define CHECK(condition, ...) \
+	do { \
+		if (!(condition)) { \
+			g_failures++; \
+			printf("FAILED %s:%d: %s: ", __FILE__, __LINE__, #condition); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while (0)
+
+inline bool ReadWholeFile(const char* path, std::vector<uint8_t>& out) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The scanner ScanSign had before signatures were compiled, kept verbatim
+// over a plain buffer as the reference the new one must agree with
+inline const uint8_t* ReferenceScanSign(const uint8_t* base, size_t size, const char* sig, size_t len) {
+	if (size < len) return nullptr;
+
+	const uint8_t* ptr = base;
+	const uint8_t* end = base + size - len;
+	bool found = true;
+	while (ptr < end) {
+		const uint8_t* tmp = ptr;
+		for (size_t i = 0; i < len; ++i) {
+			if (sig[i] == ' ') { continue; }
+			if (sig[i] == '?') { tmp++; continue; }
+
+			if (tmp[0] != strtoul(&sig[i], NULL, 16)) {
+				found = false;
+				break;
+			}
+			i++;
+			tmp++;
+		}
+
+		if (found)
+			return ptr;
+
+		++ptr;
+		found = true;
+	}
+
+	return nullptr;
+}
+
+// Signatures the module scans for in the game's DLLs, they mostly miss in
+// other images, which is the slow case
+inline const char* const kShippedSignatures[] = {
+	"0F B6 81 54 03 00 00 C3",
+	"48 63 C8 99 F7 F9",
+	"89 51 34 89 38 48 89 D9",
+	"8B F2 44 0F B6 C0",
+	"F7 F9 03 C1 0F AF C1",
+	"42 89 44 24 20 44 89 44 24 28",
+	"48 8D 4C 24 20 E8",
+	"BA E1 0D 74 5E 48 89 1D ?? ?? ?? ??",
+	"48 89 54 24 10 48 89 4C 24 08 55 56 57 41 54 41 55 41 56 41 57 48 83 EC 50",
+};
+
+// Signatures cut from the image itself at pseudo random offsets, with some
+// bytes turned into '?' or "??" wildcards, so they hit
+inline std::vector<std::string> MakeSignatures(const uint8_t* data, size_t size, size_t count, uint32_t seed) {
+	std::vector<std::string> signatures;
+	if (size < 64) return signatures;
+
+	uint32_t state = seed;
+	auto next = [&state]() {
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	};
+
+	for (size_t s = 0; s < count; s++) {
+		size_t length = 6 + next() % 18;
+		size_t offset = next() % (size - length);
+
+		std::string sig;
+		for (size_t i = 0; i < length; i++) {
+			if (i) sig += ' ';
+			uint32_t roll = next() % 8;
+			if (i > 0 && roll == 0) {
+				sig += '?';
+			} else if (i > 0 && roll == 1) {
+				sig += "??";
+				i++;
+			} else {
+				char byte[3];
+				snprintf(byte, sizeof(byte), "%02X", data[offset + i]);
+				sig += byte;
+			}
+		}
+		signatures.push_back(sig);
+	}
+	return signatures;
+}
@@ -0,0 +1,172 @@
+// VTableHook on a synthetic interface: a call through the swapped slot
+// against the unhooked call and against an inline detour, which enters its
+// hook through a jump patched over the function and calls the original
+// through a trampoline.
+//
+//   vtable_hook_bench
+//
+// Also checks that hooks on one slot stack and unlink in any order.
+#include "test_support.h"
+#include "../source/vtable_hook.h"
+#include <sys/mman.h>
+#include <algorithm>
+
+namespace {
+	constexpr int kCalls = 20000000;
+	constexpr int kRepeats = 5;
+
+	// Stands in for IDirect3DDevice9: no virtual destructor, so the slots
+	// follow declaration order on both ABIs
+	struct ICounter {
+		virtual int Add(int value) = 0;
+		virtual int Get() = 0;
+	};
+
+	struct Counter : ICounter {
+		int total = 0;
+		int Add(int value) override;
+		int Get() override { return total; }
+	};
+
+	__attribute__((noinline)) int Counter::Add(int value) {
+		total += value;
+		return total;
+	}
+
+	using AddFn = int (*)(ICounter*, int);
+
+	void** GetSlots(ICounter* object) {
+		return *reinterpret_cast<void***>(object);
+	}
+
+	// The compiler knows what a vtable was initialized with and would read
+	// that instead of what the hook wrote
+	void* ReadSlot(void** slots, size_t index) {
+		return *reinterpret_cast<void* volatile*>(&slots[index]);
+	}
+
+	// What a virtual call compiles to, written out so it can't be
+	// devirtualized
+	int CallAdd(ICounter* object, int value) {
+		return reinterpret_cast<AddFn>(ReadSlot(GetSlots(object), 0))(object, value);
+	}
+
+	AddFn g_originalAdd = nullptr;
+	AddFn g_upperOriginalAdd = nullptr;
+	AddFn g_trampoline = nullptr;
+	int g_detourCalls = 0;
+	int g_upperDetourCalls = 0;
+
+	int DetourAdd(ICounter* self, int value) {
+		g_detourCalls++;
+		return g_originalAdd(self, value);
+	}
+
+	int UpperDetourAdd(ICounter* self, int value) {
+		g_upperDetourCalls++;
+		return g_upperOriginalAdd(self, value);
+	}
+
+	int TrampolineDetourAdd(ICounter* self, int value) {
+		g_detourCalls++;
+		return g_trampoline(self, value);
+	}
+
+	double NanosecondsPerCall(ICounter* object) {
+		double best = 0.0;
+		for (int repeat = 0; repeat < kRepeats; repeat++) {
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < kCalls; i++) {
+				CallAdd(object, 1);
+			}
+			double elapsed = MillisecondsSince(start) * 1e6 / kCalls;
+			best = repeat ? std::min(best, elapsed) : elapsed;
+		}
+		return best;
+	}
+
+	void TestStacking() {
+		Counter counter;
+		void** slots = GetSlots(&counter);
+		void* unhooked = ReadSlot(slots, 0);
+
+		VTableHook lower, upper;
+		CHECK(lower.Create(slots, 0, &DetourAdd, &g_originalAdd), "Create failed");
+		CHECK(upper.Create(slots, 0, &UpperDetourAdd, &g_upperOriginalAdd), "Create failed");
+		CHECK(lower.Enable() && upper.Enable(), "Enable failed");
+		CHECK(ReadSlot(slots, 0) == reinterpret_cast<void*>(&UpperDetourAdd), "slot holds %p", ReadSlot(slots, 0));
+		CHECK(g_upperOriginalAdd == &DetourAdd, "upper hook does not chain to the lower one");
+
+		g_detourCalls = g_upperDetourCalls = 0;
+		CHECK(CallAdd(&counter, 2) == 2, "call returned %d", counter.Get());
+		CHECK(g_detourCalls == 1 && g_upperDetourCalls == 1, "detours ran %d and %d times", g_detourCalls,
+			g_upperDetourCalls);
+
+		// Lower first, the upper one has to be relinked past it
+		CHECK(lower.Disable(), "Disable failed");
+		CHECK(reinterpret_cast<void*>(g_upperOriginalAdd) == unhooked, "upper hook was not relinked");
+		CHECK(CallAdd(&counter, 3) == 5 && g_detourCalls == 1 && g_upperDetourCalls == 2,
+			"call after unlinking the lower hook");
+
+		CHECK(upper.Disable(), "Disable failed");
+		CHECK(ReadSlot(slots, 0) == unhooked, "slot not restored");
+		CHECK(CallAdd(&counter, 1) == 6 && g_upperDetourCalls == 2, "call after unhooking");
+	}
+
+	// jmp [rip + 0] followed by the target, the way a hook library leaves
+	// both the patched function entry and the trampoline's jump back
+	void WriteJump(uint8_t* code, void* target) {
+		const uint8_t jump[] = { 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 };
+		memcpy(code, jump, sizeof(jump));
+		memcpy(code + sizeof(jump), &target, sizeof(target));
+	}
+}
+
+int main() {
+	TestStacking();
+
+	Counter counter;
+	ICounter* object = &counter;
+
+	double direct = NanosecondsPerCall(object);
+
+	VTableHook hook;
+	CHECK(hook.Create(GetSlots(object), 0, &DetourAdd, &g_originalAdd) && hook.Enable(), "hook failed");
+	g_detourCalls = 0;
+	double hooked = NanosecondsPerCall(object);
+	CHECK(g_detourCalls == kCalls * kRepeats, "detour ran %d times", g_detourCalls);
+	CHECK(hook.Disable(), "Disable failed");
+
+	printf("direct %.2f ns, vtable hook %.2f ns (%+.2f)", direct, hooked, hooked - direct);
+
+#if defined(__x86_64__)
+	// Inline detour: the slot is left alone, the function entry jumps to the
+	// detour and the detour calls the original through a trampoline. The
+	// object gets its own copy of the vtable so the real function is not
+	// patched.
+	void* page = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	CHECK(page != MAP_FAILED, "mmap failed");
+	if (page == MAP_FAILED) return 1;
+
+	uint8_t* patched = static_cast<uint8_t*>(page);
+	uint8_t* trampoline = patched + 64;
+	WriteJump(patched, reinterpret_cast<void*>(&TrampolineDetourAdd));
+	WriteJump(trampoline, ReadSlot(GetSlots(object), 0));
+	mprotect(page, 4096, PROT_READ | PROT_EXEC);
+	g_trampoline = reinterpret_cast<AddFn>(trampoline);
+
+	Counter patchedCounter;
+	void* slots[2] = { patched, ReadSlot(GetSlots(&patchedCounter), 1) };
+	*reinterpret_cast<void***>(&patchedCounter) = slots;
+
+	g_detourCalls = 0;
+	double inlined = NanosecondsPerCall(&patchedCounter);
+	CHECK(g_detourCalls == kCalls * kRepeats && patchedCounter.Get() == kCalls * kRepeats,
+		"inline detour ran %d times", g_detourCalls);
+	printf(", inline detour %.2f ns (%+.2f)", inlined, inlined - direct);
+	munmap(page, 4096);
+#endif
+
+	printf("\n");
+	return g_failures ? 1 : 0;
+}